@@ -0,0 +1,486 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "bsp/audio.h"
+#include "bsp/board.h"
+#include "bsp_audio_priv.h"
+#include "bsp_audio_stream.h"
+
+#if !CONFIG_BSP_AUDIO_FILE_SINK
+#include "driver/i2s_std.h"
+#endif
+
+static const char *TAG = "BSP_AUDIO";
+
+#define AUDIO_OUT_FRAME_BYTES   (4)     /* 16 bit stereo */
+#define AUDIO_BLOCK_FRAMES      CONFIG_BSP_AUDIO_DMA_FRAME_NUM
+#define AUDIO_RING_SIZE         (CONFIG_BSP_AUDIO_RING_BUFFER_KB * 1024)
+#define AUDIO_PATH_MAX          (64)
+
+typedef struct {
+    char path[AUDIO_PATH_MAX];
+    uint32_t generation;            /* Of the bsp_audio_play() call, stale once another play or stop ran */
+} audio_request_t;
+#if CONFIG_BSP_AUDIO_FILE_SINK
+#define AUDIO_DRAIN_BLOCKS      (0)     /* Writes are synchronous */
+#else
+#define AUDIO_DRAIN_BLOCKS      CONFIG_BSP_AUDIO_DMA_DESC_NUM   /* Moves the last samples through every DMA buffer */
+#endif
+
+static struct {
+    bsp_audio_config_t config;
+#if CONFIG_BSP_AUDIO_FILE_SINK
+    FILE *sink;
+#else
+    i2s_chan_handle_t tx;
+#endif
+    uint32_t out_rate;
+    bool out_enabled;
+    TaskHandle_t reader;
+    TaskHandle_t output;
+    QueueHandle_t play_queue;
+    audio_stream_t stream;          /* Ring buffer and handoff between the reader and the output task */
+    volatile bool counting;         /* Count DMA underruns only while samples are being fed */
+    volatile uint32_t gain;         /* Q8 */
+    bsp_audio_stats_t stats;
+    int16_t block[AUDIO_BLOCK_FRAMES * 2];
+} s_audio;
+
+/**************************************************************************************************
+ *  Output sink
+ **************************************************************************************************/
+
+#if CONFIG_BSP_AUDIO_FILE_SINK
+
+static esp_err_t audio_sink_init(void)
+{
+    s_audio.sink = fopen(CONFIG_BSP_AUDIO_FILE_SINK_PATH, "wb");
+    ESP_RETURN_ON_FALSE(s_audio.sink, ESP_FAIL, TAG, "Cannot open %s", CONFIG_BSP_AUDIO_FILE_SINK_PATH);
+    ESP_LOGW(TAG, "Audio output goes to %s", CONFIG_BSP_AUDIO_FILE_SINK_PATH);
+    s_audio.out_rate = s_audio.config.sample_rate;
+    return ESP_OK;
+}
+
+static void audio_sink_deinit(void)
+{
+    fclose(s_audio.sink);
+    s_audio.sink = NULL;
+}
+
+static esp_err_t audio_sink_set_rate(uint32_t sample_rate)
+{
+    s_audio.out_rate = sample_rate;
+    return ESP_OK;
+}
+
+static void audio_sink_enable(bool enable)
+{
+    s_audio.out_enabled = enable;
+    if (!enable) {
+        fflush(s_audio.sink);
+    }
+}
+
+static void audio_sink_write(const void *data, size_t len)
+{
+    /* Wait for the previous block to be consumed at the DAC rate, like the I2S DMA would */
+    vTaskDelay(MAX(1, pdMS_TO_TICKS((len / AUDIO_OUT_FRAME_BYTES) * 1000 / s_audio.out_rate)));
+    fwrite(data, 1, len, s_audio.sink);
+}
+
+static uint32_t audio_sink_queued_us(void)
+{
+    return 0;
+}
+
+#else
+
+static IRAM_ATTR bool audio_on_send_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    if (s_audio.counting) {
+        s_audio.stats.underruns++;
+    }
+    return false;
+}
+
+static esp_err_t audio_sink_init(void)
+{
+    esp_err_t ret = ESP_OK;
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(BSP_I2S_NUM, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = CONFIG_BSP_AUDIO_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_BLOCK_FRAMES;
+    chan_cfg.auto_clear = true;     /* Send silence instead of stale samples on underrun */
+    ESP_RETURN_ON_ERROR(i2s_new_channel(&chan_cfg, &s_audio.tx, NULL), TAG, "I2S channel failed");
+
+    const i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(s_audio.config.sample_rate),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = BSP_I2S_BCLK,
+            .ws = BSP_I2S_LRCK,
+            .dout = BSP_I2S_DOUT,
+            .din = I2S_GPIO_UNUSED,
+        },
+    };
+    ESP_GOTO_ON_ERROR(i2s_channel_init_std_mode(s_audio.tx, &std_cfg), err, TAG, "I2S std mode failed");
+
+    const i2s_event_callbacks_t cbs = {
+        .on_send_q_ovf = audio_on_send_q_ovf,
+    };
+    ESP_GOTO_ON_ERROR(i2s_channel_register_event_callback(s_audio.tx, &cbs, NULL), err, TAG, "I2S callback failed");
+    s_audio.out_rate = s_audio.config.sample_rate;
+    return ESP_OK;
+
+err:
+    i2s_del_channel(s_audio.tx);
+    s_audio.tx = NULL;
+    return ret;
+}
+
+static void audio_sink_deinit(void)
+{
+    i2s_del_channel(s_audio.tx);
+    s_audio.tx = NULL;
+}
+
+static void audio_sink_enable(bool enable)
+{
+    if (enable == s_audio.out_enabled) {
+        return;
+    }
+    s_audio.counting = false;
+    if (enable) {
+        i2s_channel_enable(s_audio.tx);
+    } else {
+        i2s_channel_disable(s_audio.tx);
+    }
+    s_audio.out_enabled = enable;
+}
+
+static esp_err_t audio_sink_set_rate(uint32_t sample_rate)
+{
+    if (sample_rate == s_audio.out_rate) {
+        return ESP_OK;
+    }
+    const i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
+    const bool enabled = s_audio.out_enabled;
+    audio_sink_enable(false);
+    ESP_RETURN_ON_ERROR(i2s_channel_reconfig_std_clock(s_audio.tx, &clk_cfg), TAG, "I2S clock %"PRIu32" Hz failed", sample_rate);
+    audio_sink_enable(enabled);
+    s_audio.out_rate = sample_rate;
+    return ESP_OK;
+}
+
+static void audio_sink_write(const void *data, size_t len)
+{
+    size_t written = 0;
+    i2s_channel_write(s_audio.tx, data, len, &written, portMAX_DELAY);
+    s_audio.counting = true;
+}
+
+/* Time until the block just written reaches the DAC: the other DMA buffers are played first */
+static uint32_t audio_sink_queued_us(void)
+{
+    return (uint64_t)(CONFIG_BSP_AUDIO_DMA_DESC_NUM - 1) * AUDIO_BLOCK_FRAMES * 1000000 / s_audio.out_rate;
+}
+
+#endif /* CONFIG_BSP_AUDIO_FILE_SINK */
+
+/**************************************************************************************************
+ *  Reader task
+ **************************************************************************************************/
+
+FILE *audio_open(const char *path, audio_format_t *fmt, uint32_t *ret_len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return NULL;
+    }
+
+    const char *ext = strrchr(path, '.');
+    if (ext && !strcasecmp(ext, ".wav")) {
+        const char *err = audio_wav_parse(f, fmt, ret_len);
+        if (err) {
+            ESP_LOGE(TAG, "%s: %s", path, err);
+            fclose(f);
+            return NULL;
+        }
+    } else {
+        fmt->channels = 2;
+        fmt->sample_rate = audio_default_rate();
+        *ret_len = UINT32_MAX;
+    }
+    return f;
+}
+
+/* Ask the output task to drop buffered samples and wait until it did */
+static void audio_reader_flush(void)
+{
+    audio_stream_flush(&s_audio.stream);
+    while (s_audio.stream.flush_req) {
+        xTaskNotifyGive(s_audio.output);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+}
+
+static void audio_reader_task(void *arg)
+{
+    audio_request_t req;
+    audio_format_t fmt;
+    uint32_t remaining;
+
+    for (;;) {
+        xQueueReceive(s_audio.play_queue, &req, portMAX_DELAY);
+        const uint32_t gen = req.generation;
+        const char *path = req.path;
+        audio_reader_flush();
+
+        FILE *f = audio_open(path, &fmt, &remaining);
+        if (f == NULL) {
+            continue;
+        }
+        ESP_LOGI(TAG, "Playing %s (%"PRIu32" Hz, %d ch)", path, fmt.sample_rate, fmt.channels);
+
+        audio_stream_publish(&s_audio.stream, &fmt, gen);
+        xTaskNotifyGive(s_audio.output);
+
+        while (audio_stream_current(&s_audio.stream, gen) && remaining > 0) {
+            if (audio_stream_fill(&s_audio.stream) == AUDIO_RING_SIZE) {
+                /* Full, the output task wakes us after each block */
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+                continue;
+            }
+            size_t n = audio_stream_fill_from(&s_audio.stream, f, remaining);
+            if (n == 0) {
+                break;
+            }
+            remaining -= (remaining == UINT32_MAX) ? 0 : n;
+            xTaskNotifyGive(s_audio.output);
+        }
+        fclose(f);
+
+        if (audio_stream_end(&s_audio.stream, gen)) {
+            xTaskNotifyGive(s_audio.output);
+        }
+    }
+}
+
+/**************************************************************************************************
+ *  Output task
+ **************************************************************************************************/
+
+/* Read the next block of the file into s_audio.block, returns the number of frames or AUDIO_STREAM_WAIT
+ * while the stream is prefetching or has just ended */
+static int audio_output_next(void)
+{
+    const int frames = audio_stream_next(&s_audio.stream, s_audio.block, AUDIO_BLOCK_FRAMES, s_audio.gain);
+
+    xTaskNotifyGive(s_audio.reader);
+    if (frames >= 0) {
+        audio_sink_set_rate(s_audio.stream.fmt.sample_rate);
+    }
+    return frames;
+}
+
+static void audio_output_task(void *arg)
+{
+    uint32_t drain = 0;     /* Silent blocks to write before the output can be disabled */
+
+    for (;;) {
+        if (audio_stream_take_flush(&s_audio.stream)) {
+            drain = 0;
+            xTaskNotifyGive(s_audio.reader);
+        }
+
+        const bool mixing = audio_mixer_active();
+        if (!s_audio.stream.ready && !mixing) {
+            if (drain > 0) {
+                /* i2s_channel_disable() drops the queued DMA buffers, play them out first */
+                memset(s_audio.block, 0, sizeof(s_audio.block));
+                audio_sink_write(s_audio.block, sizeof(s_audio.block));
+                drain--;
+                continue;
+            }
+            audio_sink_enable(false);
+            s_audio.stream.started = false;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        int frames = s_audio.stream.ready ? audio_output_next() : 0;
+        if (frames < 0) {
+            if (!mixing) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+                continue;
+            }
+            /* Keep sound effects going while the file is prefetched */
+            frames = 0;
+        }
+        memset(&s_audio.block[frames * 2], 0, (AUDIO_BLOCK_FRAMES - frames) * AUDIO_OUT_FRAME_BYTES);
+
+        audio_sink_enable(true);
+        audio_mixer_render(s_audio.block, AUDIO_BLOCK_FRAMES, s_audio.out_rate, s_audio.gain);
+        audio_sink_write(s_audio.block, sizeof(s_audio.block));
+        audio_mixer_queued(esp_timer_get_time() + audio_sink_queued_us());
+        s_audio.stats.bytes_played += sizeof(s_audio.block);
+        if (frames > 0 || mixing) {
+            /* The voice that ended in this block is still in the DMA buffers */
+            drain = AUDIO_DRAIN_BLOCKS;
+        }
+    }
+}
+
+uint32_t audio_default_rate(void)
+{
+    return s_audio.config.sample_rate;
+}
+
+bool audio_output_wake(void)
+{
+    if (s_audio.output == NULL) {
+        return false;
+    }
+    xTaskNotifyGive(s_audio.output);
+    return true;
+}
+
+/**************************************************************************************************
+ *  Public API
+ **************************************************************************************************/
+
+esp_err_t bsp_audio_init(const bsp_audio_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    bool sink = false;
+
+    assert(config && config->sample_rate);
+    ESP_RETURN_ON_FALSE(BSP_CAPS_AUDIO_SPEAKER, ESP_ERR_NOT_SUPPORTED, TAG, "No speaker on " BSP_BOARD_NAME);
+    ESP_RETURN_ON_FALSE(s_audio.output == NULL, ESP_ERR_INVALID_STATE, TAG, "Audio already initialized");
+
+    s_audio.config = *config;
+    s_audio.gain = 256;
+    s_audio.stats.ring_size = AUDIO_RING_SIZE;
+    uint8_t *ring = heap_caps_malloc(AUDIO_RING_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ring == NULL) {
+        ring = heap_caps_malloc(AUDIO_RING_SIZE, MALLOC_CAP_8BIT);
+    }
+    ESP_RETURN_ON_FALSE(ring, ESP_ERR_NO_MEM, TAG, "No memory for the ring buffer");
+    audio_stream_init(&s_audio.stream, ring, AUDIO_RING_SIZE);
+    ESP_GOTO_ON_FALSE(s_audio.play_queue = xQueueCreate(1, sizeof(audio_request_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    ESP_GOTO_ON_ERROR(audio_sink_init(), err, TAG, "Audio output failed");
+    sink = true;
+    audio_mixer_init();
+
+    /* Output task feeds the DMA and must preempt the file reader */
+    ESP_GOTO_ON_FALSE(xTaskCreate(audio_output_task, "audio_out", CONFIG_BSP_AUDIO_TASK_STACK, NULL,
+                                  CONFIG_BSP_AUDIO_TASK_PRIORITY + 1, &s_audio.output) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Audio output task failed");
+    ESP_GOTO_ON_FALSE(xTaskCreate(audio_reader_task, "audio_rd", CONFIG_BSP_AUDIO_TASK_STACK, NULL,
+                                  CONFIG_BSP_AUDIO_TASK_PRIORITY, &s_audio.reader) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Audio reader task failed");
+
+    ESP_LOGI(TAG, "Audio output %"PRIu32" Hz, %d KB ring buffer", config->sample_rate, CONFIG_BSP_AUDIO_RING_BUFFER_KB);
+    return ESP_OK;
+
+err:
+    /* The output task waits for a stream that never comes */
+    if (s_audio.output) {
+        vTaskDelete(s_audio.output);
+        s_audio.output = NULL;
+    }
+    if (sink) {
+        audio_sink_deinit();
+    }
+    if (s_audio.play_queue) {
+        vQueueDelete(s_audio.play_queue);
+        s_audio.play_queue = NULL;
+    }
+    heap_caps_free(ring);
+    s_audio.stream.ring = NULL;
+    return ret;
+}
+
+esp_err_t bsp_audio_play(const char *path)
+{
+    audio_request_t req;
+
+    assert(path);
+    ESP_RETURN_ON_FALSE(s_audio.output, ESP_ERR_INVALID_STATE, TAG, "Audio not initialized");
+    ESP_RETURN_ON_FALSE(strlen(path) < sizeof(req.path), ESP_ERR_INVALID_ARG, TAG, "Path too long");
+    strncpy(req.path, path, sizeof(req.path));
+
+    req.generation = audio_stream_cancel(&s_audio.stream);
+    xQueueOverwrite(s_audio.play_queue, &req);
+    return ESP_OK;
+}
+
+esp_err_t bsp_audio_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_audio.output, ESP_ERR_INVALID_STATE, TAG, "Audio not initialized");
+    audio_stream_cancel(&s_audio.stream);
+    xTaskNotifyGive(s_audio.output);
+    return ESP_OK;
+}
+
+bool bsp_audio_is_playing(void)
+{
+    return s_audio.stream.ready;
+}
+
+esp_err_t bsp_audio_set_volume(int percent)
+{
+    if (percent > 100) {
+        percent = 100;
+    }
+    if (percent < 0) {
+        percent = 0;
+    }
+    s_audio.gain = (percent * 256) / 100;
+    return ESP_OK;
+}
+
+void bsp_audio_get_stats(bsp_audio_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_audio.stats;
+    stats->starvations = s_audio.stream.starvations;
+    stats->ring_fill_min = s_audio.stream.fill_min;
+    stats->ring_fill = audio_stream_fill(&s_audio.stream);
+}
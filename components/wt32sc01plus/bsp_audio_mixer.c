@@ -0,0 +1,311 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/audio.h"
+#include "bsp_audio_priv.h"
+#include "bsp_audio_mix.h"
+#include "bsp_mpsc.h"
+
+static const char *TAG = "BSP_AUDIO_MIX";
+
+#define MIXER_VOICES            CONFIG_BSP_AUDIO_MIXER_VOICES
+#define MIXER_QUEUE_LEN         (16)    /* Power of two */
+#define MIXER_BLOCK_FRAMES      CONFIG_BSP_AUDIO_DMA_FRAME_NUM
+
+typedef struct {
+    struct bsp_audio_clip *clip;
+    int32_t gain;
+    int64_t trigger_us;
+} mixer_trigger_t;
+
+static struct {
+    bsp_mpsc_t queue;
+    uint32_t queue_seq[MIXER_QUEUE_LEN];
+    mixer_trigger_t triggers[MIXER_QUEUE_LEN];
+    bool queue_ready;
+    /* Owned by the output task */
+    audio_mix_voice_t voices[MIXER_VOICES];
+    int32_t acc[MIXER_BLOCK_FRAMES];
+    int64_t started_us[MIXER_QUEUE_LEN];
+    size_t started;
+    bsp_audio_mixer_stats_t stats;
+} s_mixer;
+
+/**************************************************************************************************
+ *  Trigger queue
+ **************************************************************************************************/
+
+void audio_mixer_init(void)
+{
+    bsp_mpsc_init(&s_mixer.queue, s_mixer.queue_seq, MIXER_QUEUE_LEN);
+    __atomic_store_n(&s_mixer.queue_ready, true, __ATOMIC_RELEASE);
+}
+
+static bool mixer_enqueue(struct bsp_audio_clip *clip, int32_t gain)
+{
+    uint32_t pos;
+
+    if (!bsp_mpsc_claim(&s_mixer.queue, &pos)) {
+        return false;
+    }
+    mixer_trigger_t *trigger = &s_mixer.triggers[pos % MIXER_QUEUE_LEN];
+    trigger->clip = clip;
+    trigger->gain = gain;
+    trigger->trigger_us = esp_timer_get_time();
+    bsp_mpsc_publish(&s_mixer.queue, pos);
+    return true;
+}
+
+static bool mixer_dequeue(mixer_trigger_t *trigger)
+{
+    uint32_t pos;
+
+    if (!bsp_mpsc_peek(&s_mixer.queue, &pos)) {
+        return false;
+    }
+    *trigger = s_mixer.triggers[pos % MIXER_QUEUE_LEN];
+    bsp_mpsc_release(&s_mixer.queue);
+    return true;
+}
+
+/**************************************************************************************************
+ *  Output task interface
+ **************************************************************************************************/
+
+bool audio_mixer_active(void)
+{
+    if (!s_mixer.queue_ready) {
+        return false;
+    }
+    for (size_t v = 0; v < MIXER_VOICES; v++) {
+        if (s_mixer.voices[v].clip) {
+            return true;
+        }
+    }
+    uint32_t pos;
+    return bsp_mpsc_peek(&s_mixer.queue, &pos);
+}
+
+static audio_mix_voice_t *mixer_voice_get(void)
+{
+    audio_mix_voice_t *best = NULL;
+    uint32_t best_left = UINT32_MAX;
+
+    for (size_t v = 0; v < MIXER_VOICES; v++) {
+        audio_mix_voice_t *voice = &s_mixer.voices[v];
+        if (voice->clip == NULL) {
+            return voice;
+        }
+        const uint32_t left = audio_mix_voice_end(voice) - voice->pos;
+        if (left < best_left) {
+            best_left = left;
+            best = voice;
+        }
+    }
+    s_mixer.stats.stolen++;
+    audio_mix_voice_release(best);
+    return best;
+}
+
+void audio_mixer_render(int16_t *block, size_t frames, uint32_t out_rate, uint32_t master_gain)
+{
+    mixer_trigger_t trigger;
+
+    assert(frames <= MIXER_BLOCK_FRAMES);
+    if (!s_mixer.queue_ready) {
+        return;
+    }
+    s_mixer.started = 0;
+    while (s_mixer.started < MIXER_QUEUE_LEN && mixer_dequeue(&trigger)) {
+        audio_mix_voice_t *voice = mixer_voice_get();
+        /* The trigger's reference on the clip passes to the voice */
+        voice->clip = trigger.clip;
+        voice->pos = 0;
+        voice->gain = trigger.gain;
+        s_mixer.started_us[s_mixer.started++] = trigger.trigger_us;
+        s_mixer.stats.triggers++;
+    }
+    audio_mix(block, frames, s_mixer.voices, MIXER_VOICES, out_rate, master_gain, s_mixer.acc);
+}
+
+void audio_mixer_queued(int64_t dac_time_us)
+{
+    for (size_t i = 0; i < s_mixer.started; i++) {
+        const uint32_t latency = dac_time_us - s_mixer.started_us[i];
+        s_mixer.stats.latency_us_last = latency;
+        s_mixer.stats.latency_us_max = MAX(s_mixer.stats.latency_us_max, latency);
+    }
+    s_mixer.started = 0;
+}
+
+/**************************************************************************************************
+ *  Public API
+ **************************************************************************************************/
+
+static struct bsp_audio_clip *mixer_clip_alloc(size_t frames, uint32_t sample_rate)
+{
+    const size_t size = sizeof(struct bsp_audio_clip) + frames * sizeof(int16_t);
+    struct bsp_audio_clip *clip;
+
+    if (frames == 0 || frames >= (UINT32_MAX >> AUDIO_MIX_POS_SHIFT) || size > CONFIG_BSP_AUDIO_CLIP_MAX_KB * 1024) {
+        return NULL;
+    }
+    clip = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (clip == NULL) {
+        clip = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    if (clip) {
+        clip->frames = frames;
+        clip->sample_rate = sample_rate;
+        clip->users = 0;
+    }
+    return clip;
+}
+
+esp_err_t bsp_audio_clip_create(const int16_t *pcm, size_t frames, uint32_t sample_rate, bsp_audio_clip_handle_t *ret_clip)
+{
+    assert(pcm && ret_clip && sample_rate);
+    struct bsp_audio_clip *clip = mixer_clip_alloc(frames, sample_rate);
+    ESP_RETURN_ON_FALSE(clip, ESP_ERR_NO_MEM, TAG, "No memory for %u samples", (unsigned)frames);
+    memcpy(clip->pcm, pcm, frames * sizeof(int16_t));
+    *ret_clip = clip;
+    return ESP_OK;
+}
+
+esp_err_t bsp_audio_clip_load(const char *path, bsp_audio_clip_handle_t *ret_clip)
+{
+    esp_err_t ret = ESP_OK;
+    audio_format_t fmt;
+    uint32_t len;
+    struct bsp_audio_clip *clip = NULL;
+
+    assert(path && ret_clip);
+    FILE *f = audio_open(path, &fmt, &len);
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "Cannot load %s", path);
+    if (len == UINT32_MAX) {
+        /* Raw PCM, up to the end of the file */
+        const long start = ftell(f);
+        fseek(f, 0, SEEK_END);
+        len = ftell(f) - start;
+        fseek(f, start, SEEK_SET);
+    }
+
+    const size_t frames = len / (fmt.channels * sizeof(int16_t));
+    ESP_GOTO_ON_FALSE(frames * sizeof(int16_t) <= CONFIG_BSP_AUDIO_CLIP_MAX_KB * 1024, ESP_ERR_INVALID_SIZE, err, TAG,
+                      "%s is too large for a clip", path);
+    clip = mixer_clip_alloc(frames, fmt.sample_rate);
+    ESP_GOTO_ON_FALSE(clip, ESP_ERR_NO_MEM, err, TAG, "No memory for %s", path);
+    for (size_t done = 0; done < frames;) {
+        int16_t lr[2 * 64];
+        const size_t n = MIN(frames - done, 64);
+        ESP_GOTO_ON_FALSE(fread(lr, fmt.channels * sizeof(int16_t), n, f) == n, ESP_FAIL, err, TAG, "Read error %s", path);
+        for (size_t i = 0; i < n; i++) {
+            /* Downmix stereo */
+            clip->pcm[done + i] = (fmt.channels == 2) ? (lr[2 * i] + lr[2 * i + 1]) / 2 : lr[i];
+        }
+        done += n;
+    }
+    fclose(f);
+    ESP_LOGI(TAG, "Clip %s: %u samples at %"PRIu32" Hz", path, (unsigned)frames, fmt.sample_rate);
+    *ret_clip = clip;
+    return ESP_OK;
+
+err:
+    free(clip);
+    fclose(f);
+    return ret;
+}
+
+esp_err_t bsp_audio_clip_delete(bsp_audio_clip_handle_t clip)
+{
+    assert(clip);
+    ESP_RETURN_ON_FALSE(__atomic_load_n(&clip->users, __ATOMIC_ACQUIRE) == 0, ESP_ERR_INVALID_STATE, TAG,
+                        "Clip is playing");
+    free(clip);
+    return ESP_OK;
+}
+
+esp_err_t bsp_audio_clip_play(bsp_audio_clip_handle_t clip, int volume)
+{
+    assert(clip);
+    ESP_RETURN_ON_FALSE(s_mixer.queue_ready, ESP_ERR_INVALID_STATE, TAG, "Audio not initialized");
+
+    volume = MAX(0, MIN(volume, 100));
+    /* Taken before the trigger is visible to the output task, which may finish the voice right away */
+    __atomic_fetch_add(&clip->users, 1, __ATOMIC_RELAXED);
+    if (!mixer_enqueue(clip, volume * 256 / 100)) {
+        __atomic_fetch_sub(&clip->users, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s_mixer.stats.dropped, 1, __ATOMIC_RELAXED);
+        return ESP_ERR_NO_MEM;
+    }
+    audio_output_wake();
+    return ESP_OK;
+}
+
+void bsp_audio_mixer_get_stats(bsp_audio_mixer_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_mixer.stats;
+    stats->voices_active = 0;
+    for (size_t v = 0; v < MIXER_VOICES; v++) {
+        stats->voices_active += (s_mixer.voices[v].clip != NULL);
+    }
+}
+
+uint32_t bsp_audio_mixer_benchmark(int voices, int blocks)
+{
+    struct bsp_audio_clip *clip = malloc(sizeof(struct bsp_audio_clip) + AUDIO_MIX_BENCH_CLIP_FRAMES * sizeof(int16_t));
+    audio_mix_voice_t *v = calloc(MAX(voices, 1), sizeof(audio_mix_voice_t));
+    int16_t *block = malloc(MIXER_BLOCK_FRAMES * 2 * sizeof(int16_t));
+    int32_t *acc = malloc(MIXER_BLOCK_FRAMES * sizeof(int32_t));
+    int64_t elapsed = 0;
+
+    if (clip && v && block && acc && blocks > 0) {
+        audio_mix_bench_clip(clip);
+        for (int b = 0; b < blocks; b++) {
+            audio_mix_bench_prepare(block, MIXER_BLOCK_FRAMES, v, voices, clip);
+            const int64_t start = esp_timer_get_time();
+            audio_mix(block, MIXER_BLOCK_FRAMES, v, voices, AUDIO_MIX_BENCH_RATE, 256, acc);
+            elapsed += esp_timer_get_time() - start;
+        }
+        ESP_LOGI(TAG, "%d voices: %"PRIu32" ns per %d frame block, %.2f%% of real time", voices,
+                 (uint32_t)(elapsed * 1000 / blocks), MIXER_BLOCK_FRAMES,
+                 100.0 * elapsed / blocks / (MIXER_BLOCK_FRAMES * 1e6 / AUDIO_MIX_BENCH_RATE));
+    }
+    free(acc);
+    free(block);
+    free(v);
+    free(clip);
+    return blocks > 0 ? elapsed * 1000 / blocks : 0;
+}
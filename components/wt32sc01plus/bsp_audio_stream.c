@@ -0,0 +1,215 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+#include <sys/param.h>
+
+#include "bsp_audio_stream.h"
+
+void audio_stream_init(audio_stream_t *s, uint8_t *ring, uint32_t size)
+{
+    memset(s, 0, sizeof(*s));
+    s->ring = ring;
+    s->size = size;
+}
+
+/*
+ * Play and stop cancel the stream: generation first, then ready. The reader publishes in the opposite
+ * order, so whichever of the two ran last, a cancelled stream ends up unpublished.
+ */
+uint32_t audio_stream_cancel(audio_stream_t *s)
+{
+    const uint32_t gen = __atomic_add_fetch(&s->generation, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->ready, false, __ATOMIC_SEQ_CST);
+    return gen;
+}
+
+static inline uint16_t audio_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t audio_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const char *audio_wav_parse(FILE *f, audio_format_t *fmt, uint32_t *ret_len)
+{
+    uint8_t hdr[12];
+    uint8_t chunk[8];
+    uint8_t fmt_chunk[16];
+    bool have_fmt = false;
+
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, "RIFF", 4) || memcmp(&hdr[8], "WAVE", 4)) {
+        return "Not a WAV file";
+    }
+
+    while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+        const uint32_t size = audio_le32(&chunk[4]);
+        if (!memcmp(chunk, "fmt ", 4) && size >= sizeof(fmt_chunk)) {
+            if (fread(fmt_chunk, 1, sizeof(fmt_chunk), f) != sizeof(fmt_chunk)) {
+                return "Truncated WAV";
+            }
+            fseek(f, (size - sizeof(fmt_chunk) + 1) & ~1U, SEEK_CUR);
+            if (audio_le16(&fmt_chunk[0]) != 1 || audio_le16(&fmt_chunk[14]) != 16) {
+                return "Only 16 bit PCM WAV is supported";
+            }
+            fmt->channels = audio_le16(&fmt_chunk[2]);
+            fmt->sample_rate = audio_le32(&fmt_chunk[4]);
+            if (fmt->channels != 1 && fmt->channels != 2) {
+                return "Only mono and stereo are supported";
+            }
+            have_fmt = true;
+        } else if (!memcmp(chunk, "data", 4) && have_fmt) {
+            *ret_len = size;
+            return NULL;
+        } else {
+            /* Chunks are word aligned */
+            fseek(f, (size + 1) & ~1U, SEEK_CUR);
+        }
+    }
+    return "WAV without fmt/data chunk";
+}
+
+/**************************************************************************************************
+ *  Reader side
+ **************************************************************************************************/
+
+void audio_stream_flush(audio_stream_t *s)
+{
+    s->ready = false;
+    __atomic_store_n(&s->flush_req, true, __ATOMIC_SEQ_CST);
+}
+
+bool audio_stream_publish(audio_stream_t *s, const audio_format_t *fmt, uint32_t gen)
+{
+    s->fmt = *fmt;
+    s->eof = false;
+    __atomic_store_n(&s->ready, true, __ATOMIC_SEQ_CST);
+    if (!audio_stream_current(s, gen)) {
+        /* Cancelled while the file was opened, the flag may have been cleared before it was set */
+        __atomic_store_n(&s->ready, false, __ATOMIC_SEQ_CST);
+        return false;
+    }
+    return true;
+}
+
+size_t audio_stream_fill_from(audio_stream_t *s, FILE *f, size_t max)
+{
+    const uint32_t head = s->head;
+    const uint32_t off = head % s->size;
+    const size_t space = MIN(s->size - audio_stream_fill(s), s->size - off);
+    const size_t n = fread(&s->ring[off], 1, MIN(space, max), f);
+
+    __atomic_store_n(&s->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+bool audio_stream_end(audio_stream_t *s, uint32_t gen)
+{
+    if (!audio_stream_current(s, gen)) {
+        return false;
+    }
+    s->eof = true;
+    return true;
+}
+
+/**************************************************************************************************
+ *  Output side
+ **************************************************************************************************/
+
+bool audio_stream_take_flush(audio_stream_t *s)
+{
+    if (!__atomic_load_n(&s->flush_req, __ATOMIC_SEQ_CST)) {
+        return false;
+    }
+    __atomic_store_n(&s->tail, s->head, __ATOMIC_RELEASE);
+    s->started = false;
+    __atomic_store_n(&s->flush_req, false, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+static void audio_stream_read(audio_stream_t *s, uint8_t *dst, size_t len)
+{
+    const uint32_t tail = s->tail;
+    const uint32_t off = tail % s->size;
+    const size_t first = MIN(len, s->size - off);
+
+    memcpy(dst, &s->ring[off], first);
+    memcpy(dst + first, s->ring, len - first);
+    __atomic_store_n(&s->tail, tail + len, __ATOMIC_RELEASE);
+}
+
+/* Convert `frames` input frames in `block` to 16 bit stereo with `gain` applied */
+static void audio_stream_convert(int16_t *block, size_t frames, uint16_t channels, int32_t gain)
+{
+    if (channels == 1) {
+        /* Expand in place, back to front */
+        for (size_t i = frames; i-- > 0;) {
+            const int16_t v = (block[i] * gain) >> 8;
+            block[2 * i] = v;
+            block[2 * i + 1] = v;
+        }
+    } else if (gain != 256) {
+        for (size_t i = 0; i < frames * 2; i++) {
+            block[i] = (block[i] * gain) >> 8;
+        }
+    }
+}
+
+int audio_stream_next(audio_stream_t *s, int16_t *block, size_t frames, uint32_t gain)
+{
+    const uint32_t in_frame = s->fmt.channels * sizeof(int16_t);
+    uint32_t fill = audio_stream_fill(s);
+
+    if (!s->started) {
+        /* Prefetch before the first sample reaches the DAC */
+        if (fill < s->size / 2 && !s->eof) {
+            return AUDIO_STREAM_WAIT;
+        }
+        s->fill_min = fill;
+        s->started = true;
+    }
+
+    const size_t n = MIN(fill / in_frame, frames);
+    audio_stream_read(s, (uint8_t *)block, n * in_frame);
+
+    if (n < frames) {
+        if (s->eof && n == 0) {
+            /* End of file */
+            s->ready = false;
+            s->started = false;
+            return AUDIO_STREAM_WAIT;
+        }
+        if (!s->eof) {
+            s->starvations++;
+        }
+    }
+    audio_stream_convert(block, n, s->fmt.channels, gain);
+
+    fill = audio_stream_fill(s);
+    s->fill_min = MIN(s->fill_min, fill);
+    return n;
+}
@@ -0,0 +1,574 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/bitmap_cache.h"
+#include "bsp/profiler.h"
+
+#if CONFIG_BSP_BITMAP_CACHE
+
+static const char *TAG = "BSP_BITMAP";
+
+#define BITMAP_ENTRIES          CONFIG_BSP_BITMAP_CACHE_ENTRIES
+#define BITMAP_BUDGET           (CONFIG_BSP_BITMAP_CACHE_KB * 1024U)
+
+/* Renamed in LVGL 9.2 */
+#if LVGL_VERSION_MAJOR == 9 && LVGL_VERSION_MINOR < 2
+#define lv_obj_get_ext_draw_size _lv_obj_get_ext_draw_size
+#endif
+
+/*
+ * A cached subtree. The root gets opa_layered 0, so the refresh skips it with all its children but
+ * layouts, input and invalidation still see them. The proxy, an image placed right after the root,
+ * draws the bitmap rendered by lv_snapshot. It is floating, so it stays out of the parent's layout and
+ * scrollable content, but it still shifts the index of the siblings after the root by one.
+ */
+typedef struct {
+    lv_obj_t *root;         /* NULL when the entry is free */
+    lv_obj_t *proxy;
+    lv_color_format_t cf;
+    lv_opa_t opa_layered;   /* of the root before caching, applied to the proxy */
+    lv_draw_buf_t buf;
+    uint8_t *data;          /* NULL while drawn by LVGL */
+    size_t bytes;
+    lv_area_t area;         /* covered by the bitmap */
+    uint32_t released;      /* s_bitmap.released when memory was last missing */
+    uint32_t geometry;      /* digest of the descendant coordinates relative to the root */
+    bool dirty;
+} bitmap_entry_t;
+
+static struct {
+    bitmap_entry_t entries[BITMAP_ENTRIES];
+    uint32_t count;         /* entries in use, the invalidate hooks return at once when 0 */
+    bool busy;              /* own style changes and renders are not changes of the subtree */
+    uint32_t released;      /* incremented when bitmap memory is released */
+    lv_display_t *disp;
+    bsp_bitmap_cache_stats_t stats;
+} s_bitmap;
+
+/*
+ * Descendant changes of the cached subtrees, see the --wrap options in CMakeLists.txt. Calls from inside
+ * lv_obj_pos.c, where lv_obj_invalidate() is defined, are not wrapped: moves and resizes are found by
+ * bitmap_geometry() instead.
+ */
+void __real_lv_obj_invalidate(const lv_obj_t *obj);
+void __real_lv_obj_invalidate_area(const lv_obj_t *obj, const lv_area_t *area);
+
+static void bitmap_mark(bitmap_entry_t *entry)
+{
+    if (!entry->dirty) {
+        entry->dirty = true;
+        s_bitmap.stats.invalidations++;
+    }
+}
+
+static void bitmap_changed(const lv_obj_t *obj)
+{
+    for (const lv_obj_t *o = obj; o != NULL; o = lv_obj_get_parent(o)) {
+        for (size_t i = 0; i < BITMAP_ENTRIES; i++) {
+            if (s_bitmap.entries[i].root == o) {
+                bitmap_mark(&s_bitmap.entries[i]);
+            }
+        }
+    }
+}
+
+void __wrap_lv_obj_invalidate(const lv_obj_t *obj)
+{
+    if (s_bitmap.count && !s_bitmap.busy) {
+        bitmap_changed(obj);
+    }
+    __real_lv_obj_invalidate(obj);
+}
+
+void __wrap_lv_obj_invalidate_area(const lv_obj_t *obj, const lv_area_t *area)
+{
+    if (s_bitmap.count && !s_bitmap.busy) {
+        bitmap_changed(obj);
+    }
+    __real_lv_obj_invalidate_area(obj, area);
+}
+
+static bitmap_entry_t *bitmap_find(const lv_obj_t *root)
+{
+    for (size_t i = 0; i < BITMAP_ENTRIES; i++) {
+        if (s_bitmap.entries[i].root == root) {
+            return &s_bitmap.entries[i];
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    lv_obj_t *root;
+    lv_area_t origin;
+    uint32_t digest;
+} bitmap_geometry_t;
+
+static lv_obj_tree_walk_res_t bitmap_geometry_cb(lv_obj_t *obj, void *user_data)
+{
+    bitmap_geometry_t *g = user_data;
+
+    if (obj != g->root) {
+        lv_area_t a;
+        lv_obj_get_coords(obj, &a);
+        const int32_t v[4] = { a.x1 - g->origin.x1, a.y1 - g->origin.y1, a.x2 - g->origin.x1, a.y2 - g->origin.y1 };
+        for (int k = 0; k < 4; k++) {
+            g->digest = (g->digest ^ (uint32_t)v[k]) * 16777619u;
+        }
+    }
+    return LV_OBJ_TREE_WALK_NEXT;
+}
+
+/* FNV-1a digest of where the descendants are in the root, moving the root itself does not change it */
+static uint32_t bitmap_geometry(lv_obj_t *root)
+{
+    bitmap_geometry_t g = { .root = root, .digest = 2166136261u };
+
+    lv_obj_get_coords(root, &g.origin);
+    lv_obj_tree_walk(root, bitmap_geometry_cb, &g);
+    return g.digest;
+}
+
+/* The area lv_snapshot renders: the root and its extra draw area */
+static void bitmap_area(lv_obj_t *root, lv_area_t *area)
+{
+    const int32_t ext = lv_obj_get_ext_draw_size(root);
+
+    lv_obj_get_coords(root, area);
+    lv_area_increase(area, ext, ext);
+}
+
+static void bitmap_free(bitmap_entry_t *entry)
+{
+    if (entry->data) {
+        heap_caps_free(entry->data);
+        s_bitmap.stats.bytes -= entry->bytes;
+        entry->data = NULL;
+        entry->bytes = 0;
+        s_bitmap.released++;
+    }
+}
+
+static bool bitmap_alloc(bitmap_entry_t *entry, const lv_area_t *area)
+{
+    const uint32_t w = lv_area_get_width(area);
+    const uint32_t h = lv_area_get_height(area);
+    const uint32_t stride = lv_draw_buf_width_to_stride(w, entry->cf);
+    const size_t bytes = (size_t)stride * h;
+
+    bitmap_free(entry);
+    entry->released = s_bitmap.released;
+    if (s_bitmap.stats.bytes + bytes > BITMAP_BUDGET) {
+        ESP_LOGW(TAG, "%"PRIu32"x%"PRIu32" bitmap over the budget, %"PRIu32" of %u bytes used",
+                 w, h, s_bitmap.stats.bytes, BITMAP_BUDGET);
+        s_bitmap.stats.over_budget++;
+        return false;
+    }
+    uint8_t *data = heap_caps_aligned_alloc(LV_DRAW_BUF_ALIGN, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == NULL) {
+        ESP_LOGW(TAG, "No PSRAM for a %"PRIu32"x%"PRIu32" bitmap", w, h);
+        return false;
+    }
+    lv_draw_buf_init(&entry->buf, w, h, entry->cf, stride, data, bytes);
+    entry->data = data;
+    entry->bytes = bytes;
+    s_bitmap.stats.bytes += bytes;
+    return true;
+}
+
+/* Draw the subtree from the bitmap or by LVGL */
+static void bitmap_show(bitmap_entry_t *entry, bool cached)
+{
+    if (cached) {
+        lv_obj_set_style_opa_layered(entry->root, LV_OPA_TRANSP, LV_PART_MAIN);
+        lv_obj_remove_flag(entry->proxy, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        if (entry->opa_layered == LV_OPA_COVER) {
+            lv_obj_remove_local_style_prop(entry->root, LV_STYLE_OPA_LAYERED, LV_PART_MAIN);
+        } else {
+            lv_obj_set_style_opa_layered(entry->root, entry->opa_layered, LV_PART_MAIN);
+        }
+        if (entry->proxy) {
+            lv_obj_add_flag(entry->proxy, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+}
+
+/* Keep the proxy over the bitmap area, right after the root in its parent */
+static void bitmap_place(bitmap_entry_t *entry)
+{
+    lv_obj_t *parent = lv_obj_get_parent(entry->root);
+    const int32_t ext = lv_obj_get_ext_draw_size(entry->root);
+
+    if (lv_obj_get_parent(entry->proxy) != parent) {
+        lv_obj_set_parent(entry->proxy, parent);
+    }
+    const int32_t root_index = lv_obj_get_index(entry->root);
+    const int32_t proxy_index = lv_obj_get_index(entry->proxy);
+    if (proxy_index != root_index + 1) {
+        lv_obj_move_to_index(entry->proxy, proxy_index < root_index ? root_index : root_index + 1);
+    }
+    /* A floating child does not scroll with its parent, the next sync places it again */
+    lv_obj_set_pos(entry->proxy, lv_obj_get_x(entry->root) - lv_obj_get_scroll_x(parent) - ext,
+                   lv_obj_get_y(entry->root) - lv_obj_get_scroll_y(parent) - ext);
+    /* Moves are not seen by the invalidate hooks, an enclosing cached subtree changes too */
+    bitmap_changed(parent);
+}
+
+static void bitmap_sync(bitmap_entry_t *entry)
+{
+    lv_area_t area;
+    bitmap_area(entry->root, &area);
+
+    const bool resized = lv_area_get_width(&area) != lv_area_get_width(&entry->area) ||
+                         lv_area_get_height(&area) != lv_area_get_height(&entry->area);
+    const bool moved = area.x1 != entry->area.x1 || area.y1 != entry->area.y1;
+
+    if (entry->data == NULL && !resized && entry->released == s_bitmap.released) {
+        /* Waiting for memory, drawn by LVGL */
+        return;
+    }
+    entry->area = area;
+    if (resized || entry->data == NULL) {
+        if (!bitmap_alloc(entry, &area)) {
+            bitmap_show(entry, false);
+            return;
+        }
+        /* The image reads the size from the header when the source is set */
+        lv_image_set_src(entry->proxy, NULL);
+        lv_image_set_src(entry->proxy, &entry->buf);
+        entry->dirty = true;
+    }
+    if (entry->dirty) {
+        BSP_PROFILER_BEGIN_TAG("bsp_bitmap_render");
+        const lv_result_t res = lv_snapshot_take_to_draw_buf(entry->root, entry->cf, &entry->buf);
+        BSP_PROFILER_END_TAG("bsp_bitmap_render");
+        entry->dirty = false;
+        s_bitmap.stats.renders++;
+        if (res != LV_RESULT_OK) {
+            ESP_LOGW(TAG, "Snapshot of %p failed", entry->root);
+            bitmap_free(entry);
+            bitmap_show(entry, false);
+            return;
+        }
+        /* The changed descendants invalidated their own area, the proxy is redrawn only there */
+        if (resized) {
+            lv_obj_invalidate(entry->proxy);
+        }
+    }
+    if (moved || resized) {
+        bitmap_place(entry);
+    }
+    bitmap_show(entry, true);
+}
+
+static void bitmap_root_event_cb(lv_event_t *e);
+
+static void bitmap_release(bitmap_entry_t *entry, bool root_deleted)
+{
+    lv_obj_t *proxy = entry->proxy;
+    const bool busy = s_bitmap.busy;
+
+    s_bitmap.busy = true;
+    entry->proxy = NULL;
+    if (!root_deleted) {
+        bitmap_show(entry, false);
+    }
+    bitmap_free(entry);
+    if (proxy) {
+        lv_obj_delete(proxy);
+    }
+    s_bitmap.busy = busy;
+    memset(entry, 0, sizeof(bitmap_entry_t));
+    s_bitmap.count--;
+}
+
+/* Renders the changed subtrees */
+static void bitmap_update(void)
+{
+    bitmap_entry_t *order[BITMAP_ENTRIES];
+    uint32_t depth[BITMAP_ENTRIES];
+    size_t n = 0;
+
+    if (s_bitmap.count == 0) {
+        return;
+    }
+    /* A nested cached subtree is drawn into the enclosing bitmap, render the deepest first */
+    for (size_t i = 0; i < BITMAP_ENTRIES; i++) {
+        bitmap_entry_t *entry = &s_bitmap.entries[i];
+        if (entry->root == NULL) {
+            continue;
+        }
+        uint32_t d = 0;
+        for (const lv_obj_t *o = entry->root; o != NULL; o = lv_obj_get_parent(o)) {
+            d++;
+        }
+        size_t j = n++;
+        for (; j > 0 && depth[j - 1] < d; j--) {
+            order[j] = order[j - 1];
+            depth[j] = depth[j - 1];
+        }
+        order[j] = entry;
+        depth[j] = d;
+    }
+
+    s_bitmap.busy = true;
+    for (size_t i = 0; i < n; i++) {
+        if (order[i]->proxy == NULL) {
+            /* The application deleted the image, draw the subtree by LVGL again */
+            lv_obj_remove_event_cb_with_user_data(order[i]->root, bitmap_root_event_cb, order[i]);
+            bitmap_release(order[i], false);
+            continue;
+        }
+        lv_obj_update_layout(order[i]->root);
+        const uint32_t geometry = bitmap_geometry(order[i]->root);
+        if (geometry != order[i]->geometry) {
+            order[i]->geometry = geometry;
+            bitmap_mark(order[i]);
+        }
+        bitmap_sync(order[i]);
+    }
+    s_bitmap.busy = false;
+}
+
+/* Before the layout update and rendering of each frame */
+static void bitmap_refr_start_cb(lv_event_t *e)
+{
+    bitmap_update();
+}
+
+static void bitmap_root_event_cb(lv_event_t *e)
+{
+    bitmap_release(lv_event_get_user_data(e), true);
+}
+
+static void bitmap_proxy_event_cb(lv_event_t *e)
+{
+    bitmap_entry_t *entry = lv_event_get_user_data(e);
+
+    /* Deleted with its parent before the root */
+    if (entry->proxy == lv_event_get_current_target(e)) {
+        entry->proxy = NULL;
+    }
+}
+
+esp_err_t bsp_bitmap_cache_enable(lv_obj_t *root, lv_color_format_t cf)
+{
+    assert(root);
+    ESP_RETURN_ON_FALSE(lv_obj_get_parent(root), ESP_ERR_INVALID_ARG, TAG, "A screen cannot be cached");
+    ESP_RETURN_ON_FALSE(cf == LV_COLOR_FORMAT_RGB565 || cf == LV_COLOR_FORMAT_ARGB8888, ESP_ERR_INVALID_ARG, TAG,
+                        "Unsupported color format %d", cf);
+
+    bitmap_entry_t *entry = bitmap_find(root);
+    if (entry) {
+        if (entry->cf != cf) {
+            s_bitmap.busy = true;
+            bitmap_free(entry);
+            bitmap_show(entry, false);
+            s_bitmap.busy = false;
+            entry->cf = cf;
+            entry->area = (lv_area_t) { 0 };
+            entry->released = s_bitmap.released - 1;
+            lv_obj_invalidate(root);
+        }
+        return ESP_OK;
+    }
+    entry = bitmap_find(NULL);
+    ESP_RETURN_ON_FALSE(entry, ESP_ERR_NO_MEM, TAG, "%d widgets already cached", BITMAP_ENTRIES);
+
+    lv_obj_t *proxy = lv_image_create(lv_obj_get_parent(root));
+    ESP_RETURN_ON_FALSE(proxy, ESP_ERR_NO_MEM, TAG, "No memory for the bitmap image");
+    lv_obj_add_flag(proxy, LV_OBJ_FLAG_HIDDEN | LV_OBJ_FLAG_IGNORE_LAYOUT | LV_OBJ_FLAG_FLOATING);
+    lv_obj_remove_flag(proxy, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ON_FOCUS);
+
+    entry->root = root;
+    entry->proxy = proxy;
+    entry->cf = cf;
+    entry->opa_layered = lv_obj_get_style_opa_layered(root, LV_PART_MAIN);
+    entry->released = s_bitmap.released - 1;
+    entry->dirty = true;
+    lv_obj_set_style_image_opa(proxy, entry->opa_layered, LV_PART_MAIN);
+    lv_obj_add_event_cb(root, bitmap_root_event_cb, LV_EVENT_DELETE, entry);
+    lv_obj_add_event_cb(proxy, bitmap_proxy_event_cb, LV_EVENT_DELETE, entry);
+    s_bitmap.count++;
+
+    if (s_bitmap.disp == NULL) {
+        s_bitmap.disp = lv_obj_get_display(root);
+        lv_display_add_event_cb(s_bitmap.disp, bitmap_refr_start_cb, LV_EVENT_REFR_START, NULL);
+    }
+    lv_obj_invalidate(root);
+    return ESP_OK;
+}
+
+void bsp_bitmap_cache_disable(lv_obj_t *root)
+{
+    assert(root);
+    bitmap_entry_t *entry = bitmap_find(root);
+    if (entry) {
+        lv_obj_remove_event_cb_with_user_data(root, bitmap_root_event_cb, entry);
+        bitmap_release(entry, false);
+    }
+}
+
+void bsp_bitmap_cache_invalidate(lv_obj_t *root)
+{
+    assert(root);
+    bitmap_entry_t *entry = bitmap_find(root);
+    if (entry) {
+        bitmap_changed(root);
+        lv_obj_invalidate(root);
+    }
+}
+
+void bsp_bitmap_cache_get_stats(bsp_bitmap_cache_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_bitmap.stats;
+    stats->cached = 0;
+    stats->uncached = 0;
+    for (size_t i = 0; i < BITMAP_ENTRIES; i++) {
+        if (s_bitmap.entries[i].data) {
+            stats->cached++;
+        } else if (s_bitmap.entries[i].root) {
+            stats->uncached++;
+        }
+    }
+    stats->budget = BITMAP_BUDGET;
+}
+
+/* Every pixel of the bitmap is the panel color, or the child color inside the child */
+static bool bitmap_selftest_pixels(const bitmap_entry_t *entry, const lv_area_t *child, uint16_t panel_px,
+                                   uint16_t child_px)
+{
+    for (int32_t y = 0; y < (int32_t)entry->buf.header.h; y++) {
+        const uint16_t *row = (const uint16_t *)(entry->data + y * entry->buf.header.stride);
+        for (int32_t x = 0; x < (int32_t)entry->buf.header.w; x++) {
+            const bool inside = x >= child->x1 && x <= child->x2 && y >= child->y1 && y <= child->y2;
+            if (row[x] != (inside ? child_px : panel_px)) {
+                ESP_LOGE(TAG, "Pixel %"PRId32",%"PRId32" is 0x%04x", x, y, row[x]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+esp_err_t bsp_bitmap_cache_selftest(void)
+{
+    /* Position and size of the child in the 64x32 panel, one step per frame */
+    static const struct {
+        int32_t x, y, w, h;
+        bool render;
+    } steps[] = {
+        { 0, 0, 8, 8, true },
+        { 0, 0, 8, 8, false },      /* Unchanged */
+        { 40, 16, 8, 8, true },     /* Moved */
+        { 40, 16, 16, 12, true },   /* Resized */
+        { 40, 16, 16, 12, false },
+    };
+    const lv_color_t panel_color = lv_color_hex(0xff0000);
+    const lv_color_t child_color = lv_color_hex(0x0000ff);
+    esp_err_t ret = ESP_OK;
+    lv_obj_t *screen = lv_obj_create(NULL);
+    lv_obj_t *panel = NULL;
+
+    ESP_RETURN_ON_FALSE(screen, ESP_ERR_NO_MEM, TAG, "No memory for the test screen");
+    panel = lv_obj_create(screen);
+    lv_obj_t *child = panel ? lv_obj_create(panel) : NULL;
+    ESP_GOTO_ON_FALSE(child, ESP_ERR_NO_MEM, err, TAG, "No memory for the test widgets");
+    lv_obj_remove_style_all(panel);
+    lv_obj_remove_style_all(child);
+    lv_obj_set_style_bg_opa(panel, LV_OPA_COVER, LV_PART_MAIN);
+    lv_obj_set_style_bg_color(panel, panel_color, LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(child, LV_OPA_COVER, LV_PART_MAIN);
+    lv_obj_set_style_bg_color(child, child_color, LV_PART_MAIN);
+    lv_obj_set_size(panel, 64, 32);
+    ESP_GOTO_ON_ERROR(bsp_bitmap_cache_enable(panel, LV_COLOR_FORMAT_RGB565), err, TAG, "Cannot cache the panel");
+
+    const bitmap_entry_t *entry = bitmap_find(panel);
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        const uint32_t renders = s_bitmap.stats.renders;
+        const lv_area_t area = {
+            steps[i].x, steps[i].y, steps[i].x + steps[i].w - 1, steps[i].y + steps[i].h - 1
+        };
+
+        /* Hidden from the invalidate hooks like the moves made inside lv_obj_pos.c, only the geometry shows them */
+        s_bitmap.busy = true;
+        lv_obj_set_pos(child, steps[i].x, steps[i].y);
+        lv_obj_set_size(child, steps[i].w, steps[i].h);
+        s_bitmap.busy = false;
+        bitmap_update();
+        ESP_GOTO_ON_FALSE(entry->data, ESP_ERR_NO_MEM, err, TAG, "No memory for the bitmap");
+        ESP_GOTO_ON_FALSE((s_bitmap.stats.renders != renders) == steps[i].render, ESP_FAIL, err, TAG,
+                          "Step %u %s", (unsigned)i, steps[i].render ? "not rendered" : "rendered again");
+        ESP_GOTO_ON_FALSE(bitmap_selftest_pixels(entry, &area, lv_color_to_u16(panel_color),
+                                                 lv_color_to_u16(child_color)), ESP_FAIL, err, TAG,
+                          "Step %u: stale bitmap", (unsigned)i);
+    }
+    ESP_LOGI(TAG, "Moved and resized children rendered again");
+
+err:
+    if (panel) {
+        bsp_bitmap_cache_disable(panel);
+    }
+    lv_obj_delete(screen);
+    return ret;
+}
+
+#else /* CONFIG_BSP_BITMAP_CACHE */
+
+esp_err_t bsp_bitmap_cache_enable(lv_obj_t *root, lv_color_format_t cf)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_bitmap_cache_disable(lv_obj_t *root)
+{
+}
+
+void bsp_bitmap_cache_invalidate(lv_obj_t *root)
+{
+}
+
+void bsp_bitmap_cache_get_stats(bsp_bitmap_cache_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(bsp_bitmap_cache_stats_t));
+}
+
+esp_err_t bsp_bitmap_cache_selftest(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_BSP_BITMAP_CACHE */
@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/wt32sc01plus.h"
+#include "bsp/blend.h"
+#include "bsp/dma_copy.h"
+#include "bsp_blend_kernels.h"
+
+static const char *TAG = "BSP_BLEND";
+
+#define BENCH_LINES             16
+#define BENCH_MIN_US            100000
+#define SELFTEST_ROUNDS         200
+
+#if CONFIG_BSP_BLEND_PIE
+/* Shorter rows are not worth aligning for the vector stores */
+#define PIE_FILL_MIN_PX         24
+
+/* bsp_blend_s3.S: dest 16 byte aligned, blocks of 8 pixels, color2 holds the color twice */
+void bsp_blend_fill_pie(uint16_t *dest, uint32_t blocks, uint32_t color2);
+
+void bsp_blend_fill_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color)
+{
+    const uint32_t c2 = color | ((uint32_t)color << 16);
+
+    for (int32_t y = 0; y < h; y++, dest = bsp_blend_next_row(dest, stride)) {
+        uint16_t *d = dest;
+        int32_t n = w;
+        if (n >= PIE_FILL_MIN_PX) {
+            const int32_t head = (-(uintptr_t)d & 15) / 2;
+            bsp_blend_swar_fill_row(d, head, color);
+            d += head;
+            n -= head;
+            bsp_blend_fill_pie(d, n / 8, c2);
+            d += n & ~7;
+            n &= 7;
+        }
+        bsp_blend_swar_fill_row(d, n, color);
+    }
+}
+#else
+void bsp_blend_fill_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color)
+{
+    bsp_blend_swar_fill(dest, w, h, stride, color);
+}
+#endif
+
+void bsp_blend_fill_opa_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color, uint8_t opa)
+{
+    if (opa == 255) {
+        bsp_blend_fill_rgb565(dest, w, h, stride, color);
+        return;
+    }
+    bsp_blend_swar_fill_opa(dest, w, h, stride, color, opa);
+}
+
+void bsp_blend_copy_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                           const uint16_t *src, int32_t src_stride)
+{
+    /* memcpy, or the GDMA for large copies in internal RAM */
+    bsp_dma_copy_rows(dest, dest_stride, src, src_stride, (size_t)w * 2, h);
+}
+
+void bsp_blend_argb8888_to_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                                  const uint8_t *src, int32_t src_stride)
+{
+    bsp_blend_swar_argb8888(dest, w, h, dest_stride, src, src_stride);
+}
+
+void bsp_blend_rgb565_swap(uint16_t *buf, size_t count)
+{
+    bsp_blend_swar_swap(buf, count);
+}
+
+esp_err_t bsp_blend_selftest(void)
+{
+    const bsp_blend_kernels_t kernels = {
+        .fill = bsp_blend_fill_rgb565,
+        .fill_opa = bsp_blend_fill_opa_rgb565,
+        .copy = bsp_blend_copy_rgb565,
+        .argb8888 = bsp_blend_argb8888_to_rgb565,
+        .swap = bsp_blend_rgb565_swap,
+    };
+    uint8_t *a = heap_caps_malloc(BSP_BLEND_CHECK_DEST_SIZE, MALLOC_CAP_8BIT);
+    uint8_t *b = heap_caps_malloc(BSP_BLEND_CHECK_DEST_SIZE, MALLOC_CAP_8BIT);
+    uint8_t *src = heap_caps_malloc(BSP_BLEND_CHECK_SRC_SIZE, MALLOC_CAP_8BIT);
+    bsp_blend_mismatch_t m;
+    esp_err_t ret = ESP_OK;
+
+    if (a == NULL || b == NULL || src == NULL) {
+        ret = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    if (!bsp_blend_check(&kernels, SELFTEST_ROUNDS, a, b, src, &m)) {
+        ESP_LOGE(TAG, "%s differs at byte %u: %dx%d stride %d offset %d color 0x%04x opa %d",
+                 m.kernel, (unsigned)m.byte, (int)m.w, (int)m.h, (int)m.stride, (int)m.offset, m.color, m.opa);
+        ret = ESP_FAIL;
+        goto out;
+    }
+    ESP_LOGI(TAG, "Kernels match the references in %d rounds", SELFTEST_ROUNDS);
+
+out:
+    heap_caps_free(a);
+    heap_caps_free(b);
+    heap_caps_free(src);
+    return ret;
+}
+
+/* Runs the kernel until BENCH_MIN_US passed, returns megapixels per second */
+#define BENCH(call) ({                                              \
+    uint32_t runs = 0;                                              \
+    const int64_t start = esp_timer_get_time();                     \
+    int64_t elapsed;                                                \
+    do {                                                            \
+        call;                                                       \
+        runs++;                                                     \
+        elapsed = esp_timer_get_time() - start;                     \
+    } while (elapsed < BENCH_MIN_US);                               \
+    (double)runs * w * h / elapsed;                                 \
+})
+
+esp_err_t bsp_blend_bench(FILE *f)
+{
+    const int32_t w = BSP_LCD_H_RES;
+    const int32_t h = BENCH_LINES;
+    const int32_t stride = w * 2;
+    /* Internal RAM like the draw buffers, images come from flash or PSRAM in practice */
+    uint16_t *dest = heap_caps_malloc(w * h * 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint16_t *src16 = heap_caps_malloc(w * h * 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *src32 = heap_caps_malloc(w * h * 4, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    esp_err_t ret = ESP_OK;
+    uint32_t rng = 1;
+
+    assert(f);
+    if (dest == NULL || src16 == NULL || src32 == NULL) {
+        ret = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    bsp_blend_randomize((uint8_t *)dest, w * h * 2, &rng);
+    bsp_blend_randomize((uint8_t *)src16, w * h * 2, &rng);
+    bsp_blend_randomize(src32, w * h * 4, &rng);
+    for (int32_t i = 3; i < w * h * 4; i += 4) {
+        src32[i] = bsp_blend_rand_alpha(&rng);
+    }
+
+    const struct {
+        const char *name;
+        double ref;
+        double fast;
+    } results[] = {
+        {"fill", BENCH(bsp_blend_ref_fill(dest, w, h, stride, 0x1234)), BENCH(bsp_blend_fill_rgb565(dest, w, h, stride, 0x1234))},
+        {"fill_opa", BENCH(bsp_blend_ref_fill_opa(dest, w, h, stride, 0x1234, 128)), BENCH(bsp_blend_fill_opa_rgb565(dest, w, h, stride, 0x1234, 128))},
+        {"copy", BENCH(bsp_blend_ref_copy(dest, w, h, stride, src16, stride)), BENCH(bsp_blend_copy_rgb565(dest, w, h, stride, src16, stride))},
+        {"argb8888", BENCH(bsp_blend_ref_argb8888(dest, w, h, stride, src32, w * 4)), BENCH(bsp_blend_argb8888_to_rgb565(dest, w, h, stride, src32, w * 4))},
+        {"swap", BENCH(bsp_blend_ref_swap(dest, (size_t)w * h)), BENCH(bsp_blend_rgb565_swap(dest, (size_t)w * h))},
+    };
+
+    if (fprintf(f, "Blend kernels, %dx%d area, Mpixel/s:\n  kernel      reference   fast  speedup\n", (int)w, (int)h) < 0) {
+        ret = ESP_FAIL;
+    }
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]) && ret == ESP_OK; i++) {
+        if (fprintf(f, "  %-10s %9.1f %6.1f %7.2fx\n", results[i].name, results[i].ref, results[i].fast,
+                    results[i].fast / results[i].ref) < 0) {
+            ret = ESP_FAIL;
+        }
+    }
+
+out:
+    heap_caps_free(dest);
+    heap_caps_free(src16);
+    heap_caps_free(src32);
+    return ret;
+}
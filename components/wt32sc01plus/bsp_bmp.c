@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+#include "bsp_bmp.h"
+
+static void bmp_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void bmp_put_u32(uint8_t *p, uint32_t v)
+{
+    bmp_put_u16(p, v & 0xFFFF);
+    bmp_put_u16(p + 2, v >> 16);
+}
+
+bool bmp_open(bmp_writer_t *bmp, const char *path, uint16_t width, uint16_t height)
+{
+    uint8_t hdr[BMP_HEADER_SIZE] = { 0 };
+
+    bmp->width = width;
+    bmp->height = height;
+    bmp->row_bytes = (width * 2 + 3) & ~3U;     /* Rows are padded to 4 bytes */
+    const uint32_t image_size = bmp->row_bytes * height;
+
+    /* BITMAPFILEHEADER */
+    hdr[0] = 'B';
+    hdr[1] = 'M';
+    bmp_put_u32(&hdr[2], BMP_HEADER_SIZE + image_size);
+    bmp_put_u32(&hdr[10], BMP_HEADER_SIZE);
+    /* BITMAPINFOHEADER, negative height for top-down rows */
+    bmp_put_u32(&hdr[14], 40);
+    bmp_put_u32(&hdr[18], width);
+    bmp_put_u32(&hdr[22], (uint32_t)(-(int32_t)height));
+    bmp_put_u16(&hdr[26], 1);
+    bmp_put_u16(&hdr[28], 16);
+    bmp_put_u32(&hdr[30], 3);                   /* BI_BITFIELDS */
+    bmp_put_u32(&hdr[34], image_size);
+    bmp_put_u32(&hdr[38], 2835);                /* 72 DPI */
+    bmp_put_u32(&hdr[42], 2835);
+    /* RGB565 masks */
+    bmp_put_u32(&hdr[54], 0xF800);
+    bmp_put_u32(&hdr[58], 0x07E0);
+    bmp_put_u32(&hdr[62], 0x001F);
+
+    bmp->f = fopen(path, "wb");
+    if (bmp->f == NULL) {
+        return false;
+    }
+    if (fwrite(hdr, 1, sizeof(hdr), bmp->f) != sizeof(hdr)) {
+        fclose(bmp->f);
+        bmp->f = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool bmp_write_area(bmp_writer_t *bmp, int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint16_t *px, int32_t stride)
+{
+    const int32_t cx1 = (x1 < 0) ? 0 : x1;
+    const int32_t cy1 = (y1 < 0) ? 0 : y1;
+    const int32_t cx2 = (x2 >= bmp->width) ? bmp->width - 1 : x2;
+    const int32_t cy2 = (y2 >= bmp->height) ? bmp->height - 1 : y2;
+
+    if (bmp->f == NULL) {
+        return false;
+    }
+    if (cx1 > cx2 || cy1 > cy2) {
+        return true;
+    }
+    px += (cy1 - y1) * stride + (cx1 - x1);
+
+    const size_t row_len = (cx2 - cx1 + 1) * sizeof(uint16_t);
+    if (row_len == bmp->row_bytes && stride * sizeof(uint16_t) == row_len) {
+        /* Full width band without padding, one write */
+        const size_t len = row_len * (cy2 - cy1 + 1);
+        return fseek(bmp->f, BMP_HEADER_SIZE + cy1 * bmp->row_bytes, SEEK_SET) == 0 &&
+               fwrite(px, 1, len, bmp->f) == len;
+    }
+    for (int32_t y = cy1; y <= cy2; y++, px += stride) {
+        if (fseek(bmp->f, BMP_HEADER_SIZE + y * bmp->row_bytes + cx1 * sizeof(uint16_t), SEEK_SET) != 0 ||
+                fwrite(px, 1, row_len, bmp->f) != row_len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool bmp_close(bmp_writer_t *bmp)
+{
+    bool ok = (bmp->f != NULL);
+
+    if (ok) {
+        /* Make sure the padding and any area never written exist */
+        fseek(bmp->f, 0, SEEK_END);
+        const long size = ftell(bmp->f);
+        const long expected = BMP_HEADER_SIZE + (long)bmp->row_bytes * bmp->height;
+        for (long i = size; i < expected; i++) {
+            fputc(0, bmp->f);
+        }
+        ok = (fclose(bmp->f) == 0);
+        bmp->f = NULL;
+    }
+    return ok;
+}
@@ -0,0 +1,365 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/display_lock.h"
+
+#if CONFIG_BSP_DISPLAY_LOCK_PROFILER
+#include "esp_lvgl_port.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "BSP_DLOCK";
+
+#define DLOCK_SITES             CONFIG_BSP_DISPLAY_LOCK_SITES
+#define DLOCK_HOLD_WARN_US      (CONFIG_BSP_DISPLAY_LOCK_HOLD_WARN_MS * 1000)
+#define DLOCK_CONTENDED_US      50      /* An uncontended lvgl_port_lock() takes a few us */
+#define DLOCK_NONE              UINT32_MAX
+
+typedef struct {
+    bsp_display_lock_site_t stats;
+    TaskHandle_t task;              /* With stats.site the key, NULL when the entry is free */
+} dlock_site_t;
+
+static struct {
+    portMUX_TYPE lock;              /* Guards everything below, never held while waiting for the display lock */
+    /* Holder that took the lock with bsp_display_lock(), or the LVGL task in lv_timer_handler() */
+    TaskHandle_t holder;
+    uint32_t depth;                 /* Nested locks of the holder */
+    const void *holder_addr;        /* Call site of the holder */
+    uint32_t holder_site;           /* Index in sites, DLOCK_NONE if not recorded */
+    int64_t hold_start;
+    bsp_display_lock_stats_t totals;
+    dlock_site_t sites[DLOCK_SITES];
+} s_dlock = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Entry of the site and task, added if new; called in the critical section */
+static uint32_t dlock_site_get(const void *site, TaskHandle_t task)
+{
+    for (uint32_t i = 0; i < DLOCK_SITES; i++) {
+        dlock_site_t *s = &s_dlock.sites[i];
+        if (s->task == NULL) {
+            s->task = task;
+            s->stats = (bsp_display_lock_site_t) {
+                .site = site,
+            };
+            /* The name stays valid while the task runs this */
+            strlcpy(s->stats.task, pcTaskGetName(task), sizeof(s->stats.task));
+            s_dlock.totals.sites++;
+            return i;
+        }
+        if (s->task == task && s->stats.site == site) {
+            return i;
+        }
+    }
+    return DLOCK_NONE;
+}
+
+bool bsp_display_lock_take(uint32_t timeout_ms, const void *site)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&s_dlock.lock);
+    if (s_dlock.holder == self) {
+        /* Nested, the recursive mutex is taken at once and the outer lock keeps the hold */
+        s_dlock.depth++;
+        portEXIT_CRITICAL(&s_dlock.lock);
+        return lvgl_port_lock(timeout_ms);
+    }
+    const void *blocker = s_dlock.holder ? s_dlock.holder_addr : NULL;
+    portEXIT_CRITICAL(&s_dlock.lock);
+
+    const int64_t start = esp_timer_get_time();
+    const bool taken = lvgl_port_lock(timeout_ms);
+    const int64_t now = esp_timer_get_time();
+    const uint32_t wait_us = now - start;
+
+    portENTER_CRITICAL(&s_dlock.lock);
+    const uint32_t idx = dlock_site_get(site, self);
+    if (idx == DLOCK_NONE) {
+        s_dlock.totals.dropped++;
+    } else {
+        bsp_display_lock_site_t *s = &s_dlock.sites[idx].stats;
+        s->wait_us_total += wait_us;
+        if (wait_us >= s->wait_us_max) {
+            s->wait_us_max = wait_us;
+            s->blocker = blocker;
+        }
+        if (wait_us >= DLOCK_CONTENDED_US) {
+            s->contended++;
+        }
+        if (taken) {
+            s->locks++;
+        } else {
+            s->timeouts++;
+        }
+    }
+    if (wait_us >= DLOCK_CONTENDED_US) {
+        s_dlock.totals.contended++;
+    }
+    if (taken) {
+        s_dlock.totals.locks++;
+        s_dlock.holder = self;
+        s_dlock.depth = 1;
+        s_dlock.holder_addr = site;
+        s_dlock.holder_site = idx;
+        s_dlock.hold_start = now;
+    } else {
+        s_dlock.totals.timeouts++;
+    }
+    portEXIT_CRITICAL(&s_dlock.lock);
+    return taken;
+}
+
+/* End of a hold of the calling task, returns its length or 0 while nested; called in the critical section */
+static uint32_t dlock_hold_end(void)
+{
+    uint32_t hold_us = 0;
+
+    /* Locks nested in a lvgl_port_lock() of the same task are not recorded as the holder */
+    if (s_dlock.holder == xTaskGetCurrentTaskHandle() && --s_dlock.depth == 0) {
+        hold_us = esp_timer_get_time() - s_dlock.hold_start;
+        if (s_dlock.holder_site != DLOCK_NONE) {
+            bsp_display_lock_site_t *s = &s_dlock.sites[s_dlock.holder_site].stats;
+            s->hold_us_total += hold_us;
+            s->hold_us_max = MAX(s->hold_us_max, hold_us);
+            s->long_holds += hold_us > DLOCK_HOLD_WARN_US;
+        }
+        s_dlock.totals.long_holds += hold_us > DLOCK_HOLD_WARN_US;
+        /* Before the mutex is given, the next holder records itself */
+        s_dlock.holder = NULL;
+    }
+    return hold_us;
+}
+
+void bsp_display_lock_give(void)
+{
+    portENTER_CRITICAL(&s_dlock.lock);
+    const void *site = s_dlock.holder_addr;
+    const uint32_t hold_us = dlock_hold_end();
+    portEXIT_CRITICAL(&s_dlock.lock);
+
+    lvgl_port_unlock();
+    if (hold_us > DLOCK_HOLD_WARN_US) {
+        ESP_LOGW(TAG, "Display lock held %"PRIu32" ms by %s at %p", hold_us / 1000, pcTaskGetName(NULL), site);
+    }
+}
+
+void bsp_display_lock_pass_begin(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    /* The real lv_timer_handler(), the site that addr2line decodes */
+    const void *site = (const void *)__real_lv_timer_handler;
+
+    portENTER_CRITICAL(&s_dlock.lock);
+    if (s_dlock.holder == self) {
+        /* lv_timer_handler() called under bsp_display_lock(), that hold goes on */
+        s_dlock.depth++;
+    } else {
+        const uint32_t idx = dlock_site_get(site, self);
+        if (idx == DLOCK_NONE) {
+            s_dlock.totals.dropped++;
+        } else {
+            s_dlock.sites[idx].stats.locks++;
+        }
+        s_dlock.totals.locks++;
+        s_dlock.holder = self;
+        s_dlock.depth = 1;
+        s_dlock.holder_addr = site;
+        s_dlock.holder_site = idx;
+        s_dlock.hold_start = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&s_dlock.lock);
+}
+
+void bsp_display_lock_pass_end(void)
+{
+    /* Long passes are counted, the stall detector is the place to log them */
+    portENTER_CRITICAL(&s_dlock.lock);
+    dlock_hold_end();
+    portEXIT_CRITICAL(&s_dlock.lock);
+}
+
+#if !CONFIG_BSP_STALL
+/* The LVGL task pass, bsp_stall.c wraps it instead when enabled; see the --wrap options in CMakeLists.txt */
+uint32_t __wrap_lv_timer_handler(void)
+{
+    bsp_display_lock_pass_begin();
+    const uint32_t ret = __real_lv_timer_handler();
+    bsp_display_lock_pass_end();
+    return ret;
+}
+#endif
+
+esp_err_t bsp_display_lock_get_stats(bsp_display_lock_stats_t *stats)
+{
+    assert(stats);
+
+    portENTER_CRITICAL(&s_dlock.lock);
+    *stats = s_dlock.totals;
+    portEXIT_CRITICAL(&s_dlock.lock);
+    return ESP_OK;
+}
+
+static int dlock_cmp_hold_max(const void *a, const void *b)
+{
+    const bsp_display_lock_site_t *sa = a, *sb = b;
+    return (sa->hold_us_max < sb->hold_us_max) - (sa->hold_us_max > sb->hold_us_max);
+}
+
+static int dlock_cmp_hold_total(const void *a, const void *b)
+{
+    const bsp_display_lock_site_t *sa = a, *sb = b;
+    return (sa->hold_us_total < sb->hold_us_total) - (sa->hold_us_total > sb->hold_us_total);
+}
+
+static int dlock_cmp_wait_total(const void *a, const void *b)
+{
+    const bsp_display_lock_site_t *sa = a, *sb = b;
+    return (sa->wait_us_total < sb->wait_us_total) - (sa->wait_us_total > sb->wait_us_total);
+}
+
+/* Copy of the sites in use, sorted; the sort happens outside of the critical section */
+static size_t dlock_sorted(bsp_display_lock_site_t *sites, bsp_display_lock_order_t order)
+{
+    size_t n = 0;
+
+    portENTER_CRITICAL(&s_dlock.lock);
+    for (size_t i = 0; i < DLOCK_SITES && s_dlock.sites[i].task; i++) {
+        sites[n++] = s_dlock.sites[i].stats;
+    }
+    portEXIT_CRITICAL(&s_dlock.lock);
+
+    switch (order) {
+    case BSP_DISPLAY_LOCK_BY_HOLD_TOTAL:
+        qsort(sites, n, sizeof(sites[0]), dlock_cmp_hold_total);
+        break;
+    case BSP_DISPLAY_LOCK_BY_WAIT_TOTAL:
+        qsort(sites, n, sizeof(sites[0]), dlock_cmp_wait_total);
+        break;
+    default:
+        qsort(sites, n, sizeof(sites[0]), dlock_cmp_hold_max);
+        break;
+    }
+    return n;
+}
+
+size_t bsp_display_lock_top(bsp_display_lock_site_t *sites, size_t max, bsp_display_lock_order_t order)
+{
+    assert(sites || max == 0);
+
+    bsp_display_lock_site_t *all = malloc(sizeof(bsp_display_lock_site_t) * DLOCK_SITES);
+    if (all == NULL) {
+        return 0;
+    }
+    const size_t n = MIN(max, dlock_sorted(all, order));
+    memcpy(sites, all, n * sizeof(sites[0]));
+    free(all);
+    return n;
+}
+
+void bsp_display_lock_reset(void)
+{
+    portENTER_CRITICAL(&s_dlock.lock);
+    memset(&s_dlock.totals, 0, sizeof(s_dlock.totals));
+    memset(s_dlock.sites, 0, sizeof(s_dlock.sites));
+    /* The hold in progress is still measured, only not recorded */
+    s_dlock.holder_site = DLOCK_NONE;
+    portEXIT_CRITICAL(&s_dlock.lock);
+}
+
+static int dlock_print_sites(FILE *f, const char *title, bsp_display_lock_site_t *sites, size_t top,
+                             bsp_display_lock_order_t order)
+{
+    const size_t n = MIN(top, dlock_sorted(sites, order));
+    int res = fprintf(f, "%s\n  %-10s %-16s %8s %8s %8s %12s %10s %12s %10s %10s\n", title, "site", "task", "locks",
+                      "waited", "timeouts", "wait us", "max", "hold us", "max", "blocker");
+    for (size_t i = 0; i < n && res >= 0; i++) {
+        const bsp_display_lock_site_t *s = &sites[i];
+        res = fprintf(f, "  %-10p %-16s %8"PRIu32" %8"PRIu32" %8"PRIu32" %12"PRIu64" %10"PRIu32" %12"PRIu64" %10"PRIu32
+                      " %10p\n", s->site, s->task, s->locks, s->contended, s->timeouts, s->wait_us_total,
+                      s->wait_us_max, s->hold_us_total, s->hold_us_max, s->blocker);
+    }
+    return res;
+}
+
+esp_err_t bsp_display_lock_print(FILE *f, size_t top)
+{
+    bsp_display_lock_stats_t stats;
+
+    assert(f);
+    bsp_display_lock_site_t *sites = malloc(sizeof(bsp_display_lock_site_t) * DLOCK_SITES);
+    ESP_RETURN_ON_FALSE(sites, ESP_ERR_NO_MEM, TAG, "No memory for %d sites", DLOCK_SITES);
+    bsp_display_lock_get_stats(&stats);
+
+    int res = fprintf(f, "Display lock: %"PRIu32" locks, %"PRIu32" waited, %"PRIu32" timeouts, %"PRIu32" holds over "
+                      "%d ms, %"PRIu32" sites, %"PRIu32" dropped\n", stats.locks, stats.contended, stats.timeouts,
+                      stats.long_holds, CONFIG_BSP_DISPLAY_LOCK_HOLD_WARN_MS, stats.sites, stats.dropped);
+    if (res >= 0) {
+        res = dlock_print_sites(f, "Longest hold:", sites, top, BSP_DISPLAY_LOCK_BY_HOLD_MAX);
+    }
+    if (res >= 0) {
+        res = dlock_print_sites(f, "Most time waited:", sites, top, BSP_DISPLAY_LOCK_BY_WAIT_TOTAL);
+    }
+    free(sites);
+    ESP_RETURN_ON_FALSE(res >= 0 && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
+
+#else /* CONFIG_BSP_DISPLAY_LOCK_PROFILER */
+
+esp_err_t bsp_display_lock_get_stats(bsp_display_lock_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(bsp_display_lock_stats_t));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+size_t bsp_display_lock_top(bsp_display_lock_site_t *sites, size_t max, bsp_display_lock_order_t order)
+{
+    return 0;
+}
+
+void bsp_display_lock_reset(void)
+{
+}
+
+esp_err_t bsp_display_lock_print(FILE *f, size_t top)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_BSP_DISPLAY_LOCK_PROFILER */
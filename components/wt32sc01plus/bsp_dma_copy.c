@@ -0,0 +1,270 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/wt32sc01plus.h"
+#include "bsp/dma_copy.h"
+
+static void cpu_copy_rows(uint8_t *dest, int32_t dest_stride, const uint8_t *src, int32_t src_stride,
+                          size_t row_bytes, int32_t rows)
+{
+    if (dest_stride == (int32_t)row_bytes && src_stride == (int32_t)row_bytes) {
+        memcpy(dest, src, row_bytes * rows);
+        return;
+    }
+    for (int32_t y = 0; y < rows; y++, dest += dest_stride, src += src_stride) {
+        memcpy(dest, src, row_bytes);
+    }
+}
+
+#if CONFIG_BSP_DMA_COPY
+#include "esp_idf_version.h"
+#include "esp_attr.h"
+#include "esp_memory_utils.h"
+#include "esp_async_memcpy.h"
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 2, 0)
+typedef async_memcpy_t async_memcpy_handle_t;
+#endif
+
+static const char *TAG = "BSP_DMA_COPY";
+
+/* Transfers in flight, each at most one descriptor long */
+#define DMA_COPY_BACKLOG        8
+#define DMA_COPY_CHUNK          4032
+/* Below this a strided row costs more to set up than to memcpy */
+#define DMA_COPY_MIN_ROW        256
+
+#define BENCH_LINES             32
+#define BENCH_MIN_US            200000
+
+static struct {
+    async_memcpy_handle_t mcp;
+    SemaphoreHandle_t busy;         /* one caller at a time, the others use memcpy */
+    SemaphoreHandle_t done;         /* given by each finished transfer */
+    portMUX_TYPE lock;
+    bsp_dma_copy_stats_t stats;
+} s_dma = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool IRAM_ATTR dma_copy_done(async_memcpy_handle_t mcp, async_memcpy_event_t *event, void *cb_args)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_dma.done, &woken);
+    return woken == pdTRUE;
+}
+
+esp_err_t bsp_dma_copy_init(void)
+{
+    esp_err_t ret = ESP_OK;
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+
+    if (s_dma.mcp) {
+        return ESP_OK;
+    }
+    s_dma.busy = xSemaphoreCreateMutex();
+    s_dma.done = xSemaphoreCreateCounting(DMA_COPY_BACKLOG, 0);
+    ESP_GOTO_ON_FALSE(s_dma.busy && s_dma.done, ESP_ERR_NO_MEM, err, TAG, "No memory for semaphores");
+    config.backlog = DMA_COPY_BACKLOG;
+    ESP_GOTO_ON_ERROR(esp_async_memcpy_install(&config, &s_dma.mcp), err, TAG, "Async memcpy install failed");
+    ESP_LOGI(TAG, "DMA copy from %d bytes", CONFIG_BSP_DMA_COPY_MIN_BYTES);
+    return ESP_OK;
+
+err:
+    if (s_dma.busy) {
+        vSemaphoreDelete(s_dma.busy);
+        s_dma.busy = NULL;
+    }
+    if (s_dma.done) {
+        vSemaphoreDelete(s_dma.done);
+        s_dma.done = NULL;
+    }
+    return ret;
+}
+
+static bool dma_copy_eligible(void *dest, int32_t dest_stride, const void *src, int32_t src_stride,
+                              size_t row_bytes, int32_t rows)
+{
+    const bool contiguous = dest_stride == (int32_t)row_bytes && src_stride == (int32_t)row_bytes;
+
+    /* GDMA reaches internal RAM only, word aligned */
+    return row_bytes * rows >= CONFIG_BSP_DMA_COPY_MIN_BYTES &&
+           (contiguous || row_bytes >= DMA_COPY_MIN_ROW) &&
+           ((uintptr_t)dest | (uintptr_t)src | row_bytes | (uint32_t)dest_stride | (uint32_t)src_stride) % 4 == 0 &&
+           esp_ptr_dma_capable(dest) && esp_ptr_dma_capable(src) &&
+           esp_ptr_dma_capable((uint8_t *)dest + (rows - 1) * dest_stride + row_bytes - 1) &&
+           esp_ptr_dma_capable((const uint8_t *)src + (rows - 1) * src_stride + row_bytes - 1);
+}
+
+/* Call with s_dma.busy taken, returns the time spent blocked */
+static int64_t dma_copy_run(uint8_t *dest, int32_t dest_stride, const uint8_t *src, int32_t src_stride,
+                            size_t row_bytes, int32_t rows)
+{
+    int64_t wait_us = 0;
+    int inflight = 0;
+
+    if (dest_stride == (int32_t)row_bytes && src_stride == (int32_t)row_bytes) {
+        row_bytes *= rows;
+        rows = 1;
+    }
+    for (int32_t y = 0; y < rows; y++, dest += dest_stride, src += src_stride) {
+        for (size_t off = 0; off < row_bytes; off += DMA_COPY_CHUNK) {
+            const size_t n = row_bytes - off < DMA_COPY_CHUNK ? row_bytes - off : DMA_COPY_CHUNK;
+            if (inflight == DMA_COPY_BACKLOG) {
+                const int64_t start = esp_timer_get_time();
+                xSemaphoreTake(s_dma.done, portMAX_DELAY);
+                wait_us += esp_timer_get_time() - start;
+                inflight--;
+            }
+            if (esp_async_memcpy(s_dma.mcp, dest + off, (void *)(src + off), n, dma_copy_done, NULL) == ESP_OK) {
+                inflight++;
+            } else {
+                memcpy(dest + off, src + off, n);
+            }
+        }
+    }
+    const int64_t start = esp_timer_get_time();
+    for (; inflight > 0; inflight--) {
+        xSemaphoreTake(s_dma.done, portMAX_DELAY);
+    }
+    return wait_us + esp_timer_get_time() - start;
+}
+
+void bsp_dma_copy_rows(void *dest, int32_t dest_stride, const void *src, int32_t src_stride,
+                       size_t row_bytes, int32_t rows)
+{
+    const size_t bytes = row_bytes * rows;
+
+    if (rows <= 0 || row_bytes == 0) {
+        return;
+    }
+    if (dma_copy_eligible(dest, dest_stride, src, src_stride, row_bytes, rows) &&
+            bsp_dma_copy_init() == ESP_OK && xSemaphoreTake(s_dma.busy, 0) == pdTRUE) {
+        const int64_t wait_us = dma_copy_run(dest, dest_stride, src, src_stride, row_bytes, rows);
+        xSemaphoreGive(s_dma.busy);
+        portENTER_CRITICAL(&s_dma.lock);
+        s_dma.stats.dma_copies++;
+        s_dma.stats.dma_bytes += bytes;
+        s_dma.stats.wait_us += wait_us;
+        portEXIT_CRITICAL(&s_dma.lock);
+        return;
+    }
+
+    cpu_copy_rows(dest, dest_stride, src, src_stride, row_bytes, rows);
+    portENTER_CRITICAL(&s_dma.lock);
+    s_dma.stats.cpu_copies++;
+    s_dma.stats.cpu_bytes += bytes;
+    portEXIT_CRITICAL(&s_dma.lock);
+}
+
+void bsp_dma_copy_get_stats(bsp_dma_copy_stats_t *stats)
+{
+    assert(stats);
+    portENTER_CRITICAL(&s_dma.lock);
+    *stats = s_dma.stats;
+    portEXIT_CRITICAL(&s_dma.lock);
+}
+
+esp_err_t bsp_dma_copy_bench(FILE *f)
+{
+    const size_t size = BSP_LCD_H_RES * BENCH_LINES * 2;
+    uint8_t *src = heap_caps_malloc(size, MALLOC_CAP_DMA);
+    uint8_t *dest = heap_caps_malloc(size, MALLOC_CAP_DMA);
+    bsp_dma_copy_stats_t before, after;
+    esp_err_t ret = ESP_OK;
+    uint32_t runs;
+    int64_t start, cpu_us, dma_us;
+
+    assert(f);
+    ESP_GOTO_ON_FALSE(src && dest, ESP_ERR_NO_MEM, out, TAG, "No memory for the bench buffers");
+    ESP_GOTO_ON_ERROR(bsp_dma_copy_init(), out, TAG, "DMA copy init failed");
+    for (size_t i = 0; i < size; i++) {
+        src[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+
+    start = esp_timer_get_time();
+    for (runs = 0; (cpu_us = esp_timer_get_time() - start) < BENCH_MIN_US; runs++) {
+        memcpy(dest, src, size);
+    }
+    const double cpu_mbs = (double)runs * size / cpu_us;
+
+    memset(dest, 0, size);
+    bsp_dma_copy_get_stats(&before);
+    start = esp_timer_get_time();
+    for (runs = 0; (dma_us = esp_timer_get_time() - start) < BENCH_MIN_US; runs++) {
+        bsp_dma_copy_rows(dest, size, src, size, size, 1);
+    }
+    bsp_dma_copy_get_stats(&after);
+    ESP_GOTO_ON_FALSE(memcmp(dest, src, size) == 0, ESP_FAIL, out, TAG, "DMA copy differs from the source");
+
+    if (fprintf(f, "Copy of %u bytes, internal RAM:\n"
+                "  memcpy  %6.1f MB/s\n"
+                "  DMA     %6.1f MB/s, CPU free %.0f%% of the copy time, %"PRIu32" of %"PRIu32" copies by DMA\n",
+                (unsigned)size, cpu_mbs, (double)runs * size / dma_us,
+                100.0 * (after.wait_us - before.wait_us) / dma_us, after.dma_copies - before.dma_copies, runs) < 0) {
+        ret = ESP_FAIL;
+    }
+
+out:
+    heap_caps_free(src);
+    heap_caps_free(dest);
+    return ret;
+}
+
+#else /* CONFIG_BSP_DMA_COPY */
+
+esp_err_t bsp_dma_copy_init(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_dma_copy_rows(void *dest, int32_t dest_stride, const void *src, int32_t src_stride,
+                       size_t row_bytes, int32_t rows)
+{
+    cpu_copy_rows(dest, dest_stride, src, src_stride, row_bytes, rows);
+}
+
+void bsp_dma_copy_get_stats(bsp_dma_copy_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(*stats));
+}
+
+esp_err_t bsp_dma_copy_bench(FILE *f)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_BSP_DMA_COPY */
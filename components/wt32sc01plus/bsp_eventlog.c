@@ -0,0 +1,517 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include "bsp/eventlog.h"
+#include "bsp/pm.h"
+#include "bsp_err_check.h"
+
+static const char *TAG = "BSP_EVENTLOG";
+
+#define EVENTLOG_BLOCK_RECORDS  CONFIG_BSP_EVENTLOG_BLOCK_RECORDS
+#define EVENTLOG_PATH_MAX       (64)
+
+/* Record as stored on the card */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint64_t timestamp_ms;
+    uint16_t code;
+    uint8_t  severity;
+    uint8_t  reserved;
+    char     text[BSP_EVENTLOG_TEXT_LEN];
+    uint16_t crc;
+} eventlog_disk_record_t;
+
+/* Index entry as stored on the card, one per full block of records */
+typedef struct __attribute__((packed)) {
+    uint64_t min_ts;
+    uint64_t max_ts;
+    uint8_t  severity_mask;
+    uint8_t  reserved;
+    uint16_t crc;
+} eventlog_disk_index_t;
+
+_Static_assert(sizeof(eventlog_disk_record_t) == 48, "Event log record layout changed");
+_Static_assert(sizeof(eventlog_disk_index_t) == 20, "Event log index layout changed");
+
+/* Block summary kept in RAM */
+typedef struct {
+    uint64_t min_ts;
+    uint64_t max_ts;
+    uint64_t prefix_max_ts;     /* Max timestamp of this and all older blocks */
+    uint8_t  severity_mask;
+} eventlog_block_t;
+
+static struct {
+    FILE *log;
+    FILE *idx;
+    SemaphoreHandle_t mutex;
+    uint32_t count;                 /* Records in the log */
+    eventlog_block_t *blocks;       /* Summaries of full blocks */
+    uint32_t blocks_cap;
+    uint32_t idx_count;             /* Index entries on the card, may lag behind the full blocks */
+    eventlog_block_t tail;          /* Summary of the partial block at the end of the log */
+    bool monotonic;                 /* Block and tail time ranges do not overlap, allows binary search */
+    eventlog_disk_record_t *buf;    /* One block of records */
+} s_log;
+
+static uint16_t eventlog_record_crc(const eventlog_disk_record_t *rec)
+{
+    return esp_rom_crc16_le(0, (const uint8_t *)rec, offsetof(eventlog_disk_record_t, crc));
+}
+
+static uint16_t eventlog_index_crc(const eventlog_disk_index_t *entry)
+{
+    return esp_rom_crc16_le(0, (const uint8_t *)entry, offsetof(eventlog_disk_index_t, crc));
+}
+
+static bool eventlog_record_valid(const eventlog_disk_record_t *rec, uint32_t seq)
+{
+    return rec->seq == seq && rec->crc == eventlog_record_crc(rec);
+}
+
+static void eventlog_block_reset(eventlog_block_t *blk)
+{
+    blk->min_ts = UINT64_MAX;
+    blk->max_ts = 0;
+    blk->severity_mask = 0;
+}
+
+static void eventlog_block_add(eventlog_block_t *blk, uint64_t ts, uint8_t severity)
+{
+    if (ts < blk->min_ts) {
+        blk->min_ts = ts;
+    }
+    if (ts > blk->max_ts) {
+        blk->max_ts = ts;
+    }
+    blk->severity_mask |= (uint8_t)(1U << severity);
+}
+
+static uint64_t eventlog_prefix_max(uint32_t nblocks)
+{
+    return nblocks ? s_log.blocks[nblocks - 1].prefix_max_ts : 0;
+}
+
+/* Make room for the summary of block `n` */
+static esp_err_t eventlog_blocks_reserve(uint32_t n)
+{
+    if (n >= s_log.blocks_cap) {
+        uint32_t cap = s_log.blocks_cap ? s_log.blocks_cap * 2 : 16;
+        eventlog_block_t *blocks = realloc(s_log.blocks, cap * sizeof(eventlog_block_t));
+        if (blocks == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        s_log.blocks = blocks;
+        s_log.blocks_cap = cap;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t eventlog_blocks_push(const eventlog_block_t *blk)
+{
+    uint32_t n = s_log.count / EVENTLOG_BLOCK_RECORDS;
+    ESP_RETURN_ON_ERROR(eventlog_blocks_reserve(n), TAG, "No memory for index");
+    if (n > 0 && blk->min_ts < eventlog_prefix_max(n)) {
+        s_log.monotonic = false;
+    }
+    s_log.blocks[n] = *blk;
+    s_log.blocks[n].prefix_max_ts = MAX(blk->max_ts, eventlog_prefix_max(n));
+    return ESP_OK;
+}
+
+static esp_err_t eventlog_read_records(uint32_t first, uint32_t cnt)
+{
+    if (fseek(s_log.log, (long)first * sizeof(eventlog_disk_record_t), SEEK_SET) != 0 ||
+            fread(s_log.buf, sizeof(eventlog_disk_record_t), cnt, s_log.log) != cnt) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* Summarize records [first, first + cnt) from the card */
+static esp_err_t eventlog_summarize(uint32_t first, uint32_t cnt, eventlog_block_t *blk)
+{
+    eventlog_block_reset(blk);
+    ESP_RETURN_ON_ERROR(eventlog_read_records(first, cnt), TAG, "Block read failed");
+    for (uint32_t i = 0; i < cnt; i++) {
+        eventlog_block_add(blk, s_log.buf[i].timestamp_ms, s_log.buf[i].severity);
+    }
+    return ESP_OK;
+}
+
+/*
+ * Write the index entries of full blocks which are not on the card yet. Entry `b` always lands at
+ * its own offset, so a failed write is retried with the next block and never shifts later entries.
+ */
+static esp_err_t eventlog_index_sync(void)
+{
+    const uint32_t full = s_log.count / EVENTLOG_BLOCK_RECORDS;
+    esp_err_t ret = ESP_OK;
+
+    while (s_log.idx_count < full) {
+        const eventlog_block_t *blk = &s_log.blocks[s_log.idx_count];
+        eventlog_disk_index_t entry = {
+            .min_ts = blk->min_ts,
+            .max_ts = blk->max_ts,
+            .severity_mask = blk->severity_mask,
+        };
+        entry.crc = eventlog_index_crc(&entry);
+        if (fseek(s_log.idx, (long)s_log.idx_count * sizeof(entry), SEEK_SET) != 0 ||
+                fwrite(&entry, sizeof(entry), 1, s_log.idx) != 1) {
+            ret = ESP_FAIL;
+            break;
+        }
+        s_log.idx_count++;
+    }
+    fflush(s_log.idx);
+    fsync(fileno(s_log.idx));
+    return ret;
+}
+
+static long eventlog_file_size(FILE *f)
+{
+    if (fseek(f, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return ftell(f);
+}
+
+static FILE *eventlog_fopen(const char *path)
+{
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        f = fopen(path, "w+b");
+    }
+    return f;
+}
+
+/* Drop torn records at the end of the log, returns number of valid records */
+static esp_err_t eventlog_recover_log(const char *path, uint32_t *ret_count)
+{
+    eventlog_disk_record_t rec;
+    long size = eventlog_file_size(s_log.log);
+    ESP_RETURN_ON_FALSE(size >= 0, ESP_FAIL, TAG, "Log size unknown");
+
+    uint32_t n = size / sizeof(eventlog_disk_record_t);
+    while (n > 0) {
+        if (fseek(s_log.log, (long)(n - 1) * sizeof(rec), SEEK_SET) == 0 &&
+                fread(&rec, sizeof(rec), 1, s_log.log) == 1 && eventlog_record_valid(&rec, n - 1)) {
+            break;
+        }
+        n--;
+    }
+
+    if ((long)(n * sizeof(rec)) != size) {
+        ESP_LOGW(TAG, "Dropping %ld bytes of torn records from %s", size - (long)(n * sizeof(rec)), path);
+        fclose(s_log.log);
+        s_log.log = NULL;
+        ESP_RETURN_ON_FALSE(truncate(path, (off_t)n * sizeof(rec)) == 0, ESP_FAIL, TAG, "Log truncate failed");
+        ESP_RETURN_ON_FALSE((s_log.log = fopen(path, "r+b")) != NULL, ESP_FAIL, TAG, "Log reopen failed");
+    }
+    *ret_count = n;
+    return ESP_OK;
+}
+
+/* Load the index, rebuilding entries which did not make it to the card */
+static esp_err_t eventlog_recover_index(const char *path, uint32_t count)
+{
+    const uint32_t full = count / EVENTLOG_BLOCK_RECORDS;
+    eventlog_disk_index_t entry;
+    eventlog_block_t blk;
+    uint32_t valid = 0;
+
+    s_log.count = 0;
+    fseek(s_log.idx, 0, SEEK_SET);
+    while (valid < full && fread(&entry, sizeof(entry), 1, s_log.idx) == 1 && entry.crc == eventlog_index_crc(&entry)) {
+        blk.min_ts = entry.min_ts;
+        blk.max_ts = entry.max_ts;
+        blk.severity_mask = entry.severity_mask;
+        ESP_RETURN_ON_ERROR(eventlog_blocks_push(&blk), TAG, "No memory for index");
+        s_log.count += EVENTLOG_BLOCK_RECORDS;
+        valid++;
+    }
+
+    if ((long)(valid * sizeof(entry)) != eventlog_file_size(s_log.idx)) {
+        ESP_LOGW(TAG, "Rebuilding %"PRIu32" index entries", full - valid);
+        fclose(s_log.idx);
+        s_log.idx = NULL;
+        ESP_RETURN_ON_FALSE(truncate(path, (off_t)valid * sizeof(entry)) == 0, ESP_FAIL, TAG, "Index truncate failed");
+        ESP_RETURN_ON_FALSE((s_log.idx = fopen(path, "r+b")) != NULL, ESP_FAIL, TAG, "Index reopen failed");
+    }
+    s_log.idx_count = valid;
+
+    for (uint32_t b = valid; b < full; b++) {
+        ESP_RETURN_ON_ERROR(eventlog_summarize(b * EVENTLOG_BLOCK_RECORDS, EVENTLOG_BLOCK_RECORDS, &blk), TAG, "Index rebuild failed");
+        ESP_RETURN_ON_ERROR(eventlog_blocks_push(&blk), TAG, "No memory for index");
+        s_log.count += EVENTLOG_BLOCK_RECORDS;
+    }
+    ESP_RETURN_ON_ERROR(eventlog_index_sync(), TAG, "Index write failed");
+
+    ESP_RETURN_ON_ERROR(eventlog_summarize(full * EVENTLOG_BLOCK_RECORDS, count - s_log.count, &s_log.tail), TAG, "Tail read failed");
+    if (s_log.tail.min_ts < eventlog_prefix_max(full)) {
+        s_log.monotonic = false;
+    }
+    s_log.count = count;
+    return ESP_OK;
+}
+
+static void eventlog_release(void)
+{
+    if (s_log.log) {
+        fclose(s_log.log);
+    }
+    if (s_log.idx) {
+        fclose(s_log.idx);
+    }
+    if (s_log.mutex) {
+        vSemaphoreDelete(s_log.mutex);
+    }
+    free(s_log.blocks);
+    free(s_log.buf);
+    memset(&s_log, 0, sizeof(s_log));
+}
+
+esp_err_t bsp_eventlog_open(const char *base_path)
+{
+    char log_path[EVENTLOG_PATH_MAX];
+    char idx_path[EVENTLOG_PATH_MAX];
+    uint32_t count = 0;
+    esp_err_t ret = ESP_OK;
+
+    assert(base_path);
+    ESP_RETURN_ON_FALSE(s_log.log == NULL, ESP_ERR_INVALID_STATE, TAG, "Event log already open");
+    snprintf(log_path, sizeof(log_path), "%s.log", base_path);
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", base_path);
+
+    s_log.monotonic = true;
+    ESP_GOTO_ON_FALSE(s_log.mutex = xSemaphoreCreateMutex(), ESP_ERR_NO_MEM, err, TAG, "Mutex create failed");
+    ESP_GOTO_ON_FALSE(s_log.buf = malloc(EVENTLOG_BLOCK_RECORDS * sizeof(eventlog_disk_record_t)), ESP_ERR_NO_MEM, err, TAG, "No memory for block buffer");
+    ESP_GOTO_ON_FALSE(s_log.log = eventlog_fopen(log_path), ESP_FAIL, err, TAG, "Failed to open %s", log_path);
+    ESP_GOTO_ON_FALSE(s_log.idx = eventlog_fopen(idx_path), ESP_FAIL, err, TAG, "Failed to open %s", idx_path);
+
+    ESP_GOTO_ON_ERROR(eventlog_recover_log(log_path, &count), err, TAG, "Log recovery failed");
+    ESP_GOTO_ON_ERROR(eventlog_recover_index(idx_path, count), err, TAG, "Index recovery failed");
+
+    ESP_LOGI(TAG, "Opened %s: %"PRIu32" records, %"PRIu32" index blocks", log_path, s_log.count, s_log.count / EVENTLOG_BLOCK_RECORDS);
+    return ESP_OK;
+
+err:
+    eventlog_release();
+    return ret;
+}
+
+esp_err_t bsp_eventlog_close(void)
+{
+    ESP_RETURN_ON_FALSE(s_log.log, ESP_ERR_INVALID_STATE, TAG, "Event log not open");
+    xSemaphoreTake(s_log.mutex, portMAX_DELAY);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    fflush(s_log.log);
+    fsync(fileno(s_log.log));
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    xSemaphoreGive(s_log.mutex);
+    eventlog_release();
+    return ESP_OK;
+}
+
+esp_err_t bsp_eventlog_sync(void)
+{
+    ESP_RETURN_ON_FALSE(s_log.log, ESP_ERR_INVALID_STATE, TAG, "Event log not open");
+    xSemaphoreTake(s_log.mutex, portMAX_DELAY);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    fflush(s_log.log);
+    fsync(fileno(s_log.log));
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    xSemaphoreGive(s_log.mutex);
+    return ESP_OK;
+}
+
+uint32_t bsp_eventlog_count(void)
+{
+    return s_log.count;
+}
+
+esp_err_t bsp_eventlog_append(uint64_t timestamp_ms, bsp_eventlog_severity_t severity, uint16_t code, const char *text, uint32_t *ret_seq)
+{
+    esp_err_t ret = ESP_OK;
+    eventlog_disk_record_t rec = {0};
+
+    ESP_RETURN_ON_FALSE(s_log.log, ESP_ERR_INVALID_STATE, TAG, "Event log not open");
+    ESP_RETURN_ON_FALSE(severity <= BSP_EVENTLOG_CRITICAL, ESP_ERR_INVALID_ARG, TAG, "Invalid severity");
+
+    if (timestamp_ms == 0) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        timestamp_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+    rec.timestamp_ms = timestamp_ms;
+    rec.code = code;
+    rec.severity = severity;
+    if (text) {
+        strlcpy(rec.text, text, sizeof(rec.text));
+    }
+
+    xSemaphoreTake(s_log.mutex, portMAX_DELAY);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    rec.seq = s_log.count;
+    rec.crc = eventlog_record_crc(&rec);
+    const bool completes = rec.seq % EVENTLOG_BLOCK_RECORDS == EVENTLOG_BLOCK_RECORDS - 1;
+
+    /* Fail before the write, the record must not reach the card without room for its block summary */
+    if (completes) {
+        ESP_GOTO_ON_ERROR(eventlog_blocks_reserve(rec.seq / EVENTLOG_BLOCK_RECORDS), out, TAG, "No memory for index");
+    }
+
+    ESP_GOTO_ON_FALSE(fseek(s_log.log, (long)rec.seq * sizeof(rec), SEEK_SET) == 0 &&
+                      fwrite(&rec, sizeof(rec), 1, s_log.log) == 1, ESP_FAIL, out, TAG, "Record write failed");
+    fflush(s_log.log);
+#if CONFIG_BSP_EVENTLOG_FSYNC_EACH
+    fsync(fileno(s_log.log));
+#endif
+
+    if (rec.seq % EVENTLOG_BLOCK_RECORDS == 0) {
+        eventlog_block_reset(&s_log.tail);
+    }
+    eventlog_block_add(&s_log.tail, rec.timestamp_ms, rec.severity);
+    /* The query cuts the tail off with the full blocks newer than its window */
+    if (rec.timestamp_ms < eventlog_prefix_max(rec.seq / EVENTLOG_BLOCK_RECORDS)) {
+        s_log.monotonic = false;
+    }
+    if (completes) {
+        /* Block complete: data must be on the card before its index entry */
+        fsync(fileno(s_log.log));
+        (void)eventlog_blocks_push(&s_log.tail); /* Room reserved above */
+    }
+    s_log.count++;
+    if (completes && eventlog_index_sync() != ESP_OK) {
+        /* The record is stored, the entry is retried with the next block or rebuilt on open */
+        ESP_LOGW(TAG, "Index write failed, %"PRIu32" entries pending", s_log.count / EVENTLOG_BLOCK_RECORDS - s_log.idx_count);
+    }
+
+    if (ret_seq) {
+        *ret_seq = rec.seq;
+    }
+out:
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    xSemaphoreGive(s_log.mutex);
+    return ret;
+}
+
+/* First block whose records are all newer than `to_ms`, `nblocks` if none; valid only for a monotonic log */
+static uint32_t eventlog_find_newer_block(uint64_t to_ms, uint32_t nblocks)
+{
+    uint32_t lo = 0;
+    uint32_t hi = nblocks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s_log.blocks[mid].min_ts <= to_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+esp_err_t bsp_eventlog_query(const bsp_eventlog_filter_t *filter, uint32_t *cursor,
+                             bsp_eventlog_record_t *rows, size_t max_rows, size_t *ret_rows)
+{
+    const bsp_eventlog_filter_t all = {
+        .from_ms = 0,
+        .to_ms = UINT64_MAX,
+        .severity_mask = BSP_EVENTLOG_SEVERITY_ALL,
+    };
+    esp_err_t ret = ESP_OK;
+    size_t found = 0;
+
+    assert(cursor && ret_rows && (rows || max_rows == 0));
+    ESP_RETURN_ON_FALSE(s_log.log, ESP_ERR_INVALID_STATE, TAG, "Event log not open");
+    if (filter == NULL) {
+        filter = &all;
+    }
+
+    xSemaphoreTake(s_log.mutex, portMAX_DELAY);
+    const uint32_t full = s_log.count / EVENTLOG_BLOCK_RECORDS;
+    uint32_t end = MIN(*cursor, s_log.count);
+
+    /* Skip blocks newer than the window without touching the card */
+    if (s_log.monotonic && filter->to_ms != UINT64_MAX) {
+        uint32_t newer = eventlog_find_newer_block(filter->to_ms, full);
+        if (newer < full) {
+            end = MIN(end, newer * EVENTLOG_BLOCK_RECORDS);
+        }
+    }
+
+    while (end > 0 && found < max_rows) {
+        const uint32_t blk_idx = (end - 1) / EVENTLOG_BLOCK_RECORDS;
+        const uint32_t first = blk_idx * EVENTLOG_BLOCK_RECORDS;
+        const eventlog_block_t *blk = blk_idx < full ? &s_log.blocks[blk_idx] : &s_log.tail;
+
+        /* Nothing in this block or any older one reaches the window */
+        if (MAX(blk->max_ts, eventlog_prefix_max(MIN(blk_idx, full))) < filter->from_ms) {
+            end = 0;
+            break;
+        }
+        if (blk->min_ts > filter->to_ms || blk->max_ts < filter->from_ms || !(blk->severity_mask & filter->severity_mask)) {
+            end = first;
+            continue;
+        }
+
+        ESP_GOTO_ON_ERROR(eventlog_read_records(first, end - first), out, TAG, "Block read failed");
+        while (end > first && found < max_rows) {
+            const eventlog_disk_record_t *rec = &s_log.buf[end - 1 - first];
+            end--;
+            if (!eventlog_record_valid(rec, end) || rec->timestamp_ms < filter->from_ms ||
+                    rec->timestamp_ms > filter->to_ms || !((1U << rec->severity) & filter->severity_mask)) {
+                continue;
+            }
+            bsp_eventlog_record_t *row = &rows[found++];
+            row->seq = rec->seq;
+            row->timestamp_ms = rec->timestamp_ms;
+            row->code = rec->code;
+            row->severity = rec->severity;
+            memcpy(row->text, rec->text, sizeof(row->text));
+            row->text[sizeof(row->text) - 1] = '\0';
+        }
+    }
+    *cursor = end;
+
+out:
+    xSemaphoreGive(s_log.mutex);
+    *ret_rows = found;
+    return ret;
+}
@@ -0,0 +1,292 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/latency.h"
+
+#if CONFIG_BSP_LATENCY
+#include "esp_lvgl_port.h"
+#include "indev/lv_indev_private.h"
+#include "bsp_display_priv.h"
+#include "bsp_latency_model.h"
+
+static const char *TAG = "BSP_LATENCY";
+
+#define LATENCY_MARKER_SIZE     24
+#define LATENCY_BAR_WIDTH       40
+
+_Static_assert(BSP_LATENCY_BUCKETS == BSP_LATENCY_MODEL_BUCKETS, "Histogram size mismatch");
+_Static_assert(BSP_LATENCY_STAGE_MAX == BSP_LATENCY_MODEL_STAGES, "Stage count mismatch");
+
+static const char *const s_stage_names[BSP_LATENCY_STAGE_MAX] = {
+    [BSP_LATENCY_STAGE_READ] = "read",
+    [BSP_LATENCY_STAGE_PROCESS] = "process",
+    [BSP_LATENCY_STAGE_REFR_WAIT] = "refr_wait",
+    [BSP_LATENCY_STAGE_RENDER] = "render",
+    [BSP_LATENCY_STAGE_FLUSH] = "flush",
+};
+
+static struct {
+    bsp_latency_model_t model;
+    lv_display_t *disp;
+    lv_indev_read_cb_t touch_read_cb;
+    esp_lcd_touch_interrupt_callback_t touch_isr;  /* chained, the tickless wakeup or esp_lvgl_port */
+    lv_obj_t *marker;
+    bool marker_on;
+} s_latency;
+
+/* Transfer done callback of esp_lvgl_port, see the --wrap option in CMakeLists.txt */
+void __real_lv_display_flush_ready(lv_display_t *disp);
+
+void __wrap_lv_display_flush_ready(lv_display_t *disp)
+{
+    bsp_latency_model_flush_ready(&s_latency.model, esp_timer_get_time());
+    __real_lv_display_flush_ready(disp);
+}
+
+static void latency_touch_isr(esp_lcd_touch_handle_t tp)
+{
+    bsp_latency_model_irq(&s_latency.model, esp_timer_get_time());
+    if (s_latency.touch_isr) {
+        s_latency.touch_isr(tp);
+    }
+}
+
+static void latency_touch_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    s_latency.touch_read_cb(indev, data);
+
+    const int64_t now = esp_timer_get_time();
+    if (bsp_latency_model_read(&s_latency.model, now) && s_latency.marker) {
+        /* Invalidates at once, the process stage is then only the marker update */
+        s_latency.marker_on = !s_latency.marker_on;
+        lv_obj_set_style_bg_color(s_latency.marker, s_latency.marker_on ? lv_color_white() : lv_color_black(),
+                                  LV_PART_MAIN);
+    }
+    bsp_latency_model_poll(&s_latency.model, now, false);
+}
+
+static void latency_display_cb(lv_event_t *e)
+{
+    const int64_t now = esp_timer_get_time();
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_INVALIDATE_AREA:
+        bsp_latency_model_invalidate(&s_latency.model, now);
+        break;
+    case LV_EVENT_REFR_START:
+        bsp_latency_model_refr_start(&s_latency.model, now);
+        break;
+    case LV_EVENT_REFR_READY:
+        bsp_latency_model_poll(&s_latency.model, now, true);
+        break;
+    default:
+        break;
+    }
+}
+
+static void latency_flush_hook(lv_display_t *disp, const lv_area_t *area, const uint8_t *px_map, void *user_ctx)
+{
+    bsp_latency_model_flush(&s_latency.model, esp_timer_get_time(), lv_display_flush_is_last(disp));
+}
+
+esp_err_t bsp_latency_init(lv_display_t *disp, lv_indev_t *indev, esp_lcd_touch_handle_t tp)
+{
+    esp_err_t ret = ESP_OK;
+
+    assert(disp && indev && tp);
+    ESP_RETURN_ON_FALSE(s_latency.disp == NULL, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    bsp_latency_model_init(&s_latency.model, CONFIG_BSP_LATENCY_BUCKET_MS * 1000, CONFIG_BSP_LATENCY_TIMEOUT_MS * 1000);
+
+    lvgl_port_lock(0);
+    ESP_GOTO_ON_ERROR(bsp_display_add_flush_hook(latency_flush_hook, NULL), err, TAG, "Flush hook failed");
+    /* After the tickless and PM wrappers, so the touch ISR chain and the read are timed as a whole */
+    s_latency.touch_isr = tp->config.interrupt_callback;
+    ESP_GOTO_ON_ERROR(esp_lcd_touch_register_interrupt_callback(tp, latency_touch_isr), err_hook, TAG,
+                      "No touch interrupt");
+    s_latency.touch_read_cb = indev->read_cb;
+    lv_indev_set_read_cb(indev, latency_touch_read_cb);
+    lv_display_add_event_cb(disp, latency_display_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    lv_display_add_event_cb(disp, latency_display_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, latency_display_cb, LV_EVENT_REFR_READY, NULL);
+    s_latency.disp = disp;
+    lvgl_port_unlock();
+#if CONFIG_BSP_LATENCY_MARKER
+    bsp_latency_set_marker(true);
+#endif
+    return ESP_OK;
+
+err_hook:
+    bsp_display_remove_flush_hook(latency_flush_hook, NULL);
+err:
+    lvgl_port_unlock();
+    return ret;
+}
+
+esp_err_t bsp_latency_get_stats(bsp_latency_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(bsp_latency_stats_t));
+
+    lvgl_port_lock(0);
+    const bsp_latency_model_t *m = &s_latency.model;
+    bsp_latency_model_poll(&s_latency.model, esp_timer_get_time(), false);
+    stats->events = m->events;
+    stats->no_change = m->no_change;
+    stats->overlapped = m->overlapped;
+    stats->bucket_us = m->bucket_us;
+    memcpy(stats->hist, m->hist, sizeof(stats->hist));
+    if (m->events) {
+        stats->total_min_us = m->total_min_us;
+        stats->total_avg_us = m->total_sum_us / m->events;
+        stats->total_max_us = m->total_max_us;
+        for (int i = 0; i < BSP_LATENCY_STAGE_MAX; i++) {
+            stats->stage_avg_us[i] = m->stage_sum_us[i] / m->events;
+            stats->stage_max_us[i] = m->stage_max_us[i];
+        }
+    }
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+void bsp_latency_reset(void)
+{
+    lvgl_port_lock(0);
+    const uint32_t state = bsp_latency_model_state(&s_latency.model);
+    bsp_latency_model_t fresh;
+    bsp_latency_model_init(&fresh, s_latency.model.bucket_us, s_latency.model.timeout_us);
+    /* Keep the touch in flight, the ISRs may be using it */
+    memcpy(fresh.t, s_latency.model.t, sizeof(fresh.t));
+    fresh.state = state;
+    s_latency.model = fresh;
+    lvgl_port_unlock();
+}
+
+/* Upper bound of the bucket holding the given fraction of the touches */
+static uint32_t latency_percentile_us(const bsp_latency_stats_t *stats, uint32_t pct)
+{
+    const uint32_t rank = (stats->events * pct + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < BSP_LATENCY_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= rank) {
+            return i == BSP_LATENCY_BUCKETS - 1 ? stats->total_max_us : (i + 1) * stats->bucket_us;
+        }
+    }
+    return stats->total_max_us;
+}
+
+esp_err_t bsp_latency_print(FILE *f)
+{
+    bsp_latency_stats_t stats;
+    uint32_t peak = 1;
+    int res;
+
+    assert(f);
+    bsp_latency_get_stats(&stats);
+    res = fprintf(f, "Touch-to-photon: %"PRIu32" touches, %"PRIu32" without change, %"PRIu32" overlapped\n",
+                  stats.events, stats.no_change, stats.overlapped);
+    if (res >= 0 && stats.events) {
+        res = fprintf(f, "min %"PRIu32" avg %"PRIu32" p50 <%"PRIu32" p90 <%"PRIu32" p99 <%"PRIu32" max %"PRIu32" us\n",
+                      stats.total_min_us, stats.total_avg_us, latency_percentile_us(&stats, 50),
+                      latency_percentile_us(&stats, 90), latency_percentile_us(&stats, 99), stats.total_max_us);
+    }
+    for (int i = 0; res >= 0 && stats.events && i < BSP_LATENCY_STAGE_MAX; i++) {
+        res = fprintf(f, "  %-10s avg %6"PRIu32" max %6"PRIu32" us\n", s_stage_names[i], stats.stage_avg_us[i],
+                      stats.stage_max_us[i]);
+    }
+    for (int i = 0; i < BSP_LATENCY_BUCKETS; i++) {
+        peak = MAX(peak, stats.hist[i]);
+    }
+    for (int i = 0; res >= 0 && i < BSP_LATENCY_BUCKETS; i++) {
+        if (stats.hist[i] == 0) {
+            continue;
+        }
+        char bar[LATENCY_BAR_WIDTH + 1];
+        const int len = MAX(1, stats.hist[i] * LATENCY_BAR_WIDTH / peak);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        res = fprintf(f, "%5"PRIu32"%s ms %6"PRIu32" %s\n", i * stats.bucket_us / 1000,
+                      i == BSP_LATENCY_BUCKETS - 1 ? "+" : " ", stats.hist[i], bar);
+    }
+    ESP_RETURN_ON_FALSE(res >= 0 && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
+
+esp_err_t bsp_latency_set_marker(bool enable)
+{
+    ESP_RETURN_ON_FALSE(s_latency.disp, ESP_ERR_INVALID_STATE, TAG, "Display not started");
+
+    lvgl_port_lock(0);
+    if (enable && s_latency.marker == NULL) {
+        lv_obj_t *marker = lv_obj_create(lv_display_get_layer_top(s_latency.disp));
+        lv_obj_remove_style_all(marker);
+        lv_obj_set_size(marker, LATENCY_MARKER_SIZE, LATENCY_MARKER_SIZE);
+        lv_obj_align(marker, LV_ALIGN_TOP_RIGHT, 0, 0);
+        lv_obj_set_style_bg_opa(marker, LV_OPA_COVER, LV_PART_MAIN);
+        lv_obj_set_style_bg_color(marker, lv_color_black(), LV_PART_MAIN);
+        lv_obj_remove_flag(marker, LV_OBJ_FLAG_CLICKABLE);
+        s_latency.marker = marker;
+        s_latency.marker_on = false;
+    } else if (!enable && s_latency.marker) {
+        lv_obj_delete(s_latency.marker);
+        s_latency.marker = NULL;
+    }
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+#else /* CONFIG_BSP_LATENCY */
+
+esp_err_t bsp_latency_get_stats(bsp_latency_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(bsp_latency_stats_t));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_latency_reset(void)
+{
+}
+
+esp_err_t bsp_latency_print(FILE *f)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_latency_set_marker(bool enable)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_BSP_LATENCY */
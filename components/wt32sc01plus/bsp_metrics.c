@@ -0,0 +1,235 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/metrics.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "BSP_METRICS";
+
+#define METRICS_DEPTH           CONFIG_BSP_METRICS_DEPTH
+#define METRICS_PERIOD_MS       CONFIG_BSP_METRICS_PERIOD_MS
+
+_Static_assert(sizeof(bsp_metrics_sample_t) == 32, "bsp_metrics_sample_t must not contain padding");
+
+static struct {
+    bool started;
+    lv_timer_t *timer;
+    bool idle;                  /* The last sample had no frames */
+    bool paused;                /* Sampling paused until the next frame */
+    uint32_t px_size;
+    int64_t period_start;
+    /* Accumulated in the LVGL task, reset by every sample */
+    int64_t render_start;
+    uint64_t render_us_sum;
+    uint32_t render_us_max;
+    uint32_t frames;
+    uint32_t flushes;
+    uint32_t flushed_bytes;
+    /* Ring, guarded by lock */
+    portMUX_TYPE lock;
+    uint32_t count;             /* Samples taken since start, the newest is ring[(count - 1) % METRICS_DEPTH] */
+    bsp_metrics_sample_t ring[METRICS_DEPTH];
+} s_metrics = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void metrics_render_cb(lv_event_t *e)
+{
+    const int64_t now = esp_timer_get_time();
+
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        if (s_metrics.paused) {
+            s_metrics.paused = false;
+            s_metrics.period_start = now;
+            lv_timer_reset(s_metrics.timer);
+            lv_timer_resume(s_metrics.timer);
+        }
+        s_metrics.render_start = now;
+    } else if (s_metrics.render_start) {
+        const uint32_t us = now - s_metrics.render_start;
+        s_metrics.render_us_sum += us;
+        s_metrics.render_us_max = MAX(s_metrics.render_us_max, us);
+        s_metrics.frames++;
+        s_metrics.render_start = 0;
+    }
+}
+
+static void metrics_flush_hook(lv_display_t *disp, const lv_area_t *area, const uint8_t *px_map, void *user_ctx)
+{
+    s_metrics.flushed_bytes += lv_area_get_size(area) * s_metrics.px_size;
+    s_metrics.flushes++;
+}
+
+static void metrics_sample_timer(lv_timer_t *timer)
+{
+    const int64_t now = esp_timer_get_time();
+    const uint32_t elapsed_ms = MAX((now - s_metrics.period_start) / 1000, 1);
+    lv_mem_monitor_t mon;
+
+    lv_mem_monitor(&mon);
+    const bsp_metrics_sample_t sample = {
+        .timestamp_ms = now / 1000,
+        .render_us_avg = s_metrics.frames ? s_metrics.render_us_sum / s_metrics.frames : 0,
+        .render_us_max = s_metrics.render_us_max,
+        .flushed_bytes = s_metrics.flushed_bytes,
+        .lvgl_mem_used = mon.total_size - mon.free_size,
+        .heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        .frames = MIN(s_metrics.frames, UINT16_MAX),
+        .flushes = MIN(s_metrics.flushes, UINT16_MAX),
+        .fps_x10 = MIN(s_metrics.frames * 10000 / elapsed_ms, UINT16_MAX),
+        .lvgl_cpu_pct = 100 - MIN(lv_timer_get_idle(), 100),
+        .lvgl_mem_frag_pct = mon.frag_pct,
+    };
+
+    s_metrics.period_start = now;
+    s_metrics.render_us_sum = 0;
+    s_metrics.render_us_max = 0;
+    s_metrics.frames = 0;
+    s_metrics.flushes = 0;
+    s_metrics.flushed_bytes = 0;
+
+    portENTER_CRITICAL(&s_metrics.lock);
+    s_metrics.ring[s_metrics.count % METRICS_DEPTH] = sample;
+    s_metrics.count++;
+    portEXIT_CRITICAL(&s_metrics.lock);
+
+    /* Nothing rendered twice in a row: stop sampling until the next frame, an idle screen needs no wakeups */
+    const bool idle = sample.frames == 0;
+    if (idle && s_metrics.idle) {
+        lv_timer_pause(timer);
+        s_metrics.paused = true;
+    }
+    s_metrics.idle = idle;
+}
+
+esp_err_t bsp_metrics_start(lv_display_t *disp)
+{
+    esp_err_t ret = ESP_OK;
+
+    assert(disp);
+    ESP_RETURN_ON_FALSE(!s_metrics.started, ESP_ERR_INVALID_STATE, TAG, "Metrics already started");
+
+    lvgl_port_lock(0);
+    s_metrics.px_size = lv_color_format_get_size(lv_display_get_color_format(disp));
+    s_metrics.period_start = esp_timer_get_time();
+    ESP_GOTO_ON_ERROR(bsp_display_add_flush_hook(metrics_flush_hook, NULL), err, TAG, "Flush hook failed");
+    s_metrics.timer = lv_timer_create(metrics_sample_timer, METRICS_PERIOD_MS, NULL);
+    ESP_GOTO_ON_FALSE(s_metrics.timer, ESP_ERR_NO_MEM, err_hook, TAG, "Timer failed");
+    lv_display_add_event_cb(disp, metrics_render_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, metrics_render_cb, LV_EVENT_RENDER_READY, NULL);
+    s_metrics.started = true;
+    lvgl_port_unlock();
+    return ESP_OK;
+
+err_hook:
+    bsp_display_remove_flush_hook(metrics_flush_hook, NULL);
+err:
+    lvgl_port_unlock();
+    return ret;
+}
+
+bool bsp_metrics_get_latest(bsp_metrics_sample_t *sample)
+{
+    assert(sample);
+    return bsp_metrics_read(sample, 1) == 1;
+}
+
+size_t bsp_metrics_read(bsp_metrics_sample_t *samples, size_t max)
+{
+    assert(samples || max == 0);
+
+    portENTER_CRITICAL(&s_metrics.lock);
+    const size_t n = MIN(max, MIN(s_metrics.count, METRICS_DEPTH));
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = s_metrics.ring[(s_metrics.count - n + i) % METRICS_DEPTH];
+    }
+    portEXIT_CRITICAL(&s_metrics.lock);
+    return n;
+}
+
+/* Snapshot of the whole ring, so the (slow) file writes happen outside of the critical section */
+static size_t metrics_snapshot(bsp_metrics_sample_t **ret_samples)
+{
+    *ret_samples = malloc(sizeof(bsp_metrics_sample_t) * METRICS_DEPTH);
+    if (*ret_samples == NULL) {
+        return 0;
+    }
+    return bsp_metrics_read(*ret_samples, METRICS_DEPTH);
+}
+
+esp_err_t bsp_metrics_dump_csv(FILE *f)
+{
+    bsp_metrics_sample_t *samples;
+
+    assert(f);
+    const size_t n = metrics_snapshot(&samples);
+    ESP_RETURN_ON_FALSE(samples, ESP_ERR_NO_MEM, TAG, "No memory for %d samples", METRICS_DEPTH);
+
+    int res = fprintf(f, "timestamp_ms,fps,lvgl_cpu_pct,render_us_avg,render_us_max,frames,flushes,flushed_bytes,"
+                      "lvgl_mem_used,lvgl_mem_frag_pct,heap_free\n");
+    for (size_t i = 0; i < n && res >= 0; i++) {
+        const bsp_metrics_sample_t *s = &samples[i];
+        res = fprintf(f, "%"PRIu32",%u.%u,%u,%"PRIu32",%"PRIu32",%u,%u,%"PRIu32",%"PRIu32",%u,%"PRIu32"\n",
+                      s->timestamp_ms, s->fps_x10 / 10, s->fps_x10 % 10, s->lvgl_cpu_pct, s->render_us_avg,
+                      s->render_us_max, s->frames, s->flushes, s->flushed_bytes, s->lvgl_mem_used,
+                      s->lvgl_mem_frag_pct, s->heap_free);
+    }
+    free(samples);
+    ESP_RETURN_ON_FALSE(res >= 0 && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
+
+esp_err_t bsp_metrics_dump_binary(FILE *f)
+{
+    bsp_metrics_sample_t *samples;
+
+    assert(f);
+    const size_t n = metrics_snapshot(&samples);
+    ESP_RETURN_ON_FALSE(samples, ESP_ERR_NO_MEM, TAG, "No memory for %d samples", METRICS_DEPTH);
+
+    const bsp_metrics_dump_header_t header = {
+        .magic = BSP_METRICS_MAGIC,
+        .version = BSP_METRICS_VERSION,
+        .sample_size = sizeof(bsp_metrics_sample_t),
+        .count = n,
+        .period_ms = METRICS_PERIOD_MS,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && (n == 0 || fwrite(samples, sizeof(bsp_metrics_sample_t), n, f) == n);
+    free(samples);
+    ESP_RETURN_ON_FALSE(ok && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
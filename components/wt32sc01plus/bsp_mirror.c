@@ -0,0 +1,403 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_lvgl_port.h"
+#if CONFIG_BSP_MIRROR_TRANSPORT_USB
+#include "driver/usb_serial_jtag.h"
+#else
+#include "driver/uart.h"
+#endif
+
+#include "bsp/mirror.h"
+#include "bsp/display.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "BSP_MIRROR";
+
+#define MIRROR_TILE             (16)
+#define MIRROR_MAX_TILES        (((BSP_LCD_H_RES + MIRROR_TILE - 1) / MIRROR_TILE) * ((BSP_LCD_V_RES + MIRROR_TILE - 1) / MIRROR_TILE))
+#define MIRROR_HEADER           (5)     /* Sync, type, length */
+#define MIRROR_TILE_HEADER      (6)
+#define MIRROR_PAYLOAD_MAX      (MIRROR_TILE_HEADER + MIRROR_TILE * MIRROR_TILE * 3)
+
+#define MIRROR_PKT_FRAME_BEGIN  (1)
+#define MIRROR_PKT_TILE         (2)
+#define MIRROR_PKT_FRAME_END    (3)
+
+#if CONFIG_BSP_MIRROR_TRANSPORT_USB
+#define MIRROR_BANDWIDTH        (CONFIG_BSP_MIRROR_USB_BANDWIDTH)
+#else
+#define MIRROR_BANDWIDTH        (CONFIG_BSP_MIRROR_UART_BAUD / 10)
+#endif
+
+static struct {
+    uint16_t *shadow;               /* Last flushed screen content, PSRAM */
+    uint32_t *sent_hash;            /* Hash of each tile as last sent, 0 means never sent */
+    /* Shared between the flush hook and the mirror task, guarded by `lock` */
+    portMUX_TYPE lock;
+    uint32_t dirty[(MIRROR_MAX_TILES + 31) / 32];
+    uint16_t width;
+    uint16_t height;
+    bool resized;
+    /* Mirror task */
+    TaskHandle_t task;
+    volatile bool stop;
+    uint32_t frame;
+    uint8_t pkt[MIRROR_HEADER + MIRROR_PAYLOAD_MAX + 2];
+    uint64_t hook_us_total;
+    uint32_t hook_calls;
+    bsp_mirror_stats_t stats;
+} s_mirror = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/**************************************************************************************************
+ *  Transport
+ **************************************************************************************************/
+
+#if CONFIG_BSP_MIRROR_TRANSPORT_USB
+
+static esp_err_t mirror_transport_init(void)
+{
+    usb_serial_jtag_driver_config_t cfg = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    cfg.tx_buffer_size = 4096;
+    const esp_err_t ret = usb_serial_jtag_driver_install(&cfg);
+    /* Already installed by the console */
+    return (ret == ESP_ERR_INVALID_STATE) ? ESP_OK : ret;
+}
+
+static void mirror_transport_write(const void *data, size_t len)
+{
+    usb_serial_jtag_write_bytes(data, len, portMAX_DELAY);
+}
+
+#else
+
+static esp_err_t mirror_transport_init(void)
+{
+    if (!uart_is_driver_installed(CONFIG_BSP_MIRROR_UART_NUM)) {
+        ESP_RETURN_ON_ERROR(uart_driver_install(CONFIG_BSP_MIRROR_UART_NUM, 256, 4096, 0, NULL, 0), TAG, "UART driver failed");
+    }
+    ESP_RETURN_ON_ERROR(uart_set_baudrate(CONFIG_BSP_MIRROR_UART_NUM, CONFIG_BSP_MIRROR_UART_BAUD), TAG, "UART baud rate failed");
+#if CONFIG_BSP_MIRROR_UART_TX_GPIO >= 0
+    ESP_RETURN_ON_ERROR(uart_set_pin(CONFIG_BSP_MIRROR_UART_NUM, CONFIG_BSP_MIRROR_UART_TX_GPIO, UART_PIN_NO_CHANGE,
+                                     UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE), TAG, "UART pins failed");
+#endif
+    return ESP_OK;
+}
+
+static void mirror_transport_write(const void *data, size_t len)
+{
+    uart_write_bytes(CONFIG_BSP_MIRROR_UART_NUM, data, len);
+}
+
+#endif /* CONFIG_BSP_MIRROR_TRANSPORT_USB */
+
+/* Frame the payload already in s_mirror.pkt and send it, returns the bytes written */
+static size_t mirror_send(uint8_t type, size_t len)
+{
+    uint8_t *p = s_mirror.pkt;
+
+    p[0] = 0xA5;
+    p[1] = 0x5A;
+    p[2] = type;
+    p[3] = len & 0xFF;
+    p[4] = len >> 8;
+    const uint16_t crc = esp_rom_crc16_le(0, &p[MIRROR_HEADER], len);
+    p[MIRROR_HEADER + len] = crc & 0xFF;
+    p[MIRROR_HEADER + len + 1] = crc >> 8;
+    mirror_transport_write(p, MIRROR_HEADER + len + 2);
+    return MIRROR_HEADER + len + 2;
+}
+
+static inline void mirror_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void mirror_put_u32(uint8_t *p, uint32_t v)
+{
+    mirror_put_u16(p, v & 0xFFFF);
+    mirror_put_u16(p + 2, v >> 16);
+}
+
+/**************************************************************************************************
+ *  Flush hook, LVGL task
+ **************************************************************************************************/
+
+static void mirror_set_dirty(uint32_t *dirty, size_t tile)
+{
+    dirty[tile / 32] |= 1U << (tile % 32);
+}
+
+static void mirror_flush_hook(lv_display_t *disp, const lv_area_t *area, const uint8_t *px_map, void *user_ctx)
+{
+    const int64_t start = esp_timer_get_time();
+    const int32_t w = lv_display_get_horizontal_resolution(disp);
+    const int32_t h = lv_display_get_vertical_resolution(disp);
+    const int32_t tiles_x = (w + MIRROR_TILE - 1) / MIRROR_TILE;
+
+    if (w != s_mirror.width || h != s_mirror.height) {
+        /* Rotated, send everything again */
+        portENTER_CRITICAL(&s_mirror.lock);
+        s_mirror.width = w;
+        s_mirror.height = h;
+        s_mirror.resized = true;
+        memset(s_mirror.dirty, 0xFF, sizeof(s_mirror.dirty));
+        portEXIT_CRITICAL(&s_mirror.lock);
+    }
+
+    const int32_t x1 = MAX(area->x1, 0);
+    const int32_t y1 = MAX(area->y1, 0);
+    const int32_t x2 = MIN(area->x2, w - 1);
+    const int32_t y2 = MIN(area->y2, h - 1);
+    if (x1 <= x2 && y1 <= y2) {
+        const uint16_t *src = (const uint16_t *)px_map;
+        const int32_t stride = lv_area_get_width(area);
+        for (int32_t y = y1; y <= y2; y++) {
+            memcpy(&s_mirror.shadow[y * w + x1], &src[(y - area->y1) * stride + (x1 - area->x1)], (x2 - x1 + 1) * sizeof(uint16_t));
+        }
+
+        portENTER_CRITICAL(&s_mirror.lock);
+        for (int32_t ty = y1 / MIRROR_TILE; ty <= y2 / MIRROR_TILE; ty++) {
+            for (int32_t tx = x1 / MIRROR_TILE; tx <= x2 / MIRROR_TILE; tx++) {
+                mirror_set_dirty(s_mirror.dirty, ty * tiles_x + tx);
+            }
+        }
+        portEXIT_CRITICAL(&s_mirror.lock);
+    }
+
+    if (lv_display_flush_is_last(disp)) {
+        s_mirror.stats.refreshes++;
+    }
+    const uint32_t took = esp_timer_get_time() - start;
+    s_mirror.hook_us_total += took;
+    s_mirror.hook_calls++;
+    s_mirror.stats.hook_us_max = MAX(s_mirror.stats.hook_us_max, took);
+}
+
+/**************************************************************************************************
+ *  Mirror task
+ **************************************************************************************************/
+
+/* FNV-1a of the tile pixels, never 0 so that 0 can mean "not sent" */
+static uint32_t mirror_tile_hash(const uint16_t *px, int32_t stride, int32_t tw, int32_t th)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int32_t y = 0; y < th; y++) {
+        for (int32_t x = 0; x < tw; x++) {
+            hash = (hash ^ px[y * stride + x]) * 16777619u;
+        }
+    }
+    return hash | 1;
+}
+
+/* Run length encode the tile into the packet payload after the tile header, returns the payload length */
+static size_t mirror_tile_encode(uint8_t *out, const uint16_t *px, int32_t stride, int32_t tw, int32_t th)
+{
+    size_t len = 0;
+    uint16_t color = px[0];
+    uint32_t count = 0;
+
+    for (int32_t y = 0; y < th; y++) {
+        for (int32_t x = 0; x < tw; x++) {
+            const uint16_t c = px[y * stride + x];
+            if (c == color && count < 256) {
+                count++;
+                continue;
+            }
+            out[len] = count - 1;
+            mirror_put_u16(&out[len + 1], color);
+            len += 3;
+            color = c;
+            count = 1;
+        }
+    }
+    out[len] = count - 1;
+    mirror_put_u16(&out[len + 1], color);
+    return len + 3;
+}
+
+static void mirror_task(void *arg)
+{
+    uint32_t dirty[(MIRROR_MAX_TILES + 31) / 32];
+    uint8_t *payload = &s_mirror.pkt[MIRROR_HEADER];
+    uint32_t delay_ms = CONFIG_BSP_MIRROR_MIN_INTERVAL_MS;
+
+    while (!s_mirror.stop) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        delay_ms = CONFIG_BSP_MIRROR_MIN_INTERVAL_MS;
+
+        portENTER_CRITICAL(&s_mirror.lock);
+        memcpy(dirty, s_mirror.dirty, sizeof(dirty));
+        memset(s_mirror.dirty, 0, sizeof(s_mirror.dirty));
+        const int32_t w = s_mirror.width;
+        const int32_t h = s_mirror.height;
+        const bool resized = s_mirror.resized;
+        s_mirror.resized = false;
+        portEXIT_CRITICAL(&s_mirror.lock);
+
+        const int32_t tiles_x = (w + MIRROR_TILE - 1) / MIRROR_TILE;
+        const int32_t tiles = tiles_x * ((h + MIRROR_TILE - 1) / MIRROR_TILE);
+        bool any = false;
+        for (size_t i = 0; i < sizeof(dirty) / sizeof(dirty[0]); i++) {
+            any |= (dirty[i] != 0);
+        }
+        if (!any) {
+            continue;
+        }
+        if (resized) {
+            memset(s_mirror.sent_hash, 0, MIRROR_MAX_TILES * sizeof(uint32_t));
+        }
+
+        const int64_t start = esp_timer_get_time();
+        size_t bytes = 0;
+        s_mirror.frame++;
+        mirror_put_u16(&payload[0], w);
+        mirror_put_u16(&payload[2], h);
+        mirror_put_u32(&payload[4], s_mirror.frame);
+        bytes += mirror_send(MIRROR_PKT_FRAME_BEGIN, 8);
+
+        for (int32_t t = 0; t < tiles; t++) {
+            if (!(dirty[t / 32] & (1U << (t % 32)))) {
+                continue;
+            }
+            const int32_t x = (t % tiles_x) * MIRROR_TILE;
+            const int32_t y = (t / tiles_x) * MIRROR_TILE;
+            const int32_t tw = MIN(MIRROR_TILE, w - x);
+            const int32_t th = MIN(MIRROR_TILE, h - y);
+            const uint16_t *px = &s_mirror.shadow[y * w + x];
+
+            const uint32_t hash = mirror_tile_hash(px, w, tw, th);
+            if (hash == s_mirror.sent_hash[t]) {
+                s_mirror.stats.tiles_unchanged++;
+                continue;
+            }
+            s_mirror.sent_hash[t] = hash;
+
+            mirror_put_u16(&payload[0], x);
+            mirror_put_u16(&payload[2], y);
+            payload[4] = tw;
+            payload[5] = th;
+            const size_t len = MIRROR_TILE_HEADER + mirror_tile_encode(&payload[MIRROR_TILE_HEADER], px, w, tw, th);
+            bytes += mirror_send(MIRROR_PKT_TILE, len);
+            s_mirror.stats.tiles_sent++;
+            s_mirror.stats.tile_bytes_raw += tw * th * sizeof(uint16_t);
+        }
+
+        mirror_put_u32(&payload[0], s_mirror.frame);
+        bytes += mirror_send(MIRROR_PKT_FRAME_END, 4);
+
+        s_mirror.stats.frames_sent++;
+        s_mirror.stats.bytes_sent += bytes;
+        s_mirror.stats.frame_us_last = esp_timer_get_time() - start;
+        /* Leave the transport time to drain this frame, refreshes meanwhile are merged into the next one */
+        delay_ms = MAX(delay_ms, (uint32_t)((uint64_t)bytes * 1000 / MIRROR_BANDWIDTH));
+    }
+
+    s_mirror.task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**************************************************************************************************
+ *  Public API
+ **************************************************************************************************/
+
+static void mirror_free(void)
+{
+    heap_caps_free(s_mirror.shadow);
+    heap_caps_free(s_mirror.sent_hash);
+    s_mirror.shadow = NULL;
+    s_mirror.sent_hash = NULL;
+}
+
+esp_err_t bsp_mirror_start(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(s_mirror.task == NULL, ESP_ERR_INVALID_STATE, TAG, "Mirror already started");
+
+    const size_t shadow_size = BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(uint16_t);
+    s_mirror.shadow = heap_caps_calloc(1, shadow_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (s_mirror.shadow == NULL) {
+        s_mirror.shadow = heap_caps_calloc(1, shadow_size, MALLOC_CAP_8BIT);
+    }
+    s_mirror.sent_hash = heap_caps_calloc(MIRROR_MAX_TILES, sizeof(uint32_t), MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(s_mirror.shadow && s_mirror.sent_hash, ESP_ERR_NO_MEM, err, TAG, "No memory for the shadow framebuffer");
+    ESP_GOTO_ON_ERROR(mirror_transport_init(), err, TAG, "Transport failed");
+
+    s_mirror.width = 0;
+    s_mirror.height = 0;
+    s_mirror.stop = false;
+    ESP_GOTO_ON_FALSE(xTaskCreate(mirror_task, "mirror", 3072, NULL, CONFIG_BSP_MIRROR_TASK_PRIORITY, &s_mirror.task) == pdPASS,
+                      ESP_ERR_NO_MEM, err, TAG, "Mirror task failed");
+    ret = bsp_display_add_flush_hook(mirror_flush_hook, NULL);
+    if (ret != ESP_OK) {
+        bsp_mirror_stop();
+        return ret;
+    }
+    /* Send the current screen content */
+    lvgl_port_lock(0);
+    lv_obj_invalidate(lv_screen_active());
+    lvgl_port_unlock();
+    ESP_LOGI(TAG, "Mirroring display, %d bytes/s", MIRROR_BANDWIDTH);
+    return ESP_OK;
+
+err:
+    mirror_free();
+    return ret;
+}
+
+esp_err_t bsp_mirror_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_mirror.task, ESP_ERR_INVALID_STATE, TAG, "Mirror not started");
+
+    bsp_display_remove_flush_hook(mirror_flush_hook, NULL);
+    s_mirror.stop = true;
+    while (s_mirror.task) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    mirror_free();
+    return ESP_OK;
+}
+
+void bsp_mirror_get_stats(bsp_mirror_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_mirror.stats;
+    stats->hook_us_avg = s_mirror.hook_calls ? s_mirror.hook_us_total / s_mirror.hook_calls : 0;
+}
@@ -0,0 +1,232 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/modbus.h"
+#include "bsp_modbus_master_core.h"
+
+static const char *TAG = "BSP_MODBUS_M";
+
+#define MODBUS_WRITE_QUEUE_LEN  (8)
+#define MODBUS_IDLE_WAIT_MS     (100)   /* Longest sleep without polls, bounds the stop latency */
+
+typedef struct {
+    uint8_t slave;
+    uint16_t address;
+    uint16_t value;
+} modbus_write_t;
+
+static struct {
+    modbus_master_t core;               /* Scheduler and transactions, see bsp_modbus_master_core.h */
+    QueueHandle_t write_queue;
+    SemaphoreHandle_t done;
+    volatile bool running;
+} s_master;
+
+static int modbus_io_write(void *ctx, const uint8_t *frame, size_t len)
+{
+    return bsp_rs485_write(frame, len);
+}
+
+static int modbus_io_read_frame(void *ctx, uint8_t *buf, size_t size, uint32_t timeout_ms, size_t *ret_len)
+{
+    return bsp_rs485_read_frame(buf, size, timeout_ms, ret_len);
+}
+
+static void modbus_io_flush_input(void *ctx)
+{
+    bsp_rs485_flush_input();
+}
+
+static int64_t modbus_io_now_us(void *ctx)
+{
+    return esp_timer_get_time();
+}
+
+static void modbus_io_wait_until_us(void *ctx, int64_t deadline_us)
+{
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    const int64_t us = deadline_us - esp_timer_get_time();
+    /* vTaskDelay() may return up to one tick early, sleep one tick less and spin on the clock for the rest */
+    if (us >= 2 * tick_us) {
+        vTaskDelay(us / tick_us - 1);
+    }
+    while (esp_timer_get_time() < deadline_us) {
+    }
+}
+
+static void modbus_master_task(void *arg)
+{
+    modbus_write_t wr;
+
+    while (s_master.running) {
+        if (xQueueReceive(s_master.write_queue, &wr, 0) == pdTRUE) {
+            if (!modbus_master_write_single(&s_master.core, wr.slave, wr.address, wr.value)) {
+                ESP_LOGW(TAG, "Write %d:%d failed", wr.slave, wr.address);
+            }
+            continue;
+        }
+        if (!modbus_master_poll(&s_master.core)) {
+            const int64_t wait_us = modbus_master_next_due(&s_master.core) - esp_timer_get_time();
+            TickType_t ticks = pdMS_TO_TICKS(MIN(wait_us / 1000, MODBUS_IDLE_WAIT_MS));
+            /* Sleep until the next poll is due, a queued write wakes us early */
+            xQueuePeek(s_master.write_queue, &wr, MAX(ticks, 1));
+        }
+    }
+
+    xSemaphoreGive(s_master.done);
+    vTaskDelete(NULL);
+}
+
+static void modbus_master_release(void)
+{
+    if (s_master.write_queue) {
+        vQueueDelete(s_master.write_queue);
+    }
+    if (s_master.done) {
+        vSemaphoreDelete(s_master.done);
+    }
+    free(s_master.core.entries);
+    free(s_master.core.cache);
+    memset(&s_master, 0, sizeof(s_master));
+}
+
+esp_err_t bsp_modbus_master_start(const bsp_modbus_master_config_t *config, const bsp_modbus_poll_t *polls, size_t num_polls)
+{
+    esp_err_t ret = ESP_OK;
+    modbus_master_t *m = &s_master.core;
+
+    assert(config && (polls || num_polls == 0));
+    ESP_RETURN_ON_FALSE(!s_master.running, ESP_ERR_INVALID_STATE, TAG, "Master already running");
+    ESP_RETURN_ON_ERROR(bsp_rs485_init(&config->rs485), TAG, "RS485 init failed");
+
+    m->io = (modbus_master_io_t) {
+        .write = modbus_io_write,
+        .read_frame = modbus_io_read_frame,
+        .flush_input = modbus_io_flush_input,
+        .now_us = modbus_io_now_us,
+        .wait_until_us = modbus_io_wait_until_us,
+    };
+    m->num = num_polls;
+    m->baud_rate = config->rs485.baud_rate;
+    m->response_timeout_ms = config->response_timeout_ms;
+    m->max_merge_gap = config->max_merge_gap;
+    m->on_change = config->on_change;
+    m->user_ctx = config->user_ctx;
+    ESP_GOTO_ON_FALSE(m->entries = calloc(MAX(num_polls, 1), sizeof(modbus_master_entry_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    ESP_GOTO_ON_FALSE(m->cache = calloc(MAX(num_polls, 1), sizeof(modbus_master_cache_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    ESP_GOTO_ON_FALSE(s_master.write_queue = xQueueCreate(MODBUS_WRITE_QUEUE_LEN, sizeof(modbus_write_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    ESP_GOTO_ON_FALSE(s_master.done = xSemaphoreCreateBinary(), ESP_ERR_NO_MEM, err, TAG, "No memory");
+
+    const int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < num_polls; i++) {
+        ESP_GOTO_ON_FALSE(polls[i].period_ms > 0, ESP_ERR_INVALID_ARG, err, TAG, "Poll %d has no period", (int)i);
+        m->entries[i] = (modbus_master_entry_t) {
+            .slave = polls[i].slave,
+            .function = polls[i].type,
+            .address = polls[i].address,
+            .period_ms = polls[i].period_ms,
+            .id = i,
+            .next_due_us = now,
+        };
+    }
+    modbus_master_init(m);
+
+    s_master.running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(modbus_master_task, "modbus_m", CONFIG_BSP_MODBUS_TASK_STACK, NULL,
+                      CONFIG_BSP_MODBUS_TASK_PRIORITY, NULL, tskNO_AFFINITY) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Task create failed");
+    ESP_LOGI(TAG, "Polling %d registers", (int)num_polls);
+    return ESP_OK;
+
+err:
+    modbus_master_release();
+    bsp_rs485_deinit();
+    return ret;
+}
+
+esp_err_t bsp_modbus_master_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_master.running, ESP_ERR_INVALID_STATE, TAG, "Master not running");
+    s_master.running = false;
+    xSemaphoreTake(s_master.done, portMAX_DELAY);
+    modbus_master_release();
+    return bsp_rs485_deinit();
+}
+
+esp_err_t bsp_modbus_master_get(size_t poll_id, uint16_t *value, uint32_t *ret_age_ms)
+{
+    assert(value);
+    ESP_RETURN_ON_FALSE(s_master.core.cache && poll_id < s_master.core.num, ESP_ERR_INVALID_ARG, TAG, "Invalid poll id");
+
+    const modbus_master_cache_t *c = &s_master.core.cache[poll_id];
+    if (!c->valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *value = c->value;
+    if (ret_age_ms) {
+        *ret_age_ms = (uint32_t)(esp_timer_get_time() / 1000) - c->updated_ms;
+    }
+    return ESP_OK;
+}
+
+esp_err_t bsp_modbus_master_write(uint8_t slave, uint16_t address, uint16_t value)
+{
+    const modbus_write_t wr = {
+        .slave = slave,
+        .address = address,
+        .value = value,
+    };
+    ESP_RETURN_ON_FALSE(s_master.running, ESP_ERR_INVALID_STATE, TAG, "Master not running");
+    return xQueueSend(s_master.write_queue, &wr, 0) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void bsp_modbus_master_get_stats(bsp_modbus_master_stats_t *stats)
+{
+    const modbus_master_stats_t *s = &s_master.core.stats;
+
+    assert(stats);
+    *stats = (bsp_modbus_master_stats_t) {
+        .requests = s->requests,
+        .writes = s->writes,
+        .timeouts = s->timeouts,
+        .crc_errors = s->crc_errors,
+        .exceptions = s->exceptions,
+        .bad_responses = s->bad_responses,
+        .merged = s->merged,
+        .late = s->late,
+        .last_rtt_us = s->last_rtt_us,
+        .max_rtt_us = s->max_rtt_us,
+    };
+}
@@ -0,0 +1,249 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "bsp_modbus_master_core.h"
+
+static int modbus_entry_cmp(const void *a, const void *b)
+{
+    const modbus_master_entry_t *ea = a;
+    const modbus_master_entry_t *eb = b;
+    if (ea->slave != eb->slave) {
+        return ea->slave - eb->slave;
+    }
+    if (ea->function != eb->function) {
+        return ea->function - eb->function;
+    }
+    return (int)ea->address - (int)eb->address;
+}
+
+void modbus_master_init(modbus_master_t *m)
+{
+    qsort(m->entries, m->num, sizeof(modbus_master_entry_t), modbus_entry_cmp);
+    m->t35_us = modbus_rtu_t35_us(m->baud_rate);
+    m->bus_idle_us = 0;
+    m->sent_us = 0;
+    m->cur = 0;
+    m->have = false;
+    memset(&m->stats, 0, sizeof(m->stats));
+}
+
+/* Register `n` can be read by the same request as the span [lo, hi] */
+static bool modbus_master_fits(const modbus_master_t *m, const modbus_master_entry_t *n, const modbus_master_entry_t *due,
+                               uint16_t lo, uint16_t hi)
+{
+    if (n->slave != due->slave || n->function != due->function) {
+        return false;
+    }
+    const uint16_t addr = n->address;
+    const uint32_t gap = addr < lo ? lo - addr - 1U : (addr > hi ? addr - hi - 1U : 0);
+    return MAX(hi, addr) - MIN(lo, addr) + 1 <= MODBUS_RTU_MAX_READ_REGS && gap <= m->max_merge_gap;
+}
+
+/* Only pull in registers due within half of their own period */
+static bool modbus_master_due_soon(const modbus_master_entry_t *n, int64_t now)
+{
+    return n->next_due_us <= now + (int64_t)n->period_ms * 500;
+}
+
+static size_t modbus_master_next_idx(const modbus_master_t *m)
+{
+    size_t idx = 0;
+    for (size_t i = 1; i < m->num; i++) {
+        if (m->entries[i].next_due_us < m->entries[idx].next_due_us) {
+            idx = i;
+        }
+    }
+    return idx;
+}
+
+int64_t modbus_master_next_due(const modbus_master_t *m)
+{
+    return m->num ? m->entries[modbus_master_next_idx(m)].next_due_us : INT64_MAX;
+}
+
+bool modbus_master_plan(modbus_master_t *m, int64_t now, modbus_request_t *req)
+{
+    if (modbus_master_next_due(m) > now) {
+        return false;
+    }
+
+    const size_t due_idx = modbus_master_next_idx(m);
+    const modbus_master_entry_t *due = &m->entries[due_idx];
+    uint16_t lo = due->address;
+    uint16_t hi = due->address;
+    size_t first = due_idx;
+    size_t last = due_idx;
+
+    /* Extend over registers that are not due yet if a due one follows, they get refreshed for free */
+    for (size_t j = first, l = lo; j > 0 && modbus_master_fits(m, &m->entries[j - 1], due, l, hi); j--) {
+        l = m->entries[j - 1].address;
+        if (modbus_master_due_soon(&m->entries[j - 1], now)) {
+            first = j - 1;
+            lo = l;
+        }
+    }
+    for (size_t j = last + 1, h = hi; j < m->num && modbus_master_fits(m, &m->entries[j], due, lo, h); j++) {
+        h = m->entries[j].address;
+        if (modbus_master_due_soon(&m->entries[j], now)) {
+            last = j;
+            hi = h;
+        }
+    }
+
+    for (size_t i = first; i <= last; i++) {
+        modbus_master_entry_t *e = &m->entries[i];
+        const int64_t period_us = (int64_t)e->period_ms * 1000;
+        if (i != due_idx) {
+            m->stats.merged++;
+        }
+        if (now - e->next_due_us > period_us) {
+            m->stats.late++;
+        }
+        /* Keep the poll grid unless we fell behind or served the register early */
+        e->next_due_us += period_us;
+        if (e->next_due_us <= now || e->next_due_us > now + period_us) {
+            e->next_due_us = now + period_us;
+        }
+    }
+
+    req->first = first;
+    req->last = last;
+    req->start = lo;
+    req->count = hi - lo + 1;
+    req->len = modbus_rtu_build_read(req->frame, due->slave, due->function, lo, req->count);
+    return true;
+}
+
+static int modbus_master_send(modbus_master_t *m, const uint8_t *frame, size_t len)
+{
+    /* Inter-frame gap: t3.5 of silence since the last activity on the bus */
+    m->io.wait_until_us(m->io.ctx, m->bus_idle_us);
+    /* Drop late responses to timed out requests */
+    m->io.flush_input(m->io.ctx);
+    const int ret = m->io.write(m->io.ctx, frame, len);
+    m->sent_us = m->io.now_us(m->io.ctx);
+    m->bus_idle_us = m->sent_us + m->t35_us;
+    return ret;
+}
+
+/* Receive and check the response to `request`, returns its length or 0 */
+static size_t modbus_master_receive(modbus_master_t *m, const uint8_t *request)
+{
+    size_t len = 0;
+    const int ret = m->io.read_frame(m->io.ctx, m->rx, sizeof(m->rx), m->response_timeout_ms, &len);
+    const int64_t now = m->io.now_us(m->io.ctx);
+    m->bus_idle_us = now + m->t35_us;
+
+    if (ret != 0 || (len > 0 && !modbus_rtu_crc_ok(m->rx, len))) {
+        m->stats.crc_errors++;
+        return 0;
+    }
+    if (len == 0) {
+        m->stats.timeouts++;
+        return 0;
+    }
+    if (m->rx[0] != request[0]) {
+        m->stats.bad_responses++;
+        return 0;
+    }
+    m->stats.last_rtt_us = now - m->sent_us;
+    m->stats.max_rtt_us = MAX(m->stats.max_rtt_us, m->stats.last_rtt_us);
+    if (m->rx[1] == (request[1] | MODBUS_FC_EXCEPTION)) {
+        m->stats.exceptions++;
+        return 0;
+    }
+    if (m->rx[1] != request[1]) {
+        m->stats.bad_responses++;
+        return 0;
+    }
+    return len;
+}
+
+static void modbus_master_update_cache(modbus_master_t *m, const modbus_request_t *req, size_t len)
+{
+    if (m->rx[2] != req->count * 2 || len != 5U + req->count * 2) {
+        m->stats.bad_responses++;
+        return;
+    }
+    const uint32_t now_ms = m->io.now_us(m->io.ctx) / 1000;
+    for (size_t i = req->first; i <= req->last; i++) {
+        const modbus_master_entry_t *e = &m->entries[i];
+        modbus_master_cache_t *c = &m->cache[e->id];
+        const uint16_t value = modbus_rtu_get_u16(&m->rx[3 + 2 * (e->address - req->start)]);
+        const bool changed = !c->valid || c->value != value;
+
+        c->value = value;
+        c->updated_ms = now_ms;
+        c->valid = true;
+        if (changed && m->on_change) {
+            m->on_change(e->id, value, m->user_ctx);
+        }
+    }
+}
+
+bool modbus_master_poll(modbus_master_t *m)
+{
+    modbus_request_t *req = &m->req[m->cur];
+
+    if (!m->have) {
+        m->have = modbus_master_plan(m, m->io.now_us(m->io.ctx), req);
+    }
+    if (!m->have) {
+        return false;
+    }
+
+    m->stats.requests++;
+    if (modbus_master_send(m, req->frame, req->len) != 0) {
+        m->have = false;
+        return true;
+    }
+    /* Plan the next request while the response is on the wire */
+    const int next = m->cur ^ 1;
+    const bool next_have = modbus_master_plan(m, m->io.now_us(m->io.ctx), &m->req[next]);
+
+    const size_t len = modbus_master_receive(m, req->frame);
+    if (len) {
+        modbus_master_update_cache(m, req, len);
+    }
+    m->cur = next;
+    m->have = next_have;
+    return true;
+}
+
+bool modbus_master_write_single(modbus_master_t *m, uint8_t slave, uint16_t address, uint16_t value)
+{
+    uint8_t frame[8];
+    const size_t len = modbus_rtu_build_write_single(frame, slave, address, value);
+
+    m->stats.writes++;
+    if (modbus_master_send(m, frame, len) != 0) {
+        return false;
+    }
+    /* Broadcast, no response */
+    return slave == 0 || modbus_master_receive(m, frame) != 0;
+}
@@ -0,0 +1,288 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/modbus.h"
+#include "bsp_modbus_rtu.h"
+
+static const char *TAG = "BSP_MODBUS_S";
+
+#define MODBUS_SLAVE_POLL_MS    (100)   /* Longest wait for a request, bounds the stop latency */
+
+static struct {
+    bsp_modbus_slave_config_t config;
+    uint16_t *holding;
+    uint16_t *input;
+    portMUX_TYPE lock;              /* Guards the register map, held only while copying registers */
+    volatile bool running;
+    SemaphoreHandle_t done;
+    bsp_modbus_slave_stats_t stats;
+    uint8_t rx[MODBUS_RTU_MAX_FRAME];
+    uint8_t tx[MODBUS_RTU_MAX_FRAME];
+} s_slave = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Registers [address, address + count) of the map, NULL if out of range */
+static uint16_t *modbus_slave_map(bsp_modbus_reg_type_t type, uint16_t address, size_t count)
+{
+    uint16_t *regs = (type == BSP_MODBUS_HOLDING) ? s_slave.holding : s_slave.input;
+    uint16_t base = (type == BSP_MODBUS_HOLDING) ? s_slave.config.holding_base : s_slave.config.input_base;
+    uint16_t num = (type == BSP_MODBUS_HOLDING) ? s_slave.config.num_holding : s_slave.config.num_input;
+
+    if (regs == NULL || address < base || (size_t)(address - base) + count > num) {
+        return NULL;
+    }
+    return &regs[address - base];
+}
+
+static uint8_t modbus_slave_read(const uint8_t *req, size_t len, size_t *tx_len)
+{
+    if (len != 8) {
+        return MODBUS_EX_ILLEGAL_VALUE;
+    }
+    const uint16_t address = modbus_rtu_get_u16(&req[2]);
+    const uint16_t count = modbus_rtu_get_u16(&req[4]);
+    if (count == 0 || count > MODBUS_RTU_MAX_READ_REGS) {
+        return MODBUS_EX_ILLEGAL_VALUE;
+    }
+    const uint16_t *regs = modbus_slave_map((bsp_modbus_reg_type_t)req[1], address, count);
+    if (regs == NULL) {
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    }
+
+    /* Serialize straight from the map */
+    uint8_t *p = &s_slave.tx[3];
+    s_slave.tx[2] = count * 2;
+    portENTER_CRITICAL(&s_slave.lock);
+    for (uint16_t i = 0; i < count; i++, p += 2) {
+        modbus_rtu_put_u16(p, regs[i]);
+    }
+    portEXIT_CRITICAL(&s_slave.lock);
+    *tx_len = 3 + count * 2;
+    return 0;
+}
+
+static uint8_t modbus_slave_write(const uint8_t *req, size_t len, size_t *tx_len)
+{
+    uint16_t address = modbus_rtu_get_u16(&req[2]);
+    uint16_t count = 1;
+    const uint8_t *values = &req[4];
+
+    if (req[1] == MODBUS_FC_WRITE_MULTIPLE) {
+        count = modbus_rtu_get_u16(&req[4]);
+        if (len < 9 || count == 0 || count > MODBUS_RTU_MAX_WRITE_REGS || req[6] != count * 2 || len != 9U + count * 2) {
+            return MODBUS_EX_ILLEGAL_VALUE;
+        }
+        values = &req[7];
+    } else if (len != 8) {
+        return MODBUS_EX_ILLEGAL_VALUE;
+    }
+
+    uint16_t *regs = modbus_slave_map(BSP_MODBUS_HOLDING, address, count);
+    if (regs == NULL) {
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    }
+    portENTER_CRITICAL(&s_slave.lock);
+    for (uint16_t i = 0; i < count; i++) {
+        regs[i] = modbus_rtu_get_u16(&values[2 * i]);
+    }
+    portEXIT_CRITICAL(&s_slave.lock);
+
+    /* Both write responses echo the first 6 bytes of the request */
+    memcpy(&s_slave.tx[2], &req[2], 4);
+    *tx_len = 6;
+    if (s_slave.config.on_write) {
+        s_slave.config.on_write(address, count, s_slave.config.user_ctx);
+    }
+    return 0;
+}
+
+/* Build the response to `req` in s_slave.tx, returns its length */
+static size_t modbus_slave_process(const uint8_t *req, size_t len)
+{
+    size_t tx_len = 0;
+    uint8_t ex;
+
+    s_slave.tx[0] = req[0];
+    s_slave.tx[1] = req[1];
+    switch (req[1]) {
+    case MODBUS_FC_READ_HOLDING:
+    case MODBUS_FC_READ_INPUT:
+        ex = modbus_slave_read(req, len, &tx_len);
+        break;
+    case MODBUS_FC_WRITE_SINGLE:
+    case MODBUS_FC_WRITE_MULTIPLE:
+        ex = modbus_slave_write(req, len, &tx_len);
+        break;
+    default:
+        ex = MODBUS_EX_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if (ex) {
+        s_slave.stats.exceptions++;
+        s_slave.tx[1] = req[1] | MODBUS_FC_EXCEPTION;
+        s_slave.tx[2] = ex;
+        tx_len = 3;
+    }
+    return modbus_rtu_seal(s_slave.tx, tx_len);
+}
+
+static void modbus_slave_task(void *arg)
+{
+    size_t len;
+
+    while (s_slave.running) {
+        /* Blocks on the UART event queue, woken by the RX timeout interrupt at the end of a frame */
+        esp_err_t ret = bsp_rs485_read_frame(s_slave.rx, sizeof(s_slave.rx), MODBUS_SLAVE_POLL_MS, &len);
+        const int64_t rx_end = esp_timer_get_time();
+        if (ret == ESP_OK && len == 0) {
+            continue;
+        }
+        if (ret != ESP_OK || !modbus_rtu_crc_ok(s_slave.rx, len)) {
+            s_slave.stats.crc_errors++;
+            continue;
+        }
+        if (s_slave.rx[0] != s_slave.config.address && s_slave.rx[0] != 0) {
+            s_slave.stats.foreign++;
+            continue;
+        }
+
+        s_slave.stats.requests++;
+        len = modbus_slave_process(s_slave.rx, len);
+        if (s_slave.rx[0] == 0) {
+            /* Broadcast, no response */
+            continue;
+        }
+        if (bsp_rs485_write(s_slave.tx, len) != ESP_OK) {
+            s_slave.stats.tx_errors++;
+            continue;
+        }
+
+        const uint32_t latency = esp_timer_get_time() - rx_end;
+        s_slave.stats.last_latency_us = latency;
+        s_slave.stats.max_latency_us = MAX(s_slave.stats.max_latency_us, latency);
+        s_slave.stats.avg_latency_us = s_slave.stats.avg_latency_us ?
+                                       (s_slave.stats.avg_latency_us * 7 + latency) / 8 : latency;
+    }
+
+    xSemaphoreGive(s_slave.done);
+    vTaskDelete(NULL);
+}
+
+static void modbus_slave_release(void)
+{
+    if (s_slave.done) {
+        vSemaphoreDelete(s_slave.done);
+    }
+    free(s_slave.holding);
+    free(s_slave.input);
+    s_slave.done = NULL;
+    s_slave.holding = NULL;
+    s_slave.input = NULL;
+}
+
+esp_err_t bsp_modbus_slave_start(const bsp_modbus_slave_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+
+    assert(config);
+    ESP_RETURN_ON_FALSE(!s_slave.running, ESP_ERR_INVALID_STATE, TAG, "Slave already running");
+    ESP_RETURN_ON_FALSE(config->address >= 1 && config->address <= 247, ESP_ERR_INVALID_ARG, TAG, "Invalid slave address");
+    ESP_RETURN_ON_ERROR(bsp_rs485_init(&config->rs485), TAG, "RS485 init failed");
+
+    s_slave.config = *config;
+    memset(&s_slave.stats, 0, sizeof(s_slave.stats));
+    if (config->num_holding) {
+        ESP_GOTO_ON_FALSE(s_slave.holding = calloc(config->num_holding, sizeof(uint16_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    }
+    if (config->num_input) {
+        ESP_GOTO_ON_FALSE(s_slave.input = calloc(config->num_input, sizeof(uint16_t)), ESP_ERR_NO_MEM, err, TAG, "No memory");
+    }
+    ESP_GOTO_ON_FALSE(s_slave.done = xSemaphoreCreateBinary(), ESP_ERR_NO_MEM, err, TAG, "No memory");
+
+    s_slave.running = true;
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(modbus_slave_task, "modbus_s", CONFIG_BSP_MODBUS_TASK_STACK, NULL,
+                      CONFIG_BSP_MODBUS_TASK_PRIORITY, NULL, tskNO_AFFINITY) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "Task create failed");
+    ESP_LOGI(TAG, "Slave %d: %d holding, %d input registers", config->address, config->num_holding, config->num_input);
+    return ESP_OK;
+
+err:
+    s_slave.running = false;
+    modbus_slave_release();
+    bsp_rs485_deinit();
+    return ret;
+}
+
+esp_err_t bsp_modbus_slave_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_slave.running, ESP_ERR_INVALID_STATE, TAG, "Slave not running");
+    s_slave.running = false;
+    xSemaphoreTake(s_slave.done, portMAX_DELAY);
+    modbus_slave_release();
+    return bsp_rs485_deinit();
+}
+
+esp_err_t bsp_modbus_slave_set(bsp_modbus_reg_type_t type, uint16_t address, const uint16_t *values, size_t count)
+{
+    assert(values);
+    ESP_RETURN_ON_FALSE(s_slave.running, ESP_ERR_INVALID_STATE, TAG, "Slave not running");
+    uint16_t *regs = modbus_slave_map(type, address, count);
+    ESP_RETURN_ON_FALSE(regs, ESP_ERR_INVALID_ARG, TAG, "Registers out of range");
+
+    portENTER_CRITICAL(&s_slave.lock);
+    memcpy(regs, values, count * sizeof(uint16_t));
+    portEXIT_CRITICAL(&s_slave.lock);
+    return ESP_OK;
+}
+
+esp_err_t bsp_modbus_slave_get(bsp_modbus_reg_type_t type, uint16_t address, uint16_t *values, size_t count)
+{
+    assert(values);
+    ESP_RETURN_ON_FALSE(s_slave.running, ESP_ERR_INVALID_STATE, TAG, "Slave not running");
+    const uint16_t *regs = modbus_slave_map(type, address, count);
+    ESP_RETURN_ON_FALSE(regs, ESP_ERR_INVALID_ARG, TAG, "Registers out of range");
+
+    portENTER_CRITICAL(&s_slave.lock);
+    memcpy(values, regs, count * sizeof(uint16_t));
+    portEXIT_CRITICAL(&s_slave.lock);
+    return ESP_OK;
+}
+
+void bsp_modbus_slave_get_stats(bsp_modbus_slave_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_slave.stats;
+}
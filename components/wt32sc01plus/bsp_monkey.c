@@ -0,0 +1,276 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "bsp/monkey.h"
+#include "indev/lv_indev_private.h"
+
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "bsp/wt32sc01plus.h"
+#include "bsp_monkey_seq.h"
+
+static const char *TAG = "BSP_MONKEY";
+
+typedef struct {
+    bsp_monkey_hist_t frame;
+    bsp_monkey_hist_t latency;
+} monkey_hist_t;
+
+static struct {
+    bool running;
+    bool done;
+    bsp_monkey_config_t cfg;
+    lv_indev_t *indev;
+    lv_display_t *disp;
+    lv_indev_read_cb_t read_cb;     /* Callback of the input device, restored at the end */
+    bsp_monkey_seq_t seq;
+    /* Measurements */
+    int64_t start_us;
+    int64_t render_start_us;
+    int64_t input_us;               /* Last input not rendered yet, 0 if none */
+    size_t heap_start;
+    size_t heap_min;
+    uint32_t alloc_failed;
+    monkey_hist_t *hist;
+    bsp_monkey_report_t report;
+} s_monkey;
+
+static int64_t monkey_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static void monkey_heap_sample(void)
+{
+    s_monkey.heap_min = MIN(s_monkey.heap_min, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+/*
+ * Failed LVGL allocations, counted where lv_malloc() and lv_realloc() call the allocator; see the --wrap
+ * options in CMakeLists.txt. ESP-IDF has a single failed-allocation callback and no way to restore the
+ * previous one, so the monkey leaves it to the application.
+ */
+void *__real_lv_malloc_core(size_t size);
+void *__real_lv_realloc_core(void *p, size_t new_size);
+
+static void *monkey_alloc_check(void *p)
+{
+    if (p == NULL && __atomic_load_n(&s_monkey.running, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(&s_monkey.alloc_failed, 1, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+void *__wrap_lv_malloc_core(size_t size)
+{
+    return monkey_alloc_check(__real_lv_malloc_core(size));
+}
+
+void *__wrap_lv_realloc_core(void *p, size_t new_size)
+{
+    return monkey_alloc_check(__real_lv_realloc_core(p, new_size));
+}
+
+static void monkey_dist(const bsp_monkey_hist_t *hist, bsp_monkey_dist_t *dist)
+{
+    static const uint32_t pct[3] = {50, 90, 99};
+    uint32_t out[3] = {0};
+
+    bsp_monkey_hist_percentiles(hist, pct, out, 3);
+    dist->count = hist->count;
+    dist->max = hist->max;
+    dist->p50 = out[0];
+    dist->p90 = out[1];
+    dist->p99 = out[2];
+}
+
+static void monkey_input(int64_t now)
+{
+    if (s_monkey.input_us) {
+        s_monkey.report.unrendered++;
+    }
+    s_monkey.input_us = now;
+}
+
+static void monkey_render_cb(lv_event_t *e)
+{
+    const int64_t now = monkey_time_us();
+
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        s_monkey.render_start_us = now;
+        return;
+    }
+    if (s_monkey.render_start_us) {
+        bsp_monkey_hist_add(&s_monkey.hist->frame, now - s_monkey.render_start_us);
+        s_monkey.render_start_us = 0;
+    }
+    if (s_monkey.input_us) {
+        bsp_monkey_hist_add(&s_monkey.hist->latency, now - s_monkey.input_us);
+        s_monkey.input_us = 0;
+    }
+    /* The allocator's high-water mark, which includes the peaks within a frame */
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    s_monkey.report.lvgl_mem_peak = MAX(s_monkey.report.lvgl_mem_peak, mon.max_used);
+    monkey_heap_sample();
+}
+
+static void monkey_finish(int64_t now)
+{
+    lv_indev_set_read_cb(s_monkey.indev, s_monkey.read_cb);
+    lv_display_remove_event_cb_with_user_data(s_monkey.disp, monkey_render_cb, NULL);
+
+    bsp_monkey_report_t *r = &s_monkey.report;
+    r->duration_ms = (now - s_monkey.start_us) / 1000;
+    r->heap_peak = s_monkey.heap_start - s_monkey.heap_min;
+    r->alloc_failed = __atomic_load_n(&s_monkey.alloc_failed, __ATOMIC_RELAXED);
+    monkey_dist(&s_monkey.hist->frame, &r->frame);
+    monkey_dist(&s_monkey.hist->latency, &r->latency);
+    free(s_monkey.hist);
+    s_monkey.hist = NULL;
+
+    s_monkey.done = true;
+    __atomic_store_n(&s_monkey.running, false, __ATOMIC_RELEASE);
+}
+
+static void monkey_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    const int64_t now = monkey_time_us();
+    const bool finished = s_monkey.cfg.steps ? s_monkey.report.steps >= s_monkey.cfg.steps
+                                             : now - s_monkey.start_us >= (int64_t)s_monkey.cfg.duration_ms * 1000;
+
+    monkey_heap_sample();
+    if (finished) {
+        /* Leave the device released for the real touch driver */
+        data->point.x = s_monkey.seq.x;
+        data->point.y = s_monkey.seq.y;
+        data->state = LV_INDEV_STATE_RELEASED;
+        monkey_finish(now);
+        return;
+    }
+
+    s_monkey.report.steps++;
+    const bool was_pressed = s_monkey.seq.pressed;
+    if (bsp_monkey_seq_step(&s_monkey.seq)) {
+        s_monkey.report.touches += !was_pressed;
+        monkey_input(now);
+    }
+    data->point.x = s_monkey.seq.x;
+    data->point.y = s_monkey.seq.y;
+    data->state = s_monkey.seq.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+esp_err_t bsp_monkey_start(const bsp_monkey_config_t *config)
+{
+    assert(config);
+    ESP_RETURN_ON_FALSE(!__atomic_load_n(&s_monkey.running, __ATOMIC_ACQUIRE), ESP_ERR_INVALID_STATE, TAG,
+                        "Monkey already running");
+
+    lv_indev_t *indev = config->indev;
+    if (indev == NULL) {
+        indev = bsp_display_get_input_dev();
+    }
+    ESP_RETURN_ON_FALSE(indev && lv_indev_get_type(indev) == LV_INDEV_TYPE_POINTER, ESP_ERR_INVALID_STATE, TAG,
+                        "No pointer input device");
+    lv_display_t *disp = lv_indev_get_display(indev);
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_STATE, TAG, "Input device has no display");
+
+    monkey_hist_t *hist = calloc(1, sizeof(monkey_hist_t));
+    ESP_RETURN_ON_FALSE(hist, ESP_ERR_NO_MEM, TAG, "No memory for histograms");
+
+    memset(&s_monkey, 0, sizeof(s_monkey));
+    s_monkey.cfg = *config;
+    s_monkey.indev = indev;
+    s_monkey.disp = disp;
+    s_monkey.hist = hist;
+    bsp_monkey_seq_init(&s_monkey.seq, config->seed, lv_display_get_physical_horizontal_resolution(disp),
+                        lv_display_get_physical_vertical_resolution(disp), config->press_pct, config->hold_max);
+    s_monkey.report.seed = config->seed;
+    s_monkey.heap_start = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s_monkey.heap_min = s_monkey.heap_start;
+    s_monkey.start_us = monkey_time_us();
+
+    lv_display_add_event_cb(disp, monkey_render_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, monkey_render_cb, LV_EVENT_RENDER_READY, NULL);
+    s_monkey.read_cb = indev->read_cb;
+    lv_indev_set_read_cb(indev, monkey_read_cb);
+    /* The read timer is paused while idle when touch is interrupt driven (CONFIG_BSP_DISPLAY_TICKLESS) */
+    lv_timer_t *read_timer = lv_indev_get_read_timer(indev);
+    if (read_timer) {
+        lv_timer_resume(read_timer);
+    }
+    __atomic_store_n(&s_monkey.running, true, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+bool bsp_monkey_is_running(void)
+{
+    return __atomic_load_n(&s_monkey.running, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t bsp_monkey_get_report(bsp_monkey_report_t *report)
+{
+    assert(report);
+    ESP_RETURN_ON_FALSE(!bsp_monkey_is_running() && s_monkey.done, ESP_ERR_INVALID_STATE, TAG, "No finished run");
+    *report = s_monkey.report;
+    return ESP_OK;
+}
+
+esp_err_t bsp_monkey_run(const bsp_monkey_config_t *config, bsp_monkey_report_t *report)
+{
+    bsp_monkey_report_t r;
+
+    bsp_display_lock(0);
+    esp_err_t ret = bsp_monkey_start(config);
+    bsp_display_unlock();
+    ESP_RETURN_ON_ERROR(ret, TAG, "Start failed");
+
+    while (bsp_monkey_is_running()) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    ESP_RETURN_ON_ERROR(bsp_monkey_get_report(&r), TAG, "No report");
+    ESP_LOGI(TAG, "seed %"PRIu32": %"PRIu32" reads, %"PRIu32" touches in %"PRIu32" ms", r.seed, r.steps, r.touches,
+             r.duration_ms);
+    ESP_LOGI(TAG, "frame   us: n %"PRIu32" p50 %"PRIu32" p90 %"PRIu32" p99 %"PRIu32" max %"PRIu32, r.frame.count,
+             r.frame.p50, r.frame.p90, r.frame.p99, r.frame.max);
+    ESP_LOGI(TAG, "latency us: n %"PRIu32" p50 %"PRIu32" p90 %"PRIu32" p99 %"PRIu32" max %"PRIu32", %"PRIu32" unrendered",
+             r.latency.count, r.latency.p50, r.latency.p90, r.latency.p99, r.latency.max, r.unrendered);
+    ESP_LOGI(TAG, "LVGL heap peak %"PRIu32", heap peak %"PRIu32", %"PRIu32" failed allocations", r.lvgl_mem_peak,
+             r.heap_peak, r.alloc_failed);
+    if (report) {
+        *report = r;
+    }
+    return ESP_OK;
+}
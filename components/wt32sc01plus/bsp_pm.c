@@ -0,0 +1,315 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/pm.h"
+
+#if CONFIG_BSP_PM
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_lvgl_port.h"
+#include "indev/lv_indev_private.h"
+#include "bsp/wt32sc01plus.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "BSP_PM";
+
+static const struct {
+    esp_pm_lock_type_t type;
+    const char *name;
+} s_lock_cfg[BSP_PM_LOCK_MAX] = {
+    [BSP_PM_LOCK_DISPLAY] = { ESP_PM_CPU_FREQ_MAX, "bsp_display" },
+    [BSP_PM_LOCK_TOUCH] = { ESP_PM_APB_FREQ_MAX, "bsp_touch" },
+    [BSP_PM_LOCK_STORAGE] = { ESP_PM_APB_FREQ_MAX, "bsp_storage" },
+    [BSP_PM_LOCK_BACKLIGHT] = { ESP_PM_NO_LIGHT_SLEEP, "bsp_backlight" },
+};
+
+static struct {
+    bool initialized;
+    bool backlight_dimmed;      /* BSP_PM_LOCK_BACKLIGHT held, or to take at init */
+    portMUX_TYPE lock;
+    struct {
+        esp_pm_lock_handle_t handle;
+        uint32_t depth;
+        int64_t since;
+        bsp_pm_lock_stats_t stats;
+    } locks[BSP_PM_LOCK_MAX];
+    /* LVGL task only */
+    bool rendering;
+    bool touched;
+    lv_indev_read_cb_t touch_read_cb;
+#if CONFIG_BSP_PM_MEASURE && CONFIG_BSP_PM_MEASURE_PERIOD_S
+    esp_timer_handle_t measure_timer;
+#endif
+} s_pm = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+void bsp_pm_lock_acquire(bsp_pm_lock_t lock)
+{
+    assert(lock < BSP_PM_LOCK_MAX);
+    if (!s_pm.initialized) {
+        return;
+    }
+    esp_pm_lock_acquire(s_pm.locks[lock].handle);
+
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_pm.lock);
+    if (s_pm.locks[lock].depth++ == 0) {
+        s_pm.locks[lock].since = now;
+        s_pm.locks[lock].stats.count++;
+    }
+    portEXIT_CRITICAL(&s_pm.lock);
+}
+
+void bsp_pm_lock_release(bsp_pm_lock_t lock)
+{
+    assert(lock < BSP_PM_LOCK_MAX);
+    if (!s_pm.initialized) {
+        return;
+    }
+
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_pm.lock);
+    assert(s_pm.locks[lock].depth > 0);
+    if (--s_pm.locks[lock].depth == 0) {
+        s_pm.locks[lock].stats.held_us += now - s_pm.locks[lock].since;
+    }
+    portEXIT_CRITICAL(&s_pm.lock);
+    esp_pm_lock_release(s_pm.locks[lock].handle);
+}
+
+void bsp_pm_get_stats(bsp_pm_lock_stats_t stats[BSP_PM_LOCK_MAX])
+{
+    assert(stats);
+
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_pm.lock);
+    for (int i = 0; i < BSP_PM_LOCK_MAX; i++) {
+        stats[i] = s_pm.locks[i].stats;
+        if (s_pm.locks[i].depth) {
+            stats[i].held_us += now - s_pm.locks[i].since;
+        }
+    }
+    portEXIT_CRITICAL(&s_pm.lock);
+}
+
+esp_err_t bsp_pm_dump(FILE *f)
+{
+    bsp_pm_lock_stats_t stats[BSP_PM_LOCK_MAX];
+
+    assert(f);
+    ESP_RETURN_ON_FALSE(s_pm.initialized, ESP_ERR_INVALID_STATE, TAG, "PM not initialized");
+
+    bsp_pm_get_stats(stats);
+    fprintf(f, "BSP locks:\n%-12s  %-10s  %-12s\n", "Name", "Count", "Held(us)");
+    for (int i = 0; i < BSP_PM_LOCK_MAX; i++) {
+        fprintf(f, "%-12s  %-10"PRIu32"  %-12"PRIu64"\n", s_lock_cfg[i].name, stats[i].count, stats[i].held_us);
+    }
+    return esp_pm_dump_locks(f);
+}
+
+#if CONFIG_BSP_PM_MEASURE && CONFIG_BSP_PM_MEASURE_PERIOD_S
+static void pm_measure_timer(void *arg)
+{
+    bsp_pm_dump(stdout);
+}
+#endif
+
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+/* Light sleep wakes up on a low level of the touch interrupt, armed while the panel is not touched */
+static void pm_touch_wakeup_arm(bool arm)
+{
+    if (arm) {
+        gpio_wakeup_enable(BSP_LCD_TP_INT, GPIO_INTR_LOW_LEVEL);
+    } else {
+        gpio_wakeup_disable(BSP_LCD_TP_INT);
+        gpio_set_intr_type(BSP_LCD_TP_INT, GPIO_INTR_NEGEDGE);
+    }
+}
+
+void bsp_pm_touch_isr(void)
+{
+    /* The wakeup level is also the interrupt type, back to edge or the interrupt keeps firing while touched */
+    gpio_ll_wakeup_disable(&GPIO, BSP_LCD_TP_INT);
+    gpio_ll_set_intr_type(&GPIO, BSP_LCD_TP_INT, GPIO_INTR_NEGEDGE);
+}
+#endif
+
+/* CPU at full speed from the first drawn area to the end of the refresh */
+static void pm_refr_cb(lv_event_t *e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        if (!s_pm.rendering) {
+            s_pm.rendering = true;
+            bsp_pm_lock_acquire(BSP_PM_LOCK_DISPLAY);
+        }
+    } else if (s_pm.rendering) {
+        s_pm.rendering = false;
+        bsp_pm_lock_release(BSP_PM_LOCK_DISPLAY);
+    }
+}
+
+/* No light sleep and no APB change between the reads of a touch */
+static void pm_touch_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    if (!s_pm.touched) {
+        bsp_pm_lock_acquire(BSP_PM_LOCK_TOUCH);
+    }
+    s_pm.touch_read_cb(indev, data);
+
+    const bool touched = data->state == LV_INDEV_STATE_PRESSED;
+    if (touched != s_pm.touched) {
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+        pm_touch_wakeup_arm(!touched);
+#endif
+        s_pm.touched = touched;
+    }
+    if (!touched) {
+        bsp_pm_lock_release(BSP_PM_LOCK_TOUCH);
+    }
+}
+
+esp_err_t bsp_pm_init(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (s_pm.initialized) {
+        return ESP_OK;
+    }
+
+    const esp_pm_config_t pm_cfg = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_BSP_PM_MIN_FREQ_MHZ,
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    ESP_RETURN_ON_ERROR(esp_pm_configure(&pm_cfg), TAG, "esp_pm_configure failed");
+
+    for (int i = 0; i < BSP_PM_LOCK_MAX; i++) {
+        ESP_GOTO_ON_ERROR(esp_pm_lock_create(s_lock_cfg[i].type, 0, s_lock_cfg[i].name, &s_pm.locks[i].handle),
+                          err, TAG, "Lock %s failed", s_lock_cfg[i].name);
+    }
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+    ESP_GOTO_ON_ERROR(esp_sleep_enable_gpio_wakeup(), err, TAG, "GPIO wakeup failed");
+#endif
+#if CONFIG_BSP_PM_MEASURE && CONFIG_BSP_PM_MEASURE_PERIOD_S
+    const esp_timer_create_args_t measure_args = {
+        .callback = pm_measure_timer,
+        .name = "bsp_pm",
+        .skip_unhandled_events = true,
+    };
+    ESP_GOTO_ON_ERROR(esp_timer_create(&measure_args, &s_pm.measure_timer), err, TAG, "Timer failed");
+    esp_timer_start_periodic(s_pm.measure_timer, CONFIG_BSP_PM_MEASURE_PERIOD_S * 1000000ULL);
+#endif
+    s_pm.initialized = true;
+    if (s_pm.backlight_dimmed) {
+        bsp_pm_lock_acquire(BSP_PM_LOCK_BACKLIGHT);
+    }
+
+    ESP_LOGI(TAG, "CPU %d..%d MHz, light sleep %s", CONFIG_BSP_PM_MIN_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+             pm_cfg.light_sleep_enable ? "on" : "off");
+    return ESP_OK;
+
+err:
+    for (int i = 0; i < BSP_PM_LOCK_MAX; i++) {
+        if (s_pm.locks[i].handle) {
+            esp_pm_lock_delete(s_pm.locks[i].handle);
+            s_pm.locks[i].handle = NULL;
+        }
+    }
+    return ret;
+}
+
+esp_err_t bsp_pm_display_init(lv_display_t *disp, lv_indev_t *indev)
+{
+    assert(disp && indev);
+    ESP_RETURN_ON_ERROR(bsp_pm_init(), TAG, "PM init failed");
+
+    lvgl_port_lock(0);
+    lv_display_add_event_cb(disp, pm_refr_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, pm_refr_cb, LV_EVENT_REFR_READY, NULL);
+    s_pm.touch_read_cb = indev->read_cb;
+    lv_indev_set_read_cb(indev, pm_touch_read_cb);
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+    pm_touch_wakeup_arm(true);
+#endif
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+void bsp_pm_backlight_dimmed(bool dimmed)
+{
+    if (dimmed == s_pm.backlight_dimmed) {
+        return;
+    }
+    s_pm.backlight_dimmed = dimmed;
+    if (dimmed) {
+        bsp_pm_lock_acquire(BSP_PM_LOCK_BACKLIGHT);
+    } else if (s_pm.initialized) {
+        bsp_pm_lock_release(BSP_PM_LOCK_BACKLIGHT);
+    }
+}
+
+#else /* CONFIG_BSP_PM */
+
+esp_err_t bsp_pm_init(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_pm_lock_acquire(bsp_pm_lock_t lock)
+{
+}
+
+void bsp_pm_lock_release(bsp_pm_lock_t lock)
+{
+}
+
+void bsp_pm_get_stats(bsp_pm_lock_stats_t stats[BSP_PM_LOCK_MAX])
+{
+    memset(stats, 0, BSP_PM_LOCK_MAX * sizeof(stats[0]));
+}
+
+esp_err_t bsp_pm_dump(FILE *f)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+void bsp_pm_backlight_dimmed(bool dimmed)
+{
+}
+
+#endif /* CONFIG_BSP_PM */
@@ -0,0 +1,237 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/profiler.h"
+
+static const char *TAG = "BSP_PROFILER";
+
+#if CONFIG_BSP_PROFILER
+
+#define PROF_CORES              portNUM_PROCESSORS
+#define PROF_CAPACITY           CONFIG_BSP_PROFILER_BUF_EVENTS
+#define PROF_TASKS_MAX          32
+#define PROF_TID_ISR            0
+#define PROF_TID_UNKNOWN        PROF_TASKS_MAX
+#define PROF_TID_ISR_CORE(c)    (PROF_TASKS_MAX + 1 + (c))  /* Exported ISR thread of a core */
+#define PROF_PID                1
+
+_Static_assert(PROF_CORES <= 2, "bsp_profiler_stats_t holds two cores");
+
+typedef struct {
+    uint32_t ts_us;             /* Since bsp_profiler_start() */
+    const char *tag;
+    char type;
+    uint8_t tid;
+} prof_event_t;
+
+static struct {
+    bool running;
+    int64_t start_us;
+    struct {
+        prof_event_t *events;
+        uint32_t head;          /* Claimed slots, counts on past PROF_CAPACITY so the overflow is known */
+    } core[PROF_CORES];
+    struct {
+        TaskHandle_t handle;    /* Claimed with CAS, NULL when free. Index + 1 is the trace tid */
+        char name[configMAX_TASK_NAME_LEN];
+    } tasks[PROF_TASKS_MAX];
+} s_prof;
+
+/* Trace thread id of the running task, registers the task on first sight */
+static uint8_t profiler_tid(void)
+{
+    if (xPortInIsrContext()) {
+        return PROF_TID_ISR;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < PROF_TASKS_MAX; i++) {
+        TaskHandle_t h = __atomic_load_n(&s_prof.tasks[i].handle, __ATOMIC_ACQUIRE);
+        if (h == NULL) {
+            if (!__atomic_compare_exchange_n(&s_prof.tasks[i].handle, &h, self, false, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE)) {
+                /* Another task took the slot, it may still be this one's */
+                if (h != self) {
+                    continue;
+                }
+                return i + 1;
+            }
+            strlcpy(s_prof.tasks[i].name, pcTaskGetName(NULL), sizeof(s_prof.tasks[i].name));
+            return i + 1;
+        }
+        if (h == self) {
+            return i + 1;
+        }
+    }
+    return PROF_TID_UNKNOWN;
+}
+
+void bsp_profiler_write(const char *tag, char type)
+{
+    if (!__atomic_load_n(&s_prof.running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    const uint32_t ts = esp_timer_get_time() - s_prof.start_us;
+    /* Buffers are per core so the cores rarely contend, the atomic claim covers tasks preempting each other
+     * and a task migrating between reading the core id and claiming the slot */
+    const int core = esp_cpu_get_core_id();
+    const uint32_t idx = __atomic_fetch_add(&s_prof.core[core].head, 1, __ATOMIC_RELAXED);
+    if (idx >= PROF_CAPACITY) {
+        return;
+    }
+    prof_event_t *ev = &s_prof.core[core].events[idx];
+    ev->ts_us = ts;
+    ev->tag = tag;
+    ev->type = type;
+    ev->tid = profiler_tid();
+}
+
+esp_err_t bsp_profiler_start(void)
+{
+    for (int c = 0; c < PROF_CORES; c++) {
+        if (s_prof.core[c].events == NULL) {
+            s_prof.core[c].events = heap_caps_malloc(PROF_CAPACITY * sizeof(prof_event_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (s_prof.core[c].events == NULL) {
+                s_prof.core[c].events = heap_caps_malloc(PROF_CAPACITY * sizeof(prof_event_t), MALLOC_CAP_8BIT);
+            }
+            ESP_RETURN_ON_FALSE(s_prof.core[c].events, ESP_ERR_NO_MEM, TAG, "No memory for %d events", PROF_CAPACITY);
+        }
+    }
+
+    __atomic_store_n(&s_prof.running, false, __ATOMIC_RELEASE);
+    for (int c = 0; c < PROF_CORES; c++) {
+        __atomic_store_n(&s_prof.core[c].head, 0, __ATOMIC_RELAXED);
+    }
+    s_prof.start_us = esp_timer_get_time();
+    __atomic_store_n(&s_prof.running, true, __ATOMIC_RELEASE);
+    ESP_LOGI(TAG, "Recording, %d events per core", PROF_CAPACITY);
+    return ESP_OK;
+}
+
+void bsp_profiler_stop(void)
+{
+    __atomic_store_n(&s_prof.running, false, __ATOMIC_RELEASE);
+}
+
+esp_err_t bsp_profiler_export_chrome(FILE *f)
+{
+    assert(f);
+    ESP_RETURN_ON_FALSE(!__atomic_load_n(&s_prof.running, __ATOMIC_ACQUIRE), ESP_ERR_INVALID_STATE, TAG,
+                        "Profiler is recording");
+
+    /* One process: an unpinned task migrates between the cores, its begin and end must meet in one thread */
+    int res = fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    res = res < 0 ? res : fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                                  PROF_PID, CONFIG_IDF_TARGET);
+    for (int c = 0; c < PROF_CORES && res >= 0; c++) {
+        res = fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                      "\"args\":{\"name\":\"ISR core %d\"}},\n", PROF_PID, PROF_TID_ISR_CORE(c), c);
+    }
+    for (int i = 0; i < PROF_TASKS_MAX && res >= 0 && s_prof.tasks[i].handle; i++) {
+        res = fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                      PROF_PID, i + 1, s_prof.tasks[i].name);
+    }
+
+    /* Merge the per core buffers by time, each is in claim order */
+    uint32_t next[PROF_CORES] = {0};
+    uint32_t count[PROF_CORES];
+    for (int c = 0; c < PROF_CORES; c++) {
+        count[c] = MIN(s_prof.core[c].head, PROF_CAPACITY);
+    }
+    while (res >= 0) {
+        int c = -1;
+        for (int k = 0; k < PROF_CORES; k++) {
+            if (next[k] < count[k] &&
+                    (c < 0 || s_prof.core[k].events[next[k]].ts_us < s_prof.core[c].events[next[c]].ts_us)) {
+                c = k;
+            }
+        }
+        if (c < 0) {
+            break;
+        }
+        const prof_event_t *ev = &s_prof.core[c].events[next[c]++];
+        res = fprintf(f, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRIu32",\"pid\":%d,\"tid\":%d,\"args\":{\"core\":%d}},\n",
+                      ev->tag, ev->type, ev->ts_us, PROF_PID, ev->tid == PROF_TID_ISR ? PROF_TID_ISR_CORE(c) : ev->tid, c);
+    }
+    /* Closing metadata event, JSON does not allow the trailing comma */
+    res = res < 0 ? res : fprintf(f, "{\"name\":\"trace_end\",\"ph\":\"M\",\"pid\":%d}\n]}\n", PROF_PID);
+    ESP_RETURN_ON_FALSE(res >= 0 && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
+
+void bsp_profiler_get_stats(bsp_profiler_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(*stats));
+    for (int c = 0; c < PROF_CORES; c++) {
+        const uint32_t head = __atomic_load_n(&s_prof.core[c].head, __ATOMIC_RELAXED);
+        stats->events[c] = MIN(head, PROF_CAPACITY);
+        stats->dropped[c] = head - stats->events[c];
+    }
+    stats->capacity = PROF_CAPACITY;
+    for (int i = 0; i < PROF_TASKS_MAX && s_prof.tasks[i].handle; i++) {
+        stats->tasks++;
+    }
+}
+
+#else /* CONFIG_BSP_PROFILER */
+
+void bsp_profiler_write(const char *tag, char type)
+{
+}
+
+esp_err_t bsp_profiler_start(void)
+{
+    ESP_LOGW(TAG, "Enable CONFIG_BSP_PROFILER");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_profiler_stop(void)
+{
+}
+
+esp_err_t bsp_profiler_export_chrome(FILE *f)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_profiler_get_stats(bsp_profiler_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* CONFIG_BSP_PROFILER */
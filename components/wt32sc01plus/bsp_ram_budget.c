@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include "esp_heap_caps.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/wt32sc01plus.h"
+#include "bsp/ram_budget.h"
+
+/* bsp_display_start() allocates two buffers of BSP_LCD_DRAW_BUF_LINES and uses the default port task */
+#define RAM_DRAW_BUF_BYTES      (2 * BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_LINES * BSP_LCD_BITS_PER_PIXEL / 8)
+
+void bsp_ram_budget_get(bsp_ram_budget_t *budget)
+{
+    const lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    lv_mem_monitor_t mon;
+
+    assert(budget);
+    lvgl_port_lock(0);
+    lv_mem_monitor(&mon);
+    lvgl_port_unlock();
+
+    *budget = (bsp_ram_budget_t) {
+        .draw_buf = RAM_DRAW_BUF_BYTES,
+        .lvgl_heap = mon.total_size,
+        .lvgl_heap_used = mon.total_size - mon.free_size,
+        .lvgl_task_stack = port_cfg.task_stack,
+        .internal_total = heap_caps_get_total_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .internal_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .internal_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+        .dma_free = heap_caps_get_free_size(MALLOC_CAP_DMA),
+        .psram_total = heap_caps_get_total_size(MALLOC_CAP_SPIRAM),
+    };
+}
+
+esp_err_t bsp_ram_budget_print(FILE *f)
+{
+    bsp_ram_budget_t b;
+
+    assert(f);
+    bsp_ram_budget_get(&b);
+    const int ret = fprintf(f,
+                            "RAM budget (" BSP_BOARD_NAME "), KB:\n"
+                            "  draw buffers     %6.1f  2 x %d lines, DMA\n"
+                            "  LVGL heap        %6.1f  %.1f used\n"
+                            "  LVGL task stack  %6.1f\n"
+                            "  internal heap    %6.1f  %.1f free, %.1f min free, %.1f largest block\n"
+                            "  DMA heap free    %6.1f\n"
+                            "  PSRAM            %6.1f\n",
+                            b.draw_buf / 1024.0, BSP_LCD_DRAW_BUF_LINES,
+                            b.lvgl_heap / 1024.0, b.lvgl_heap_used / 1024.0,
+                            b.lvgl_task_stack / 1024.0,
+                            b.internal_total / 1024.0, b.internal_free / 1024.0, b.internal_min_free / 1024.0,
+                            b.internal_largest / 1024.0,
+                            b.dma_free / 1024.0,
+                            b.psram_total / 1024.0);
+    return ret < 0 ? ESP_FAIL : ESP_OK;
+}
@@ -0,0 +1,232 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_lvgl_port.h"
+#include "indev/lv_indev_private.h"
+
+#include "bsp/wt32sc01plus.h"
+#include "bsp/refr_governor.h"
+
+static const char *TAG = "BSP_REFR_GOV";
+
+#define GOV_MIN_PERIOD_MS       CONFIG_BSP_REFR_GOVERNOR_MIN_PERIOD_MS
+#define GOV_IDLE_PERIOD_MS      CONFIG_BSP_REFR_GOVERNOR_IDLE_PERIOD_MS
+#define GOV_HOLD_MS             CONFIG_BSP_REFR_GOVERNOR_HOLD_MS
+#define GOV_STATIC_MS           CONFIG_BSP_REFR_GOVERNOR_STATIC_MS
+
+/* Time to send one full frame over the i80 bus, a faster refresh would only tear and queue */
+#define GOV_BUS_FRAME_US        ((uint64_t)BSP_LCD_H_RES * BSP_LCD_V_RES * BSP_LCD_BITS_PER_PIXEL * 1000000 / \
+                                 ((uint64_t)BSP_LCD_WIDTH * BSP_LCD_PIXEL_CLOCK_HZ))
+
+static struct {
+    bool started;
+    lv_display_t *disp;
+    lv_indev_t *indev;
+    lv_timer_t *refr_timer;
+    bsp_refr_mode_t mode;
+    uint32_t period_ms;
+    uint32_t min_period_ms;
+    int64_t last_active;        /* Last frame with animation, touch or scroll */
+    int64_t last_change;        /* Last invalidated area */
+    int64_t mode_since;
+    /* Frame cost, REFR_START to REFR_READY of frames that rendered */
+    int64_t refr_start;
+    bool rendered;
+    uint32_t cost_us;           /* Fast attack, slow decay average */
+    /* Statistics, guarded by lock */
+    portMUX_TYPE lock;
+    bsp_refr_governor_stats_t stats;
+} s_gov = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool gov_frame_is_active(void)
+{
+    if (lv_anim_count_running() > 0) {
+        return true;
+    }
+    if (s_gov.indev) {
+        return s_gov.indev->state == LV_INDEV_STATE_PRESSED || lv_indev_get_scroll_obj(s_gov.indev) != NULL;
+    }
+    return false;
+}
+
+static void gov_set_mode(bsp_refr_mode_t mode, int64_t now)
+{
+    if (mode == s_gov.mode) {
+        return;
+    }
+    ESP_LOGD(TAG, "Mode %d -> %d", s_gov.mode, mode);
+
+    /* bsp_refr_governor_get_stats() reads the mode and its start time from other tasks */
+    portENTER_CRITICAL(&s_gov.lock);
+    s_gov.stats.time_ms[s_gov.mode] += (now - s_gov.mode_since) / 1000;
+    s_gov.stats.transitions[mode]++;
+    s_gov.stats.mode = mode;
+    s_gov.mode = mode;
+    s_gov.mode_since = now;
+    portEXIT_CRITICAL(&s_gov.lock);
+
+    /* Animations step with the frames they are drawn in */
+    lv_timer_t *anim_timer = lv_anim_get_timer();
+    if (anim_timer) {
+        lv_timer_set_period(anim_timer, mode == BSP_REFR_MODE_ACTIVE ? s_gov.min_period_ms : LV_DEF_REFR_PERIOD);
+    }
+}
+
+static void gov_set_period(void)
+{
+    uint32_t period_ms;
+    uint32_t cost_ms;
+
+    switch (s_gov.mode) {
+    case BSP_REFR_MODE_ACTIVE:
+        period_ms = s_gov.min_period_ms;
+        cost_ms = (s_gov.cost_us * 5 / 4 + 999) / 1000;
+        break;
+    case BSP_REFR_MODE_NORMAL:
+        period_ms = LV_DEF_REFR_PERIOD;
+        cost_ms = (s_gov.cost_us * 5 / 4 + 999) / 1000;
+        break;
+    default:
+        period_ms = GOV_IDLE_PERIOD_MS;
+        cost_ms = (s_gov.cost_us + 999) / 1000;
+        break;
+    }
+
+    const bool cost_limited = cost_ms > period_ms;
+    period_ms = MAX(period_ms, cost_ms);
+    if (period_ms != s_gov.period_ms) {
+        s_gov.period_ms = period_ms;
+        lv_timer_set_period(s_gov.refr_timer, period_ms);
+    }
+
+    portENTER_CRITICAL(&s_gov.lock);
+    s_gov.stats.period_ms = period_ms;
+    s_gov.stats.cost_us = s_gov.cost_us;
+    s_gov.stats.frames[s_gov.mode]++;
+    s_gov.stats.cost_limited += cost_limited;
+    portEXIT_CRITICAL(&s_gov.lock);
+}
+
+static void gov_refr_cb(lv_event_t *e)
+{
+    const int64_t now = esp_timer_get_time();
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        s_gov.refr_start = now;
+        s_gov.rendered = false;
+        if (gov_frame_is_active()) {
+            s_gov.last_active = now;
+        }
+        if (now - s_gov.last_active < GOV_HOLD_MS * 1000LL) {
+            gov_set_mode(BSP_REFR_MODE_ACTIVE, now);
+        } else if (now - s_gov.last_change < GOV_STATIC_MS * 1000LL) {
+            gov_set_mode(BSP_REFR_MODE_NORMAL, now);
+        } else {
+            gov_set_mode(BSP_REFR_MODE_IDLE, now);
+        }
+        break;
+    case LV_EVENT_RENDER_START:
+        s_gov.rendered = true;
+        break;
+    case LV_EVENT_REFR_READY:
+        if (s_gov.rendered && s_gov.refr_start) {
+            const uint32_t us = now - s_gov.refr_start;
+            /* Follow a slower frame at once so the period is never too short, relax slowly */
+            s_gov.cost_us = us > s_gov.cost_us ? us : s_gov.cost_us - (s_gov.cost_us - us) / 8;
+            gov_set_period();
+        }
+        s_gov.refr_start = 0;
+        break;
+    case LV_EVENT_INVALIDATE_AREA:
+        s_gov.last_change = now;
+        /* A change of static content must not wait for the long idle period */
+        if (s_gov.mode == BSP_REFR_MODE_IDLE && !s_gov.refr_start) {
+            lv_timer_ready(s_gov.refr_timer);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t bsp_refr_governor_start(lv_display_t *disp, lv_indev_t *indev)
+{
+    assert(disp);
+    ESP_RETURN_ON_FALSE(!s_gov.started, ESP_ERR_INVALID_STATE, TAG, "Governor already started");
+
+    lvgl_port_lock(0);
+    s_gov.disp = disp;
+    s_gov.indev = indev;
+    s_gov.refr_timer = lv_display_get_refr_timer(disp);
+    s_gov.min_period_ms = MAX(GOV_MIN_PERIOD_MS, (GOV_BUS_FRAME_US + 999) / 1000);
+    s_gov.period_ms = LV_DEF_REFR_PERIOD;
+    s_gov.last_active = esp_timer_get_time();
+    s_gov.last_change = s_gov.last_active;
+    portENTER_CRITICAL(&s_gov.lock);
+    s_gov.mode = BSP_REFR_MODE_NORMAL;
+    s_gov.mode_since = s_gov.last_active;
+    s_gov.stats.mode = BSP_REFR_MODE_NORMAL;
+    s_gov.stats.period_ms = LV_DEF_REFR_PERIOD;
+    s_gov.stats.min_period_ms = s_gov.min_period_ms;
+    s_gov.stats.transitions[BSP_REFR_MODE_NORMAL] = 1;
+    portEXIT_CRITICAL(&s_gov.lock);
+    lv_display_add_event_cb(disp, gov_refr_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, gov_refr_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, gov_refr_cb, LV_EVENT_REFR_READY, NULL);
+    lv_display_add_event_cb(disp, gov_refr_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    s_gov.started = true;
+    lvgl_port_unlock();
+
+    ESP_LOGI(TAG, "Refresh period %"PRIu32"..%d ms", s_gov.min_period_ms, GOV_IDLE_PERIOD_MS);
+    return ESP_OK;
+}
+
+bsp_refr_mode_t bsp_refr_governor_get_mode(void)
+{
+    return s_gov.mode;
+}
+
+void bsp_refr_governor_get_stats(bsp_refr_governor_stats_t *stats)
+{
+    assert(stats);
+
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_gov.lock);
+    *stats = s_gov.stats;
+    if (s_gov.started) {
+        stats->time_ms[s_gov.mode] += (now - s_gov.mode_since) / 1000;
+    }
+    portEXIT_CRITICAL(&s_gov.lock);
+}
@@ -0,0 +1,166 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "driver/uart.h"
+
+#include "bsp/rs485.h"
+#include "bsp_modbus_rtu.h"
+
+static const char *TAG = "BSP_RS485";
+
+#define RS485_RX_BUF_SIZE       (512)
+#define RS485_EVENT_QUEUE_LEN   (16)
+/* RX timeout in character times, the UART reports end of frame after this much silence (t3.5) */
+#define RS485_RX_TOUT_SYMBOLS   (4)
+/* Time for the transmission on top of the frame time, the task may be preempted while waiting */
+#define RS485_TX_MARGIN_MS      (10)
+
+static uint32_t s_baud_rate;
+static QueueHandle_t s_uart_queue;
+
+esp_err_t bsp_rs485_init(const bsp_rs485_config_t *config)
+{
+    static const uart_parity_t parity[] = {
+        [BSP_RS485_PARITY_NONE] = UART_PARITY_DISABLE,
+        [BSP_RS485_PARITY_EVEN] = UART_PARITY_EVEN,
+        [BSP_RS485_PARITY_ODD] = UART_PARITY_ODD,
+    };
+    esp_err_t ret = ESP_OK;
+
+    assert(config && config->parity <= BSP_RS485_PARITY_ODD);
+#if CONFIG_BSP_BOARD_WT32SC01
+    ESP_LOGE(TAG, "No RS485 transceiver on this board");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+    ESP_RETURN_ON_FALSE(s_uart_queue == NULL, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+
+    const uart_config_t uart_config = {
+        .baud_rate = config->baud_rate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = parity[config->parity],
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 122,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    ESP_RETURN_ON_ERROR(uart_driver_install(BSP_RS485_UART_NUM, RS485_RX_BUF_SIZE, 0, RS485_EVENT_QUEUE_LEN, &s_uart_queue, 0),
+                        TAG, "UART driver install failed");
+    ESP_GOTO_ON_ERROR(uart_param_config(BSP_RS485_UART_NUM, &uart_config), err, TAG, "UART config failed");
+    ESP_GOTO_ON_ERROR(uart_set_pin(BSP_RS485_UART_NUM, BSP_RS485_TXD, BSP_RS485_RXD, BSP_RS485_RTS, UART_PIN_NO_CHANGE), err, TAG, "UART pins failed");
+    /* RTS drives the transceiver DE/RE, switched by hardware around each transmission */
+    ESP_GOTO_ON_ERROR(uart_set_mode(BSP_RS485_UART_NUM, UART_MODE_RS485_HALF_DUPLEX), err, TAG, "RS485 mode failed");
+    ESP_GOTO_ON_ERROR(uart_set_rx_timeout(BSP_RS485_UART_NUM, RS485_RX_TOUT_SYMBOLS), err, TAG, "RX timeout failed");
+
+    s_baud_rate = config->baud_rate;
+    ESP_LOGI(TAG, "RS485 on UART%d, %"PRIu32" baud", BSP_RS485_UART_NUM, s_baud_rate);
+    return ESP_OK;
+
+err:
+    uart_driver_delete(BSP_RS485_UART_NUM);
+    s_uart_queue = NULL;
+    return ret;
+}
+
+esp_err_t bsp_rs485_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_uart_queue, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_ERROR(uart_driver_delete(BSP_RS485_UART_NUM), TAG, "UART driver delete failed");
+    s_uart_queue = NULL;
+    s_baud_rate = 0;
+    return ESP_OK;
+}
+
+esp_err_t bsp_rs485_write(const uint8_t *data, size_t len)
+{
+    if (uart_write_bytes(BSP_RS485_UART_NUM, data, len) != (int)len) {
+        return ESP_FAIL;
+    }
+    /* Frame timing is measured from the end of transmission */
+    const uint32_t tx_ms = (modbus_rtu_frame_us(s_baud_rate, len) + 999) / 1000 + RS485_TX_MARGIN_MS;
+    return uart_wait_tx_done(BSP_RS485_UART_NUM, pdMS_TO_TICKS(tx_ms) + 1);
+}
+
+esp_err_t bsp_rs485_read_frame(uint8_t *buf, size_t size, uint32_t timeout_ms, size_t *ret_len)
+{
+    const TickType_t gap_ticks = pdMS_TO_TICKS((modbus_rtu_t35_us(s_baud_rate) + 999) / 1000) + 1;
+    TickType_t wait = pdMS_TO_TICKS(timeout_ms);
+    esp_err_t ret = ESP_OK;
+    uart_event_t event;
+    size_t len = 0;
+
+    *ret_len = 0;
+    while (xQueueReceive(s_uart_queue, &event, wait) == pdTRUE) {
+        switch (event.type) {
+        case UART_DATA:
+            if (len + event.size > size) {
+                ret = ESP_ERR_INVALID_SIZE;
+            } else {
+                int n = uart_read_bytes(BSP_RS485_UART_NUM, buf + len, event.size, 0);
+                len += MAX(n, 0);
+            }
+            if (event.timeout_flag) {
+                /* Line idle for RS485_RX_TOUT_SYMBOLS: end of frame */
+                goto done;
+            }
+            wait = gap_ticks;
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ret = ESP_ERR_INVALID_SIZE;
+            goto done;
+        case UART_PARITY_ERR:
+        case UART_FRAME_ERR:
+            ret = ESP_ERR_INVALID_RESPONSE;
+            break;
+        default:
+            break;
+        }
+    }
+
+done:
+    if (ret != ESP_OK) {
+        bsp_rs485_flush_input();
+        return ret;
+    }
+    *ret_len = len;
+    return ESP_OK;
+}
+
+void bsp_rs485_flush_input(void)
+{
+    uart_flush_input(BSP_RS485_UART_NUM);
+    xQueueReset(s_uart_queue);
+}
+
+uint32_t bsp_rs485_get_baud_rate(void)
+{
+    return s_baud_rate;
+}
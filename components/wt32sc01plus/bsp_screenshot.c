@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/screenshot.h"
+#include "bsp/pm.h"
+#include "bsp_display_priv.h"
+#include "bsp_bmp.h"
+
+static const char *TAG = "BSP_SCREENSHOT";
+
+static struct {
+    bmp_writer_t bmp;
+    bool ok;
+    uint32_t bands;
+    size_t heap_min;
+} s_shot;
+
+static void screenshot_heap_sample(void)
+{
+    s_shot.heap_min = MIN(s_shot.heap_min, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+static void screenshot_flush_hook(lv_display_t *disp, const lv_area_t *area, const uint8_t *px_map, void *user_ctx)
+{
+    s_shot.ok &= bmp_write_area(&s_shot.bmp, area->x1, area->y1, area->x2, area->y2,
+                                (const uint16_t *)px_map, lv_area_get_width(area));
+    s_shot.bands++;
+    screenshot_heap_sample();
+}
+
+esp_err_t bsp_screenshot_save(const char *path, bsp_screenshot_info_t *ret_info)
+{
+    esp_err_t ret = ESP_OK;
+    lv_display_t *disp = lv_display_get_default();
+
+    assert(path);
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_STATE, TAG, "Display not started");
+
+    const int64_t start = esp_timer_get_time();
+    const size_t heap_start = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s_shot.heap_min = heap_start;
+    s_shot.bands = 0;
+    s_shot.ok = true;
+
+    lvgl_port_lock(0);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    const int32_t w = lv_display_get_horizontal_resolution(disp);
+    const int32_t h = lv_display_get_vertical_resolution(disp);
+    if (!bmp_open(&s_shot.bmp, path, w, h)) {
+        bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+        lvgl_port_unlock();
+        ESP_LOGE(TAG, "Cannot create %s", path);
+        return ESP_FAIL;
+    }
+    screenshot_heap_sample();
+
+    ret = bsp_display_add_flush_hook(screenshot_flush_hook, NULL);
+    if (ret == ESP_OK) {
+        /* Redraw the whole screen now, the hook receives it band by band */
+        lv_obj_invalidate(lv_screen_active());
+        lv_refr_now(disp);
+        bsp_display_remove_flush_hook(screenshot_flush_hook, NULL);
+    }
+    s_shot.ok &= bmp_close(&s_shot.bmp);
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    lvgl_port_unlock();
+    ESP_RETURN_ON_ERROR(ret, TAG, "Flush hook failed");
+    ESP_RETURN_ON_FALSE(s_shot.ok, ESP_FAIL, TAG, "Write error %s", path);
+
+    const bsp_screenshot_info_t info = {
+        .capture_ms = (esp_timer_get_time() - start) / 1000,
+        .file_size = BMP_HEADER_SIZE + s_shot.bmp.row_bytes * h,
+        .bands = s_shot.bands,
+        .heap_peak = heap_start - s_shot.heap_min,
+    };
+    ESP_LOGI(TAG, "%s: %"PRIi32"x%"PRIi32" in %"PRIu32" ms, %"PRIu32" bands, %"PRIu32" bytes heap", path, w, h,
+             info.capture_ms, info.bands, info.heap_peak);
+    if (ret_info) {
+        *ret_info = info;
+    }
+    return ESP_OK;
+}
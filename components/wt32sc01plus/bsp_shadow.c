@@ -0,0 +1,461 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+
+#include "bsp/shadow.h"
+#include "bsp/pm.h"
+#include "bsp/profiler.h"
+
+static const char *TAG = "BSP_SHADOW";
+
+#define SHADOW_ENTRIES          CONFIG_BSP_SHADOW_CACHE_ENTRIES
+#define SHADOW_BUDGET           (CONFIG_BSP_SHADOW_CACHE_KB * 1024U)
+/* Three box blurs approximate a gaussian */
+#define SHADOW_BLUR_PASSES      3
+
+#define SHADOW_FILE_MAGIC       0x44485342U     /* "BSHD" */
+#define SHADOW_FILE_VERSION     1
+
+/* Mask of a shadow, the offset and color are applied when drawing */
+typedef struct {
+    int16_t w;              /* widget size */
+    int16_t h;
+    int16_t radius;         /* clamped to the shadow core */
+    int16_t blur;           /* half of the shadow width */
+    int16_t spread;
+} shadow_key_t;
+
+typedef struct {
+    shadow_key_t key;
+    uint8_t *data;          /* NULL when the entry is free */
+    lv_image_dsc_t img;
+    uint32_t last_use;
+} shadow_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+} shadow_file_header_t;
+
+static struct {
+    shadow_entry_t entries[SHADOW_ENTRIES];
+    uint32_t use_clock;
+    lv_display_t *disp;     /* trimmed to the budget after each refresh */
+    bsp_shadow_stats_t stats;
+} s_shadow;
+
+static inline int32_t shadow_core(int32_t size, int32_t spread)
+{
+    return MAX(size + 2 * spread, 1);
+}
+
+static inline size_t shadow_bytes(const shadow_key_t *key)
+{
+    return (size_t)(shadow_core(key->w, key->spread) + 2 * key->blur) *
+           (shadow_core(key->h, key->spread) + 2 * key->blur);
+}
+
+/* Box blur of one line with zeros outside, tmp holds a copy of the line */
+static void shadow_box_blur(uint8_t *line, int32_t n, int32_t step, int32_t k, uint8_t *tmp)
+{
+    const uint32_t div = 2 * k + 1;
+    uint32_t sum = 0;
+
+    for (int32_t i = 0; i < n; i++) {
+        tmp[i] = line[i * step];
+    }
+    for (int32_t i = 0; i < k && i < n; i++) {
+        sum += tmp[i];
+    }
+    for (int32_t i = 0; i < n; i++) {
+        if (i + k < n) {
+            sum += tmp[i + k];
+        }
+        line[i * step] = (uint8_t)((sum + div / 2) / div);
+        if (i - k >= 0) {
+            sum -= tmp[i - k];
+        }
+    }
+}
+
+/* Rounded rectangle of the core size, anti-aliased, then blurred by the shadow width. tmp holds a row or column. */
+static void shadow_render(const shadow_key_t *key, uint8_t *buf, uint8_t *tmp)
+{
+    const int32_t cw = shadow_core(key->w, key->spread);
+    const int32_t ch = shadow_core(key->h, key->spread);
+    const int32_t b = key->blur;
+    const int32_t w = cw + 2 * b;
+    const int32_t h = ch + 2 * b;
+    const float r = key->radius;
+
+    memset(buf, 0, (size_t)w * h);
+    for (int32_t y = 0; y < ch; y++) {
+        const float py = y + 0.5f;
+        const float dy = py < r ? r - py : py > ch - r ? py - (ch - r) : 0;
+        uint8_t *row = buf + (y + b) * w + b;
+        for (int32_t x = 0; x < cw; x++) {
+            const float px = x + 0.5f;
+            const float dx = px < r ? r - px : px > cw - r ? px - (cw - r) : 0;
+            if (dx > 0 && dy > 0) {
+                const float cov = r - sqrtf(dx * dx + dy * dy) + 0.5f;
+                row[x] = cov >= 1 ? 255 : cov <= 0 ? 0 : (uint8_t)(cov * 255 + 0.5f);
+            } else {
+                row[x] = 255;
+            }
+        }
+    }
+
+    const int32_t k = (b + SHADOW_BLUR_PASSES - 1) / SHADOW_BLUR_PASSES;
+    for (int pass = 0; k > 0 && pass < SHADOW_BLUR_PASSES; pass++) {
+        for (int32_t y = 0; y < h; y++) {
+            shadow_box_blur(buf + y * w, w, 1, k, tmp);
+        }
+        for (int32_t x = 0; x < w; x++) {
+            shadow_box_blur(buf + x, h, w, k, tmp);
+        }
+    }
+}
+
+static void shadow_entry_set(shadow_entry_t *entry, const shadow_key_t *key, uint8_t *data)
+{
+    entry->key = *key;
+    entry->data = data;
+    entry->last_use = ++s_shadow.use_clock;
+    entry->img = (lv_image_dsc_t) {
+        .header.magic = LV_IMAGE_HEADER_MAGIC,
+        .header.cf = LV_COLOR_FORMAT_A8,
+        .header.w = shadow_core(key->w, key->spread) + 2 * key->blur,
+        .header.h = shadow_core(key->h, key->spread) + 2 * key->blur,
+        .header.stride = shadow_core(key->w, key->spread) + 2 * key->blur,
+        .data_size = shadow_bytes(key),
+        .data = data,
+    };
+    s_shadow.stats.entries++;
+    s_shadow.stats.bytes += shadow_bytes(key);
+}
+
+static void shadow_entry_free(shadow_entry_t *entry)
+{
+    s_shadow.stats.entries--;
+    s_shadow.stats.bytes -= shadow_bytes(&entry->key);
+    heap_caps_free(entry->data);
+    memset(entry, 0, sizeof(shadow_entry_t));
+}
+
+static uint8_t *shadow_alloc(size_t size)
+{
+    uint8_t *data = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == NULL) {
+        data = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    return data;
+}
+
+/* A free entry, or NULL when all are in use */
+static shadow_entry_t *shadow_free_entry(void)
+{
+    for (size_t i = 0; i < SHADOW_ENTRIES; i++) {
+        if (s_shadow.entries[i].data == NULL) {
+            return &s_shadow.entries[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Drop the least recently used masks until the cache fits, with at least one entry free.
+ * Only between refreshes: the draw tasks of a frame point to the masks until it is rendered.
+ */
+static void shadow_trim(size_t budget)
+{
+    while (s_shadow.stats.bytes > budget || s_shadow.stats.entries == SHADOW_ENTRIES) {
+        shadow_entry_t *lru = NULL;
+        for (size_t i = 0; i < SHADOW_ENTRIES; i++) {
+            shadow_entry_t *entry = &s_shadow.entries[i];
+            if (entry->data && (lru == NULL || entry->last_use < lru->last_use)) {
+                lru = entry;
+            }
+        }
+        if (lru == NULL) {
+            break;
+        }
+        shadow_entry_free(lru);
+        s_shadow.stats.evictions++;
+    }
+}
+
+static void shadow_refr_ready_cb(lv_event_t *e)
+{
+    shadow_trim(SHADOW_BUDGET);
+}
+
+static const lv_image_dsc_t *shadow_get(const shadow_key_t *key)
+{
+    shadow_entry_t *entry = NULL;
+
+    for (size_t i = 0; i < SHADOW_ENTRIES; i++) {
+        if (s_shadow.entries[i].data && memcmp(&s_shadow.entries[i].key, key, sizeof(shadow_key_t)) == 0) {
+            entry = &s_shadow.entries[i];
+            entry->last_use = ++s_shadow.use_clock;
+            s_shadow.stats.hits++;
+            return &entry->img;
+        }
+    }
+
+    /* Over the budget until the refresh is done, all entries busy means no shadow this frame */
+    s_shadow.stats.misses++;
+    entry = shadow_free_entry();
+    uint8_t *data = entry ? shadow_alloc(shadow_bytes(key)) : NULL;
+    uint8_t *tmp = malloc(MAX(shadow_core(key->w, key->spread), shadow_core(key->h, key->spread)) + 2 * key->blur);
+    if (data == NULL || tmp == NULL) {
+        ESP_LOGW(TAG, "No room for a %dx%d shadow", key->w, key->h);
+        heap_caps_free(data);
+        free(tmp);
+        return NULL;
+    }
+    BSP_PROFILER_BEGIN_TAG("bsp_shadow_render");
+    shadow_render(key, data, tmp);
+    BSP_PROFILER_END_TAG("bsp_shadow_render");
+    free(tmp);
+    shadow_entry_set(entry, key, data);
+    return &entry->img;
+}
+
+static void shadow_draw(lv_event_t *e, const bsp_shadow_cfg_t *cfg)
+{
+    lv_obj_t *obj = lv_event_get_current_target(e);
+    lv_area_t coords;
+    lv_obj_get_coords(obj, &coords);
+
+    const int32_t w = lv_area_get_width(&coords);
+    const int32_t h = lv_area_get_height(&coords);
+    const int32_t core = MIN(shadow_core(w, cfg->spread), shadow_core(h, cfg->spread));
+    const shadow_key_t key = {
+        .w = w,
+        .h = h,
+        .radius = MIN(lv_obj_get_style_radius(obj, LV_PART_MAIN), core / 2),
+        .blur = cfg->width / 2,
+        .spread = cfg->spread,
+    };
+    const lv_image_dsc_t *img = shadow_get(&key);
+    if (img == NULL) {
+        return;
+    }
+
+    lv_draw_image_dsc_t dsc;
+    lv_draw_image_dsc_init(&dsc);
+    dsc.src = img;
+    dsc.recolor = cfg->color;
+    dsc.recolor_opa = LV_OPA_COVER;
+    dsc.opa = cfg->opa;
+
+    lv_area_t area;
+    area.x1 = coords.x1 - key.spread - key.blur + cfg->ofs_x;
+    area.y1 = coords.y1 - key.spread - key.blur + cfg->ofs_y;
+    area.x2 = area.x1 + img->header.w - 1;
+    area.y2 = area.y1 + img->header.h - 1;
+    lv_draw_image(lv_event_get_layer(e), &dsc, &area);
+}
+
+static void shadow_event_cb(lv_event_t *e)
+{
+    bsp_shadow_cfg_t *cfg = lv_event_get_user_data(e);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_DRAW_MAIN_BEGIN:
+        if (cfg->opa > LV_OPA_MIN) {
+            shadow_draw(e, cfg);
+        }
+        break;
+    case LV_EVENT_REFR_EXT_DRAW_SIZE:
+        lv_event_set_ext_draw_size(e, cfg->width / 2 + MAX(cfg->spread, 0) + MAX(abs(cfg->ofs_x), abs(cfg->ofs_y)) + 1);
+        break;
+    case LV_EVENT_DELETE:
+        free(cfg);
+        break;
+    default:
+        break;
+    }
+}
+
+static bsp_shadow_cfg_t *shadow_find_cfg(lv_obj_t *obj, uint32_t *index)
+{
+    const uint32_t count = lv_obj_get_event_count(obj);
+
+    for (uint32_t i = 0; i < count; i++) {
+        lv_event_dsc_t *dsc = lv_obj_get_event_dsc(obj, i);
+        if (lv_event_dsc_get_cb(dsc) == shadow_event_cb) {
+            if (index) {
+                *index = i;
+            }
+            return lv_event_dsc_get_user_data(dsc);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t bsp_shadow_attach(lv_obj_t *obj, const bsp_shadow_cfg_t *cfg)
+{
+    assert(obj && cfg);
+
+    bsp_shadow_cfg_t *attached = shadow_find_cfg(obj, NULL);
+    if (attached) {
+        *attached = *cfg;
+    } else {
+        attached = malloc(sizeof(bsp_shadow_cfg_t));
+        ESP_RETURN_ON_FALSE(attached, ESP_ERR_NO_MEM, TAG, "No memory for the shadow");
+        *attached = *cfg;
+        lv_obj_add_event_cb(obj, shadow_event_cb, LV_EVENT_DRAW_MAIN_BEGIN, attached);
+        lv_obj_add_event_cb(obj, shadow_event_cb, LV_EVENT_REFR_EXT_DRAW_SIZE, attached);
+        lv_obj_add_event_cb(obj, shadow_event_cb, LV_EVENT_DELETE, attached);
+    }
+    if (s_shadow.disp == NULL) {
+        s_shadow.disp = lv_obj_get_display(obj);
+        lv_display_add_event_cb(s_shadow.disp, shadow_refr_ready_cb, LV_EVENT_REFR_READY, NULL);
+    }
+    lv_obj_refresh_ext_draw_size(obj);
+    lv_obj_invalidate(obj);
+    return ESP_OK;
+}
+
+void bsp_shadow_detach(lv_obj_t *obj)
+{
+    uint32_t index;
+    bsp_shadow_cfg_t *cfg;
+
+    assert(obj);
+    lv_obj_invalidate(obj);
+    while ((cfg = shadow_find_cfg(obj, &index)) != NULL) {
+        lv_obj_remove_event(obj, index);
+        /* The three callbacks share the configuration, free it with the last one */
+        if (shadow_find_cfg(obj, NULL) == NULL) {
+            free(cfg);
+        }
+    }
+    lv_obj_refresh_ext_draw_size(obj);
+}
+
+esp_err_t bsp_shadow_cache_save(const char *path)
+{
+    esp_err_t ret = ESP_OK;
+    shadow_file_header_t header = {
+        .magic = SHADOW_FILE_MAGIC,
+        .version = SHADOW_FILE_VERSION,
+        .count = s_shadow.stats.entries,
+    };
+
+    assert(path);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    FILE *f = fopen(path, "wb");
+    ESP_GOTO_ON_FALSE(f, ESP_FAIL, out, TAG, "Cannot open %s: %s", path, strerror(errno));
+    ESP_GOTO_ON_FALSE(fwrite(&header, sizeof(header), 1, f) == 1, ESP_FAIL, err, TAG, "Write error");
+    for (size_t i = 0; i < SHADOW_ENTRIES; i++) {
+        const shadow_entry_t *entry = &s_shadow.entries[i];
+        if (entry->data) {
+            ESP_GOTO_ON_FALSE(fwrite(&entry->key, sizeof(shadow_key_t), 1, f) == 1 &&
+                              fwrite(entry->data, shadow_bytes(&entry->key), 1, f) == 1, ESP_FAIL, err, TAG, "Write error");
+        }
+    }
+err:
+    if (fclose(f) != 0 && ret == ESP_OK) {
+        ret = ESP_FAIL;
+    }
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Saved %"PRIu32" shadows, %"PRIu32" bytes to %s", s_shadow.stats.entries, s_shadow.stats.bytes, path);
+    } else {
+        remove(path);
+    }
+out:
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    return ret;
+}
+
+esp_err_t bsp_shadow_cache_load(const char *path)
+{
+    esp_err_t ret = ESP_OK;
+    shadow_file_header_t header;
+    uint32_t loaded = 0;
+
+    assert(path);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    FILE *f = fopen(path, "rb");
+    ESP_GOTO_ON_FALSE(f, ESP_ERR_NOT_FOUND, out, TAG, "No shadow cache %s", path);
+    ESP_GOTO_ON_FALSE(fread(&header, sizeof(header), 1, f) == 1, ESP_ERR_INVALID_SIZE, err, TAG, "Truncated %s", path);
+    ESP_GOTO_ON_FALSE(header.magic == SHADOW_FILE_MAGIC && header.version == SHADOW_FILE_VERSION, ESP_ERR_INVALID_VERSION,
+                      err, TAG, "%s is not a shadow cache of this version", path);
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        shadow_key_t key;
+        ESP_GOTO_ON_FALSE(fread(&key, sizeof(key), 1, f) == 1 && key.w > 0 && key.h > 0 && key.blur >= 0,
+                          ESP_ERR_INVALID_SIZE, err, TAG, "Truncated %s", path);
+        const size_t size = shadow_bytes(&key);
+        shadow_entry_t *entry = shadow_free_entry();
+        if (entry == NULL || s_shadow.stats.bytes + size > SHADOW_BUDGET) {
+            break;
+        }
+        uint8_t *data = shadow_alloc(size);
+        ESP_GOTO_ON_FALSE(data, ESP_ERR_NO_MEM, err, TAG, "No memory for shadow %"PRIu32, i);
+        if (fread(data, size, 1, f) != 1) {
+            heap_caps_free(data);
+            ESP_GOTO_ON_FALSE(false, ESP_ERR_INVALID_SIZE, err, TAG, "Truncated %s", path);
+        }
+        shadow_entry_set(entry, &key, data);
+        loaded++;
+    }
+    ESP_LOGI(TAG, "Loaded %"PRIu32" of %u shadows from %s", loaded, header.count, path);
+err:
+    fclose(f);
+    s_shadow.stats.restored += loaded;
+out:
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    return ret;
+}
+
+void bsp_shadow_cache_clear(void)
+{
+    for (size_t i = 0; i < SHADOW_ENTRIES; i++) {
+        if (s_shadow.entries[i].data) {
+            shadow_entry_free(&s_shadow.entries[i]);
+        }
+    }
+}
+
+void bsp_shadow_get_stats(bsp_shadow_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_shadow.stats;
+}
@@ -0,0 +1,504 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "bsp/stall.h"
+
+#if CONFIG_BSP_STALL
+#include "esp_lvgl_port.h"
+#include "bsp_display_priv.h"
+
+/* The class and event descriptor fields are private from LVGL 9.2 */
+#if LVGL_VERSION_MAJOR > 9 || LVGL_VERSION_MINOR >= 2
+#include "core/lv_obj_class_private.h"
+#include "misc/lv_event_private.h"
+#endif
+
+static const char *TAG = "BSP_STALL";
+
+#define STALL_RING              CONFIG_BSP_STALL_RING
+#define STALL_TIMERS            CONFIG_BSP_STALL_TIMERS
+#define STALL_STACK             16
+#define STALL_LINE_LEN          192
+
+static const char *const s_kind_names[] = {
+    [BSP_STALL_NONE] = "lvgl",
+    [BSP_STALL_TIMER] = "timer",
+    [BSP_STALL_EVENT] = "event",
+    [BSP_STALL_UI_APPLY] = "ui_apply",
+    [BSP_STALL_OBSERVER] = "observer",
+};
+
+/* Callback of a LVGL timer created through the trampoline */
+typedef struct {
+    lv_timer_t *timer;      /* NULL when the entry is free */
+    lv_timer_cb_t cb;
+} stall_timer_t;
+
+static struct {
+    /* Activities of the LVGL task, innermost last. Pushed and popped by the LVGL task only; the
+       watchdog copies the pointers without following them, a torn copy only misattributes the stall */
+    bsp_stall_ctx_t stack[STALL_STACK];
+    uint32_t depth;
+    uint32_t max_depth;
+    /* Timers created through the trampoline, guarded by the LVGL lock */
+    stall_timer_t timers[STALL_TIMERS];
+    bool in_async;          /* In lv_async_call(), its timer keeps its callback */
+    /* Current lv_timer_handler() pass, the LVGL task only */
+    esp_timer_handle_t watchdog;
+    uint32_t nesting;
+    uint32_t passes;
+    uint32_t max_us;
+    /* Guarded by lock, shared with the watchdog and the readers */
+    portMUX_TYPE lock;
+    uint32_t budget_us;
+    int64_t pass_start;     /* 0 outside of a pass */
+    bool fired;
+    uint8_t snap_depth;
+    uint8_t snap_count;
+    bsp_stall_ctx_t snap[BSP_STALL_DEPTH];
+    uint32_t stalls;        /* Recorded since start, the newest is ring[(stalls - 1) % STALL_RING] */
+    bsp_stall_record_t ring[STALL_RING];
+} s_stall = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .budget_us = CONFIG_BSP_STALL_BUDGET_MS * 1000,
+};
+
+void bsp_stall_enter(bsp_stall_kind_t kind, const void *fn, const void *obj, uint32_t code)
+{
+    const uint32_t depth = s_stall.depth;
+
+    if (depth < STALL_STACK) {
+        s_stall.stack[depth] = (bsp_stall_ctx_t) {
+            .kind = kind,
+            .code = code,
+            .fn = fn,
+            .obj = obj,
+        };
+    }
+    /* Entry before depth, the watchdog may be copying on the other core */
+    __atomic_store_n(&s_stall.depth, depth + 1, __ATOMIC_RELEASE);
+    s_stall.max_depth = MAX(s_stall.max_depth, depth + 1);
+}
+
+void bsp_stall_leave(void)
+{
+    assert(s_stall.depth > 0);
+    __atomic_store_n(&s_stall.depth, s_stall.depth - 1, __ATOMIC_RELEASE);
+}
+
+/* Object events, including the draw events of the refresh; see the --wrap options in CMakeLists.txt */
+lv_result_t __real_lv_obj_send_event(lv_obj_t *obj, lv_event_code_t event_code, void *param);
+
+lv_result_t __wrap_lv_obj_send_event(lv_obj_t *obj, lv_event_code_t event_code, void *param)
+{
+    bsp_stall_enter(BSP_STALL_EVENT, NULL, obj, event_code);
+    const lv_result_t res = __real_lv_obj_send_event(obj, event_code, param);
+    bsp_stall_leave();
+    return res;
+}
+
+static void stall_timer_cb(lv_timer_t *timer)
+{
+    lv_timer_cb_t cb = NULL;
+
+    for (size_t i = 0; i < STALL_TIMERS; i++) {
+        if (s_stall.timers[i].timer == timer) {
+            cb = s_stall.timers[i].cb;
+            break;
+        }
+    }
+    if (cb) {
+        bsp_stall_enter(BSP_STALL_TIMER, (const void *)cb, timer, 0);
+        cb(timer);
+        bsp_stall_leave();
+    }
+}
+
+/* Free every entry of the timer, a new timer may reuse the memory of one deleted without lv_timer_delete() */
+static void stall_timer_forget(const lv_timer_t *timer)
+{
+    for (size_t i = 0; i < STALL_TIMERS; i++) {
+        if (s_stall.timers[i].timer == timer) {
+            s_stall.timers[i].timer = NULL;
+        }
+    }
+}
+
+/* Free the entries of timers deleted without lv_timer_delete(), e.g. by lv_timer_set_auto_delete() */
+static void stall_timer_reclaim(void)
+{
+    for (size_t i = 0; i < STALL_TIMERS; i++) {
+        lv_timer_t *t = lv_timer_get_next(NULL);
+        while (t && t != s_stall.timers[i].timer) {
+            t = lv_timer_get_next(t);
+        }
+        if (t == NULL) {
+            s_stall.timers[i].timer = NULL;
+        }
+    }
+}
+
+static stall_timer_t *stall_timer_alloc(void)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < STALL_TIMERS; i++) {
+            if (s_stall.timers[i].timer == NULL) {
+                return &s_stall.timers[i];
+            }
+        }
+        stall_timer_reclaim();
+    }
+    return NULL;
+}
+
+/* Timer callbacks run through stall_timer_cb(), which knows the real one */
+lv_timer_t *__real_lv_timer_create(lv_timer_cb_t timer_xcb, uint32_t period, void *user_data);
+
+lv_timer_t *__wrap_lv_timer_create(lv_timer_cb_t timer_xcb, uint32_t period, void *user_data)
+{
+    stall_timer_t *entry = timer_xcb && !s_stall.in_async ? stall_timer_alloc() : NULL;
+    lv_timer_t *timer;
+
+    if (entry == NULL) {
+        /* Still counted as a stall, only not attributed to the timer */
+        timer = __real_lv_timer_create(timer_xcb, period, user_data);
+        stall_timer_forget(timer);
+        return timer;
+    }
+    timer = __real_lv_timer_create(stall_timer_cb, period, user_data);
+    if (timer) {
+        stall_timer_forget(timer);
+        entry->timer = timer;
+        entry->cb = timer_xcb;
+    }
+    return timer;
+}
+
+/* lv_async_call_cancel() finds the timer of the call by its callback, which must stay LVGL's own */
+lv_result_t __real_lv_async_call(lv_async_cb_t async_xcb, void *user_data);
+
+lv_result_t __wrap_lv_async_call(lv_async_cb_t async_xcb, void *user_data)
+{
+    s_stall.in_async = true;
+    const lv_result_t res = __real_lv_async_call(async_xcb, user_data);
+    s_stall.in_async = false;
+    return res;
+}
+
+void __real_lv_timer_delete(lv_timer_t *timer);
+
+void __wrap_lv_timer_delete(lv_timer_t *timer)
+{
+    stall_timer_forget(timer);
+    __real_lv_timer_delete(timer);
+}
+
+/* Runs in the esp_timer task when a pass reaches the budget, copies the activities without following them */
+static void stall_watchdog_cb(void *arg)
+{
+    const int64_t now = esp_timer_get_time();
+    bsp_stall_ctx_t top = { 0 };
+    uint32_t budget_ms = 0;
+
+    portENTER_CRITICAL(&s_stall.lock);
+    /* A pass that ended while the callback was dispatched is not a stall */
+    if (s_stall.pass_start && !s_stall.fired && now - s_stall.pass_start >= s_stall.budget_us) {
+        const uint32_t depth = __atomic_load_n(&s_stall.depth, __ATOMIC_ACQUIRE);
+        const uint32_t stored = MIN(depth, STALL_STACK);
+        const uint32_t n = MIN(stored, BSP_STALL_DEPTH);
+        for (uint32_t i = 0; i < n; i++) {
+            s_stall.snap[i] = s_stall.stack[stored - n + i];
+        }
+        s_stall.snap_depth = MIN(depth, UINT8_MAX);
+        s_stall.snap_count = n;
+        s_stall.fired = true;
+        budget_ms = s_stall.budget_us / 1000;
+        if (n) {
+            top = s_stall.snap[n - 1];
+        }
+    }
+    portEXIT_CRITICAL(&s_stall.lock);
+
+    if (budget_ms) {
+        ESP_LOGW(TAG, "LVGL task stalled for %"PRIu32" ms in %s %p", budget_ms, s_kind_names[top.kind],
+                 top.fn ? top.fn : top.obj);
+    }
+}
+
+/*
+ * First registered event callback of the object whose filter takes the event. This is resolved after
+ * the stall: with several matching callbacks it need not be the one that ran, and the class event
+ * handler is never named.
+ */
+static const void *stall_first_event_cb(lv_obj_t *obj, uint32_t code)
+{
+    const uint32_t count = lv_obj_get_event_count(obj);
+
+    for (uint32_t i = 0; i < count; i++) {
+        lv_event_dsc_t *dsc = lv_obj_get_event_dsc(obj, i);
+        const uint32_t filter = dsc->filter & ~LV_EVENT_PREPROCESS;
+        if (filter == LV_EVENT_ALL || filter == code) {
+            return (const void *)lv_event_dsc_get_cb(dsc);
+        }
+    }
+    return NULL;
+}
+
+/* Called by the LVGL task at the end of the pass, objects deleted since the watchdog are skipped */
+static void stall_resolve(bsp_stall_record_t *r)
+{
+    for (int i = r->count - 1; i >= 0; i--) {
+        bsp_stall_ctx_t *ctx = &r->ctx[i];
+        if (ctx->kind != BSP_STALL_EVENT || !lv_obj_is_valid(ctx->obj)) {
+            continue;
+        }
+        lv_obj_t *obj = (lv_obj_t *)ctx->obj;
+        ctx->fn = stall_first_event_cb(obj, ctx->code);
+        if (r->class_name == NULL) {
+            lv_obj_t *screen = lv_obj_get_screen(obj);
+            r->class_name = lv_obj_get_class(obj)->name;
+            r->screen = screen;
+            r->screen_active = screen == lv_display_get_screen_active(lv_obj_get_display(obj));
+        }
+    }
+}
+
+static int stall_format(const bsp_stall_record_t *r, char *buf, int len)
+{
+    int pos = 0;
+
+    if (r->count == 0) {
+        return snprintf(buf, len, "%s", s_kind_names[BSP_STALL_NONE]);
+    }
+    if (r->depth > r->count) {
+        pos += snprintf(buf + pos, len - pos, "(%u more) > ", r->depth - r->count);
+    }
+    for (int i = 0; i < r->count && pos < len; i++) {
+        const bsp_stall_ctx_t *ctx = &r->ctx[i];
+        pos += snprintf(buf + pos, len - pos, "%s%s", i ? " > " : "", s_kind_names[ctx->kind]);
+        if (pos < len && ctx->kind == BSP_STALL_EVENT) {
+            pos += snprintf(buf + pos, len - pos, " %u on %p", ctx->code, ctx->obj);
+        }
+        if (pos < len && ctx->fn) {
+            pos += snprintf(buf + pos, len - pos, ctx->kind == BSP_STALL_EVENT ? " first cb %p" : " cb %p", ctx->fn);
+        }
+    }
+    if (pos < len && r->class_name) {
+        pos += snprintf(buf + pos, len - pos, " [%s, screen %p%s]", r->class_name, r->screen,
+                        r->screen_active ? " active" : "");
+    }
+    return pos;
+}
+
+static void stall_commit(int64_t start, uint32_t duration_us)
+{
+    bsp_stall_record_t r = {
+        .timestamp_ms = start / 1000,
+        .duration_us = duration_us,
+    };
+    char line[STALL_LINE_LEN];
+
+    portENTER_CRITICAL(&s_stall.lock);
+    if (s_stall.fired) {
+        r.depth = s_stall.snap_depth;
+        r.count = s_stall.snap_count;
+        memcpy(r.ctx, s_stall.snap, sizeof(r.ctx));
+    }
+    portEXIT_CRITICAL(&s_stall.lock);
+
+    stall_resolve(&r);
+
+    portENTER_CRITICAL(&s_stall.lock);
+    s_stall.ring[s_stall.stalls % STALL_RING] = r;
+    s_stall.stalls++;
+    portEXIT_CRITICAL(&s_stall.lock);
+
+    stall_format(&r, line, STALL_LINE_LEN);
+    ESP_LOGW(TAG, "Stall of %"PRIu32" ms: %s", duration_us / 1000, line);
+}
+
+/* The LVGL task pass, also for the display lock profiler; see the --wrap options in CMakeLists.txt */
+uint32_t __wrap_lv_timer_handler(void)
+{
+    if (s_stall.watchdog == NULL || s_stall.nesting) {
+        bsp_display_lock_pass_begin();
+        const uint32_t ret = __real_lv_timer_handler();
+        bsp_display_lock_pass_end();
+        return ret;
+    }
+
+    bsp_display_lock_pass_begin();
+
+    s_stall.nesting++;
+    const int64_t start = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stall.lock);
+    const uint32_t budget_us = s_stall.budget_us;
+    s_stall.pass_start = start;
+    s_stall.fired = false;
+    portEXIT_CRITICAL(&s_stall.lock);
+    esp_timer_start_once(s_stall.watchdog, budget_us);
+
+    const uint32_t ret = __real_lv_timer_handler();
+
+    esp_timer_stop(s_stall.watchdog);
+    const uint32_t duration_us = esp_timer_get_time() - start;
+    portENTER_CRITICAL(&s_stall.lock);
+    s_stall.pass_start = 0;
+    portEXIT_CRITICAL(&s_stall.lock);
+    s_stall.passes++;
+    s_stall.max_us = MAX(s_stall.max_us, duration_us);
+    if (duration_us > budget_us) {
+        stall_commit(start, duration_us);
+    }
+    s_stall.nesting--;
+    bsp_display_lock_pass_end();
+    return ret;
+}
+
+esp_err_t bsp_stall_init(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = stall_watchdog_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "bsp_stall",
+    };
+
+    ESP_RETURN_ON_FALSE(s_stall.watchdog == NULL, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_stall.watchdog), TAG, "Watchdog timer failed");
+    ESP_LOGI(TAG, "Budget %"PRIu32" ms, tracking %d timers", s_stall.budget_us / 1000, STALL_TIMERS);
+    return ESP_OK;
+}
+
+size_t bsp_stall_read(bsp_stall_record_t *records, size_t max)
+{
+    assert(records || max == 0);
+
+    portENTER_CRITICAL(&s_stall.lock);
+    const size_t n = MIN(max, MIN(s_stall.stalls, STALL_RING));
+    for (size_t i = 0; i < n; i++) {
+        records[i] = s_stall.ring[(s_stall.stalls - n + i) % STALL_RING];
+    }
+    portEXIT_CRITICAL(&s_stall.lock);
+    return n;
+}
+
+esp_err_t bsp_stall_get_stats(bsp_stall_stats_t *stats)
+{
+    assert(stats);
+
+    portENTER_CRITICAL(&s_stall.lock);
+    *stats = (bsp_stall_stats_t) {
+        .passes = s_stall.passes,
+        .stalls = s_stall.stalls,
+        .budget_ms = s_stall.budget_us / 1000,
+        .max_us = s_stall.max_us,
+        .max_depth = MIN(s_stall.max_depth, UINT8_MAX),
+    };
+    portEXIT_CRITICAL(&s_stall.lock);
+    return ESP_OK;
+}
+
+esp_err_t bsp_stall_set_budget(uint32_t budget_ms)
+{
+    ESP_RETURN_ON_FALSE(budget_ms > 0, ESP_ERR_INVALID_ARG, TAG, "Budget must not be 0");
+
+    portENTER_CRITICAL(&s_stall.lock);
+    s_stall.budget_us = budget_ms * 1000;
+    portEXIT_CRITICAL(&s_stall.lock);
+    return ESP_OK;
+}
+
+void bsp_stall_reset(void)
+{
+    portENTER_CRITICAL(&s_stall.lock);
+    s_stall.stalls = 0;
+    s_stall.passes = 0;
+    s_stall.max_us = 0;
+    s_stall.max_depth = 0;
+    portEXIT_CRITICAL(&s_stall.lock);
+}
+
+esp_err_t bsp_stall_print(FILE *f)
+{
+    bsp_stall_stats_t stats;
+    bsp_stall_record_t *records;
+    char line[STALL_LINE_LEN];
+
+    assert(f);
+    records = malloc(sizeof(bsp_stall_record_t) * STALL_RING);
+    ESP_RETURN_ON_FALSE(records, ESP_ERR_NO_MEM, TAG, "No memory for %d records", STALL_RING);
+    bsp_stall_get_stats(&stats);
+    const size_t n = bsp_stall_read(records, STALL_RING);
+
+    int res = fprintf(f, "LVGL stalls: %"PRIu32" of %"PRIu32" passes over %"PRIu32" ms, longest %"PRIu32" us, "
+                      "nesting %u\n", stats.stalls, stats.passes, stats.budget_ms, stats.max_us, stats.max_depth);
+    for (size_t i = 0; i < n && res >= 0; i++) {
+        stall_format(&records[i], line, STALL_LINE_LEN);
+        res = fprintf(f, "%10"PRIu32" ms %6"PRIu32" us  %s\n", records[i].timestamp_ms, records[i].duration_us, line);
+    }
+    free(records);
+    ESP_RETURN_ON_FALSE(res >= 0 && fflush(f) == 0, ESP_FAIL, TAG, "Write error");
+    return ESP_OK;
+}
+
+#else /* CONFIG_BSP_STALL */
+
+size_t bsp_stall_read(bsp_stall_record_t *records, size_t max)
+{
+    return 0;
+}
+
+esp_err_t bsp_stall_get_stats(bsp_stall_stats_t *stats)
+{
+    assert(stats);
+    memset(stats, 0, sizeof(bsp_stall_stats_t));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t bsp_stall_set_budget(uint32_t budget_ms)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void bsp_stall_reset(void)
+{
+}
+
+esp_err_t bsp_stall_print(FILE *f)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* CONFIG_BSP_STALL */
@@ -0,0 +1,229 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_lcd_touch.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/tickless.h"
+#include "bsp_display_priv.h"
+#include "indev/lv_indev_private.h"
+
+static const char *TAG = "BSP_TICKLESS";
+
+#define TICKLESS_LVGL_TASK_NAME     "taskLVGL"  /* Task created by lvgl_port_init() */
+#define TICKLESS_WAKE_GAP_US        1000
+#define TICKLESS_RETRY_US           2000
+#define TICKLESS_RATE_WINDOW_US     1000000
+/* Released reads before touch goes back to interrupt driven, LVGL sends RELEASED/CLICKED on the first one */
+#define TICKLESS_RELEASED_READS     2
+
+#define TICKLESS_REQ_REFRESH        (1 << 0)
+#define TICKLESS_REQ_TOUCH          (1 << 1)
+
+static struct {
+    lv_display_t *disp;
+    lv_indev_t *indev;
+    TaskHandle_t lvgl_task;
+    esp_timer_handle_t retry_timer;
+    /* Requests, set by any task or ISR, cleared once the refresh started or the touch was read */
+    uint32_t pending;
+    bool seen;                  /* A pass resumed the timers for the pending requests */
+    bool late_kicked;
+    /* LVGL task only */
+    bool refreshing;
+    int64_t last_tick_us;
+    int64_t window_start_us;
+    uint32_t window_wakeups;
+#if CONFIG_BSP_DISPLAY_TICKLESS
+    lv_indev_read_cb_t touch_read_cb;
+    uint32_t released_reads;
+#endif
+    bsp_tickless_stats_t stats;
+} s_tickless;
+
+/* Wake the LVGL task until a pass has picked the pending requests up */
+static void tickless_kick(void *arg)
+{
+    if (__atomic_load_n(&s_tickless.pending, __ATOMIC_ACQUIRE) == 0 || s_tickless.late_kicked) {
+        return;
+    }
+    const bool seen = s_tickless.seen;
+    if (xTaskAbortDelay(s_tickless.lvgl_task) == pdPASS && seen) {
+        /* The pass that resumed the timers may have computed its sleep before, one more pass fixes that */
+        s_tickless.late_kicked = true;
+        return;
+    }
+    /* Not blocked: in a pass that may or may not have seen the request yet, or just about to sleep */
+    esp_timer_start_once(s_tickless.retry_timer, TICKLESS_RETRY_US);
+}
+
+static void tickless_kick_pended(void *arg, uint32_t unused)
+{
+    tickless_kick(arg);
+}
+
+static void tickless_request(uint32_t req)
+{
+    s_tickless.seen = false;
+    s_tickless.late_kicked = false;
+    __atomic_fetch_or(&s_tickless.pending, req, __ATOMIC_RELEASE);
+}
+
+void bsp_display_wake(void)
+{
+    if (s_tickless.lvgl_task == NULL) {
+        return;
+    }
+    __atomic_fetch_add(&s_tickless.stats.wake_requests, 1, __ATOMIC_RELAXED);
+    tickless_request(TICKLESS_REQ_REFRESH);
+    tickless_kick(NULL);
+}
+
+/* LVGL tick source, also the first thing lv_timer_handler() calls in every pass */
+static uint32_t tickless_tick_get(void)
+{
+    const int64_t now = esp_timer_get_time();
+
+    if (xTaskGetCurrentTaskHandle() != s_tickless.lvgl_task) {
+        return now / 1000;
+    }
+
+    const int64_t gap = now - s_tickless.last_tick_us;
+    if (!s_tickless.refreshing && gap > TICKLESS_WAKE_GAP_US) {
+        s_tickless.stats.wakeups++;
+        s_tickless.stats.sleep_ms_max = MAX(s_tickless.stats.sleep_ms_max, gap / 1000);
+    }
+    s_tickless.last_tick_us = now;
+    if (now - s_tickless.window_start_us >= TICKLESS_RATE_WINDOW_US) {
+        s_tickless.stats.wakeups_per_sec_x10 = (uint64_t)(s_tickless.stats.wakeups - s_tickless.window_wakeups) *
+                                               10 * 1000000 / (now - s_tickless.window_start_us);
+        s_tickless.stats.idle_pct = lv_timer_get_idle();
+        s_tickless.window_start_us = now;
+        s_tickless.window_wakeups = s_tickless.stats.wakeups;
+    }
+
+    const uint32_t pending = __atomic_load_n(&s_tickless.pending, __ATOMIC_ACQUIRE);
+    if (pending) {
+        if (pending & TICKLESS_REQ_REFRESH) {
+            lv_timer_resume(lv_display_get_refr_timer(s_tickless.disp));
+        }
+        lv_timer_t *read_timer = lv_indev_get_read_timer(s_tickless.indev);
+        if ((pending & TICKLESS_REQ_TOUCH) && read_timer) {
+            lv_timer_resume(read_timer);
+        }
+        s_tickless.seen = true;
+    }
+    return now / 1000;
+}
+
+static void tickless_refr_cb(lv_event_t *e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_REFR_START) {
+        s_tickless.refreshing = true;
+        __atomic_fetch_and(&s_tickless.pending, ~TICKLESS_REQ_REFRESH, __ATOMIC_RELEASE);
+    } else {
+        s_tickless.refreshing = false;
+    }
+}
+
+#if CONFIG_BSP_DISPLAY_TICKLESS
+static void tickless_touch_isr(esp_lcd_touch_handle_t tp)
+{
+    BaseType_t task_woken = pdFALSE;
+
+#if CONFIG_BSP_PM_LIGHT_SLEEP
+    bsp_pm_touch_isr();
+#endif
+    __atomic_fetch_add(&s_tickless.stats.touch_irqs, 1, __ATOMIC_RELAXED);
+    tickless_request(TICKLESS_REQ_TOUCH);
+    /* esp_timer and xTaskAbortDelay() are not for ISRs, kick from the timer service task */
+    xTimerPendFunctionCallFromISR(tickless_kick_pended, NULL, 0, &task_woken);
+    if (task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/* Wraps the touch read, pauses the read timer once the finger is lifted and scrolling has ended */
+static void tickless_touch_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    __atomic_fetch_and(&s_tickless.pending, ~TICKLESS_REQ_TOUCH, __ATOMIC_RELEASE);
+    s_tickless.touch_read_cb(indev, data);
+    if (data->state == LV_INDEV_STATE_PRESSED || lv_indev_get_scroll_obj(indev)) {
+        s_tickless.released_reads = 0;
+    } else if (++s_tickless.released_reads >= TICKLESS_RELEASED_READS) {
+        lv_timer_pause(lv_indev_get_read_timer(indev));
+    }
+}
+#endif
+
+esp_err_t bsp_tickless_init(lv_display_t *disp, lv_indev_t *indev, esp_lcd_touch_handle_t tp)
+{
+    assert(disp && indev);
+    ESP_RETURN_ON_FALSE(s_tickless.lvgl_task == NULL, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+
+    TaskHandle_t lvgl_task = xTaskGetHandle(TICKLESS_LVGL_TASK_NAME);
+    ESP_RETURN_ON_FALSE(lvgl_task, ESP_ERR_NOT_FOUND, TAG, "LVGL task not found");
+    const esp_timer_create_args_t retry_args = {
+        .callback = tickless_kick,
+        .name = "lvgl_wake",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&retry_args, &s_tickless.retry_timer), TAG, "Timer failed");
+
+    lvgl_port_lock(0);
+    s_tickless.disp = disp;
+    s_tickless.indev = indev;
+    s_tickless.window_start_us = esp_timer_get_time();
+    s_tickless.last_tick_us = s_tickless.window_start_us;
+    /* Before bsp_ui_channel_init() so the request is cleared before the channel drains */
+    lv_display_add_event_cb(disp, tickless_refr_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, tickless_refr_cb, LV_EVENT_REFR_READY, NULL);
+    lv_tick_set_cb(tickless_tick_get);
+    s_tickless.lvgl_task = lvgl_task;
+
+#if CONFIG_BSP_DISPLAY_TICKLESS
+    if (tp && esp_lcd_touch_register_interrupt_callback(tp, tickless_touch_isr) == ESP_OK) {
+        s_tickless.touch_read_cb = indev->read_cb;
+        lv_indev_set_read_cb(indev, tickless_touch_read_cb);
+    } else {
+        ESP_LOGW(TAG, "No touch interrupt, touch stays polled");
+    }
+#endif
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+void bsp_tickless_get_stats(bsp_tickless_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_tickless.stats;
+}
@@ -0,0 +1,293 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_lvgl_port.h"
+
+#include "bsp/ui_channel.h"
+#include "bsp/tickless.h"
+#include "bsp_mpsc.h"
+#include "bsp_display_priv.h"
+
+static const char *TAG = "BSP_UI";
+
+#define UI_QUEUE_LEN            CONFIG_BSP_UI_CHANNEL_LEN
+#define UI_BATCH_MAX            CONFIG_BSP_UI_BATCH_OBSERVERS
+
+_Static_assert((UI_QUEUE_LEN & (UI_QUEUE_LEN - 1)) == 0, "CONFIG_BSP_UI_CHANNEL_LEN must be a power of two");
+
+typedef struct {
+    bsp_ui_apply_cb_t apply;
+    void *target;
+    int32_t value;
+    int64_t post_us;
+} ui_update_t;
+
+typedef struct {
+    lv_observer_t *observer;    /* NULL when the entry is free */
+    lv_subject_t *subject;
+    lv_obj_t *obj;
+    lv_observer_cb_t cb;
+    bool dirty;
+} ui_batched_t;
+
+static struct {
+    bsp_mpsc_t queue;
+    uint32_t queue_seq[UI_QUEUE_LEN];
+    ui_update_t updates[UI_QUEUE_LEN];
+    bool ready;
+    /* LVGL task only: latest update per target collected in one drain */
+    ui_update_t pending[UI_QUEUE_LEN];
+    /* LVGL task only: batched observers */
+    ui_batched_t batched[UI_BATCH_MAX];
+    ui_batched_t *adding;
+    bsp_ui_channel_stats_t stats;
+} s_ui;
+
+static void ui_apply_subject_int(void *target, int32_t value)
+{
+    lv_subject_set_int(target, value);
+}
+
+/**************************************************************************************************
+ *  Batched subject observers
+ **************************************************************************************************/
+
+static ui_batched_t *ui_batch_find(const lv_observer_t *observer)
+{
+    for (size_t i = 0; i < UI_BATCH_MAX; i++) {
+        if (s_ui.batched[i].observer == observer) {
+            return &s_ui.batched[i];
+        }
+    }
+    return NULL;
+}
+
+/* Registered as the LVGL observer, only marks the batched observer dirty */
+static void ui_batch_mark(lv_observer_t *observer, lv_subject_t *subject)
+{
+    ui_batched_t *b = ui_batch_find(observer);
+
+    if (b == NULL) {
+        /* LVGL notifies a new observer right away, deliver the initial value */
+        b = s_ui.adding;
+        assert(b);
+        b->observer = observer;
+        bsp_stall_enter(BSP_STALL_OBSERVER, (const void *)b->cb, subject, 0);
+        b->cb(observer, subject);
+        bsp_stall_leave();
+        return;
+    }
+    s_ui.stats.subject_notifications++;
+    if (b->dirty) {
+        s_ui.stats.subject_suppressed++;
+    }
+    b->dirty = true;
+    /* Delivered on the next refresh, which may be paused */
+    bsp_display_wake();
+}
+
+static void ui_batch_deliver(void)
+{
+    for (size_t i = 0; i < UI_BATCH_MAX; i++) {
+        ui_batched_t *b = &s_ui.batched[i];
+        if (b->observer && b->dirty) {
+            b->dirty = false;
+            s_ui.stats.subject_delivered++;
+            bsp_stall_enter(BSP_STALL_OBSERVER, (const void *)b->cb, b->subject, 0);
+            b->cb(b->observer, b->subject);
+            bsp_stall_leave();
+        }
+    }
+}
+
+static void ui_batch_obj_deleted(lv_event_t *e)
+{
+    const lv_obj_t *obj = lv_event_get_target(e);
+
+    /* LVGL removes the observers of the object itself */
+    for (size_t i = 0; i < UI_BATCH_MAX; i++) {
+        if (s_ui.batched[i].observer && s_ui.batched[i].obj == obj) {
+            memset(&s_ui.batched[i], 0, sizeof(ui_batched_t));
+        }
+    }
+}
+
+static void ui_label_text_cb(lv_observer_t *observer, lv_subject_t *subject)
+{
+    lv_label_set_text_fmt(lv_observer_get_target(observer), lv_observer_get_user_data(observer), lv_subject_get_int(subject));
+}
+
+lv_observer_t *bsp_subject_add_observer_batched(lv_subject_t *subject, lv_observer_cb_t cb, lv_obj_t *obj, void *user_data)
+{
+    assert(subject && cb);
+    ui_batched_t *b = ui_batch_find(NULL);
+    ESP_RETURN_ON_FALSE(b, NULL, TAG, "No free batched observer, increase CONFIG_BSP_UI_BATCH_OBSERVERS");
+
+    b->subject = subject;
+    b->obj = obj;
+    b->cb = cb;
+    b->dirty = false;
+    s_ui.adding = b;
+    lv_observer_t *observer = lv_subject_add_observer_obj(subject, ui_batch_mark, obj, user_data);
+    s_ui.adding = NULL;
+    if (observer == NULL) {
+        memset(b, 0, sizeof(ui_batched_t));
+        return NULL;
+    }
+    if (obj) {
+        lv_obj_add_event_cb(obj, ui_batch_obj_deleted, LV_EVENT_DELETE, NULL);
+    }
+    return observer;
+}
+
+lv_observer_t *bsp_label_bind_text_batched(lv_obj_t *label, lv_subject_t *subject, const char *fmt)
+{
+    assert(label && fmt);
+    return bsp_subject_add_observer_batched(subject, ui_label_text_cb, label, (void *)fmt);
+}
+
+void bsp_subject_remove_observer_batched(lv_observer_t *observer)
+{
+    ui_batched_t *b = ui_batch_find(observer);
+
+    if (observer && b) {
+        memset(b, 0, sizeof(ui_batched_t));
+        lv_observer_remove(observer);
+    }
+}
+
+void bsp_subject_batch_flush(void)
+{
+    ui_batch_deliver();
+}
+
+/**************************************************************************************************
+ *  Update channel
+ **************************************************************************************************/
+
+static void ui_channel_drain(lv_event_t *e)
+{
+    size_t count = 0;
+    uint32_t pos;
+
+    s_ui.stats.depth_max = MAX(s_ui.stats.depth_max, bsp_mpsc_depth(&s_ui.queue));
+
+    /* Bounded to one queue length so that a flooding producer cannot stall the frame */
+    for (size_t n = 0; n < UI_QUEUE_LEN && bsp_mpsc_peek(&s_ui.queue, &pos); n++) {
+        const ui_update_t *u = &s_ui.updates[pos % UI_QUEUE_LEN];
+        size_t i;
+        for (i = 0; i < count; i++) {
+            if (s_ui.pending[i].apply == u->apply && s_ui.pending[i].target == u->target) {
+                break;
+            }
+        }
+        if (i < count) {
+            s_ui.stats.coalesced++;
+        } else {
+            count++;
+        }
+        s_ui.pending[i] = *u;
+        bsp_mpsc_release(&s_ui.queue);
+    }
+
+    if (count == 0) {
+        ui_batch_deliver();
+        return;
+    }
+    const int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        bsp_stall_enter(BSP_STALL_UI_APPLY, (const void *)s_ui.pending[i].apply, s_ui.pending[i].target, 0);
+        s_ui.pending[i].apply(s_ui.pending[i].target, s_ui.pending[i].value);
+        bsp_stall_leave();
+        const uint32_t latency = now - s_ui.pending[i].post_us;
+        s_ui.stats.latency_us_last = latency;
+        s_ui.stats.latency_us_max = MAX(s_ui.stats.latency_us_max, latency);
+    }
+    s_ui.stats.applied += count;
+
+    /* Subjects set above notify their batched observers in this frame too */
+    ui_batch_deliver();
+}
+
+esp_err_t bsp_ui_channel_init(lv_display_t *disp)
+{
+    assert(disp);
+    ESP_RETURN_ON_FALSE(!s_ui.ready, ESP_ERR_INVALID_STATE, TAG, "UI channel already initialized");
+
+    bsp_mpsc_init(&s_ui.queue, s_ui.queue_seq, UI_QUEUE_LEN);
+    lvgl_port_lock(0);
+    lv_display_add_event_cb(disp, ui_channel_drain, LV_EVENT_REFR_START, NULL);
+    lvgl_port_unlock();
+    __atomic_store_n(&s_ui.ready, true, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+esp_err_t bsp_ui_post(bsp_ui_apply_cb_t apply, void *target, int32_t value)
+{
+    uint32_t pos;
+
+    assert(apply);
+    ESP_RETURN_ON_FALSE(__atomic_load_n(&s_ui.ready, __ATOMIC_ACQUIRE), ESP_ERR_INVALID_STATE, TAG, "UI channel not initialized");
+
+    const int64_t start = esp_timer_get_time();
+    if (!bsp_mpsc_claim(&s_ui.queue, &pos)) {
+        __atomic_fetch_add(&s_ui.stats.dropped, 1, __ATOMIC_RELAXED);
+        return ESP_ERR_NO_MEM;
+    }
+    ui_update_t *u = &s_ui.updates[pos % UI_QUEUE_LEN];
+    u->apply = apply;
+    u->target = target;
+    u->value = value;
+    u->post_us = start;
+    bsp_mpsc_publish(&s_ui.queue, pos);
+    bsp_display_wake();
+
+    __atomic_fetch_add(&s_ui.stats.posted, 1, __ATOMIC_RELAXED);
+    const uint32_t took = esp_timer_get_time() - start;
+    if (took > s_ui.stats.post_us_max) {
+        /* Racy between producers, good enough for a maximum */
+        s_ui.stats.post_us_max = took;
+    }
+    return ESP_OK;
+}
+
+esp_err_t bsp_ui_post_subject_int(lv_subject_t *subject, int32_t value)
+{
+    assert(subject);
+    return bsp_ui_post(ui_apply_subject_int, subject, value);
+}
+
+void bsp_ui_channel_get_stats(bsp_ui_channel_stats_t *stats)
+{
+    assert(stats);
+    *stats = s_ui.stats;
+    stats->depth = s_ui.ready ? bsp_mpsc_depth(&s_ui.queue) : 0;
+}
@@ -22,9 +22,198 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-/*
-    LRCK 35
-    BCLK 36
-    DOUT 37
-*/
+/**
+ * @file
+ * @brief BSP Audio
+ *
+ * Speaker output through I2S (standard Philips mode, 16 bit stereo).
+ *
+ * bsp_audio_play() streams a WAV (PCM 16 bit, mono or stereo) or raw PCM file from uSD card or SPIFFS.
+ * A reader task prefetches the file into a ring buffer, an output task converts the samples and feeds
+ * the I2S DMA. Playback starts only after the ring buffer is filled up to the prefetch level, so slow
+ * file system accesses are absorbed by the buffer instead of reaching the DAC.
+ *
+ * Short sound effects (key clicks, beeps) are preloaded into RAM as clips and played by a mixer with
+ * CONFIG_BSP_AUDIO_MIXER_VOICES voices on top of the streamed file. Triggering a clip only queues
+ * it without locking, the output task starts it with the next DMA block.
+ *
+ *     LRCK 35
+ *     BCLK 36
+ *     DOUT 37
+ */
 #pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/* Audio */
+#define BSP_I2S_LRCK            (35)
+#define BSP_I2S_BCLK            (36)
+#define BSP_I2S_DOUT            (37)
+#define BSP_I2S_NUM             CONFIG_BSP_I2S_NUM
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief BSP audio configuration structure
+ */
+typedef struct {
+    uint32_t sample_rate;       /*!< Output sample rate, also used for raw PCM files */
+} bsp_audio_config_t;
+
+/**
+ * @brief Audio output statistics
+ */
+typedef struct {
+    uint32_t underruns;         /*!< I2S DMA ran out of data and sent silence */
+    uint32_t starvations;       /*!< Output task found the ring buffer empty during playback */
+    uint32_t ring_size;         /*!< Ring buffer size in bytes */
+    uint32_t ring_fill;         /*!< Current ring buffer fill in bytes */
+    uint32_t ring_fill_min;     /*!< Lowest ring buffer fill since playback started */
+    uint64_t bytes_played;      /*!< Bytes written to the output */
+} bsp_audio_stats_t;
+
+/**
+ * @brief Initialize the speaker output and start the audio tasks
+ *
+ * With CONFIG_BSP_AUDIO_FILE_SINK the samples are written to CONFIG_BSP_AUDIO_FILE_SINK_PATH
+ * in real time instead of I2S.
+ *
+ * @param[in] config Audio configuration
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already initialized
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ *      - Else                I2S driver failure
+ */
+esp_err_t bsp_audio_init(const bsp_audio_config_t *config);
+
+/**
+ * @brief Play a file, stops the current playback
+ *
+ * Files with a `.wav` extension are parsed, other files are played as raw signed 16 bit
+ * little endian stereo PCM at the configured sample rate.
+ *
+ * @param[in] path File path, e.g. BSP_SD_MOUNT_POINT "/alarm.wav"
+ * @return
+ *      - ESP_OK              Playback requested
+ *      - ESP_ERR_INVALID_STATE Audio not initialized
+ *      - ESP_ERR_INVALID_ARG Path too long
+ */
+esp_err_t bsp_audio_play(const char *path);
+
+/**
+ * @brief Stop the current playback
+ */
+esp_err_t bsp_audio_stop(void);
+
+/**
+ * @brief A file is being played
+ */
+bool bsp_audio_is_playing(void);
+
+/**
+ * @brief Set output volume
+ *
+ * @param[in] percent Volume 0..100
+ */
+esp_err_t bsp_audio_set_volume(int percent);
+
+/**
+ * @brief Get audio output statistics
+ */
+void bsp_audio_get_stats(bsp_audio_stats_t *stats);
+
+/**
+ * @brief Preloaded sound effect clip
+ */
+typedef struct bsp_audio_clip *bsp_audio_clip_handle_t;
+
+/**
+ * @brief Sound effect mixer statistics
+ */
+typedef struct {
+    uint32_t triggers;          /*!< Clips started */
+    uint32_t dropped;           /*!< Triggers lost because the trigger queue was full */
+    uint32_t stolen;            /*!< Playing voices cut off to start a new clip */
+    uint32_t voices_active;     /*!< Voices playing now */
+    uint32_t latency_us_last;   /*!< Trigger to DAC latency of the last started clip */
+    uint32_t latency_us_max;    /*!< Highest trigger to DAC latency */
+} bsp_audio_mixer_stats_t;
+
+/**
+ * @brief Load a sound effect clip
+ *
+ * The file (same formats as bsp_audio_play()) is decoded to mono once and kept in PSRAM until
+ * bsp_audio_clip_delete(). Clips play at their own sample rate whatever the output rate is.
+ *
+ * @param[in]  path     File path
+ * @param[out] ret_clip Clip handle
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_SIZE Clip larger than CONFIG_BSP_AUDIO_CLIP_MAX_KB
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ *      - Else                File could not be read
+ */
+esp_err_t bsp_audio_clip_load(const char *path, bsp_audio_clip_handle_t *ret_clip);
+
+/**
+ * @brief Create a sound effect clip from mono 16 bit samples, the samples are copied
+ *
+ * @param[in]  pcm         Samples
+ * @param[in]  frames      Number of samples
+ * @param[in]  sample_rate Sample rate of the clip
+ * @param[out] ret_clip    Clip handle
+ */
+esp_err_t bsp_audio_clip_create(const int16_t *pcm, size_t frames, uint32_t sample_rate, bsp_audio_clip_handle_t *ret_clip);
+
+/**
+ * @brief Free a clip
+ *
+ * Refused while a voice plays the clip or a bsp_audio_clip_play() of it is still queued, retry once it
+ * has finished. The clip must not be played from another task during the call.
+ *
+ * @param[in] clip Clip handle
+ * @return
+ *      - ESP_OK              Clip freed
+ *      - ESP_ERR_INVALID_STATE Clip is playing, not freed
+ */
+esp_err_t bsp_audio_clip_delete(bsp_audio_clip_handle_t clip);
+
+/**
+ * @brief Play a clip on a free voice
+ *
+ * Lock free, can be called from any task including LVGL event callbacks, but not from an ISR.
+ * When all voices are busy the voice closest to its end is reused.
+ *
+ * @param[in] clip   Clip handle
+ * @param[in] volume Clip volume 0..100, scaled by the output volume
+ * @return
+ *      - ESP_OK              Clip queued
+ *      - ESP_ERR_INVALID_STATE Audio not initialized
+ *      - ESP_ERR_NO_MEM      Trigger queue full
+ */
+esp_err_t bsp_audio_clip_play(bsp_audio_clip_handle_t clip, int volume);
+
+/**
+ * @brief Get sound effect mixer statistics
+ */
+void bsp_audio_mixer_get_stats(bsp_audio_mixer_stats_t *stats);
+
+/**
+ * @brief Measure the mixing kernel
+ *
+ * Mixes `blocks` DMA blocks with `voices` active voices of a synthetic clip, off the output path.
+ * tools/mixer_bench.c runs the same load on Linux.
+ *
+ * @return Average time per DMA block in nanoseconds
+ */
+uint32_t bsp_audio_mixer_benchmark(int voices, int blocks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP retained bitmap cache
+ *
+ * Static widget subtrees drawn from a bitmap. A panel with labels, icons and borders is re-rasterized
+ * by LVGL whenever anything overlapping it is redrawn. bsp_bitmap_cache_enable() renders the subtree
+ * once into a bitmap in PSRAM and from then on LVGL only blends the bitmap:
+ *
+ *     lv_obj_t *panel = lv_obj_create(screen);
+ *     ...labels and icons...
+ *     bsp_bitmap_cache_enable(panel, LV_COLOR_FORMAT_RGB565);
+ *
+ * The subtree stays a normal LVGL subtree: layouts, input and events work as before. Changes of the
+ * root or a descendant (text, value, style, state, scroll, flags) are seen through lv_obj_invalidate(),
+ * moves and resizes of descendants by comparing their coordinates, and the bitmap is rendered again
+ * before the next refresh.
+ * Subtrees with animations are better left uncached, they are rendered again every frame.
+ *
+ * Bitmaps are kept within CONFIG_BSP_BITMAP_CACHE_KB. A subtree that does not fit is drawn by LVGL as
+ * usual until memory is released. Call the functions with the display lock held.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bitmap cache statistics
+ */
+typedef struct {
+    uint32_t renders;       /*!< Subtrees rendered into their bitmap */
+    uint32_t invalidations; /*!< Changes of cached subtrees */
+    uint32_t over_budget;   /*!< Bitmaps that did not fit in CONFIG_BSP_BITMAP_CACHE_KB */
+    uint32_t cached;        /*!< Subtrees drawn from a bitmap */
+    uint32_t uncached;      /*!< Subtrees waiting for memory, drawn by LVGL */
+    uint32_t bytes;         /*!< Memory used by the bitmaps */
+    uint32_t budget;        /*!< CONFIG_BSP_BITMAP_CACHE_KB in bytes */
+} bsp_bitmap_cache_stats_t;
+
+/**
+ * @brief Draw a widget and its children from a bitmap
+ *
+ * The bitmap covers the widget and its extra draw area (shadow, outline). Children overflowing the
+ * widget (LV_OBJ_FLAG_OVERFLOW_VISIBLE) are not in the bitmap.
+ *
+ * @note The bitmap is drawn by an image inserted into the parent right after the widget, so
+ *       lv_obj_get_index() and lv_obj_get_child() of the later siblings are one higher while the
+ *       widget is cached. The image is floating and not clickable, layouts and scrolling ignore it.
+ *
+ * @param[in] root Widget, not a screen
+ * @param[in] cf   LV_COLOR_FORMAT_RGB565 for an opaque rectangular widget without shadow or outline,
+ *                 half the memory and copied without blending, else LV_COLOR_FORMAT_ARGB8888
+ * @return
+ *      - ESP_OK              On success, also when the widget is already cached
+ *      - ESP_ERR_INVALID_ARG Screen or unsupported color format
+ *      - ESP_ERR_NO_MEM      CONFIG_BSP_BITMAP_CACHE_ENTRIES widgets already cached
+ */
+esp_err_t bsp_bitmap_cache_enable(lv_obj_t *root, lv_color_format_t cf);
+
+/**
+ * @brief Draw the widget and its children by LVGL again and release the bitmap
+ *
+ * Deleting the widget does the same.
+ *
+ * @param[in] root Widget
+ */
+void bsp_bitmap_cache_disable(lv_obj_t *root);
+
+/**
+ * @brief Render the bitmap of a cached widget again before the next refresh
+ *
+ * @param[in] root Widget
+ */
+void bsp_bitmap_cache_invalidate(lv_obj_t *root);
+
+/**
+ * @brief Get the statistics since start
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_bitmap_cache_get_stats(bsp_bitmap_cache_stats_t *stats);
+
+/**
+ * @brief Check that moving and resizing a child renders the bitmap again
+ *
+ * Caches a panel on a screen of its own, moves and resizes its child and compares the bitmap with the
+ * expected pixels after each step. Call with the display lock held.
+ *
+ * @return
+ *      - ESP_OK              Bitmaps follow the child
+ *      - ESP_ERR_NO_MEM      Widgets or bitmap could not be allocated
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_BITMAP_CACHE is off
+ *      - ESP_FAIL            A step was not rendered, rendered without a change, or left a stale bitmap
+ */
+esp_err_t bsp_bitmap_cache_selftest(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP RGB565 blend kernels
+ *
+ * Word-at-a-time (two RGB565 pixels per 32-bit access) versions of the LVGL software renderer's
+ * hottest RGB565 loops. With CONFIG_BSP_BLEND_FAST this header is LV_DRAW_SW_ASM_CUSTOM_INCLUDE:
+ * LVGL's blend functions call the kernels through the LV_DRAW_SW_*_TO_RGB565 hooks and keep their
+ * generic loops for the cases not covered here (masks, other blend modes).
+ *
+ * On the ESP32-S3 the solid fill stores 16 bytes at a time with the PIE vector instructions
+ * (CONFIG_BSP_BLEND_PIE), the word-at-a-time C stays the fallback and serves the other targets.
+ *
+ * The kernels produce the same pixels as the generic LVGL loops. bsp_blend_selftest() compares them
+ * with scalar reference versions of those loops, bsp_blend_bench() measures both. tools/blend_check.c
+ * runs the same comparison for the C kernels on Linux.
+ * Strides are in bytes.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BSP_BLEND_FAST
+/* LVGL 9 hooks, only expanded inside the LVGL blend sources */
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565(dsc) \
+    (bsp_blend_fill_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, (dsc)->dest_stride, \
+                           lv_color_to_u16((dsc)->color)), LV_RESULT_OK)
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565_WITH_OPA(dsc) \
+    (bsp_blend_fill_opa_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, (dsc)->dest_stride, \
+                               lv_color_to_u16((dsc)->color), (dsc)->opa), LV_RESULT_OK)
+#define LV_DRAW_SW_RGB565_BLEND_NORMAL_TO_RGB565(dsc) \
+    (bsp_blend_copy_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, (dsc)->dest_stride, \
+                           (const uint16_t *)(dsc)->src_buf, (dsc)->src_stride), LV_RESULT_OK)
+#define LV_DRAW_SW_ARGB8888_BLEND_NORMAL_TO_RGB565(dsc) \
+    (bsp_blend_argb8888_to_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, (dsc)->dest_stride, \
+                                  (const uint8_t *)(dsc)->src_buf, (dsc)->src_stride), LV_RESULT_OK)
+#endif
+
+/**
+ * @brief Fill an area with a color
+ *
+ * @param[out] dest   First pixel of the area
+ * @param[in]  w      Width in pixels
+ * @param[in]  h      Height in pixels
+ * @param[in]  stride Destination stride
+ * @param[in]  color  RGB565 color
+ */
+void bsp_blend_fill_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color);
+
+/**
+ * @brief Mix a color into an area with an opacity
+ *
+ * Same rounding as lv_color_16_16_mix().
+ *
+ * @param[in,out] dest   First pixel of the area
+ * @param[in]     w      Width in pixels
+ * @param[in]     h      Height in pixels
+ * @param[in]     stride Destination stride
+ * @param[in]     color  RGB565 color
+ * @param[in]     opa    Opacity, 0 (transparent) to 255 (cover)
+ */
+void bsp_blend_fill_opa_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color, uint8_t opa);
+
+/**
+ * @brief Copy an RGB565 image into an area
+ *
+ * Large copies in internal RAM go to the GDMA with CONFIG_BSP_DMA_COPY, see bsp/dma_copy.h.
+ *
+ * @param[out] dest        First pixel of the area
+ * @param[in]  w           Width in pixels
+ * @param[in]  h           Height in pixels
+ * @param[in]  dest_stride Destination stride
+ * @param[in]  src         First source pixel
+ * @param[in]  src_stride  Source stride
+ */
+void bsp_blend_copy_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                           const uint16_t *src, int32_t src_stride);
+
+/**
+ * @brief Draw an ARGB8888 image over an RGB565 area
+ *
+ * Same rounding as lv_color_24_16_mix(). Fully transparent and fully opaque pixels skip the mix.
+ *
+ * @param[in,out] dest        First pixel of the area
+ * @param[in]     w           Width in pixels
+ * @param[in]     h           Height in pixels
+ * @param[in]     dest_stride Destination stride
+ * @param[in]     src         First source pixel, B, G, R, A bytes
+ * @param[in]     src_stride  Source stride
+ */
+void bsp_blend_argb8888_to_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                                  const uint8_t *src, int32_t src_stride);
+
+/**
+ * @brief Swap the bytes of RGB565 pixels for panels that take big endian pixels
+ *
+ * Replaces lv_draw_sw_rgb565_swap() in the flush path when the board swaps in software
+ * (BSP_LCD_SW_SWAP_BYTES).
+ *
+ * @param[in,out] buf   Pixels
+ * @param[in]     count Number of pixels
+ */
+void bsp_blend_rgb565_swap(uint16_t *buf, size_t count);
+
+/**
+ * @brief Compare every kernel with its scalar reference
+ *
+ * Random sizes, alignments, strides, colors and opacities. Plain C, runs on the target and on a Linux host.
+ *
+ * @return
+ *      - ESP_OK              All kernels are bit-exact
+ *      - ESP_ERR_NO_MEM      Buffers could not be allocated
+ *      - ESP_FAIL            A kernel differs, the first difference is logged
+ */
+esp_err_t bsp_blend_selftest(void);
+
+/**
+ * @brief Measure each kernel and its scalar reference on a full-width block of the draw buffer size
+ *
+ * Prints the throughput in megapixels per second and the speedup. Takes about a second.
+ *
+ * @param[in] f Output stream
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NO_MEM      Buffers could not be allocated
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_blend_bench(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,168 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP board description
+ *
+ * Everything that differs between the supported boards is resolved here at compile time from
+ * CONFIG_BSP_BOARD_*: pins, LCD bus (i80 or SPI), panel controller, resolution, color order and
+ * capabilities. The display code only tests BSP_LCD_BUS_I80/BSP_LCD_BUS_SPI with the preprocessor,
+ * so each build contains one bus and one flush path.
+ */
+#pragma once
+
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+
+#if CONFIG_HMI_LCD_CONTROLLER_ILI9341 || CONFIG_HMI_LCD_CONTROLLER_GC9A01
+#error "No board of this BSP has the selected LCD controller, add it to bsp/board.h"
+#endif
+
+/* LCD panel controllers */
+#define BSP_LCD_PANEL_ST7796        (1)
+
+#if CONFIG_BSP_BOARD_WT32SC01
+
+/**************************************************************************************************
+ *  WT32-SC01 (ESP32): ST7796 over SPI, FT6336U touch
+ **************************************************************************************************/
+
+#define BSP_BOARD_NAME              "WT32-SC01"
+
+#define BSP_CAPS_DISPLAY            1
+#define BSP_CAPS_TOUCH              1
+#define BSP_CAPS_BUTTONS            0
+#define BSP_CAPS_AUDIO              0
+#define BSP_CAPS_AUDIO_SPEAKER      0
+#define BSP_CAPS_AUDIO_MIC          0
+#define BSP_CAPS_SDCARD             0
+#define BSP_CAPS_IMU                0
+
+/* I2C */
+#define BSP_I2C_SCL                 (GPIO_NUM_19)
+#define BSP_I2C_SDA                 (GPIO_NUM_18)
+
+/* Display - ST7796 SPI, IO_MUX pins of SPI2 */
+#define BSP_LCD_BUS_SPI             (1)
+#define BSP_LCD_PANEL               BSP_LCD_PANEL_ST7796
+#define BSP_LCD_SPI_NUM             (SPI2_HOST)
+#define BSP_LCD_WIDTH               (1)     /* Data lines */
+#define BSP_LCD_SCLK                (GPIO_NUM_14)
+#define BSP_LCD_MOSI                (GPIO_NUM_13)
+#define BSP_LCD_CS                  (GPIO_NUM_15)
+#define BSP_LCD_DC                  (GPIO_NUM_21)
+#define BSP_LCD_RST                 (GPIO_NUM_22)
+#define BSP_LCD_BACKLIGHT           (GPIO_NUM_23)
+#define BSP_LCD_TP_INT              (GPIO_NUM_39)
+#define BSP_LCD_TP_RST              (GPIO_NUM_NC)
+
+#define BSP_LCD_H_RES               (320)
+#define BSP_LCD_V_RES               (480)
+#define BSP_LCD_PIXEL_CLOCK_HZ      (40 * 1000 * 1000)
+#define BSP_LCD_INVERT_COLOR        (false)
+#define BSP_LCD_MIRROR_X            (true)
+#define BSP_LCD_MIRROR_Y            (false)
+/* No byte swap in the SPI peripheral, esp_lvgl_port swaps the RGB565 bytes */
+#define BSP_LCD_SW_SWAP_BYTES       (1)
+
+/* SD card - none */
+#define BSP_SD_MOSI                 (GPIO_NUM_NC)
+#define BSP_SD_MISO                 (GPIO_NUM_NC)
+#define BSP_SD_SCLK                 (GPIO_NUM_NC)
+#define BSP_SD_CS                   (GPIO_NUM_NC)
+
+#else
+
+/**************************************************************************************************
+ *  WT32-SC01 Plus (ESP32-S3): ST7796 over 8-bit i80, FT6336U touch
+ **************************************************************************************************/
+
+#define BSP_BOARD_NAME              "WT32-SC01 Plus"
+
+#define BSP_CAPS_DISPLAY            1
+#define BSP_CAPS_TOUCH              1
+#define BSP_CAPS_BUTTONS            1
+#define BSP_CAPS_AUDIO              1
+#define BSP_CAPS_AUDIO_SPEAKER      1
+#define BSP_CAPS_AUDIO_MIC          0
+#define BSP_CAPS_SDCARD             1
+#define BSP_CAPS_IMU                0
+
+/* I2C */
+#define BSP_I2C_SCL                 (GPIO_NUM_5)
+#define BSP_I2C_SDA                 (GPIO_NUM_6)
+
+/* Display - ST7796 8 Bit parallel */
+#define BSP_LCD_BUS_I80             (1)
+#define BSP_LCD_PANEL               BSP_LCD_PANEL_ST7796
+#define BSP_LCD_WIDTH               (8)     /* Data lines */
+#define BSP_LCD_DATA0               (GPIO_NUM_9)
+#define BSP_LCD_DATA1               (GPIO_NUM_46)
+#define BSP_LCD_DATA2               (GPIO_NUM_3)
+#define BSP_LCD_DATA3               (GPIO_NUM_8)
+#define BSP_LCD_DATA4               (GPIO_NUM_18)
+#define BSP_LCD_DATA5               (GPIO_NUM_17)
+#define BSP_LCD_DATA6               (GPIO_NUM_16)
+#define BSP_LCD_DATA7               (GPIO_NUM_15)
+
+#define BSP_LCD_CS                  (GPIO_NUM_NC)
+#define BSP_LCD_DC                  (GPIO_NUM_0)
+#define BSP_LCD_WR                  (GPIO_NUM_47)
+#define BSP_LCD_RD                  (GPIO_NUM_NC)
+#define BSP_LCD_RST                 (GPIO_NUM_4)
+#define BSP_LCD_TE                  (GPIO_NUM_48)
+#define BSP_LCD_BACKLIGHT           (GPIO_NUM_45)
+#define BSP_LCD_TP_INT              (GPIO_NUM_7)
+#define BSP_LCD_TP_RST              (GPIO_NUM_NC)
+
+#define BSP_LCD_H_RES               (320)
+#define BSP_LCD_V_RES               (480)
+#define BSP_LCD_PIXEL_CLOCK_HZ      (20 * 1000 * 1000)
+#define BSP_LCD_INVERT_COLOR        (true)
+#define BSP_LCD_MIRROR_X            (true)
+#define BSP_LCD_MIRROR_Y            (false)
+/* The i80 peripheral swaps the RGB565 bytes */
+#define BSP_LCD_SW_SWAP_BYTES       (0)
+
+/* SD card */
+#define BSP_SD_MOSI                 (GPIO_NUM_40)
+#define BSP_SD_MISO                 (GPIO_NUM_38)
+#define BSP_SD_SCLK                 (GPIO_NUM_39)
+#define BSP_SD_CS                   (GPIO_NUM_41)
+
+#endif
+
+/* Both boards: BGR ST7796 with 8-bit commands */
+#define BSP_LCD_COLOR_SPACE         (ESP_LCD_COLOR_SPACE_BGR)
+#define BSP_LCD_RGB_ENDIAN          (LCD_RGB_ENDIAN_BGR)
+#define LCD_CMD_BITS                8
+#define LCD_PARAM_BITS              8
+
+/* Lines of each of the two DMA draw buffers */
+#if CONFIG_BSP_DISPLAY_LOW_MEMORY
+#define BSP_LCD_DRAW_BUF_LINES      CONFIG_BSP_DISPLAY_LOW_MEMORY_BUF_LINES
+#else
+#define BSP_LCD_DRAW_BUF_LINES      (100)
+#endif
@@ -32,6 +32,7 @@ SOFTWARE.
 
 #pragma once
 #include "esp_lcd_types.h"
+#include "bsp/board.h"
 
 /* LCD color formats */
 #define ESP_LCD_COLOR_FORMAT_RGB565    (1)
@@ -46,14 +47,7 @@ SOFTWARE.
 /* LCD display color bits */
 #define BSP_LCD_BITS_PER_PIXEL      (16)
 
-/* LCD display color space */
-#define BSP_LCD_COLOR_SPACE         (ESP_LCD_COLOR_SPACE_BGR)
-
-/* LCD definition */
-#define BSP_LCD_H_RES              (320)
-#define BSP_LCD_V_RES              (480)
-
-#define BSP_LCD_PIXEL_CLOCK_HZ     (20 * 1000 * 1000)
+/* LCD display color space, resolution and pixel clock: see bsp/board.h */
 
 #ifdef __cplusplus
 extern "C" {
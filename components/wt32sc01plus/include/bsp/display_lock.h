@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP display lock profiler
+ *
+ * Records how long each call site of bsp_display_lock() waits for the lock and holds it, per calling
+ * task. Holds over CONFIG_BSP_DISPLAY_LOCK_HOLD_WARN_MS are logged at unlock:
+ *
+ *     W (20512) BSP_DLOCK: Display lock held 73 ms by main at 0x42009a1c
+ *     ...
+ *     bsp_display_lock_print(stdout, 5);
+ *
+ * Call sites are the addresses of the bsp_display_lock() calls; idf.py monitor decodes them, or use
+ * `xtensa-esp32s3-elf-addr2line -pfe build/<project>.elf 0x42009a1c`. The LVGL task takes the lock with
+ * lvgl_port_lock() around each lv_timer_handler() pass; the pass is recorded as a hold of the LVGL task at
+ * the site lv_timer_handler, so waits behind it name it as the blocker. BSP modules that take the lock with
+ * lvgl_port_lock() directly are not recorded, waits behind them have a NULL blocker.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_DISPLAY_LOCK_TASK_NAME_LEN  16
+
+/**
+ * @brief Lock statistics of a call site and task
+ */
+typedef struct {
+    const void *site;               /*!< Address of the bsp_display_lock() call, or lv_timer_handler */
+    char task[BSP_DISPLAY_LOCK_TASK_NAME_LEN];  /*!< Calling task */
+    uint32_t locks;                 /*!< Locks taken, nested locks of the holder not counted */
+    uint32_t contended;             /*!< Locks that had to wait */
+    uint32_t timeouts;              /*!< Locks not taken within the timeout */
+    uint32_t long_holds;            /*!< Holds over CONFIG_BSP_DISPLAY_LOCK_HOLD_WARN_MS */
+    uint64_t wait_us_total;         /*!< Time spent waiting */
+    uint32_t wait_us_max;           /*!< Longest wait */
+    const void *blocker;            /*!< Site holding the lock when the longest wait began, lv_timer_handler for
+                                         the LVGL task, NULL if taken with lvgl_port_lock() elsewhere */
+    uint64_t hold_us_total;         /*!< Time the lock was held */
+    uint32_t hold_us_max;           /*!< Longest hold */
+} bsp_display_lock_site_t;
+
+/**
+ * @brief Totals over all call sites
+ */
+typedef struct {
+    uint32_t locks;                 /*!< Locks taken */
+    uint32_t contended;             /*!< Locks that had to wait */
+    uint32_t timeouts;              /*!< Locks not taken within the timeout */
+    uint32_t long_holds;            /*!< Holds over the threshold */
+    uint32_t sites;                 /*!< Call site and task pairs seen */
+    uint32_t dropped;               /*!< Locks not recorded, all CONFIG_BSP_DISPLAY_LOCK_SITES in use */
+} bsp_display_lock_stats_t;
+
+/**
+ * @brief Order of bsp_display_lock_top()
+ */
+typedef enum {
+    BSP_DISPLAY_LOCK_BY_HOLD_MAX,   /*!< Longest hold first */
+    BSP_DISPLAY_LOCK_BY_HOLD_TOTAL, /*!< Most time held first */
+    BSP_DISPLAY_LOCK_BY_WAIT_TOTAL, /*!< Most time waited first */
+} bsp_display_lock_order_t;
+
+/**
+ * @brief Get the totals
+ *
+ * @param[out] stats Totals
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LOCK_PROFILER is not set
+ */
+esp_err_t bsp_display_lock_get_stats(bsp_display_lock_stats_t *stats);
+
+/**
+ * @brief Get the top call sites
+ *
+ * @param[out] sites Call sites
+ * @param[in]  max   Size of sites
+ * @param[in]  order Order of the call sites
+ * @return Number of call sites written, 0 if CONFIG_BSP_DISPLAY_LOCK_PROFILER is not set
+ */
+size_t bsp_display_lock_top(bsp_display_lock_site_t *sites, size_t max, bsp_display_lock_order_t order);
+
+/**
+ * @brief Forget the call sites and clear the totals
+ */
+void bsp_display_lock_reset(void);
+
+/**
+ * @brief Write the totals and the top call sites by longest hold and by time waited as text
+ *
+ * @param[in] f   Open file, e.g. stdout
+ * @param[in] top Call sites listed per order
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_DISPLAY_LOCK_PROFILER is not set
+ *      - ESP_ERR_NO_MEM      No memory for the report
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_display_lock_print(FILE *f, size_t top);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP DMA copy
+ *
+ * Large copies between internal RAM buffers (opaque RGB565 image draws and LVGL layer copies through
+ * bsp_blend_copy_rgb565()) go to the GDMA with esp_async_memcpy. The calling task blocks on the DMA
+ * completion, so the CPU runs other tasks during the copy instead of spinning in memcpy.
+ * Copies below CONFIG_BSP_DMA_COPY_MIN_BYTES, copies from flash or PSRAM and unaligned copies use memcpy.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief DMA copy statistics
+ */
+typedef struct {
+    uint32_t dma_copies;        /*!< Copies done by the DMA */
+    uint64_t dma_bytes;         /*!< Bytes copied by the DMA */
+    uint32_t cpu_copies;        /*!< Copies done with memcpy: small, unaligned, not DMA capable or DMA busy */
+    uint64_t cpu_bytes;         /*!< Bytes copied with memcpy */
+    uint64_t wait_us;           /*!< Time the callers were blocked on the DMA, free for other tasks */
+} bsp_dma_copy_stats_t;
+
+/**
+ * @brief Install the async memcpy driver
+ *
+ * Called by the first bsp_dma_copy_rows(), call it at start to keep the allocation out of a frame.
+ *
+ * @return
+ *      - ESP_OK              On success, or already installed
+ *      - ESP_ERR_NOT_SUPPORTED No GDMA on this chip or CONFIG_BSP_DMA_COPY disabled
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ *      - Other               esp_async_memcpy_install() errors
+ */
+esp_err_t bsp_dma_copy_init(void);
+
+/**
+ * @brief Copy rows of bytes and wait until done
+ *
+ * Rows are copied as one transfer when both strides equal the row size.
+ *
+ * @param[out] dest        First destination row
+ * @param[in]  dest_stride Bytes between destination rows
+ * @param[in]  src         First source row
+ * @param[in]  src_stride  Bytes between source rows
+ * @param[in]  row_bytes   Bytes per row
+ * @param[in]  rows        Number of rows
+ */
+void bsp_dma_copy_rows(void *dest, int32_t dest_stride, const void *src, int32_t src_stride,
+                       size_t row_bytes, int32_t rows);
+
+/**
+ * @brief Get the statistics since start
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_dma_copy_get_stats(bsp_dma_copy_stats_t *stats);
+
+/**
+ * @brief Compare memcpy with the DMA copy on a full-width block of RGB565 lines
+ *
+ * Prints the throughput of both and the part of the DMA copy time the CPU was free.
+ *
+ * @param[in] f Output stream
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED DMA copy not available
+ *      - ESP_ERR_NO_MEM      Buffers could not be allocated
+ *      - ESP_FAIL            Write error or the DMA copy differs from the source
+ */
+esp_err_t bsp_dma_copy_bench(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
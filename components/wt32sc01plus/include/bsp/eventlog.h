@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP event log
+ *
+ * Append-only alarm/event log stored on the uSD card.
+ *
+ * Records are fixed size binary entries in `<base>.log`. Every CONFIG_BSP_EVENTLOG_BLOCK_RECORDS records
+ * an index entry (time range and severity mask of the block) is written to `<base>.idx`. The index is
+ * kept in RAM, so a paged query only touches the blocks that can contain matching rows.
+ * Torn records at the tail of the log (power loss during write) are dropped on bsp_eventlog_open().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maximum text length stored with each record (including terminating zero) */
+#define BSP_EVENTLOG_TEXT_LEN       (30)
+
+/* Cursor value to start a query from the newest record */
+#define BSP_EVENTLOG_CURSOR_NEWEST  (UINT32_MAX)
+
+/* Severity mask matching all severities */
+#define BSP_EVENTLOG_SEVERITY_ALL   (0xFF)
+
+/**
+ * @brief Event severity
+ */
+typedef enum {
+    BSP_EVENTLOG_DEBUG = 0,
+    BSP_EVENTLOG_INFO,
+    BSP_EVENTLOG_WARNING,
+    BSP_EVENTLOG_ALARM,
+    BSP_EVENTLOG_CRITICAL,
+} bsp_eventlog_severity_t;
+
+/**
+ * @brief Event log record
+ */
+typedef struct {
+    uint32_t seq;                           /*!< Sequence number, index of the record in the log */
+    uint64_t timestamp_ms;                  /*!< Timestamp in milliseconds (Unix time) */
+    uint16_t code;                          /*!< Application defined event code */
+    uint8_t  severity;                      /*!< bsp_eventlog_severity_t */
+    char     text[BSP_EVENTLOG_TEXT_LEN];   /*!< Zero terminated description */
+} bsp_eventlog_record_t;
+
+/**
+ * @brief Event log query filter
+ */
+typedef struct {
+    uint64_t from_ms;           /*!< Oldest timestamp to return (inclusive) */
+    uint64_t to_ms;             /*!< Newest timestamp to return (inclusive), UINT64_MAX for no limit */
+    uint8_t  severity_mask;     /*!< Bit (1 << severity) set for each severity to return */
+} bsp_eventlog_filter_t;
+
+/**
+ * @brief Open (or create) the event log
+ *
+ * Validates the tail of the log, drops torn records and rebuilds missing index entries.
+ * The uSD card must be mounted, see bsp_sdcard_mount().
+ *
+ * @param[in] base_path Path without extension, e.g. BSP_SD_MOUNT_POINT "/events"
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Log already open
+ *      - ESP_ERR_NO_MEM      Not enough memory for the index
+ *      - ESP_FAIL            File could not be opened
+ */
+esp_err_t bsp_eventlog_open(const char *base_path);
+
+/**
+ * @brief Flush and close the event log
+ */
+esp_err_t bsp_eventlog_close(void);
+
+/**
+ * @brief Append one record
+ *
+ * @param[in]  timestamp_ms Timestamp in milliseconds, 0 to use the current system time
+ * @param[in]  severity     Record severity
+ * @param[in]  code         Application defined code
+ * @param[in]  text         Description, truncated to BSP_EVENTLOG_TEXT_LEN - 1 characters (may be NULL)
+ * @param[out] ret_seq      Sequence number of the new record (may be NULL)
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Log is not open
+ *      - ESP_ERR_NO_MEM      No memory to extend the index, the record is not stored
+ *      - ESP_FAIL            Write failed
+ *
+ * @note A failed index write does not fail the append, the entry is retried with the next block
+ *       and rebuilt by bsp_eventlog_open() at the latest.
+ */
+esp_err_t bsp_eventlog_append(uint64_t timestamp_ms, bsp_eventlog_severity_t severity, uint16_t code, const char *text, uint32_t *ret_seq);
+
+/**
+ * @brief Read one page of records, newest first
+ *
+ * Only records with sequence number lower than `cursor` are searched. Pass BSP_EVENTLOG_CURSOR_NEWEST
+ * for the first page and the returned `cursor` for the next (older) page. Cursor 0 means there are
+ * no older records.
+ *
+ * @param[in]     filter   Time window and severity filter (NULL for all records)
+ * @param[in,out] cursor   Position to continue from
+ * @param[out]    rows     Output rows
+ * @param[in]     max_rows Capacity of `rows`
+ * @param[out]    ret_rows Number of rows written
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Log is not open
+ *      - ESP_FAIL            Read failed
+ */
+esp_err_t bsp_eventlog_query(const bsp_eventlog_filter_t *filter, uint32_t *cursor,
+                             bsp_eventlog_record_t *rows, size_t max_rows, size_t *ret_rows);
+
+/**
+ * @brief Number of records in the log
+ */
+uint32_t bsp_eventlog_count(void);
+
+/**
+ * @brief Force buffered records to the card
+ */
+esp_err_t bsp_eventlog_sync(void);
+
+#ifdef __cplusplus
+}
+#endif
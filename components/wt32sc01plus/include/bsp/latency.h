@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP touch-to-photon latency
+ *
+ * Measures how long a touch takes to reach the panel. The FT5x06 interrupt on BSP_LCD_TP_INT is
+ * timestamped and followed through the LVGL input read, the first invalidation after it, the display
+ * refresh and the end of the transfer of the last flushed area. Touches that change nothing on the
+ * screen are counted but not measured; use the marker to measure every touch:
+ *
+ *     bsp_latency_set_marker(true);    // a square in the top right corner toggles on each touch
+ *     ...touch the screen...
+ *     bsp_latency_print(stdout);
+ *
+ * The marker also gives a visible flash for an external photodiode or high-speed camera.
+ * The pipeline model is in priv_include/bsp_latency_model.h; tools/latency_sim.c runs it on Linux
+ * with simulated touch and flush timing.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_LATENCY_BUCKETS     32
+
+/**
+ * @brief Stages of a touch, each from the end of the previous one
+ */
+typedef enum {
+    BSP_LATENCY_STAGE_READ,         /*!< Touch interrupt to the end of the LVGL input read */
+    BSP_LATENCY_STAGE_PROCESS,      /*!< Input read to the first invalidation */
+    BSP_LATENCY_STAGE_REFR_WAIT,    /*!< Invalidation to the start of the refresh */
+    BSP_LATENCY_STAGE_RENDER,       /*!< Refresh start to the last area handed to the panel driver */
+    BSP_LATENCY_STAGE_FLUSH,        /*!< Transfer of the last area to the panel */
+    BSP_LATENCY_STAGE_MAX,
+} bsp_latency_stage_t;
+
+/**
+ * @brief Latency statistics
+ */
+typedef struct {
+    uint32_t events;                /*!< Touches measured */
+    uint32_t no_change;             /*!< Touches that did not change the screen */
+    uint32_t overlapped;            /*!< Touch interrupts while a touch was measured */
+    uint32_t bucket_us;             /*!< Width of a histogram bucket */
+    uint32_t hist[BSP_LATENCY_BUCKETS];     /*!< Touch-to-photon latency, the last bucket is open ended */
+    uint32_t total_min_us;          /*!< Shortest touch-to-photon latency */
+    uint32_t total_avg_us;          /*!< Average touch-to-photon latency */
+    uint32_t total_max_us;          /*!< Longest touch-to-photon latency */
+    uint32_t stage_avg_us[BSP_LATENCY_STAGE_MAX];   /*!< Average of each stage */
+    uint32_t stage_max_us[BSP_LATENCY_STAGE_MAX];   /*!< Longest of each stage */
+} bsp_latency_stats_t;
+
+/**
+ * @brief Get the statistics since start or the last reset
+ *
+ * @param[out] stats Statistics
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_LATENCY is not set
+ */
+esp_err_t bsp_latency_get_stats(bsp_latency_stats_t *stats);
+
+/**
+ * @brief Clear the statistics
+ */
+void bsp_latency_reset(void);
+
+/**
+ * @brief Write the histogram, percentiles and stage times as text
+ *
+ * @param[in] f Open file, e.g. stdout
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_LATENCY is not set
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_latency_print(FILE *f);
+
+/**
+ * @brief Show or hide the marker that toggles on each touch
+ *
+ * Takes the display lock.
+ *
+ * @param[in] enable Show the marker
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Display not started
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_LATENCY is not set
+ */
+esp_err_t bsp_latency_set_marker(bool enable);
+
+#ifdef __cplusplus
+}
+#endif
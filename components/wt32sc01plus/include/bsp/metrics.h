@@ -0,0 +1,138 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP display metrics
+ *
+ * Headless replacement for the LVGL perf/mem monitor overlays: nothing is drawn, so the measured
+ * frames are the frames the application renders. Once per CONFIG_BSP_METRICS_PERIOD_MS a sample is
+ * taken in the LVGL task and stored in a fixed-size ring of CONFIG_BSP_METRICS_DEPTH samples.
+ * After two samples without frames sampling pauses until the next frame, so an idle screen shows
+ * up as a gap in the timestamps and costs no wakeups.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Binary dump magic, "BSPM" little-endian
+ */
+#define BSP_METRICS_MAGIC       0x4D505342
+#define BSP_METRICS_VERSION     1
+
+/**
+ * @brief One metrics sample, 32 bytes, no padding
+ *
+ * The binary dump writes the samples in this layout (little-endian).
+ */
+typedef struct {
+    uint32_t timestamp_ms;      /*!< End of the sample period, since boot */
+    uint32_t render_us_avg;     /*!< Average time to render one frame */
+    uint32_t render_us_max;     /*!< Longest frame in the period */
+    uint32_t flushed_bytes;     /*!< Pixel data sent to the panel in the period */
+    uint32_t lvgl_mem_used;     /*!< LVGL heap in use, bytes */
+    uint32_t heap_free;         /*!< Free internal heap, bytes */
+    uint16_t frames;            /*!< Frames rendered in the period */
+    uint16_t flushes;           /*!< Flushed areas in the period */
+    uint16_t fps_x10;           /*!< Rendered frames per second x10 */
+    uint8_t lvgl_cpu_pct;       /*!< LVGL task load, 100 - lv_timer_get_idle() */
+    uint8_t lvgl_mem_frag_pct;  /*!< LVGL heap fragmentation */
+} bsp_metrics_sample_t;
+
+/**
+ * @brief Header of the binary dump, followed by `count` samples, oldest first
+ */
+typedef struct {
+    uint32_t magic;             /*!< BSP_METRICS_MAGIC */
+    uint8_t version;            /*!< BSP_METRICS_VERSION */
+    uint8_t sample_size;        /*!< sizeof(bsp_metrics_sample_t) */
+    uint16_t count;             /*!< Number of samples */
+    uint32_t period_ms;         /*!< Sample period */
+} bsp_metrics_dump_header_t;
+
+/**
+ * @brief Start collecting metrics of a display
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_METRICS_ENABLE is set.
+ *
+ * @param[in] disp LVGL display
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already started
+ *      - ESP_ERR_NO_MEM      Timer or flush hook could not be added
+ */
+esp_err_t bsp_metrics_start(lv_display_t *disp);
+
+/**
+ * @brief Get the most recent sample
+ *
+ * @param[out] sample Sample
+ * @return true if a sample was available
+ */
+bool bsp_metrics_get_latest(bsp_metrics_sample_t *sample);
+
+/**
+ * @brief Copy the most recent samples, oldest first
+ *
+ * Can be called from any task.
+ *
+ * @param[out] samples Destination
+ * @param[in]  max     Size of samples
+ * @return Number of samples copied
+ */
+size_t bsp_metrics_read(bsp_metrics_sample_t *samples, size_t max);
+
+/**
+ * @brief Write the ring as CSV with a header line, e.g. to stdout or a file on uSD card
+ *
+ * @param[in] f Open file
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_metrics_dump_csv(FILE *f);
+
+/**
+ * @brief Write the ring as bsp_metrics_dump_header_t followed by the raw samples
+ *
+ * @param[in] f Open file, opened in binary mode
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_metrics_dump_binary(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
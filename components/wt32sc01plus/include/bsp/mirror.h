@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP display mirror
+ *
+ * Streams the screen content over a serial transport (UART or USB Serial/JTAG) so the screen of a
+ * unit in the field can be watched from a PC with tools/mirror_viewer.py.
+ *
+ * A flush hook copies each area flushed by LVGL into a shadow framebuffer and marks the 16x16 tiles
+ * it covers as dirty. A low priority task sends the dirty tiles whose content changed since they were
+ * last sent, run length encoded. Frames are paced to the transport bandwidth: while the transport is
+ * busy further refreshes only accumulate dirty tiles, so the display pipeline never waits for it.
+ *
+ * Stream format, all values little endian:
+ *
+ *     packet  : 0xA5 0x5A type:u8 length:u16 payload[length] crc:u16 (CRC16 of payload, esp_rom_crc16_le)
+ *     type 1  : frame begin   width:u16 height:u16 frame:u32
+ *     type 2  : tile          x:u16 y:u16 w:u8 h:u8 { count-1:u8 rgb565:u16 }...
+ *     type 3  : frame end     frame:u32
+ *
+ * When the transport is the console, log output is interleaved with packets, the viewer skips it.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Display mirror statistics
+ */
+typedef struct {
+    uint32_t refreshes;         /*!< Display refreshes seen by the flush hook */
+    uint32_t frames_sent;       /*!< Frames sent, refreshes - frames_sent were merged into later frames */
+    uint32_t tiles_sent;        /*!< Tiles sent */
+    uint32_t tiles_unchanged;   /*!< Flushed tiles not sent because their content did not change */
+    uint64_t tile_bytes_raw;    /*!< Size of the sent tiles before encoding */
+    uint64_t bytes_sent;        /*!< Bytes written to the transport */
+    uint32_t hook_us_max;       /*!< Longest time the flush hook added to a flush */
+    uint32_t hook_us_avg;       /*!< Average time the flush hook added to a flush */
+    uint32_t frame_us_last;     /*!< Time to encode and write the last frame, in the mirror task */
+} bsp_mirror_stats_t;
+
+/**
+ * @brief Start mirroring the display started with bsp_display_start()
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already started or display not started
+ *      - ESP_ERR_NO_MEM      Not enough memory for the shadow framebuffer
+ *      - Else                Transport driver failure
+ */
+esp_err_t bsp_mirror_start(void);
+
+/**
+ * @brief Stop mirroring and free the shadow framebuffer
+ */
+esp_err_t bsp_mirror_stop(void);
+
+/**
+ * @brief Get display mirror statistics
+ */
+void bsp_mirror_get_stats(bsp_mirror_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
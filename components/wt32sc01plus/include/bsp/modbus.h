@@ -0,0 +1,245 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP Modbus RTU
+ *
+ * Modbus RTU over the board RS485 port (see bsp/rs485.h).
+ *
+ * The master polls a fixed table of registers, each at its own rate. Registers of the same slave that are
+ * close to each other and due at about the same time are merged into a single read request.
+ * Polled values are kept in a register cache which can be read from any task without blocking.
+ *
+ * The slave answers requests for a holding and an input register map. Responses are built in place from the
+ * map by the slave task as soon as the UART reports the end of a request frame. Application code updates the
+ * map with bsp_modbus_slave_set(), which is atomic with respect to responses and never blocks on the display.
+ * Master and slave share the RS485 port, only one of them can run at a time.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "bsp/rs485.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Modbus register type
+ */
+typedef enum {
+    BSP_MODBUS_HOLDING = 0x03,  /*!< Holding register, read with function 0x03 */
+    BSP_MODBUS_INPUT = 0x04,    /*!< Input register, read with function 0x04 */
+} bsp_modbus_reg_type_t;
+
+/**
+ * @brief Polled register
+ */
+typedef struct {
+    uint8_t  slave;                 /*!< Slave address 1..247 */
+    bsp_modbus_reg_type_t type;     /*!< Register type */
+    uint16_t address;               /*!< Register address */
+    uint32_t period_ms;             /*!< Poll period */
+} bsp_modbus_poll_t;
+
+/**
+ * @brief Register change callback
+ *
+ * Called from the Modbus master task when a polled value changes or is read for the first time.
+ * Must not block; use the display update channel or a queue to hand the value over to the UI.
+ *
+ * @param[in] poll_id  Index of the register in the poll table passed to bsp_modbus_master_start()
+ * @param[in] value    New value
+ * @param[in] user_ctx User context from the configuration
+ */
+typedef void (*bsp_modbus_change_cb_t)(size_t poll_id, uint16_t value, void *user_ctx);
+
+/**
+ * @brief Modbus master configuration structure
+ */
+typedef struct {
+    bsp_rs485_config_t rs485;           /*!< RS485 port configuration */
+    uint32_t response_timeout_ms;       /*!< Time to wait for a response */
+    uint16_t max_merge_gap;             /*!< Max. number of unused registers read to merge two polled registers */
+    bsp_modbus_change_cb_t on_change;   /*!< Register change callback (may be NULL) */
+    void *user_ctx;                     /*!< User context passed to on_change */
+} bsp_modbus_master_config_t;
+
+/**
+ * @brief Modbus master statistics
+ */
+typedef struct {
+    uint32_t requests;          /*!< Read requests sent */
+    uint32_t writes;            /*!< Write requests sent */
+    uint32_t timeouts;          /*!< Requests without response */
+    uint32_t crc_errors;        /*!< Responses with bad CRC or line errors */
+    uint32_t exceptions;        /*!< Exception responses */
+    uint32_t bad_responses;     /*!< Responses from another slave, or with another function or length */
+    uint32_t merged;            /*!< Polled registers served by a request for another register */
+    uint32_t late;              /*!< Polls served more than one period late */
+    uint32_t last_rtt_us;       /*!< Request to response time of the last transaction */
+    uint32_t max_rtt_us;        /*!< Worst request to response time */
+} bsp_modbus_master_stats_t;
+
+/**
+ * @brief Start the Modbus master
+ *
+ * Initializes the RS485 port and starts the poll task. The poll table is copied.
+ *
+ * @param[in] config    Master configuration
+ * @param[in] polls     Poll table
+ * @param[in] num_polls Number of entries in `polls`
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Master or slave already running
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ */
+esp_err_t bsp_modbus_master_start(const bsp_modbus_master_config_t *config, const bsp_modbus_poll_t *polls, size_t num_polls);
+
+/**
+ * @brief Stop the Modbus master and release the RS485 port
+ */
+esp_err_t bsp_modbus_master_stop(void);
+
+/**
+ * @brief Read a polled register from the cache
+ *
+ * @param[in]  poll_id    Index of the register in the poll table
+ * @param[out] value      Last value read from the slave
+ * @param[out] ret_age_ms Time since the value was read (may be NULL)
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_ARG Invalid poll_id
+ *      - ESP_ERR_NOT_FOUND   Register was not read successfully yet
+ */
+esp_err_t bsp_modbus_master_get(size_t poll_id, uint16_t *value, uint32_t *ret_age_ms);
+
+/**
+ * @brief Queue a write of a single holding register
+ *
+ * Writes are sent before any pending poll. Does not block.
+ *
+ * @return
+ *      - ESP_OK              Write queued
+ *      - ESP_ERR_INVALID_STATE Master not running
+ *      - ESP_ERR_TIMEOUT     Write queue full
+ */
+esp_err_t bsp_modbus_master_write(uint8_t slave, uint16_t address, uint16_t value);
+
+/**
+ * @brief Get master statistics
+ */
+void bsp_modbus_master_get_stats(bsp_modbus_master_stats_t *stats);
+
+/**
+ * @brief Register write callback
+ *
+ * Called from the Modbus slave task after the master wrote holding registers. Must not block.
+ *
+ * @param[in] address  First written register
+ * @param[in] count    Number of written registers
+ * @param[in] user_ctx User context from the configuration
+ */
+typedef void (*bsp_modbus_write_cb_t)(uint16_t address, uint16_t count, void *user_ctx);
+
+/**
+ * @brief Modbus slave configuration structure
+ */
+typedef struct {
+    bsp_rs485_config_t rs485;           /*!< RS485 port configuration */
+    uint8_t  address;                   /*!< Slave address 1..247 */
+    uint16_t holding_base;              /*!< Address of the first holding register */
+    uint16_t num_holding;               /*!< Number of holding registers */
+    uint16_t input_base;                /*!< Address of the first input register */
+    uint16_t num_input;                 /*!< Number of input registers */
+    bsp_modbus_write_cb_t on_write;     /*!< Holding register write callback (may be NULL) */
+    void *user_ctx;                     /*!< User context passed to on_write */
+} bsp_modbus_slave_config_t;
+
+/**
+ * @brief Modbus slave statistics
+ */
+typedef struct {
+    uint32_t requests;              /*!< Valid requests addressed to this slave (or broadcast) */
+    uint32_t foreign;               /*!< Valid requests addressed to other slaves */
+    uint32_t crc_errors;            /*!< Frames with bad CRC or line errors */
+    uint32_t exceptions;            /*!< Exception responses sent */
+    uint32_t tx_errors;             /*!< Responses that failed to transmit, not in the latency */
+    uint32_t last_latency_us;       /*!< End of request to end of response of the last request */
+    uint32_t avg_latency_us;        /*!< Moving average of the response latency */
+    uint32_t max_latency_us;        /*!< Worst response latency */
+} bsp_modbus_slave_stats_t;
+
+/**
+ * @brief Start the Modbus slave
+ *
+ * Initializes the RS485 port, allocates the register map (all registers 0) and starts the slave task.
+ *
+ * @param[in] config Slave configuration
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Master or slave already running
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ */
+esp_err_t bsp_modbus_slave_start(const bsp_modbus_slave_config_t *config);
+
+/**
+ * @brief Stop the Modbus slave and release the RS485 port
+ */
+esp_err_t bsp_modbus_slave_stop(void);
+
+/**
+ * @brief Update registers of the slave map
+ *
+ * All `count` registers change at once, a concurrent read request sees either the old or the new values.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_ARG Range outside of the map
+ *      - ESP_ERR_INVALID_STATE Slave not running
+ */
+esp_err_t bsp_modbus_slave_set(bsp_modbus_reg_type_t type, uint16_t address, const uint16_t *values, size_t count);
+
+/**
+ * @brief Read registers of the slave map
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_ARG Range outside of the map
+ *      - ESP_ERR_INVALID_STATE Slave not running
+ */
+esp_err_t bsp_modbus_slave_get(bsp_modbus_reg_type_t type, uint16_t address, uint16_t *values, size_t count);
+
+/**
+ * @brief Get slave statistics
+ */
+void bsp_modbus_slave_get_stats(bsp_modbus_slave_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP touch monkey benchmark
+ *
+ * Replaces the read callback of an input device with a seeded pseudo random touch sequence (taps,
+ * long presses and drags) and measures the render path while it runs: frame render time,
+ * input-to-render latency, heap high-water mark and failed allocations.
+ *
+ * The sequence depends only on the seed and the number of input device reads, not on wall time.
+ * With `steps` set and a fixed LVGL tick two runs with the same seed inject the same touches and render
+ * the same frames, so regressions can be bisected. The sequence and the percentile histogram build on
+ * Linux as well, tools/monkey_check.c replays a seed there read by read.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Monkey configuration
+ */
+typedef struct {
+    lv_indev_t *indev;          /*!< Pointer input device to drive, NULL for bsp_display_get_input_dev() */
+    uint32_t seed;              /*!< Sequence seed */
+    uint32_t steps;             /*!< Stop after this many input device reads, 0 to use duration_ms */
+    uint32_t duration_ms;       /*!< Stop after this time when steps is 0 */
+    uint8_t press_pct;          /*!< Chance to start a touch on an idle read, 0 for the default (25) */
+    uint8_t hold_max;           /*!< Longest touch in reads, 0 for the default (20) */
+} bsp_monkey_config_t;
+
+/**
+ * @brief Latency distribution, microseconds
+ *
+ * Percentiles come from a log-linear histogram and are accurate to about 6 %.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} bsp_monkey_dist_t;
+
+/**
+ * @brief Monkey benchmark report
+ */
+typedef struct {
+    uint32_t seed;              /*!< Seed used */
+    uint32_t steps;             /*!< Input device reads */
+    uint32_t touches;           /*!< Touches injected */
+    uint32_t duration_ms;       /*!< Wall time of the run */
+    bsp_monkey_dist_t frame;    /*!< Frame render time */
+    bsp_monkey_dist_t latency;  /*!< Press/release to the end of the next rendered frame */
+    uint32_t unrendered;        /*!< Inputs still waiting for a frame when the next input came */
+    uint32_t lvgl_mem_peak;     /*!< LVGL heap high-water mark, since LVGL started */
+    uint32_t heap_peak;         /*!< Largest drop of free heap since the start */
+    uint32_t alloc_failed;      /*!< Failed LVGL allocations (lv_malloc(), lv_realloc()) during the run */
+} bsp_monkey_report_t;
+
+/**
+ * @brief Start the monkey, returns immediately
+ *
+ * Must be called with the display lock held or from LVGL context. The input device is restored
+ * when the run ends, poll bsp_monkey_is_running().
+ *
+ * @param[in] config Configuration
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already running or no input device
+ *      - ESP_ERR_NO_MEM      No memory for the histograms
+ */
+esp_err_t bsp_monkey_start(const bsp_monkey_config_t *config);
+
+/**
+ * @brief Check if the monkey is running
+ */
+bool bsp_monkey_is_running(void);
+
+/**
+ * @brief Get the report of the last run
+ *
+ * @param[out] report Report
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Still running or no run
+ */
+esp_err_t bsp_monkey_get_report(bsp_monkey_report_t *report);
+
+/**
+ * @brief Run the monkey on the BSP display, blocks until it is done and logs the report
+ *
+ * Takes the display lock, do not call it from LVGL context.
+ *
+ * @param[in]  config Configuration
+ * @param[out] report Report, can be NULL
+ * @return See bsp_monkey_start()
+ */
+esp_err_t bsp_monkey_run(const bsp_monkey_config_t *config, bsp_monkey_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
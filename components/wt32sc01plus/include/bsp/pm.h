@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP power management
+ *
+ * With CONFIG_BSP_PM the CPU runs at CONFIG_BSP_PM_MIN_FREQ_MHZ and may enter automatic light sleep
+ * unless a PM lock asks for more. The BSP holds its locks only while the work needs them:
+ * - display: CPU at maximum frequency from the start of rendering to the end of the refresh,
+ *   the i80 driver keeps the bus clock alive until its DMA transfer is done
+ * - touch: APB at maximum (no light sleep) while the panel is touched, a touch wakes the chip
+ *   from light sleep through the controller interrupt
+ * - storage: APB at maximum during SD card mount/unmount and BSP file writes, wrap application
+ *   SD card bursts with bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE) and bsp_pm_lock_release()
+ * - backlight: no light sleep while the backlight is dimmed, only with ESP-IDF older than 5.4;
+ *   from 5.4 the backlight PWM keeps running in light sleep
+ *
+ * Without CONFIG_BSP_PM the functions do nothing and the CPU stays at CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief BSP PM locks
+ */
+typedef enum {
+    BSP_PM_LOCK_DISPLAY = 0,    /*!< CPU at maximum frequency */
+    BSP_PM_LOCK_TOUCH,          /*!< APB at maximum frequency, no light sleep */
+    BSP_PM_LOCK_STORAGE,        /*!< APB at maximum frequency, no light sleep */
+    BSP_PM_LOCK_BACKLIGHT,      /*!< No light sleep */
+    BSP_PM_LOCK_MAX,
+} bsp_pm_lock_t;
+
+/**
+ * @brief Usage of a BSP PM lock since bsp_pm_init()
+ */
+typedef struct {
+    uint32_t count;             /*!< Times acquired */
+    uint64_t held_us;           /*!< Time held */
+} bsp_pm_lock_stats_t;
+
+/**
+ * @brief Configure dynamic frequency scaling and light sleep, create the BSP PM locks
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_PM is set, call it earlier to scale down before.
+ * Does nothing when already initialized.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_PM not set
+ *      - ESP_ERR_INVALID_ARG Frequencies not supported by the chip
+ */
+esp_err_t bsp_pm_init(void);
+
+/**
+ * @brief Acquire a BSP PM lock
+ *
+ * Locks are counted, every acquire needs a release. Not callable from an ISR.
+ *
+ * @param[in] lock Lock
+ */
+void bsp_pm_lock_acquire(bsp_pm_lock_t lock);
+
+/**
+ * @brief Release a lock acquired with bsp_pm_lock_acquire()
+ *
+ * @param[in] lock Lock
+ */
+void bsp_pm_lock_release(bsp_pm_lock_t lock);
+
+/**
+ * @brief Get the usage of the BSP PM locks
+ *
+ * @param[out] stats Usage of each lock, BSP_PM_LOCK_MAX entries
+ */
+void bsp_pm_get_stats(bsp_pm_lock_stats_t stats[BSP_PM_LOCK_MAX]);
+
+/**
+ * @brief Print the BSP lock usage and the esp_pm locks
+ *
+ * With CONFIG_BSP_PM_MEASURE the esp_pm part includes the time spent in each mode and at
+ * each CPU frequency, light sleep included.
+ *
+ * @param[in] f Output stream
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE bsp_pm_init() not called
+ */
+esp_err_t bsp_pm_dump(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP profiler
+ *
+ * Backend of the LVGL profiler (LV_PROFILER_BEGIN/END in lv_conf.h) and of the BSP stages: flush,
+ * touch read and brightness. Every begin/end is an event with an esp_timer microsecond timestamp,
+ * written lock-free into a buffer of the core it runs on. The buffers are exported in Chrome trace
+ * event format, open them in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Enabled with CONFIG_BSP_PROFILER, otherwise the macros compile to nothing.
+ * This header is included by LVGL itself, it must not include lvgl.h.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_BSP_PROFILER
+#define BSP_PROFILER_BEGIN_TAG(tag) bsp_profiler_write((tag), 'B')
+#define BSP_PROFILER_END_TAG(tag)   bsp_profiler_write((tag), 'E')
+#else
+#define BSP_PROFILER_BEGIN_TAG(tag)
+#define BSP_PROFILER_END_TAG(tag)
+#endif
+#define BSP_PROFILER_BEGIN          BSP_PROFILER_BEGIN_TAG(__func__)
+#define BSP_PROFILER_END            BSP_PROFILER_END_TAG(__func__)
+
+/**
+ * @brief Profiler statistics
+ */
+typedef struct {
+    uint32_t events[2];         /*!< Events recorded per core */
+    uint32_t dropped[2];        /*!< Events lost because the buffer of the core was full */
+    uint32_t capacity;          /*!< Buffer size per core, in events */
+    uint32_t tasks;             /*!< Tasks seen */
+} bsp_profiler_stats_t;
+
+/**
+ * @brief Record one event, use the BSP_PROFILER_* macros instead
+ *
+ * @param[in] tag  Event name, must be a string with static storage (e.g. __func__)
+ * @param[in] type 'B' begin or 'E' end
+ */
+void bsp_profiler_write(const char *tag, char type);
+
+/**
+ * @brief Clear the buffers and start recording
+ *
+ * Buffers are allocated on first use, CONFIG_BSP_PROFILER_BUF_EVENTS per core.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_PROFILER is disabled
+ *      - ESP_ERR_NO_MEM      Buffers could not be allocated
+ */
+esp_err_t bsp_profiler_start(void);
+
+/**
+ * @brief Stop recording, the buffers are kept until the next bsp_profiler_start()
+ */
+void bsp_profiler_stop(void);
+
+/**
+ * @brief Write the recorded events as Chrome trace JSON, e.g. to stdout or a file on uSD card
+ *
+ * One process with one thread per task, so a span stays together when its task migrates between the
+ * cores. ISRs get a thread per core, and every event carries its core in `args`.
+ *
+ * @param[in] f Open file
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Still recording, call bsp_profiler_stop() first
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_profiler_export_chrome(FILE *f);
+
+/**
+ * @brief Get profiler statistics
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_profiler_get_stats(bsp_profiler_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
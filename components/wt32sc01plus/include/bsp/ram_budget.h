@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP RAM budget
+ *
+ * Where the internal RAM went after bsp_display_start() and how much is left for the application.
+ * The BSP part is known at compile time (draw buffers, LVGL heap, LVGL task stack), the rest is read
+ * from the heap allocator.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief RAM budget, in bytes
+ */
+typedef struct {
+    uint32_t draw_buf;              /*!< LVGL draw buffers, DMA capable internal RAM */
+    uint32_t lvgl_heap;             /*!< LVGL heap pool (LV_MEM_SIZE) */
+    uint32_t lvgl_heap_used;        /*!< Part of the LVGL heap in use */
+    uint32_t lvgl_task_stack;       /*!< esp_lvgl_port task stack */
+    uint32_t internal_total;        /*!< Internal heap size */
+    uint32_t internal_free;         /*!< Internal heap free, the headroom for application tasks and buffers */
+    uint32_t internal_min_free;     /*!< Lowest internal_free since boot */
+    uint32_t internal_largest;      /*!< Largest free internal block, limits a single task stack or buffer */
+    uint32_t dma_free;              /*!< DMA capable heap free */
+    uint32_t psram_total;           /*!< PSRAM heap size, 0 without PSRAM */
+} bsp_ram_budget_t;
+
+/**
+ * @brief Get the RAM budget
+ *
+ * @param[out] budget RAM budget
+ */
+void bsp_ram_budget_get(bsp_ram_budget_t *budget);
+
+/**
+ * @brief Print the RAM budget as a table
+ *
+ * @param[in] f Output stream
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_ram_budget_print(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
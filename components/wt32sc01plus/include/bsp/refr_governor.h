@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP refresh-rate governor
+ *
+ * Sets the period of the LVGL refresh timer (and of the animation timer) per frame instead of the
+ * fixed LV_DEF_REFR_PERIOD:
+ * - ACTIVE while animations run, the screen is touched or scrolling (and CONFIG_BSP_REFR_GOVERNOR_HOLD_MS
+ *   after): as fast as the panel bus and the measured frame cost allow
+ * - NORMAL when content changes without animation or touch: LV_DEF_REFR_PERIOD
+ * - IDLE when nothing was invalidated for CONFIG_BSP_REFR_GOVERNOR_STATIC_MS: CONFIG_BSP_REFR_GOVERNOR_IDLE_PERIOD_MS,
+ *   a change is still drawn at once
+ *
+ * The period is never shorter than the measured frame cost plus 25 %, so frames are not scheduled
+ * faster than the render and flush pipeline finishes them.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Governor mode
+ */
+typedef enum {
+    BSP_REFR_MODE_IDLE = 0,
+    BSP_REFR_MODE_NORMAL,
+    BSP_REFR_MODE_ACTIVE,
+    BSP_REFR_MODE_MAX,
+} bsp_refr_mode_t;
+
+/**
+ * @brief Governor statistics
+ */
+typedef struct {
+    bsp_refr_mode_t mode;                       /*!< Current mode */
+    uint32_t period_ms;                         /*!< Current refresh period */
+    uint32_t cost_us;                           /*!< Frame cost estimate (render and flush) */
+    uint32_t min_period_ms;                     /*!< Shortest period, panel and bus limit */
+    uint32_t transitions[BSP_REFR_MODE_MAX];    /*!< Times each mode was entered */
+    uint32_t frames[BSP_REFR_MODE_MAX];         /*!< Frames rendered in each mode */
+    uint32_t time_ms[BSP_REFR_MODE_MAX];        /*!< Time spent in each mode */
+    uint32_t cost_limited;                      /*!< Frames whose period was raised to the frame cost */
+} bsp_refr_governor_stats_t;
+
+/**
+ * @brief Start governing the refresh rate of a display
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_REFR_GOVERNOR is set.
+ *
+ * @param[in] disp  Display
+ * @param[in] indev Pointer input device used to detect touches, can be NULL
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already started
+ */
+esp_err_t bsp_refr_governor_start(lv_display_t *disp, lv_indev_t *indev);
+
+/**
+ * @brief Get the current governor mode
+ */
+bsp_refr_mode_t bsp_refr_governor_get_mode(void);
+
+/**
+ * @brief Get governor statistics
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_refr_governor_get_stats(bsp_refr_governor_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP RS485
+ *
+ * Half-duplex RS485 port of the WT32-SC01 Plus. The transceiver direction is driven by the UART RTS line
+ * (UART_MODE_RS485_HALF_DUPLEX), so no software direction switching is needed.
+ *
+ *     RXD 1
+ *     RTS 2
+ *     TXD 42
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+/* RS485 */
+#define BSP_RS485_RXD           (1)
+#define BSP_RS485_RTS           (2)
+#define BSP_RS485_TXD           (42)
+#define BSP_RS485_UART_NUM      CONFIG_BSP_RS485_UART_NUM
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief RS485 parity
+ */
+typedef enum {
+    BSP_RS485_PARITY_NONE = 0,
+    BSP_RS485_PARITY_EVEN,
+    BSP_RS485_PARITY_ODD,
+} bsp_rs485_parity_t;
+
+/**
+ * @brief RS485 configuration structure
+ */
+typedef struct {
+    uint32_t baud_rate;             /*!< Baud rate, e.g. 19200 */
+    bsp_rs485_parity_t parity;      /*!< Parity, 8 data bits and 1 stop bit are always used */
+} bsp_rs485_config_t;
+
+/**
+ * @brief Install the UART driver in RS485 half-duplex mode
+ *
+ * @param[in] config RS485 configuration
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already initialized
+ *      - Else                UART driver failure
+ */
+esp_err_t bsp_rs485_init(const bsp_rs485_config_t *config);
+
+/**
+ * @brief Uninstall the UART driver
+ */
+esp_err_t bsp_rs485_deinit(void);
+
+/**
+ * @brief Transmit a frame and wait until the last bit left the line driver
+ *
+ * Waits for the frame time at the configured baud rate plus a margin.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_FAIL            Write failed
+ *      - ESP_ERR_TIMEOUT     The transmission did not end in time
+ */
+esp_err_t bsp_rs485_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Receive one frame
+ *
+ * Waits up to `timeout_ms` for the first byte, then collects bytes until the line is idle for
+ * one inter-frame gap (t3.5).
+ *
+ * @param[out] buf        Frame buffer
+ * @param[in]  size       Size of `buf`
+ * @param[in]  timeout_ms Time to wait for the first byte
+ * @param[out] ret_len    Received length, 0 on timeout
+ * @return
+ *      - ESP_OK              Frame received or timeout (`*ret_len` == 0)
+ *      - ESP_ERR_INVALID_SIZE Frame did not fit into `buf` or the receive buffer overflowed
+ *      - ESP_ERR_INVALID_RESPONSE Parity or framing error on the line
+ */
+esp_err_t bsp_rs485_read_frame(uint8_t *buf, size_t size, uint32_t timeout_ms, size_t *ret_len);
+
+/**
+ * @brief Drop all received and not yet read data
+ */
+void bsp_rs485_flush_input(void);
+
+/**
+ * @brief Baud rate the port was initialized with, 0 if not initialized
+ */
+uint32_t bsp_rs485_get_baud_rate(void);
+
+#ifdef __cplusplus
+}
+#endif
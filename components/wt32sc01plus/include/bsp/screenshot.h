@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP screenshot
+ *
+ * bsp_screenshot_save() redraws the screen through the regular LVGL partial draw buffers and writes
+ * each flushed band straight into a BMP file (16 bit RGB565, top-down), so no second frame buffer
+ * is needed. The panel shows the same content while it is captured.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Screenshot capture report
+ */
+typedef struct {
+    uint32_t capture_ms;        /*!< Time to render and write the screenshot */
+    uint32_t file_size;         /*!< BMP file size in bytes */
+    uint32_t bands;             /*!< Flushed areas written to the file */
+    uint32_t heap_peak;         /*!< Largest amount of heap used by the capture (file buffers) */
+} bsp_screenshot_info_t;
+
+/**
+ * @brief Save the active screen as BMP file, e.g. BSP_SD_MOUNT_POINT "/screen.bmp"
+ *
+ * Takes the display lock. Do not call it from draw or refresh event callbacks.
+ *
+ * @param[in]  path     File path
+ * @param[out] ret_info Capture report, can be NULL
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Display not started
+ *      - ESP_FAIL            File could not be written
+ */
+esp_err_t bsp_screenshot_save(const char *path, bsp_screenshot_info_t *ret_info);
+
+#ifdef __cplusplus
+}
+#endif
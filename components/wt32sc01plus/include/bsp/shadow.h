@@ -0,0 +1,140 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP shadow cache
+ *
+ * Card shadows drawn from a cache instead of the shadow_width style. LVGL recomputes the blurred corner
+ * of a style shadow every time the widget is redrawn (one corner is cached per draw unit, see
+ * CONFIG_BSP_LV_SHADOW_CACHE_SIZE). bsp_shadow_attach() draws the widget shadow as an A8 mask image
+ * recolored with the shadow color. The mask is rendered once per (size, radius, width, spread) and kept
+ * in PSRAM, so cards of the same size share it and redraws only blend it.
+ *
+ * The warm cache can be saved to SPIFFS or the uSD card and loaded at boot before the UI is built, so
+ * even the first frame does not compute shadows:
+ *
+ *     bsp_shadow_cache_load(BSP_SPIFFS_MOUNT_POINT "/shadows.bin");
+ *     ...
+ *     bsp_shadow_attach(card, &(bsp_shadow_cfg_t){ .width = 20, .ofs_y = 4, .color = lv_color_black(), .opa = LV_OPA_30 });
+ *     ...
+ *     bsp_shadow_cache_save(BSP_SPIFFS_MOUNT_POINT "/shadows.bin");
+ *
+ * The shadow is drawn under the whole widget, use it with an opaque background. Call the functions
+ * with the display lock held.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Shadow of a widget, the widget radius is used as shadow radius
+ */
+typedef struct {
+    int32_t width;          /*!< Blur width, as the shadow_width style */
+    int32_t spread;         /*!< Grows (or shrinks if negative) the shadow, as shadow_spread */
+    int32_t ofs_x;          /*!< Horizontal offset */
+    int32_t ofs_y;          /*!< Vertical offset */
+    lv_color_t color;       /*!< Shadow color */
+    lv_opa_t opa;           /*!< Shadow opacity */
+} bsp_shadow_cfg_t;
+
+/**
+ * @brief Shadow cache statistics
+ */
+typedef struct {
+    uint32_t hits;          /*!< Shadows drawn from the cache */
+    uint32_t misses;        /*!< Shadows rendered */
+    uint32_t evictions;     /*!< Masks dropped to stay within CONFIG_BSP_SHADOW_CACHE_KB */
+    uint32_t restored;      /*!< Masks loaded by bsp_shadow_cache_load() */
+    uint32_t entries;       /*!< Masks in the cache */
+    uint32_t bytes;         /*!< Memory used by the masks */
+} bsp_shadow_stats_t;
+
+/**
+ * @brief Draw a cached shadow under a widget
+ *
+ * Attaching again replaces the configuration. The configuration is copied.
+ *
+ * @param[in] obj Widget
+ * @param[in] cfg Shadow
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ */
+esp_err_t bsp_shadow_attach(lv_obj_t *obj, const bsp_shadow_cfg_t *cfg);
+
+/**
+ * @brief Stop drawing the shadow of a widget
+ *
+ * @param[in] obj Widget
+ */
+void bsp_shadow_detach(lv_obj_t *obj);
+
+/**
+ * @brief Save the cached masks
+ *
+ * @param[in] path File path
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_FAIL            File could not be written
+ */
+esp_err_t bsp_shadow_cache_save(const char *path);
+
+/**
+ * @brief Load masks saved by bsp_shadow_cache_save()
+ *
+ * Masks already in the cache are kept, loading stops when the cache is full.
+ *
+ * @param[in] path File path
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_FOUND   No such file
+ *      - ESP_ERR_INVALID_VERSION File written by another cache version
+ *      - ESP_ERR_INVALID_SIZE Truncated file
+ *      - ESP_ERR_NO_MEM      Not enough memory
+ */
+esp_err_t bsp_shadow_cache_load(const char *path);
+
+/**
+ * @brief Drop all cached masks
+ */
+void bsp_shadow_cache_clear(void);
+
+/**
+ * @brief Get the statistics since start
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_shadow_get_stats(bsp_shadow_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,153 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP LVGL stall detector
+ *
+ * Watches each pass of lv_timer_handler() in the LVGL task. A pass longer than the budget is a stall:
+ * a watchdog timer captures what the LVGL task is doing when the budget runs out, and the stall is
+ * logged and kept in a ring buffer:
+ *
+ *     W (51234) BSP_STALL: LVGL task stalled for 100 ms in observer 0x42012345
+ *     W (51391) BSP_STALL: Stall of 257 ms: timer cb 0x4200a1b8 > observer cb 0x42012345
+ *     ...
+ *     bsp_stall_print(stdout);
+ *
+ * The activities are LVGL timers (by their callback, except lv_async_call()), object events (by the object, its class, screen
+ * and first registered event callback matching the code, this includes drawing the object), UI channel updates and batched
+ * subject observers. An event runs its class handler and every matching callback, the first registered one only
+ * narrows down the search: it is logged as "first cb" and need not be the one that stalled. Callbacks are recorded as addresses; idf.py monitor decodes them, or use
+ * `xtensa-esp32s3-elf-addr2line -pfe build/<project>.elf 0x42012345`.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_STALL_DEPTH         4   /* Innermost activities kept per stall */
+
+/**
+ * @brief Kind of activity running in the LVGL task
+ */
+typedef enum {
+    BSP_STALL_NONE,                 /*!< Nothing tracked, e.g. LVGL internals or a missed watchdog */
+    BSP_STALL_TIMER,                /*!< LVGL timer, obj is the lv_timer_t */
+    BSP_STALL_EVENT,                /*!< Event sent to an object, including drawing it, obj is the lv_obj_t */
+    BSP_STALL_UI_APPLY,             /*!< Update posted with bsp_ui_post(), obj is the target */
+    BSP_STALL_OBSERVER,             /*!< Batched subject observer, obj is the lv_subject_t */
+} bsp_stall_kind_t;
+
+/**
+ * @brief An activity of the LVGL task
+ */
+typedef struct {
+    uint8_t kind;                   /*!< bsp_stall_kind_t */
+    uint16_t code;                  /*!< lv_event_code_t of BSP_STALL_EVENT */
+    const void *fn;                 /*!< Callback, NULL if unknown or none. For BSP_STALL_EVENT the first registered
+                                         event callback matching the code, not necessarily the running one */
+    const void *obj;                /*!< Object, timer, target or subject, see bsp_stall_kind_t */
+} bsp_stall_ctx_t;
+
+/**
+ * @brief A stall
+ */
+typedef struct {
+    uint32_t timestamp_ms;          /*!< Start of the lv_timer_handler() pass since boot */
+    uint32_t duration_us;           /*!< Length of the pass */
+    uint8_t depth;                  /*!< Nesting of the activities when the budget ran out */
+    uint8_t count;                  /*!< Entries in ctx */
+    bsp_stall_ctx_t ctx[BSP_STALL_DEPTH];   /*!< Innermost activities, outermost first */
+    const char *class_name;         /*!< Class of the innermost object, NULL if none or deleted since */
+    const void *screen;             /*!< Screen of the innermost object, NULL if none or deleted since */
+    bool screen_active;             /*!< The screen was the active one */
+} bsp_stall_record_t;
+
+/**
+ * @brief Stall statistics
+ */
+typedef struct {
+    uint32_t passes;                /*!< lv_timer_handler() passes */
+    uint32_t stalls;                /*!< Passes over the budget */
+    uint32_t budget_ms;             /*!< Current budget */
+    uint32_t max_us;                /*!< Longest pass */
+    uint8_t max_depth;              /*!< Deepest nesting of activities seen */
+} bsp_stall_stats_t;
+
+/**
+ * @brief Read the most recent stalls, oldest first
+ *
+ * @param[out] records Stalls
+ * @param[in]  max     Size of records
+ * @return Number of stalls read, 0 if CONFIG_BSP_STALL is not set
+ */
+size_t bsp_stall_read(bsp_stall_record_t *records, size_t max);
+
+/**
+ * @brief Get the statistics
+ *
+ * @param[out] stats Statistics
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_STALL is not set
+ */
+esp_err_t bsp_stall_get_stats(bsp_stall_stats_t *stats);
+
+/**
+ * @brief Change the budget of a lv_timer_handler() pass
+ *
+ * @param[in] budget_ms Budget, from the next pass
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_ARG budget_ms is 0
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_STALL is not set
+ */
+esp_err_t bsp_stall_set_budget(uint32_t budget_ms);
+
+/**
+ * @brief Forget the recorded stalls and clear the statistics
+ */
+void bsp_stall_reset(void);
+
+/**
+ * @brief Write the statistics and recorded stalls as text
+ *
+ * @param[in] f Open file, e.g. stdout
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_SUPPORTED CONFIG_BSP_STALL is not set
+ *      - ESP_FAIL            Write error
+ */
+esp_err_t bsp_stall_print(FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
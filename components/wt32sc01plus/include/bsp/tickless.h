@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP idle handling of the LVGL task
+ *
+ * LVGL reads its tick from esp_timer, so it does not need a periodic tick interrupt. LVGL pauses the
+ * refresh timer when nothing is invalidated; the LVGL task then sleeps until the next LVGL timer
+ * deadline or until it is woken by bsp_display_wake(). bsp_ui_post() and the batched subject
+ * observers wake it.
+ *
+ * With CONFIG_BSP_DISPLAY_TICKLESS the esp_lvgl_port tick timer is slowed down as well. Touch is read
+ * only after a touch controller interrupt, until the finger is lifted and scrolling has ended. An
+ * idle static screen then wakes the LVGL task only every CONFIG_BSP_DISPLAY_TICKLESS_MAX_SLEEP_MS.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Idle statistics of the LVGL task
+ */
+typedef struct {
+    uint32_t wakeups;               /*!< LVGL task wakeups, see below */
+    uint32_t wakeups_per_sec_x10;   /*!< Wakeup rate over the last second (or the last sleep, if longer) x10 */
+    uint32_t sleep_ms_max;          /*!< Longest sleep of the LVGL task */
+    uint32_t wake_requests;         /*!< bsp_display_wake() calls */
+    uint32_t touch_irqs;            /*!< Touch controller interrupts */
+    uint8_t idle_pct;               /*!< Time the LVGL task spent outside of lv_timer_handler(), lv_timer_get_idle() */
+} bsp_tickless_stats_t;
+
+/**
+ * @brief Make the LVGL task run a refresh soon
+ *
+ * For producers that change LVGL state without invalidating an object, e.g. through the UI channel.
+ * Non-blocking and safe from any task. Does nothing before bsp_display_start().
+ */
+void bsp_display_wake(void);
+
+/**
+ * @brief Get idle statistics of the LVGL task
+ *
+ * A wakeup is counted when the LVGL task reads the tick after more than 1 ms without
+ * reading it, outside of a display refresh.
+ *
+ * @param[out] stats Statistics
+ */
+void bsp_tickless_get_stats(bsp_tickless_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,143 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP UI update channel
+ *
+ * Lets any task update the UI without taking the display lock. Producers post (target, value) updates
+ * into a lock-free queue and return immediately. The LVGL task drains the queue once per refresh
+ * cycle (on LV_EVENT_REFR_START, before the invalidated areas are rendered) and applies only the
+ * last value posted for each target, so a sensor task posting faster than the frame rate costs one
+ * update per frame.
+ *
+ * Subject observers can be batched the same way: bsp_subject_add_observer_batched() registers an
+ * observer that is only marked dirty when the subject changes and is called at most once per refresh
+ * cycle with the latest value. Observers added with the LVGL API keep being notified immediately,
+ * bsp_subject_batch_flush() delivers pending batched notifications right away.
+ *
+ *     // Sensor task
+ *     bsp_ui_post_subject_int(&temperature_subject, t);
+ *
+ *     // Object property, runs in the LVGL task
+ *     static void arc_set(void *target, int32_t value) { lv_arc_set_value(target, value); }
+ *     bsp_ui_post(arc_set, arc, level);
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Apply an update, called from the LVGL task with the display lock held
+ */
+typedef void (*bsp_ui_apply_cb_t)(void *target, int32_t value);
+
+/**
+ * @brief UI update channel statistics
+ */
+typedef struct {
+    uint32_t posted;            /*!< Updates posted */
+    uint32_t applied;           /*!< Updates applied */
+    uint32_t coalesced;         /*!< Updates replaced by a newer value for the same target in the same frame */
+    uint32_t dropped;           /*!< Updates lost because the queue was full */
+    uint32_t depth;             /*!< Updates waiting now */
+    uint32_t depth_max;         /*!< Highest number of updates waiting at a frame start */
+    uint32_t post_us_max;       /*!< Longest time spent in a producer posting an update */
+    uint32_t latency_us_last;   /*!< Post to apply time of the last applied update */
+    uint32_t latency_us_max;    /*!< Highest post to apply time */
+    uint32_t subject_notifications; /*!< Subject changes seen by batched observers */
+    uint32_t subject_delivered;     /*!< Batched observer calls */
+    uint32_t subject_suppressed;    /*!< Subject changes folded into a pending call */
+} bsp_ui_channel_stats_t;
+
+/**
+ * @brief Drain the channel on each refresh of `disp`
+ *
+ * Called by bsp_display_start().
+ */
+esp_err_t bsp_ui_channel_init(lv_display_t *disp);
+
+/**
+ * @brief Post an update, lock free, from any task but not from an ISR
+ *
+ * @param[in] apply  Function applying the value, identifies the target together with `target`
+ * @param[in] target Object, subject or other pointer passed to `apply`
+ * @param[in] value  Value passed to `apply`
+ * @return
+ *      - ESP_OK              Update queued
+ *      - ESP_ERR_INVALID_STATE Channel not initialized
+ *      - ESP_ERR_NO_MEM      Queue full, the update is dropped
+ */
+esp_err_t bsp_ui_post(bsp_ui_apply_cb_t apply, void *target, int32_t value);
+
+/**
+ * @brief Post a new value for an integer lv_subject
+ */
+esp_err_t bsp_ui_post_subject_int(lv_subject_t *subject, int32_t value);
+
+/**
+ * @brief Add a subject observer called at most once per refresh cycle
+ *
+ * Same as lv_subject_add_observer_obj(), the observer is called right away with the current value,
+ * then once per frame in which the subject changed. Call with the display lock held.
+ *
+ * @param[in] subject   Subject to observe
+ * @param[in] cb        Observer callback
+ * @param[in] obj       Object owning the observer, removed with it, can be NULL
+ * @param[in] user_data User data of the observer
+ * @return Observer or NULL when CONFIG_BSP_UI_BATCH_OBSERVERS are in use
+ */
+lv_observer_t *bsp_subject_add_observer_batched(lv_subject_t *subject, lv_observer_cb_t cb, lv_obj_t *obj, void *user_data);
+
+/**
+ * @brief Batched version of lv_label_bind_text() for integer subjects
+ *
+ * @param[in] fmt Format string with one integer conversion, must stay valid
+ */
+lv_observer_t *bsp_label_bind_text_batched(lv_obj_t *label, lv_subject_t *subject, const char *fmt);
+
+/**
+ * @brief Remove an observer added with bsp_subject_add_observer_batched() without object
+ */
+void bsp_subject_remove_observer_batched(lv_observer_t *observer);
+
+/**
+ * @brief Deliver pending batched notifications now instead of at the next refresh
+ */
+void bsp_subject_batch_flush(void);
+
+/**
+ * @brief Get UI update channel statistics
+ */
+void bsp_ui_channel_get_stats(bsp_ui_channel_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
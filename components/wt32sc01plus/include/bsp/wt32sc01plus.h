@@ -24,7 +24,9 @@ SOFTWARE.
 
 /**
  * @file
- * @brief ESP BSP: WT32-SC01 Plus (ESP32-S3)
+ * @brief ESP BSP: WT32-SC01 Plus (ESP32-S3) and WT32-SC01 (ESP32)
+ *
+ * The board is selected with CONFIG_BSP_BOARD_*, see bsp/board.h.
  */
 #pragma once
 
@@ -34,63 +36,38 @@ SOFTWARE.
 #include "driver/sdmmc_host.h"
 #include "soc/usb_pins.h"
 #include "bsp/config.h"
+#include "bsp/board.h"
 #include "bsp/display.h"
 #include "bsp/touch.h"
+#include "bsp/eventlog.h"
+#include "bsp/rs485.h"
+#include "bsp/modbus.h"
+#include "bsp/audio.h"
+#include "bsp/ui_channel.h"
+#include "bsp/mirror.h"
+#include "bsp/screenshot.h"
+#include "bsp/metrics.h"
+#include "bsp/profiler.h"
+#include "bsp/monkey.h"
+#include "bsp/tickless.h"
+#include "bsp/refr_governor.h"
+#include "bsp/pm.h"
+#include "bsp/ram_budget.h"
+#include "bsp/blend.h"
+#include "bsp/dma_copy.h"
+#include "bsp/shadow.h"
+#include "bsp/bitmap_cache.h"
+#include "bsp/latency.h"
+#include "bsp/stall.h"
+#include "bsp/display_lock.h"
 #include "driver/i2s_std.h"
 
 #include "lvgl.h"
 #include "esp_lvgl_port.h"
 
-/**************************************************************************************************
- *  BSP Capabilities
- **************************************************************************************************/
-
-#define BSP_CAPS_DISPLAY        1
-#define BSP_CAPS_TOUCH          1
-#define BSP_CAPS_BUTTONS        1
-#define BSP_CAPS_AUDIO          1
-#define BSP_CAPS_AUDIO_SPEAKER  1
-#define BSP_CAPS_AUDIO_MIC      0
-#define BSP_CAPS_SDCARD         1
-#define BSP_CAPS_IMU            0
-
-/* I2C */
-#define BSP_I2C_SCL           (GPIO_NUM_5)
-#define BSP_I2C_SDA           (GPIO_NUM_6)
-
-/* Display - ST7789 8 Bit parellel */
-#define BSP_LCD_WIDTH         (8) 
-#define BSP_LCD_DATA0         (GPIO_NUM_9)
-#define BSP_LCD_DATA1         (GPIO_NUM_46)
-#define BSP_LCD_DATA2         (GPIO_NUM_3)
-#define BSP_LCD_DATA3         (GPIO_NUM_8)
-#define BSP_LCD_DATA4         (GPIO_NUM_18)
-#define BSP_LCD_DATA5         (GPIO_NUM_17)
-#define BSP_LCD_DATA6         (GPIO_NUM_16)
-#define BSP_LCD_DATA7         (GPIO_NUM_15)
-
-#define BSP_LCD_CS           (GPIO_NUM_NC) 
-#define BSP_LCD_DC           (GPIO_NUM_0)  
-#define BSP_LCD_WR           (GPIO_NUM_47) 
-#define BSP_LCD_RD           (GPIO_NUM_NC) 
-#define BSP_LCD_RST          (GPIO_NUM_4)  
-#define BSP_LCD_TE           (GPIO_NUM_48) 
-#define BSP_LCD_BACKLIGHT    (GPIO_NUM_45) 
-#define BSP_LCD_TP_INT       (GPIO_NUM_7)  
-#define BSP_LCD_TP_RST       (GPIO_NUM_NC) 
-
-#define LCD_CMD_BITS           8
-#define LCD_PARAM_BITS         8
-
 /* Display Brightness */
 #define LCD_LEDC_CH            1 //CONFIG_BSP_DISPLAY_BRIGHTNESS_LEDC_CH
 
-/* SD card */
-#define BSP_SD_MOSI           (GPIO_NUM_40)
-#define BSP_SD_MISO           (GPIO_NUM_38)
-#define BSP_SD_SCLK           (GPIO_NUM_39)
-#define BSP_SD_CS             (GPIO_NUM_41)
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Sound effect mixing kernel
+ *
+ * Clips, voices and the Q20.12 saturating mix of the sound effect mixer, and the synthetic load of
+ * bsp_audio_mixer_benchmark(). No ESP-IDF dependency: bsp_audio_mixer.c builds them for the target and
+ * tools/mixer_bench.c checks and times them on Linux.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_MIX_POS_SHIFT         (12)    /* Q20.12 play position, clips up to 1M samples */
+#define AUDIO_MIX_BENCH_RATE        (48000)
+#define AUDIO_MIX_BENCH_CLIP_RATE   (44100)
+#define AUDIO_MIX_BENCH_CLIP_FRAMES (44100)
+
+struct bsp_audio_clip {
+    uint32_t frames;
+    uint32_t sample_rate;
+    uint32_t users;                     /* Voices playing the clip and pending triggers, atomic */
+    int16_t pcm[];
+};
+
+typedef struct {
+    struct bsp_audio_clip *clip;        /* NULL when the voice is free */
+    uint32_t pos;
+    int32_t gain;                       /* Q8 */
+} audio_mix_voice_t;
+
+static inline int16_t audio_mix_sat16(int32_t v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+}
+
+/* Hands the voice's reference on its clip back, bsp_audio_clip_delete() waits for the last one */
+static inline void audio_mix_voice_release(audio_mix_voice_t *voice)
+{
+    if (voice->clip) {
+        __atomic_fetch_sub(&voice->clip->users, 1, __ATOMIC_RELEASE);
+        voice->clip = NULL;
+    }
+}
+
+/* Play position after the last sample of the voice's clip */
+static inline uint32_t audio_mix_voice_end(const audio_mix_voice_t *voice)
+{
+    return voice->clip->frames << AUDIO_MIX_POS_SHIFT;
+}
+
+/* Mix `count` voices into the stereo `block`. Voices are resampled with nearest neighbour,
+ * summed in 32 bit and saturated once per sample. Finished voices are released. */
+static inline void audio_mix(int16_t *block, size_t frames, audio_mix_voice_t *voices, size_t count,
+                             uint32_t out_rate, uint32_t master_gain, int32_t *acc)
+{
+    bool any = false;
+
+    memset(acc, 0, frames * sizeof(*acc));
+    for (size_t v = 0; v < count; v++) {
+        audio_mix_voice_t *voice = &voices[v];
+        if (voice->clip == NULL) {
+            continue;
+        }
+        const int16_t *pcm = voice->clip->pcm;
+        const uint32_t end = audio_mix_voice_end(voice);
+        const uint32_t step = ((uint64_t)voice->clip->sample_rate << AUDIO_MIX_POS_SHIFT) / out_rate;
+        const int32_t gain = (voice->gain * (int32_t)master_gain) >> 8;
+        const size_t left = (end - voice->pos + step - 1) / step;
+        const size_t n = left < frames ? left : frames;
+        uint32_t pos = voice->pos;
+
+        for (size_t i = 0; i < n; i++) {
+            acc[i] += pcm[pos >> AUDIO_MIX_POS_SHIFT] * gain;
+            pos += step;
+        }
+        voice->pos = pos;
+        if (pos >= end) {
+            audio_mix_voice_release(voice);
+        }
+        any = true;
+    }
+
+    if (!any) {
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        const int32_t s = acc[i] >> 8;
+        block[2 * i] = audio_mix_sat16(block[2 * i] + s);
+        block[2 * i + 1] = audio_mix_sat16(block[2 * i + 1] + s);
+    }
+}
+
+/* Full scale sawtooth at 44.1 kHz for AUDIO_MIX_BENCH_CLIP_FRAMES, saturates with several voices at 48 kHz */
+static inline void audio_mix_bench_clip(struct bsp_audio_clip *clip)
+{
+    clip->frames = AUDIO_MIX_BENCH_CLIP_FRAMES;
+    clip->sample_rate = AUDIO_MIX_BENCH_CLIP_RATE;
+    clip->users = 0;
+    for (size_t i = 0; i < AUDIO_MIX_BENCH_CLIP_FRAMES; i++) {
+        clip->pcm[i] = (int16_t)(i * 1310);
+    }
+}
+
+/* Restarts the finished benchmark voices at staggered positions and fills the block, before each block */
+static inline void audio_mix_bench_prepare(int16_t *block, size_t frames, audio_mix_voice_t *voices, int count,
+                                           struct bsp_audio_clip *clip)
+{
+    for (int i = 0; i < count; i++) {
+        if (voices[i].clip == NULL) {
+            __atomic_fetch_add(&clip->users, 1, __ATOMIC_RELAXED);
+            const uint32_t start = (i * 997) % AUDIO_MIX_BENCH_CLIP_FRAMES;
+            voices[i] = (audio_mix_voice_t) { .clip = clip, .pos = start << AUDIO_MIX_POS_SHIFT, .gain = 200 };
+        }
+    }
+    memset(block, 0x11, frames * 2 * sizeof(int16_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
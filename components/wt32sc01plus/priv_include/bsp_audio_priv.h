@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP Audio internals
+ *
+ * Shared by the streaming player (bsp_audio.c) and the sound effect mixer (bsp_audio_mixer.c).
+ * The output task of the player owns the I2S channel and calls the mixer once per DMA block.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+} audio_format_t;
+
+/**
+ * @brief Open a WAV or raw PCM file and position it at the first sample
+ *
+ * @param[out] fmt     Sample format of the file
+ * @param[out] ret_len Data length in bytes, UINT32_MAX for raw files
+ * @return Open file or NULL on error
+ */
+FILE *audio_open(const char *path, audio_format_t *fmt, uint32_t *ret_len);
+
+/**
+ * @brief Output rate used for raw PCM files and when no file is playing
+ */
+uint32_t audio_default_rate(void);
+
+/**
+ * @brief Wake the output task, returns false when audio is not initialized
+ */
+bool audio_output_wake(void);
+
+/**
+ * @brief Initialize the mixer trigger queue, called by bsp_audio_init()
+ */
+void audio_mixer_init(void);
+
+/**
+ * @brief Voices are playing or triggers are pending
+ *
+ * False as soon as the last voice is rendered; the output task keeps the output running until that
+ * block has left the DMA buffers. Called from the output task only.
+ */
+bool audio_mixer_active(void);
+
+/**
+ * @brief Start triggered voices and mix all voices into a 16 bit stereo block
+ *
+ * Called from the output task only.
+ *
+ * @param[in,out] block       Interleaved stereo samples, mixed with saturation
+ * @param[in]     frames      Frames in the block
+ * @param[in]     out_rate    Current output sample rate
+ * @param[in]     master_gain Output volume (Q8)
+ */
+void audio_mixer_render(int16_t *block, size_t frames, uint32_t out_rate, uint32_t master_gain);
+
+/**
+ * @brief The block passed to the last audio_mixer_render() was queued for output
+ *
+ * @param[in] dac_time_us Estimated time (esp_timer) at which the block reaches the DAC
+ */
+void audio_mixer_queued(int64_t dac_time_us);
+
+#ifdef __cplusplus
+}
+#endif
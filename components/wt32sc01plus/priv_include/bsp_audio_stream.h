@@ -0,0 +1,157 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Ring buffer and task handoff of the streaming player
+ *
+ * The ring buffer between the reader and the output task of bsp_audio.c, the flush handshake, the
+ * cancel of a stream by bsp_audio_play() and bsp_audio_stop(), the WAV header parser and the sample
+ * conversion. No ESP-IDF dependency: bsp_audio.c runs it from its FreeRTOS tasks and
+ * tools/audio_stream_check.c from threads on Linux, streaming WAV files into a file sink.
+ *
+ * The reader is the only writer of `head` and the output the only writer of `tail`. Waking the other
+ * side after each call is left to the caller.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "bsp_audio_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* audio_stream_next() while prefetching or at the end of the stream */
+#define AUDIO_STREAM_WAIT       (-1)
+
+typedef struct {
+    uint8_t *ring;
+    uint32_t size;                  /* Ring size in bytes, playback starts at half of it */
+    volatile uint32_t head;         /* Reader side */
+    volatile uint32_t tail;         /* Output side */
+    volatile uint32_t generation;   /* Bumped by audio_stream_cancel(), the reader drops its file when it changes */
+    volatile bool flush_req;        /* Reader asks the output to drop buffered data */
+    volatile bool ready;            /* `fmt` is valid and the ring holds data of the current stream */
+    volatile bool eof;              /* Reader delivered the whole file */
+    audio_format_t fmt;
+    /* Output side */
+    bool started;                   /* Prefetch done, samples go to the output */
+    uint32_t starvations;           /* Ring ran empty before the end of the file */
+    uint32_t fill_min;              /* Lowest fill since the stream started */
+} audio_stream_t;
+
+/**
+ * @brief Initialize a stream on a ring buffer of `size` bytes
+ */
+void audio_stream_init(audio_stream_t *s, uint8_t *ring, uint32_t size);
+
+/**
+ * @brief Bytes in the ring buffer
+ */
+static inline uint32_t audio_stream_fill(const audio_stream_t *s)
+{
+    return __atomic_load_n(&s->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Cancel the current stream, called by play and stop
+ *
+ * @return Generation of the next stream
+ */
+uint32_t audio_stream_cancel(audio_stream_t *s);
+
+/**
+ * @brief Parse a WAV header and leave `f` at the first sample
+ *
+ * @param[out] fmt     Sample format
+ * @param[out] ret_len Data length in bytes
+ * @return NULL on success, else why the file cannot be played
+ */
+const char *audio_wav_parse(FILE *f, audio_format_t *fmt, uint32_t *ret_len);
+
+/* Reader side */
+
+/**
+ * @brief Unpublish the stream and ask the output to drop buffered data
+ *
+ * The data is dropped once `flush_req` reads false again, the caller wakes the output until then.
+ */
+void audio_stream_flush(audio_stream_t *s);
+
+/**
+ * @brief Publish the stream of generation `gen` in format `fmt` to the output
+ *
+ * @return false if the stream was cancelled meanwhile, it stays unpublished
+ */
+bool audio_stream_publish(audio_stream_t *s, const audio_format_t *fmt, uint32_t gen);
+
+/**
+ * @brief The stream of generation `gen` was not cancelled
+ */
+static inline bool audio_stream_current(const audio_stream_t *s, uint32_t gen)
+{
+    return __atomic_load_n(&s->generation, __ATOMIC_SEQ_CST) == gen;
+}
+
+/**
+ * @brief Read the file straight into the free, contiguous part of the ring
+ *
+ * @return Bytes read, at most `max`
+ */
+size_t audio_stream_fill_from(audio_stream_t *s, FILE *f, size_t max);
+
+/**
+ * @brief Mark the end of the file, unless the stream was cancelled
+ *
+ * @return false if the stream was cancelled
+ */
+bool audio_stream_end(audio_stream_t *s, uint32_t gen);
+
+/* Output side */
+
+/**
+ * @brief Drop buffered data if the reader asked for it
+ *
+ * @return true if the data was dropped, the caller wakes the reader
+ */
+bool audio_stream_take_flush(audio_stream_t *s);
+
+/**
+ * @brief Read the next block of the published stream as 16 bit stereo with `gain` (Q8) applied
+ *
+ * Waits for the prefetch level before the first block. A block shorter than `frames` is a starvation,
+ * or the last block of the file. The stream is unpublished when the file is played out.
+ *
+ * @param[out] block  `frames` stereo frames, only the returned number is written
+ * @return Frames read, or AUDIO_STREAM_WAIT while prefetching or when the stream ended
+ */
+int audio_stream_next(audio_stream_t *s, int16_t *block, size_t frames, uint32_t gain);
+
+#ifdef __cplusplus
+}
+#endif
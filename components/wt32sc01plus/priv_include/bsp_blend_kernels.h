@@ -0,0 +1,419 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Word-at-a-time RGB565 kernels and their scalar references
+ *
+ * The portable kernels behind bsp/blend.h, the generic LVGL 9 loops they replace and the randomized
+ * comparison of the two. No ESP-IDF dependency: bsp_blend.c builds them for the target and
+ * tools/blend_check.c on Linux. The image copy kernel is the DMA copy on the target and is only
+ * compared there.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_BLEND_CHECK_W       67
+#define BSP_BLEND_CHECK_H       5
+/* Room for an area at any 2 byte offset with a stride of up to 8 extra pixels */
+#define BSP_BLEND_CHECK_DEST_SIZE   ((BSP_BLEND_CHECK_W + 8) * BSP_BLEND_CHECK_H * 2 + 4)
+#define BSP_BLEND_CHECK_SRC_SIZE    ((BSP_BLEND_CHECK_W + 8) * BSP_BLEND_CHECK_H * 4 + 4)
+
+/* Two RGB565 pixels, may alias the uint16_t pixel buffers */
+typedef uint32_t __attribute__((may_alias)) bsp_blend_px2_t;
+
+/* R, G and B of one pixel spread over 32 bits with 5 guard bits each, as in lv_color_16_16_mix() */
+#define BSP_BLEND_RGB565_SPREAD(c)  ((((uint32_t)(c)) | ((uint32_t)(c) << 16)) & 0x07E0F81FU)
+
+static inline uint16_t *bsp_blend_next_row(const void *row, int32_t stride)
+{
+    return (uint16_t *)((uint8_t *)row + stride);
+}
+
+/*
+ * Portable kernels, two pixels per 32-bit access
+ */
+
+static inline void bsp_blend_swar_fill_row(uint16_t *d, int32_t n, uint16_t color)
+{
+    const uint32_t c2 = color | ((uint32_t)color << 16);
+
+    if (((uintptr_t)d & 2) && n > 0) {
+        *d++ = color;
+        n--;
+    }
+    bsp_blend_px2_t *d2 = (bsp_blend_px2_t *)d;
+    for (; n >= 8; n -= 8, d2 += 4) {
+        d2[0] = c2;
+        d2[1] = c2;
+        d2[2] = c2;
+        d2[3] = c2;
+    }
+    for (; n >= 2; n -= 2) {
+        *d2++ = c2;
+    }
+    if (n) {
+        *(uint16_t *)d2 = color;
+    }
+}
+
+static inline void bsp_blend_swar_fill(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color)
+{
+    for (int32_t y = 0; y < h; y++, dest = bsp_blend_next_row(dest, stride)) {
+        bsp_blend_swar_fill_row(dest, w, color);
+    }
+}
+
+static inline uint16_t bsp_blend_mix_spread(uint32_t fg, uint16_t bg565, uint32_t mix)
+{
+    const uint32_t bg = BSP_BLEND_RGB565_SPREAD(bg565);
+    const uint32_t res = ((((fg - bg) * mix) >> 5) + bg) & 0x07E0F81FU;
+    return (uint16_t)((res >> 16) | res);
+}
+
+static inline void bsp_blend_swar_fill_opa(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color,
+                                           uint8_t opa)
+{
+    if (opa == 255) {
+        bsp_blend_swar_fill(dest, w, h, stride, color);
+        return;
+    }
+
+    /* The color, the mix factor and the last two results are the same for the whole area */
+    const uint32_t fg = BSP_BLEND_RGB565_SPREAD(color);
+    const uint32_t mix = ((uint32_t)opa + 4) >> 3;
+    uint32_t last_in = 0;
+    uint32_t last_out = bsp_blend_mix_spread(fg, 0, mix) * 0x10001U;
+
+    for (int32_t y = 0; y < h; y++, dest = bsp_blend_next_row(dest, stride)) {
+        uint16_t *d = dest;
+        int32_t n = w;
+        if (((uintptr_t)d & 2) && n > 0) {
+            *d = bsp_blend_mix_spread(fg, *d, mix);
+            d++;
+            n--;
+        }
+        bsp_blend_px2_t *d2 = (bsp_blend_px2_t *)d;
+        for (; n >= 2; n -= 2, d2++) {
+            const uint32_t in = *d2;
+            if (in != last_in) {
+                last_in = in;
+                last_out = bsp_blend_mix_spread(fg, (uint16_t)in, mix) |
+                           ((uint32_t)bsp_blend_mix_spread(fg, (uint16_t)(in >> 16), mix) << 16);
+            }
+            *d2 = last_out;
+        }
+        if (n) {
+            d = (uint16_t *)d2;
+            *d = bsp_blend_mix_spread(fg, *d, mix);
+        }
+    }
+}
+
+static inline void bsp_blend_swar_argb8888(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                                           const uint8_t *src, int32_t src_stride)
+{
+    for (int32_t y = 0; y < h; y++) {
+        const uint8_t *s = src;
+        for (int32_t x = 0; x < w; x++, s += 4) {
+            const uint32_t a = s[3];
+            if (a == 0) {
+                continue;
+            }
+            if (a == 255) {
+                dest[x] = ((s[2] & 0xF8) << 8) | ((s[1] & 0xFC) << 3) | (s[0] >> 3);
+                continue;
+            }
+            /* Red and blue in one multiply, 31 * 255 per channel cannot carry into the other half */
+            const uint32_t a_inv = 255 - a;
+            const uint32_t bg = dest[x];
+            const uint32_t rb = (((uint32_t)(s[2] >> 3) << 16) | (s[0] >> 3)) * a +
+                                ((((bg >> 11) & 0x1F) << 16) | (bg & 0x1F)) * a_inv;
+            const uint32_t g = (uint32_t)(s[1] >> 2) * a + ((bg >> 5) & 0x3F) * a_inv;
+            dest[x] = (((rb >> 16) << 3) & 0xF800) + ((g >> 3) & 0x07E0) + ((rb & 0xFFFF) >> 8);
+        }
+        dest = bsp_blend_next_row(dest, dest_stride);
+        src += src_stride;
+    }
+}
+
+static inline void bsp_blend_swar_swap(uint16_t *buf, size_t count)
+{
+    if (((uintptr_t)buf & 2) && count > 0) {
+        *buf = (uint16_t)((*buf << 8) | (*buf >> 8));
+        buf++;
+        count--;
+    }
+    bsp_blend_px2_t *b2 = (bsp_blend_px2_t *)buf;
+    for (; count >= 4; count -= 4, b2 += 2) {
+        const uint32_t p0 = b2[0];
+        const uint32_t p1 = b2[1];
+        b2[0] = ((p0 & 0x00FF00FFU) << 8) | ((p0 >> 8) & 0x00FF00FFU);
+        b2[1] = ((p1 & 0x00FF00FFU) << 8) | ((p1 >> 8) & 0x00FF00FFU);
+    }
+    if (count >= 2) {
+        const uint32_t p = *b2;
+        *b2++ = ((p & 0x00FF00FFU) << 8) | ((p >> 8) & 0x00FF00FFU);
+        count -= 2;
+    }
+    if (count) {
+        buf = (uint16_t *)b2;
+        *buf = (uint16_t)((*buf << 8) | (*buf >> 8));
+    }
+}
+
+/*
+ * Scalar references, the generic LVGL 9 loops of lv_draw_sw_blend_to_rgb565.c and lv_draw_sw.c
+ */
+
+static inline uint16_t bsp_blend_ref_16_16_mix(uint16_t c1, uint16_t c2, uint8_t mix)
+{
+    if (mix == 255) {
+        return c1;
+    }
+    if (mix == 0) {
+        return c2;
+    }
+    mix = ((uint32_t)mix + 4) >> 3;
+    const uint32_t bg = (uint32_t)(c2 | ((uint32_t)c2 << 16)) & 0x7E0F81F;
+    const uint32_t fg = (uint32_t)(c1 | ((uint32_t)c1 << 16)) & 0x7E0F81F;
+    const uint32_t result = ((((fg - bg) * mix) >> 5) + bg) & 0x7E0F81F;
+    return (uint16_t)(result >> 16) | result;
+}
+
+static inline uint16_t bsp_blend_ref_24_16_mix(const uint8_t *c1, uint16_t c2, uint8_t mix)
+{
+    if (mix == 0) {
+        return c2;
+    }
+    if (mix == 255) {
+        return ((c1[2] & 0xF8) << 8) + ((c1[1] & 0xFC) << 3) + ((c1[0] & 0xF8) >> 3);
+    }
+    const uint8_t mix_inv = 255 - mix;
+    return ((((c1[2] >> 3) * mix + ((c2 >> 11) & 0x1F) * mix_inv) << 3) & 0xF800) +
+           ((((c1[1] >> 2) * mix + ((c2 >> 5) & 0x3F) * mix_inv) >> 3) & 0x07E0) +
+           (((c1[0] >> 3) * mix + (c2 & 0x1F) * mix_inv) >> 8);
+}
+
+static inline void bsp_blend_ref_fill(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color)
+{
+    for (int32_t y = 0; y < h; y++, dest = bsp_blend_next_row(dest, stride)) {
+        for (int32_t x = 0; x < w; x++) {
+            dest[x] = color;
+        }
+    }
+}
+
+static inline void bsp_blend_ref_fill_opa(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color,
+                                          uint8_t opa)
+{
+    for (int32_t y = 0; y < h; y++, dest = bsp_blend_next_row(dest, stride)) {
+        for (int32_t x = 0; x < w; x++) {
+            dest[x] = bsp_blend_ref_16_16_mix(color, dest[x], opa);
+        }
+    }
+}
+
+static inline void bsp_blend_ref_copy(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                                      const uint16_t *src, int32_t src_stride)
+{
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            dest[x] = src[x];
+        }
+        dest = bsp_blend_next_row(dest, dest_stride);
+        src = bsp_blend_next_row(src, src_stride);
+    }
+}
+
+static inline void bsp_blend_ref_argb8888(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+                                          const uint8_t *src, int32_t src_stride)
+{
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            dest[x] = bsp_blend_ref_24_16_mix(&src[x * 4], dest[x], src[x * 4 + 3]);
+        }
+        dest = bsp_blend_next_row(dest, dest_stride);
+        src += src_stride;
+    }
+}
+
+static inline void bsp_blend_ref_swap(uint16_t *buf, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = (uint16_t)((buf[i] << 8) | (buf[i] >> 8));
+    }
+}
+
+/*
+ * Randomized comparison
+ */
+
+/* xorshift32, the same sequence on every platform */
+static inline uint32_t bsp_blend_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static inline void bsp_blend_randomize(uint8_t *buf, size_t size, uint32_t *state)
+{
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)bsp_blend_rand(state);
+    }
+}
+
+/* Alpha of anti-aliased icons: mostly transparent or opaque, an edge of partial alpha */
+static inline uint8_t bsp_blend_rand_alpha(uint32_t *state)
+{
+    const uint32_t r = bsp_blend_rand(state) % 8;
+    return r < 3 ? 0 : r < 6 ? 255 : (uint8_t)bsp_blend_rand(state);
+}
+
+/* The kernels under test, copy may be NULL */
+typedef struct {
+    void (*fill)(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color);
+    void (*fill_opa)(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color, uint8_t opa);
+    void (*copy)(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, const uint16_t *src, int32_t src_stride);
+    void (*argb8888)(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, const uint8_t *src, int32_t src_stride);
+    void (*swap)(uint16_t *buf, size_t count);
+} bsp_blend_kernels_t;
+
+/* The round that differed first */
+typedef struct {
+    const char *kernel;
+    size_t byte;
+    int32_t w;
+    int32_t h;
+    int32_t stride;
+    int32_t offset;
+    uint16_t color;
+    uint8_t opa;
+} bsp_blend_mismatch_t;
+
+/**
+ * Runs the kernels and the references on random sizes, alignments, strides, colors and opacities
+ *
+ * a and b hold BSP_BLEND_CHECK_DEST_SIZE bytes, src BSP_BLEND_CHECK_SRC_SIZE. Returns false and fills
+ * mismatch at the first difference.
+ */
+static inline bool bsp_blend_check(const bsp_blend_kernels_t *k, int rounds, uint8_t *a, uint8_t *b, uint8_t *src,
+                                   bsp_blend_mismatch_t *mismatch)
+{
+    const size_t dest_size = BSP_BLEND_CHECK_DEST_SIZE;
+    const size_t src_size = BSP_BLEND_CHECK_SRC_SIZE;
+    uint32_t rng = 1;
+
+    for (int round = 0; round < rounds; round++) {
+        const int32_t w = 1 + bsp_blend_rand(&rng) % BSP_BLEND_CHECK_W;
+        const int32_t h = 1 + bsp_blend_rand(&rng) % BSP_BLEND_CHECK_H;
+        const int32_t stride = (w + bsp_blend_rand(&rng) % 9) * 2;
+        const int32_t offset = (bsp_blend_rand(&rng) % 2) * 2;
+        const uint16_t color = (uint16_t)bsp_blend_rand(&rng);
+        const uint8_t opa = (uint8_t)bsp_blend_rand(&rng);
+        uint16_t *da = (uint16_t *)(a + offset);
+        uint16_t *db = (uint16_t *)(b + offset);
+        const uint16_t *s16 = (const uint16_t *)(src + (bsp_blend_rand(&rng) % 2) * 2);
+        const int32_t s16_stride = (w + bsp_blend_rand(&rng) % 9) * 2;
+        const int32_t s32_stride = (w + bsp_blend_rand(&rng) % 9) * 4;
+        const char *kernel;
+
+        bsp_blend_randomize(src, src_size, &rng);
+        for (size_t i = 3; i < src_size; i += 4) {
+            src[i] = bsp_blend_rand_alpha(&rng);
+        }
+
+        for (int n = 0; n < 5; n++) {
+            bsp_blend_randomize(a, dest_size, &rng);
+            /* Repeated pixels exercise the last result cache of the opacity fill */
+            if (bsp_blend_rand(&rng) % 2) {
+                for (size_t i = 0; i + 4 <= dest_size; i += 4) {
+                    memcpy(&a[i], a, 4);
+                }
+            }
+            memcpy(b, a, dest_size);
+            switch (n) {
+            case 0:
+                kernel = "fill";
+                k->fill(da, w, h, stride, color);
+                bsp_blend_ref_fill(db, w, h, stride, color);
+                break;
+            case 1:
+                kernel = "fill_opa";
+                k->fill_opa(da, w, h, stride, color, opa);
+                bsp_blend_ref_fill_opa(db, w, h, stride, color, opa);
+                break;
+            case 2:
+                kernel = "copy";
+                if (k->copy) {
+                    k->copy(da, w, h, stride, s16, s16_stride);
+                    bsp_blend_ref_copy(db, w, h, stride, s16, s16_stride);
+                }
+                break;
+            case 3:
+                kernel = "argb8888";
+                k->argb8888(da, w, h, stride, src, s32_stride);
+                bsp_blend_ref_argb8888(db, w, h, stride, src, s32_stride);
+                break;
+            default:
+                kernel = "swap";
+                k->swap(da, (size_t)w * h);
+                bsp_blend_ref_swap(db, (size_t)w * h);
+                break;
+            }
+            for (size_t i = 0; i < dest_size; i++) {
+                if (a[i] != b[i]) {
+                    *mismatch = (bsp_blend_mismatch_t) {
+                        .kernel = kernel,
+                        .byte = i,
+                        .w = w,
+                        .h = h,
+                        .stride = stride,
+                        .offset = offset,
+                        .color = color,
+                        .opa = opa,
+                    };
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Streaming BMP writer
+ *
+ * Writes a 16 bit RGB565 (BI_BITFIELDS) top-down bitmap area by area, without a frame buffer.
+ * Areas can come in any order, each row is written at its final offset in the file.
+ * Only depends on the C library so it can be built for any target.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BMP_HEADER_SIZE         (14 + 40 + 12)  /* File header, info header, RGB565 masks */
+
+typedef struct {
+    FILE *f;
+    uint16_t width;
+    uint16_t height;
+    uint32_t row_bytes;
+} bmp_writer_t;
+
+/**
+ * @brief Create the file and write the header
+ */
+bool bmp_open(bmp_writer_t *bmp, const char *path, uint16_t width, uint16_t height);
+
+/**
+ * @brief Write the pixels of area (x1, y1)-(x2, y2), clipped to the image
+ *
+ * @param[in] px     First pixel of the area, native endian RGB565
+ * @param[in] stride Pixels per row in `px`
+ */
+bool bmp_write_area(bmp_writer_t *bmp, int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint16_t *px, int32_t stride);
+
+/**
+ * @brief Close the file, returns false if any write failed
+ */
+bool bmp_close(bmp_writer_t *bmp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,215 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief BSP display internals
+ *
+ * Flush hooks let BSP modules look at the pixels LVGL sends to the panel (mirror, screenshots,
+ * metrics) without touching the esp_lvgl_port flush path. Hooks run in the LVGL task, before
+ * the area is handed to the panel driver, and must stay short.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "lvgl.h"
+#include "esp_lcd_touch.h"
+#include "bsp/stall.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_DISPLAY_FLUSH_HOOKS_MAX     (4)
+
+/**
+ * @brief Flush hook
+ *
+ * @param[in] disp     Display being flushed
+ * @param[in] area     Flushed area in the current (rotated) display coordinates
+ * @param[in] px_map   RGB565 pixels of the area, stride is the area width
+ * @param[in] user_ctx User context given to bsp_display_add_flush_hook()
+ */
+typedef void (*bsp_display_flush_hook_t)(lv_display_t *disp, const lv_area_t *area, const uint8_t *px_map, void *user_ctx);
+
+/**
+ * @brief Call `hook` for each area flushed by the display started with bsp_display_start()
+ *
+ * The esp_lvgl_port flush callback is wrapped when the first hook is added.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Display not started
+ *      - ESP_ERR_NO_MEM      BSP_DISPLAY_FLUSH_HOOKS_MAX hooks already added
+ */
+esp_err_t bsp_display_add_flush_hook(bsp_display_flush_hook_t hook, void *user_ctx);
+
+/**
+ * @brief Remove a hook added with bsp_display_add_flush_hook()
+ */
+void bsp_display_remove_flush_hook(bsp_display_flush_hook_t hook, void *user_ctx);
+
+/**
+ * @brief Take over the LVGL tick and the wakeups of the esp_lvgl_port task, see bsp/tickless.h
+ *
+ * Called by bsp_display_start() before bsp_ui_channel_init().
+ *
+ * @param[in] disp  Display
+ * @param[in] indev Touch input device
+ * @param[in] tp    Touch controller, its interrupt drives the touch reads with CONFIG_BSP_DISPLAY_TICKLESS
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_NOT_FOUND   esp_lvgl_port task not found
+ */
+esp_err_t bsp_tickless_init(lv_display_t *disp, lv_indev_t *indev, esp_lcd_touch_handle_t tp);
+
+/**
+ * @brief Hold the BSP PM locks while rendering and while touched, see bsp/pm.h
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_PM is set, initializes PM if not done yet.
+ *
+ * @param[in] disp  Display
+ * @param[in] indev Touch input device
+ * @return
+ *      - ESP_OK              On success
+ *      - Other               bsp_pm_init() failed
+ */
+esp_err_t bsp_pm_display_init(lv_display_t *disp, lv_indev_t *indev);
+
+/**
+ * @brief Start measuring the touch-to-photon latency, see bsp/latency.h
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_LATENCY is set, after the other touch and flush wrappers.
+ *
+ * @param[in] disp  Display
+ * @param[in] indev Touch input device
+ * @param[in] tp    Touch controller, its interrupt callback is chained
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already started
+ *      - ESP_ERR_INVALID_ARG No touch interrupt pin
+ *      - ESP_ERR_NO_MEM      Flush hook could not be added
+ */
+esp_err_t bsp_latency_init(lv_display_t *disp, lv_indev_t *indev, esp_lcd_touch_handle_t tp);
+
+/**
+ * @brief Start watching the lv_timer_handler() passes for stalls, see bsp/stall.h
+ *
+ * Called by bsp_display_start() when CONFIG_BSP_STALL is set.
+ *
+ * @return
+ *      - ESP_OK              On success
+ *      - ESP_ERR_INVALID_STATE Already started
+ *      - Other               Watchdog timer could not be created
+ */
+esp_err_t bsp_stall_init(void);
+
+#if CONFIG_BSP_STALL
+/**
+ * @brief Mark the start of an activity of the LVGL task, for the stall detector
+ *
+ * Must be paired with bsp_stall_leave(). Only stores the arguments, keep it around callbacks.
+ *
+ * @param[in] kind Activity
+ * @param[in] fn   Callback, NULL if unknown
+ * @param[in] obj  Object of the activity, see bsp_stall_kind_t
+ * @param[in] code Event code of BSP_STALL_EVENT, 0 otherwise
+ */
+void bsp_stall_enter(bsp_stall_kind_t kind, const void *fn, const void *obj, uint32_t code);
+
+/**
+ * @brief Mark the end of the innermost activity started with bsp_stall_enter()
+ */
+void bsp_stall_leave(void);
+#else
+static inline void bsp_stall_enter(bsp_stall_kind_t kind, const void *fn, const void *obj, uint32_t code)
+{
+}
+
+static inline void bsp_stall_leave(void)
+{
+}
+#endif /* CONFIG_BSP_STALL */
+
+/**
+ * @brief Take the display lock for the call site, see bsp/display_lock.h
+ *
+ * bsp_display_lock() when CONFIG_BSP_DISPLAY_LOCK_PROFILER is set.
+ *
+ * @param[in] timeout_ms Timeout, 0 waits forever
+ * @param[in] site       Address of the bsp_display_lock() call
+ * @return True if the lock was taken
+ */
+bool bsp_display_lock_take(uint32_t timeout_ms, const void *site);
+
+/**
+ * @brief Give the display lock taken with bsp_display_lock_take(), warns about a long hold
+ */
+void bsp_display_lock_give(void);
+
+#if CONFIG_BSP_DISPLAY_LOCK_PROFILER
+/**
+ * @brief Record the LVGL task as the display lock holder for a lv_timer_handler() pass
+ *
+ * esp_lvgl_port runs every pass under lvgl_port_lock(). Called by the lv_timer_handler() wrapper,
+ * paired with bsp_display_lock_pass_end().
+ */
+void bsp_display_lock_pass_begin(void);
+
+/**
+ * @brief End the hold recorded by bsp_display_lock_pass_begin()
+ */
+void bsp_display_lock_pass_end(void);
+#else
+static inline void bsp_display_lock_pass_begin(void)
+{
+}
+
+static inline void bsp_display_lock_pass_end(void)
+{
+}
+#endif /* CONFIG_BSP_DISPLAY_LOCK_PROFILER */
+
+/* The LVGL task pass, wrapped by the stall detector or the display lock profiler */
+uint32_t __real_lv_timer_handler(void);
+
+/**
+ * @brief Disarm the light sleep wakeup of the touch interrupt, called from the touch ISR
+ */
+void bsp_pm_touch_isr(void);
+
+/**
+ * @brief Keep light sleep off while the backlight PWM is dimmed, it stops in light sleep
+ *
+ * Only needed before ESP-IDF 5.4, which can keep the LEDC running in light sleep.
+ *
+ * @param[in] dimmed Duty is neither 0 nor full
+ */
+void bsp_pm_backlight_dimmed(bool dimmed);
+
+#ifdef __cplusplus
+}
+#endif
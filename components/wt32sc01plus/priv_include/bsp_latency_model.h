@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Touch-to-photon pipeline model
+ *
+ * One touch is followed at a time through the stages of the display pipeline:
+ *
+ *     touch interrupt -> input read -> invalidation -> refresh start -> last flush -> flush done
+ *
+ * The functions take the timestamps as arguments and have no ESP-IDF dependency, the same code runs
+ * in the BSP hooks and in tools/latency_sim.c on Linux. bsp_latency_model_irq() and
+ * bsp_latency_model_flush_ready() may be called from an ISR, the others from the LVGL task only.
+ * Only the touch interrupt leaves IDLE and only the flush ISR enters DONE, so a plain store after a
+ * state check is enough everywhere else.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_LATENCY_MODEL_STAGES    5
+#define BSP_LATENCY_MODEL_BUCKETS   32
+
+typedef enum {
+    BSP_LATENCY_MODEL_IDLE,
+    BSP_LATENCY_MODEL_WAIT_READ,        /* interrupt seen, t[0] */
+    BSP_LATENCY_MODEL_WAIT_INVALIDATE,  /* read by LVGL, t[1] */
+    BSP_LATENCY_MODEL_WAIT_REFRESH,     /* first invalidation, t[2] */
+    BSP_LATENCY_MODEL_RENDERING,        /* refresh started, t[3] */
+    BSP_LATENCY_MODEL_FLUSHING,         /* last area handed to the panel driver, t[4] */
+    BSP_LATENCY_MODEL_DONE,             /* last transfer done, t[5] */
+} bsp_latency_model_state_t;
+
+typedef struct {
+    uint32_t state;             /* bsp_latency_model_state_t */
+    int64_t t[BSP_LATENCY_MODEL_STAGES + 1];
+    uint32_t bucket_us;
+    uint32_t timeout_us;        /* no invalidation within this time after the read: no visible change */
+    /* Completed touches */
+    uint32_t events;
+    uint32_t no_change;
+    uint32_t overlapped;        /* interrupts while a touch was in flight */
+    uint32_t hist[BSP_LATENCY_MODEL_BUCKETS];   /* total latency, the last bucket is open */
+    uint32_t total_min_us;
+    uint32_t total_max_us;
+    uint64_t total_sum_us;
+    uint64_t stage_sum_us[BSP_LATENCY_MODEL_STAGES];
+    uint32_t stage_max_us[BSP_LATENCY_MODEL_STAGES];
+} bsp_latency_model_t;
+
+static inline void bsp_latency_model_init(bsp_latency_model_t *m, uint32_t bucket_us, uint32_t timeout_us)
+{
+    *m = (bsp_latency_model_t) {
+        .bucket_us = bucket_us,
+        .timeout_us = timeout_us,
+        .total_min_us = UINT32_MAX,
+    };
+}
+
+static inline uint32_t bsp_latency_model_state(const bsp_latency_model_t *m)
+{
+    return __atomic_load_n(&m->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void bsp_latency_model_set(bsp_latency_model_t *m, bsp_latency_model_state_t state, int64_t now)
+{
+    if (state != BSP_LATENCY_MODEL_IDLE) {
+        m->t[state - 1] = now;
+    }
+    __atomic_store_n(&m->state, state, __ATOMIC_RELEASE);
+}
+
+/* Touch controller interrupt */
+static inline void bsp_latency_model_irq(bsp_latency_model_t *m, int64_t now)
+{
+    if (bsp_latency_model_state(m) == BSP_LATENCY_MODEL_IDLE) {
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_WAIT_READ, now);
+    } else {
+        __atomic_fetch_add(&m->overlapped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Input device read done, returns true for the first read after the interrupt */
+static inline bool bsp_latency_model_read(bsp_latency_model_t *m, int64_t now)
+{
+    if (bsp_latency_model_state(m) != BSP_LATENCY_MODEL_WAIT_READ) {
+        return false;
+    }
+    bsp_latency_model_set(m, BSP_LATENCY_MODEL_WAIT_INVALIDATE, now);
+    return true;
+}
+
+/* An area of the display was invalidated */
+static inline void bsp_latency_model_invalidate(bsp_latency_model_t *m, int64_t now)
+{
+    if (bsp_latency_model_state(m) == BSP_LATENCY_MODEL_WAIT_INVALIDATE) {
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_WAIT_REFRESH, now);
+    }
+}
+
+/* Display refresh started */
+static inline void bsp_latency_model_refr_start(bsp_latency_model_t *m, int64_t now)
+{
+    if (bsp_latency_model_state(m) == BSP_LATENCY_MODEL_WAIT_REFRESH) {
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_RENDERING, now);
+    }
+}
+
+/* An area is handed to the panel driver, before the transfer is started */
+static inline void bsp_latency_model_flush(bsp_latency_model_t *m, int64_t now, bool last)
+{
+    if (last && bsp_latency_model_state(m) == BSP_LATENCY_MODEL_RENDERING) {
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_FLUSHING, now);
+    }
+}
+
+/* Transfer of an area done */
+static inline void bsp_latency_model_flush_ready(bsp_latency_model_t *m, int64_t now)
+{
+    if (bsp_latency_model_state(m) == BSP_LATENCY_MODEL_FLUSHING) {
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_DONE, now);
+    }
+}
+
+static inline void bsp_latency_model_record(bsp_latency_model_t *m)
+{
+    const uint32_t total = (uint32_t)(m->t[BSP_LATENCY_MODEL_STAGES] - m->t[0]);
+    uint32_t bucket = total / m->bucket_us;
+
+    if (bucket >= BSP_LATENCY_MODEL_BUCKETS) {
+        bucket = BSP_LATENCY_MODEL_BUCKETS - 1;
+    }
+    m->hist[bucket]++;
+    m->events++;
+    m->total_sum_us += total;
+    m->total_min_us = total < m->total_min_us ? total : m->total_min_us;
+    m->total_max_us = total > m->total_max_us ? total : m->total_max_us;
+    for (int i = 0; i < BSP_LATENCY_MODEL_STAGES; i++) {
+        const uint32_t us = (uint32_t)(m->t[i + 1] - m->t[i]);
+        m->stage_sum_us[i] += us;
+        m->stage_max_us[i] = us > m->stage_max_us[i] ? us : m->stage_max_us[i];
+    }
+}
+
+/*
+ * Collect a completed touch and drop one that did not change the screen. Called after each refresh
+ * and each input read.
+ */
+static inline void bsp_latency_model_poll(bsp_latency_model_t *m, int64_t now, bool refreshed)
+{
+    switch (bsp_latency_model_state(m)) {
+    case BSP_LATENCY_MODEL_DONE:
+        bsp_latency_model_record(m);
+        bsp_latency_model_set(m, BSP_LATENCY_MODEL_IDLE, now);
+        break;
+    case BSP_LATENCY_MODEL_WAIT_READ:
+    case BSP_LATENCY_MODEL_WAIT_INVALIDATE:
+        if (now - m->t[bsp_latency_model_state(m) - 1] > m->timeout_us) {
+            m->no_change++;
+            bsp_latency_model_set(m, BSP_LATENCY_MODEL_IDLE, now);
+        }
+        break;
+    case BSP_LATENCY_MODEL_RENDERING:
+        /* The invalidated area was not flushed (hidden or clipped) */
+        if (refreshed) {
+            m->no_change++;
+            bsp_latency_model_set(m, BSP_LATENCY_MODEL_IDLE, now);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Modbus RTU master poll scheduler and transactions
+ *
+ * The poll merging, the pipelined request planning and the request/response checks behind the
+ * master of bsp/modbus.h. No ESP-IDF dependency, the port and the clock are reached through
+ * modbus_master_io_t: bsp_modbus_master.c runs it on the RS485 UART from the master task and
+ * tools/modbus_pty_check.c on Linux against a simulated slave on a pseudo-terminal.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "bsp_modbus_rtu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Serial port and clock used by the master
+ *
+ * Functions returning int return 0 on success, like ESP_OK.
+ */
+typedef struct {
+    /* Transmit a frame, return after the last bit left the line driver */
+    int (*write)(void *ctx, const uint8_t *frame, size_t len);
+    /* Receive one frame as bsp_rs485_read_frame(): 0 and `*ret_len` == 0 on timeout */
+    int (*read_frame)(void *ctx, uint8_t *buf, size_t size, uint32_t timeout_ms, size_t *ret_len);
+    /* Drop received and not yet read data */
+    void (*flush_input)(void *ctx);
+    /* Monotonic time */
+    int64_t (*now_us)(void *ctx);
+    /* Return no earlier than `deadline_us`, at once if it passed */
+    void (*wait_until_us)(void *ctx, int64_t deadline_us);
+    void *ctx;
+} modbus_master_io_t;
+
+typedef struct {
+    uint8_t slave;
+    uint8_t function;           /* MODBUS_FC_READ_HOLDING or MODBUS_FC_READ_INPUT */
+    uint16_t address;
+    uint32_t period_ms;         /* Must not be 0 */
+    size_t id;                  /* Index in the user poll table */
+    int64_t next_due_us;
+} modbus_master_entry_t;
+
+typedef struct {
+    volatile uint16_t value;
+    volatile uint32_t updated_ms;
+    volatile bool valid;
+} modbus_master_cache_t;
+
+typedef struct {
+    uint8_t frame[8];
+    size_t len;
+    size_t first;               /* Range of sorted poll entries served by the request */
+    size_t last;
+    uint16_t start;
+    uint16_t count;
+} modbus_request_t;
+
+/* Same fields as bsp_modbus_master_stats_t */
+typedef struct {
+    uint32_t requests;
+    uint32_t writes;
+    uint32_t timeouts;
+    uint32_t crc_errors;
+    uint32_t exceptions;
+    uint32_t bad_responses;
+    uint32_t merged;
+    uint32_t late;
+    uint32_t last_rtt_us;
+    uint32_t max_rtt_us;
+} modbus_master_stats_t;
+
+typedef struct {
+    /* Set by the user, then call modbus_master_init() */
+    modbus_master_io_t io;
+    modbus_master_entry_t *entries;     /* `num` polls with next_due_us set */
+    modbus_master_cache_t *cache;       /* `num` zeroed entries, indexed by poll id */
+    size_t num;
+    uint32_t baud_rate;
+    uint32_t response_timeout_ms;
+    uint16_t max_merge_gap;             /* Max. number of unused registers read to merge two polls */
+    void (*on_change)(size_t id, uint16_t value, void *user_ctx);
+    void *user_ctx;
+
+    /* Private */
+    uint32_t t35_us;
+    int64_t bus_idle_us;                /* Earliest start of the next frame */
+    int64_t sent_us;                    /* End of the last transmitted request */
+    modbus_request_t req[2];            /* Request on the wire and the one planned meanwhile */
+    int cur;
+    bool have;
+    modbus_master_stats_t stats;
+    uint8_t rx[MODBUS_RTU_MAX_FRAME];
+} modbus_master_t;
+
+/**
+ * @brief Sort the poll entries by slave, function and address and reset the bus timing
+ */
+void modbus_master_init(modbus_master_t *m);
+
+/**
+ * @brief Time the next poll is due, INT64_MAX without polls
+ */
+int64_t modbus_master_next_due(const modbus_master_t *m);
+
+/**
+ * @brief Build the request for the most overdue poll, merged with its neighbours
+ *
+ * Advances the due time of every poll the request serves.
+ *
+ * @return false if no poll is due at `now`
+ */
+bool modbus_master_plan(modbus_master_t *m, int64_t now, modbus_request_t *req);
+
+/**
+ * @brief Send the next due request and receive its response into the cache
+ *
+ * The request after it is planned while the response is on the wire.
+ *
+ * @return false if no poll is due
+ */
+bool modbus_master_poll(modbus_master_t *m);
+
+/**
+ * @brief Write a single holding register
+ *
+ * @return false if the request could not be sent or was not acknowledged, broadcasts (slave 0)
+ *         are not acknowledged
+ */
+bool modbus_master_write_single(modbus_master_t *m, uint8_t slave, uint16_t address, uint16_t value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Modbus RTU framing shared by the BSP Modbus master and slave.
+ * Only depends on the C library so it can be built for any target.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MODBUS_RTU_MAX_FRAME            (256)
+#define MODBUS_RTU_MAX_READ_REGS        (125)
+#define MODBUS_RTU_MAX_WRITE_REGS       (123)
+#define MODBUS_RTU_MIN_FRAME            (4)     /* Address, function, CRC */
+
+#define MODBUS_FC_READ_HOLDING          (0x03)
+#define MODBUS_FC_READ_INPUT            (0x04)
+#define MODBUS_FC_WRITE_SINGLE          (0x06)
+#define MODBUS_FC_WRITE_MULTIPLE        (0x10)
+#define MODBUS_FC_EXCEPTION             (0x80)
+
+#define MODBUS_EX_ILLEGAL_FUNCTION      (0x01)
+#define MODBUS_EX_ILLEGAL_ADDRESS       (0x02)
+#define MODBUS_EX_ILLEGAL_VALUE         (0x03)
+#define MODBUS_EX_DEVICE_FAILURE        (0x04)
+
+static inline uint16_t modbus_rtu_get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void modbus_rtu_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+/**
+ * @brief Modbus CRC16 (polynomial 0xA001, initial value 0xFFFF)
+ */
+uint16_t modbus_rtu_crc16(const uint8_t *data, size_t len);
+
+/**
+ * @brief Append CRC to a frame of `len` bytes, returns the new length
+ */
+size_t modbus_rtu_seal(uint8_t *frame, size_t len);
+
+/**
+ * @brief Frame is at least MODBUS_RTU_MIN_FRAME bytes long and the CRC matches
+ */
+bool modbus_rtu_crc_ok(const uint8_t *frame, size_t len);
+
+/**
+ * @brief Silent interval between frames (t3.5) in microseconds
+ *
+ * Fixed to 1750 us above 19200 baud as required by the Modbus serial line specification.
+ */
+uint32_t modbus_rtu_t35_us(uint32_t baud_rate);
+
+/**
+ * @brief Time to transmit `bytes` bytes (11 bits per character) in microseconds
+ */
+uint32_t modbus_rtu_frame_us(uint32_t baud_rate, size_t bytes);
+
+/**
+ * @brief Build a read holding/input registers request, returns the frame length
+ */
+size_t modbus_rtu_build_read(uint8_t *frame, uint8_t slave, uint8_t function, uint16_t address, uint16_t count);
+
+/**
+ * @brief Build a write single register request, returns the frame length
+ */
+size_t modbus_rtu_build_write_single(uint8_t *frame, uint8_t slave, uint16_t address, uint16_t value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Touch sequence and latency histogram of the monkey benchmark
+ *
+ * The seeded touch sequence and the log-linear histogram behind bsp/monkey.h. No ESP-IDF or LVGL
+ * dependency: bsp_monkey.c drives an input device with them on the target and tools/monkey_check.c
+ * replays seeds on Linux, so a sequence seen on the board can be reproduced and bisected on the host.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSP_MONKEY_PRESS_PCT_DEFAULT    25
+#define BSP_MONKEY_HOLD_MAX_DEFAULT     20
+#define BSP_MONKEY_DRAG_STEP            24      /* Largest move per read while dragging, pixels */
+/* Log-linear histogram, 16 sub-buckets per power of two: exact below 16 us, 1/16 resolution above */
+#define BSP_MONKEY_HIST_SUB_BITS        4
+#define BSP_MONKEY_HIST_SIZE            ((32 - BSP_MONKEY_HIST_SUB_BITS + 1) << BSP_MONKEY_HIST_SUB_BITS)
+
+/* Touch sequence state, advanced once per input device read */
+typedef struct {
+    uint32_t rng;
+    int32_t hor_res;
+    int32_t ver_res;
+    uint8_t press_pct;
+    uint8_t hold_max;
+    int32_t x;
+    int32_t y;
+    bool pressed;
+    bool drag;
+    uint32_t hold;              /* Reads left in the current touch */
+} bsp_monkey_seq_t;
+
+typedef struct {
+    uint32_t bucket[BSP_MONKEY_HIST_SIZE];
+    uint32_t count;
+    uint32_t max;
+} bsp_monkey_hist_t;
+
+/* xorshift32, the same sequence on every platform */
+static inline uint32_t bsp_monkey_rand(bsp_monkey_seq_t *seq, uint32_t range)
+{
+    uint32_t x = seq->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    seq->rng = x;
+    return x % range;
+}
+
+/* press_pct and hold_max of 0 select the defaults */
+static inline void bsp_monkey_seq_init(bsp_monkey_seq_t *seq, uint32_t seed, int32_t hor_res, int32_t ver_res,
+                                       uint8_t press_pct, uint8_t hold_max)
+{
+    *seq = (bsp_monkey_seq_t) {
+        .rng = seed ? seed : 1,     /* xorshift must not start at 0 */
+        .hor_res = hor_res,
+        .ver_res = ver_res,
+        .press_pct = press_pct ? press_pct : BSP_MONKEY_PRESS_PCT_DEFAULT,
+        .hold_max = hold_max ? hold_max : BSP_MONKEY_HOLD_MAX_DEFAULT,
+    };
+}
+
+/* Next read: taps, long presses and drags; returns true when the touch was pressed or released */
+static inline bool bsp_monkey_seq_step(bsp_monkey_seq_t *seq)
+{
+    if (!seq->pressed) {
+        if (bsp_monkey_rand(seq, 100) >= seq->press_pct) {
+            return false;
+        }
+        seq->x = bsp_monkey_rand(seq, seq->hor_res);
+        seq->y = bsp_monkey_rand(seq, seq->ver_res);
+        seq->hold = 1 + bsp_monkey_rand(seq, seq->hold_max);
+        seq->drag = bsp_monkey_rand(seq, 4) == 0;
+        seq->pressed = true;
+        return true;
+    }
+    if (seq->drag) {
+        seq->x += (int32_t)bsp_monkey_rand(seq, 2 * BSP_MONKEY_DRAG_STEP + 1) - BSP_MONKEY_DRAG_STEP;
+        seq->y += (int32_t)bsp_monkey_rand(seq, 2 * BSP_MONKEY_DRAG_STEP + 1) - BSP_MONKEY_DRAG_STEP;
+        seq->x = seq->x < 0 ? 0 : seq->x >= seq->hor_res ? seq->hor_res - 1 : seq->x;
+        seq->y = seq->y < 0 ? 0 : seq->y >= seq->ver_res ? seq->ver_res - 1 : seq->y;
+    }
+    if (--seq->hold == 0) {
+        seq->pressed = false;
+        return true;
+    }
+    return false;
+}
+
+static inline int bsp_monkey_hist_index(uint32_t us)
+{
+    if (us < (1 << BSP_MONKEY_HIST_SUB_BITS)) {
+        return us;
+    }
+    const int msb = 31 - __builtin_clz(us);
+    const int shift = msb - BSP_MONKEY_HIST_SUB_BITS;
+    return ((shift + 1) << BSP_MONKEY_HIST_SUB_BITS) + ((us >> shift) & ((1 << BSP_MONKEY_HIST_SUB_BITS) - 1));
+}
+
+/* Largest value that falls into bucket i */
+static inline uint32_t bsp_monkey_hist_value(int i)
+{
+    if (i < (1 << BSP_MONKEY_HIST_SUB_BITS)) {
+        return i;
+    }
+    const int shift = (i >> BSP_MONKEY_HIST_SUB_BITS) - 1;
+    const uint64_t low = (uint64_t)((1 << BSP_MONKEY_HIST_SUB_BITS) + (i & ((1 << BSP_MONKEY_HIST_SUB_BITS) - 1))) << shift;
+    const uint64_t high = low + (1ULL << shift) - 1;
+    return high > UINT32_MAX ? UINT32_MAX : (uint32_t)high;
+}
+
+static inline void bsp_monkey_hist_add(bsp_monkey_hist_t *hist, uint32_t us)
+{
+    hist->bucket[bsp_monkey_hist_index(us)]++;
+    hist->count++;
+    hist->max = us > hist->max ? us : hist->max;
+}
+
+/*
+ * Nearest rank percentiles: the smallest value with at least pct[i] % of the samples at or below it,
+ * rounded up to the end of its bucket and capped at the largest sample. pct must be ascending.
+ */
+static inline void bsp_monkey_hist_percentiles(const bsp_monkey_hist_t *hist, const uint32_t *pct, uint32_t *out, int n)
+{
+    uint32_t seen = 0;
+    int p = 0;
+
+    for (int i = 0; i < BSP_MONKEY_HIST_SIZE && p < n && hist->count; i++) {
+        seen += hist->bucket[i];
+        while (p < n && (uint64_t)seen * 100 >= (uint64_t)hist->count * pct[p]) {
+            const uint32_t value = bsp_monkey_hist_value(i);
+            out[p++] = value < hist->max ? value : hist->max;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
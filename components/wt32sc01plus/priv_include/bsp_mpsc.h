@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2024 Sukesh Ashok Kumar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file
+ * @brief Bounded lock-free multi producer, single consumer queue
+ *
+ * Producers claim a slot with a CAS on the enqueue position, fill the payload kept by the caller
+ * in its own array at index `pos % len` and publish it. Each slot carries a sequence number telling
+ * whether it is free or published, so producers never wait on each other or on the consumer.
+ * Producers may run on both cores, but not in an ISR that interrupts a producer on the same core
+ * (it could spin on a slot claimed but not yet published).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t *seq;          /* One sequence number per slot */
+    uint32_t len;           /* Power of two */
+    uint32_t enqueue_pos;
+    uint32_t dequeue_pos;   /* Consumer only */
+} bsp_mpsc_t;
+
+static inline void bsp_mpsc_init(bsp_mpsc_t *q, uint32_t *seq, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        seq[i] = i;
+    }
+    q->seq = seq;
+    q->len = len;
+    q->dequeue_pos = 0;
+    __atomic_store_n(&q->enqueue_pos, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Claim a slot, returns false when the queue is full
+ *
+ * The payload at `*ret_pos % len` must be filled and then published with bsp_mpsc_publish().
+ */
+static inline bool bsp_mpsc_claim(bsp_mpsc_t *q, uint32_t *ret_pos)
+{
+    uint32_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        const int32_t diff = (int32_t)(__atomic_load_n(&q->seq[pos & (q->len - 1)], __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *ret_pos = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline void bsp_mpsc_publish(bsp_mpsc_t *q, uint32_t pos)
+{
+    __atomic_store_n(&q->seq[pos & (q->len - 1)], pos + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer: the oldest slot is published, its payload is at `*ret_pos % len`
+ */
+static inline bool bsp_mpsc_peek(bsp_mpsc_t *q, uint32_t *ret_pos)
+{
+    const uint32_t pos = q->dequeue_pos;
+
+    if (__atomic_load_n(&q->seq[pos & (q->len - 1)], __ATOMIC_ACQUIRE) != pos + 1) {
+        return false;
+    }
+    *ret_pos = pos;
+    return true;
+}
+
+/**
+ * @brief Consumer: done with the payload returned by bsp_mpsc_peek(), hand the slot back to producers
+ */
+static inline void bsp_mpsc_release(bsp_mpsc_t *q)
+{
+    const uint32_t pos = q->dequeue_pos;
+
+    __atomic_store_n(&q->seq[pos & (q->len - 1)], pos + q->len, __ATOMIC_RELEASE);
+    q->dequeue_pos = pos + 1;
+}
+
+/**
+ * @brief Claimed slots not yet released by the consumer
+ */
+static inline uint32_t bsp_mpsc_depth(const bsp_mpsc_t *q)
+{
+    return __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED) - q->dequeue_pos;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -22,7 +22,11 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <assert.h>
+#include <string.h>
 #include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_idf_version.h"
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "driver/spi_master.h"
@@ -37,10 +41,20 @@ SOFTWARE.
 #include "esp_lvgl_port.h"
 #include "esp_vfs_fat.h"
 #include "bsp_err_check.h"
+#include "bsp_display_priv.h"
+#include "display/lv_display_private.h"
+#include "indev/lv_indev_private.h"
 #include "esp_spiffs.h"
 
 static const char *TAG = "WT32SC01_Plus";
 
+/* Swap the RGB565 bytes with the BSP kernel in the flush callback instead of esp_lvgl_port */
+#if BSP_LCD_SW_SWAP_BYTES && CONFIG_BSP_BLEND_FAST
+#define BSP_DISPLAY_FAST_SWAP   1
+#else
+#define BSP_DISPLAY_FAST_SWAP   0
+#endif
+
 static lv_display_t *disp;
 static lv_indev_t *disp_indev = NULL;
 static esp_lcd_touch_handle_t tp;   // LCD touch handle
@@ -48,6 +62,22 @@ static esp_lcd_panel_handle_t panel_handle = NULL;
 
 sdmmc_card_t *bsp_sdcard = NULL;
 
+static struct {
+    lv_display_flush_cb_t port_flush_cb;    /* esp_lvgl_port flush callback, wrapped once a hook is added */
+    struct {
+        bsp_display_flush_hook_t hook;
+        void *user_ctx;
+    } hooks[BSP_DISPLAY_FLUSH_HOOKS_MAX];
+    size_t hook_count;
+} s_flush;
+
+static void bsp_display_wrap_flush_cb(void);
+
+#if CONFIG_BSP_PROFILER
+static lv_indev_read_cb_t s_touch_read_cb;     /* esp_lvgl_port touch read callback, wrapped by the profiler */
+static void bsp_display_profile_stages(void);
+#endif
+
 esp_err_t bsp_i2c_init(void) {
     const i2c_config_t i2c_conf = {
         .mode = I2C_MODE_MASTER,
@@ -106,6 +136,10 @@ esp_err_t bsp_spiffs_unmount(void)
 
 esp_err_t bsp_sdcard_mount(void)
 {
+#if !BSP_CAPS_SDCARD
+    ESP_LOGE(TAG, "No SD card slot on " BSP_BOARD_NAME);
+    return ESP_ERR_NOT_SUPPORTED;
+#else
     const esp_vfs_fat_sdmmc_mount_config_t mount_config = {
 #ifdef CONFIG_BSP_SD_FORMAT_ON_MOUNT_FAIL
         .format_if_mount_failed = true,
@@ -133,12 +167,19 @@ esp_err_t bsp_sdcard_mount(void)
     slot_config.gpio_cs = BSP_SD_CS;
     slot_config.host_id = host.slot;
 
-    return esp_vfs_fat_sdspi_mount(BSP_SD_MOUNT_POINT, &host, &slot_config, &mount_config, &bsp_sdcard);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    esp_err_t ret = esp_vfs_fat_sdspi_mount(BSP_SD_MOUNT_POINT, &host, &slot_config, &mount_config, &bsp_sdcard);
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    return ret;
+#endif
 }
 
 esp_err_t bsp_sdcard_unmount(void)
 {
-    return esp_vfs_fat_sdcard_unmount(BSP_SD_MOUNT_POINT, bsp_sdcard);
+    bsp_pm_lock_acquire(BSP_PM_LOCK_STORAGE);
+    esp_err_t ret = esp_vfs_fat_sdcard_unmount(BSP_SD_MOUNT_POINT, bsp_sdcard);
+    bsp_pm_lock_release(BSP_PM_LOCK_STORAGE);
+    return ret;
 }
 
 
@@ -157,6 +198,16 @@ lv_indev_t *bsp_display_indev_init(lv_display_t *disp) {
 }
 
 
+#if CONFIG_BSP_PM
+/* The backlight PWM only survives light sleep with the LEDC sleep modes of ESP-IDF 5.4,
+ * older versions keep light sleep off while it is dimmed */
+#define BSP_BACKLIGHT_SLEEP_KEEP_ALIVE (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0))
+#define BSP_BACKLIGHT_PM_LOCK (CONFIG_BSP_PM_LIGHT_SLEEP && !BSP_BACKLIGHT_SLEEP_KEEP_ALIVE)
+#else
+#define BSP_BACKLIGHT_SLEEP_KEEP_ALIVE 0
+#define BSP_BACKLIGHT_PM_LOCK 0
+#endif
+
 static esp_err_t bsp_display_brightness_init(void)
 {
     // Setup LEDC peripheral for PWM backlight control
@@ -167,14 +218,22 @@ static esp_err_t bsp_display_brightness_init(void)
         .intr_type = LEDC_INTR_DISABLE,
         .timer_sel = 1,
         .duty = 0,
-        .hpoint = 0
+        .hpoint = 0,
+#if BSP_BACKLIGHT_SLEEP_KEEP_ALIVE
+        .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+#endif
     };
     const ledc_timer_config_t LCD_backlight_timer = {
         .speed_mode = LEDC_LOW_SPEED_MODE,
         .duty_resolution = LEDC_TIMER_10_BIT,
         .timer_num = 1,
         .freq_hz = 5000,
+#if CONFIG_BSP_PM
+        // APB follows the CPU frequency with DFS, RC_FAST does not
+        .clk_cfg = LEDC_USE_RC_FAST_CLK
+#else
         .clk_cfg = LEDC_AUTO_CLK
+#endif
     };
 
     BSP_ERROR_CHECK_RETURN_ERR(ledc_timer_config(&LCD_backlight_timer));
@@ -205,9 +264,17 @@ esp_err_t bsp_display_brightness_set(int percent)
     }
 
     ESP_LOGI(TAG, "Setting LCD backlight: %d%%", percent);
-    uint32_t duty_cycle = (1023 * percent) / 100; // LEDC resolution set to 10bits, thus: 100% = 1023
-    BSP_ERROR_CHECK_RETURN_ERR(ledc_set_duty(LEDC_LOW_SPEED_MODE, LCD_LEDC_CH, duty_cycle));
-    BSP_ERROR_CHECK_RETURN_ERR(ledc_update_duty(LEDC_LOW_SPEED_MODE, LCD_LEDC_CH));
+    uint32_t duty_cycle = (1024 * percent) / 100; // LEDC resolution set to 10bits, 1024 holds the output high
+    BSP_PROFILER_BEGIN_TAG("bsp_brightness");
+    esp_err_t ret = ledc_set_duty(LEDC_LOW_SPEED_MODE, LCD_LEDC_CH, duty_cycle);
+    if (ret == ESP_OK) {
+        ret = ledc_update_duty(LEDC_LOW_SPEED_MODE, LCD_LEDC_CH);
+    }
+    BSP_PROFILER_END_TAG("bsp_brightness");
+    BSP_ERROR_CHECK_RETURN_ERR(ret);
+#if BSP_BACKLIGHT_PM_LOCK
+    bsp_pm_backlight_dimmed(percent > 0 && percent < 100);
+#endif
 
     return ESP_OK;
 }
@@ -222,9 +289,9 @@ esp_err_t bsp_display_backlight_on(void)
     return bsp_display_brightness_set(100);
 }
 
-lv_display_t *bsp_display_start(void) 
+#if BSP_LCD_BUS_I80
+static esp_err_t bsp_display_bus_new(esp_lcd_panel_io_handle_t *ret_io)
 {
-    
     ESP_LOGD(TAG, "Initialize Intel 8080 bus");
     /* Init Intel 8080 bus */
     esp_lcd_i80_bus_handle_t i80_bus = NULL;
@@ -247,10 +314,9 @@ lv_display_t *bsp_display_start(void)
         .psram_trans_align = 64,
         .sram_trans_align = 4,
     };
-    BSP_ERROR_CHECK_RETURN_NULL(esp_lcd_new_i80_bus(&bus_config, &i80_bus));
+    BSP_ERROR_CHECK_RETURN_ERR(esp_lcd_new_i80_bus(&bus_config, &i80_bus));
 
     ESP_LOGD(TAG, "Install panel IO");
-    esp_lcd_panel_io_handle_t io_handle = NULL;
     esp_lcd_panel_io_i80_config_t io_config = {
         .cs_gpio_num = BSP_LCD_CS,
         .pclk_hz = BSP_LCD_PIXEL_CLOCK_HZ,
@@ -268,14 +334,51 @@ lv_display_t *bsp_display_start(void)
         .lcd_cmd_bits = LCD_CMD_BITS,
         .lcd_param_bits = LCD_PARAM_BITS,
     };
-    BSP_ERROR_CHECK_RETURN_NULL(esp_lcd_new_panel_io_i80(i80_bus, &io_config, &io_handle));
+    BSP_ERROR_CHECK_RETURN_ERR(esp_lcd_new_panel_io_i80(i80_bus, &io_config, ret_io));
+    return ESP_OK;
+}
+#elif BSP_LCD_BUS_SPI
+static esp_err_t bsp_display_bus_new(esp_lcd_panel_io_handle_t *ret_io)
+{
+    ESP_LOGD(TAG, "Initialize SPI bus");
+    const spi_bus_config_t bus_config = {
+        .sclk_io_num = BSP_LCD_SCLK,
+        .mosi_io_num = BSP_LCD_MOSI,
+        .miso_io_num = GPIO_NUM_NC,
+        .quadwp_io_num = GPIO_NUM_NC,
+        .quadhd_io_num = GPIO_NUM_NC,
+        .max_transfer_sz = BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_LINES * sizeof(uint16_t),
+    };
+    BSP_ERROR_CHECK_RETURN_ERR(spi_bus_initialize(BSP_LCD_SPI_NUM, &bus_config, SPI_DMA_CH_AUTO));
+
+    ESP_LOGD(TAG, "Install panel IO");
+    const esp_lcd_panel_io_spi_config_t io_config = {
+        .cs_gpio_num = BSP_LCD_CS,
+        .dc_gpio_num = BSP_LCD_DC,
+        .spi_mode = 0,
+        .pclk_hz = BSP_LCD_PIXEL_CLOCK_HZ,
+        .trans_queue_depth = 10,
+        .lcd_cmd_bits = LCD_CMD_BITS,
+        .lcd_param_bits = LCD_PARAM_BITS,
+    };
+    BSP_ERROR_CHECK_RETURN_ERR(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)BSP_LCD_SPI_NUM, &io_config, ret_io));
+    return ESP_OK;
+}
+#else
+#error "bsp/board.h selects no LCD bus"
+#endif
+
+lv_display_t *bsp_display_start(void) 
+{
+    esp_lcd_panel_io_handle_t io_handle = NULL;
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_display_bus_new(&io_handle));
 
     ESP_LOGD(TAG, "Install LCD driver of ST7796");
     //esp_lcd_panel_handle_t panel_handle = NULL;
     esp_lcd_panel_dev_config_t panel_config = {
         .reset_gpio_num = BSP_LCD_RST,
-        .rgb_endian = LCD_RGB_ENDIAN_BGR,
-        .bits_per_pixel = 16,
+        .rgb_endian = BSP_LCD_RGB_ENDIAN,
+        .bits_per_pixel = BSP_LCD_BITS_PER_PIXEL,
     };
     BSP_ERROR_CHECK_RETURN_NULL(esp_lcd_new_panel_st7796(io_handle, &panel_config, &panel_handle));
 
@@ -284,8 +387,8 @@ lv_display_t *bsp_display_start(void)
     
     // Set inversion, x/y coordinate order, x/y mirror according to your LCD module spec
     // the gap is LCD panel specific, even panels with the same driver IC, can have different gap value
-    esp_lcd_panel_invert_color(panel_handle, true);
-    esp_lcd_panel_mirror(panel_handle, true, false);
+    esp_lcd_panel_invert_color(panel_handle, BSP_LCD_INVERT_COLOR);
+    esp_lcd_panel_mirror(panel_handle, BSP_LCD_MIRROR_X, BSP_LCD_MIRROR_Y);
 
     // user can flush pre-defined pattern to the screen before we turn on the screen or backlight
     BSP_ERROR_CHECK_RETURN_NULL(esp_lcd_panel_disp_on_off(panel_handle, false));
@@ -295,7 +398,7 @@ lv_display_t *bsp_display_start(void)
     const lvgl_port_display_cfg_t disp_cfg = {
         .io_handle = io_handle,
         .panel_handle = panel_handle,
-        .buffer_size = BSP_LCD_H_RES * 100,
+        .buffer_size = BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_LINES,
         .double_buffer = true,
         .hres = BSP_LCD_H_RES,
         .vres = BSP_LCD_V_RES,
@@ -303,14 +406,14 @@ lv_display_t *bsp_display_start(void)
         /* Rotation values must be same as used in esp_lcd for initial settings of the screen */
         .rotation = {
             .swap_xy = false,
-            .mirror_x = true,
-            .mirror_y = false,
+            .mirror_x = BSP_LCD_MIRROR_X,
+            .mirror_y = BSP_LCD_MIRROR_Y,
         },
         .flags = {
             .buff_dma = true,
             .buff_spiram = false,
             //.sw_rotate = 
-            //.swap_bytes
+            .swap_bytes = BSP_LCD_SW_SWAP_BYTES && !BSP_DISPLAY_FAST_SWAP,
         }
     };
 
@@ -327,12 +430,62 @@ lv_display_t *bsp_display_start(void)
     return bsp_display_start_with_config(&cfg);
 */
 
-    const lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+#if CONFIG_BSP_DISPLAY_TICKLESS
+    lvgl_cfg.task_max_sleep_ms = CONFIG_BSP_DISPLAY_TICKLESS_MAX_SLEEP_MS;
+    /* LVGL reads the tick from esp_timer (bsp_tickless_init), the lv_tick_inc() timer only keeps the CPU
+       awake. Slowed down rather than stopped: lvgl_port_stop() also pauses the LVGL timers */
+    lvgl_cfg.timer_period_ms = CONFIG_BSP_DISPLAY_TICKLESS_MAX_SLEEP_MS;
+#endif
     BSP_ERROR_CHECK_RETURN_NULL(lvgl_port_init(&lvgl_cfg));
     BSP_NULL_CHECK(disp = lvgl_port_add_disp(&disp_cfg), NULL);
     BSP_NULL_CHECK(disp_indev = bsp_display_indev_init(disp),NULL);
 
     BSP_ERROR_CHECK_RETURN_NULL(bsp_display_brightness_init());
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_tickless_init(disp, disp_indev, tp));
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_ui_channel_init(disp));
+#if BSP_DISPLAY_FAST_SWAP
+    bsp_display_lock(0);
+    bsp_display_wrap_flush_cb();
+    bsp_display_unlock();
+#endif
+#if CONFIG_BSP_PROFILER
+    bsp_display_profile_stages();
+#endif
+#if CONFIG_BSP_METRICS_ENABLE
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_metrics_start(disp));
+#endif
+#if CONFIG_BSP_REFR_GOVERNOR
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_refr_governor_start(disp, disp_indev));
+#endif
+#if CONFIG_BSP_PM
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_pm_display_init(disp, disp_indev));
+#endif
+#if CONFIG_BSP_DISPLAY_LOW_MEMORY
+    bsp_ram_budget_print(stdout);
+#endif
+#if CONFIG_BSP_DMA_COPY
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_dma_copy_init());
+#endif
+#if CONFIG_BSP_LATENCY
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_latency_init(disp, disp_indev, tp));
+#endif
+#if CONFIG_BSP_STALL
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_stall_init());
+#endif
+#if CONFIG_BSP_BITMAP_CACHE_SELFTEST
+    bsp_display_lock(0);
+    const esp_err_t bitmap_ret = bsp_bitmap_cache_selftest();
+    bsp_display_unlock();
+    BSP_ERROR_CHECK_RETURN_NULL(bitmap_ret);
+#endif
+#if CONFIG_BSP_BLEND_SELFTEST
+    BSP_ERROR_CHECK_RETURN_NULL(bsp_blend_selftest());
+    bsp_blend_bench(stdout);
+#if CONFIG_BSP_DMA_COPY
+    bsp_dma_copy_bench(stdout);
+#endif
+#endif
     return disp;    
 }
 
@@ -387,6 +540,94 @@ void bsp_display_rotate(lv_disp_t *disp, lv_display_rotation_t rotation)
     lv_disp_set_rotation(disp, rotation);
 }
 
+static void bsp_display_flush_cb(lv_display_t *drv, const lv_area_t *area, uint8_t *px_map)
+{
+    BSP_PROFILER_BEGIN_TAG("bsp_flush");
+    for (size_t i = 0; i < s_flush.hook_count; i++) {
+        s_flush.hooks[i].hook(drv, area, px_map, s_flush.hooks[i].user_ctx);
+    }
+#if BSP_DISPLAY_FAST_SWAP
+    bsp_blend_rgb565_swap((uint16_t *)px_map, lv_area_get_size(area));
+#endif
+    s_flush.port_flush_cb(drv, area, px_map);
+    BSP_PROFILER_END_TAG("bsp_flush");
+}
+
+/* Call with the display lock held */
+static void bsp_display_wrap_flush_cb(void)
+{
+    if (s_flush.port_flush_cb == NULL) {
+        s_flush.port_flush_cb = disp->flush_cb;
+        lv_display_set_flush_cb(disp, bsp_display_flush_cb);
+    }
+}
+
+#if CONFIG_BSP_PROFILER
+static void bsp_touch_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    BSP_PROFILER_BEGIN_TAG("bsp_touch_read");
+    s_touch_read_cb(indev, data);
+    BSP_PROFILER_END_TAG("bsp_touch_read");
+}
+
+/* Route flush and touch read through the BSP callbacks so they show up in the trace */
+static void bsp_display_profile_stages(void)
+{
+    bsp_display_lock(0);
+    bsp_display_wrap_flush_cb();
+    s_touch_read_cb = disp_indev->read_cb;
+    lv_indev_set_read_cb(disp_indev, bsp_touch_read_cb);
+    bsp_display_unlock();
+}
+#endif
+
+esp_err_t bsp_display_add_flush_hook(bsp_display_flush_hook_t hook, void *user_ctx)
+{
+    esp_err_t ret = ESP_OK;
+
+    assert(hook);
+    BSP_NULL_CHECK(disp, ESP_ERR_INVALID_STATE);
+
+    bsp_display_lock(0);
+    if (s_flush.hook_count == BSP_DISPLAY_FLUSH_HOOKS_MAX) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        s_flush.hooks[s_flush.hook_count].hook = hook;
+        s_flush.hooks[s_flush.hook_count].user_ctx = user_ctx;
+        s_flush.hook_count++;
+        bsp_display_wrap_flush_cb();
+    }
+    bsp_display_unlock();
+    return ret;
+}
+
+void bsp_display_remove_flush_hook(bsp_display_flush_hook_t hook, void *user_ctx)
+{
+    bsp_display_lock(0);
+    for (size_t i = 0; i < s_flush.hook_count; i++) {
+        if (s_flush.hooks[i].hook == hook && s_flush.hooks[i].user_ctx == user_ctx) {
+            s_flush.hook_count--;
+            memmove(&s_flush.hooks[i], &s_flush.hooks[i + 1], (s_flush.hook_count - i) * sizeof(s_flush.hooks[0]));
+            break;
+        }
+    }
+    bsp_display_unlock();
+}
+
+#if CONFIG_BSP_DISPLAY_LOCK_PROFILER
+/* Not inlined, the return address is the call site */
+__attribute__((noinline)) bool bsp_display_lock(uint32_t timeout_ms)
+{
+    const void *site = (const void *)esp_cpu_get_call_addr((intptr_t)__builtin_return_address(0));
+
+    return bsp_display_lock_take(timeout_ms, site);
+}
+
+void bsp_display_unlock(void)
+{
+    bsp_display_lock_give();
+}
+#else /* CONFIG_BSP_DISPLAY_LOCK_PROFILER */
 bool bsp_display_lock(uint32_t timeout_ms)
 {
     return lvgl_port_lock(timeout_ms);
@@ -395,4 +636,5 @@ bool bsp_display_lock(uint32_t timeout_ms)
 void bsp_display_unlock(void)
 {
     lvgl_port_unlock();
-}
\ No newline at end of file
+}
+#endif /* CONFIG_BSP_DISPLAY_LOCK_PROFILER */
\ No newline at end of file
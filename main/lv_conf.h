@@ -17,6 +17,9 @@
 #ifndef LV_CONF_H
 #define LV_CONF_H
 
+/*BSP options (CONFIG_BSP_*) select parts of this configuration*/
+#include "sdkconfig.h"
+
 /*====================
    COLOR SETTINGS
  *====================*/
@@ -36,13 +39,22 @@
  * - LV_STDLIB_CUSTOM:      Implement the functions externally
  */
 #define LV_USE_STDLIB_MALLOC    LV_STDLIB_BUILTIN
-#define LV_USE_STDLIB_STRING    LV_STDLIB_BUILTIN
+#if CONFIG_BSP_BLEND_FAST
+    #define LV_USE_STDLIB_STRING    LV_STDLIB_CLIB
+#else
+    #define LV_USE_STDLIB_STRING    LV_STDLIB_BUILTIN
+#endif
 #define LV_USE_STDLIB_SPRINTF   LV_STDLIB_BUILTIN
 
 
 #if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
-    /*Size of the memory available for `lv_malloc()` in bytes (>= 2kB)*/
-    #define LV_MEM_SIZE (128 * 1024U)          /*[bytes]*/
+    /*Size of the memory available for `lv_malloc()` in bytes (>= 2kB)
+     *CONFIG_BSP_DISPLAY_LOW_MEMORY: boards without PSRAM, the pool is in internal RAM*/
+    #if CONFIG_BSP_DISPLAY_LOW_MEMORY
+        #define LV_MEM_SIZE (CONFIG_BSP_DISPLAY_LOW_MEMORY_LVGL_KB * 1024U)
+    #else
+        #define LV_MEM_SIZE (128 * 1024U)          /*[bytes]*/
+    #endif
 
     /*Size of the memory expand for `lv_malloc()` in bytes*/
     #define LV_MEM_POOL_EXPAND_SIZE 0
@@ -119,20 +131,26 @@
     #if LV_DRAW_SW_COMPLEX == 1
         /*Allow buffering some shadow calculation.
         *LV_DRAW_SW_SHADOW_CACHE_SIZE is the max. shadow size to buffer, where shadow size is `shadow_width + radius`
-        *Caching has LV_DRAW_SW_SHADOW_CACHE_SIZE^2 RAM cost*/
-        #define LV_DRAW_SW_SHADOW_CACHE_SIZE 0
+        *Caching has LV_DRAW_SW_SHADOW_CACHE_SIZE^2 RAM cost
+        *Set with CONFIG_BSP_LV_SHADOW_CACHE_SIZE, cards can use the multi-entry cache of bsp/shadow.h instead*/
+        #define LV_DRAW_SW_SHADOW_CACHE_SIZE CONFIG_BSP_LV_SHADOW_CACHE_SIZE
 
         /* Set number of maximally cached circle data.
         * The circumference of 1/4 circle are saved for anti-aliasing
         * radius * 4 bytes are used per circle (the most often used radiuses are saved)
         * 0: to disable caching */
-        #define LV_DRAW_SW_CIRCLE_CACHE_SIZE 4
+        #define LV_DRAW_SW_CIRCLE_CACHE_SIZE CONFIG_BSP_LV_CIRCLE_CACHE_SIZE
     #endif
 
-    #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_NONE
+    /*CONFIG_BSP_BLEND_FAST: RGB565 fill, copy and ARGB8888 blend by the BSP kernels (see bsp/blend.h)*/
+    #if CONFIG_BSP_BLEND_FAST
+        #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_CUSTOM
+    #else
+        #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_NONE
+    #endif
 
     #if LV_USE_DRAW_SW_ASM == LV_DRAW_SW_ASM_CUSTOM
-        #define  LV_DRAW_SW_ASM_CUSTOM_INCLUDE ""
+        #define  LV_DRAW_SW_ASM_CUSTOM_INCLUDE "bsp/blend.h"
     #endif
 #endif
 
@@ -344,7 +362,8 @@
 /*Compiler prefix for a big array declaration in RAM*/
 #define LV_ATTRIBUTE_LARGE_RAM_ARRAY
 
-/*Place performance critical functions into a faster memory (e.g RAM)*/
+/*Place performance critical functions into a faster memory (e.g RAM)
+ *Left empty, the profiled hot paths are placed by components/wt32sc01plus/linker_iram.lf (CONFIG_BSP_IRAM_HOT_PATHS)*/
 #define LV_ATTRIBUTE_FAST_MEM
 
 /*Export integer constant to binding. This macro is used with constants in the form of LV_<CONST> that
@@ -720,18 +739,23 @@
  * OTHERS
  *==================*/
 
-/*1: Enable API to take snapshot for object*/
-#define LV_USE_SNAPSHOT 0
+/*1: Enable API to take snapshot for object
+ *Set with CONFIG_BSP_BITMAP_CACHE, the retained bitmaps of bsp/bitmap_cache.h are snapshots*/
+#if CONFIG_BSP_BITMAP_CACHE
+    #define LV_USE_SNAPSHOT 1
+#else
+    #define LV_USE_SNAPSHOT 0
+#endif
 
-/*1: Enable system monitor component*/
-#define LV_USE_SYSMON   1
+/*1: Enable system monitor component (on-screen overlays). The BSP collects the same data headless, see bsp/metrics.h*/
+#define LV_USE_SYSMON   0
 #if LV_USE_SYSMON
     /*Get the idle percentage. E.g. uint32_t my_get_idle(void);*/
     #define LV_SYSMON_GET_IDLE lv_timer_get_idle
 
     /*1: Show CPU usage and FPS count
      * Requires `LV_USE_SYSMON = 1`*/
-    #define LV_USE_PERF_MONITOR 1
+    #define LV_USE_PERF_MONITOR 0
     #if LV_USE_PERF_MONITOR
         #define LV_USE_PERF_MONITOR_POS LV_ALIGN_BOTTOM_RIGHT
 
@@ -742,37 +766,42 @@
     /*1: Show the used memory and the memory fragmentation
      * Requires `LV_USE_BUILTIN_MALLOC = 1`
      * Requires `LV_USE_SYSMON = 1`*/
-    #define LV_USE_MEM_MONITOR 1
+    #define LV_USE_MEM_MONITOR 0
     #if LV_USE_MEM_MONITOR
         #define LV_USE_MEM_MONITOR_POS LV_ALIGN_BOTTOM_LEFT
     #endif
 
 #endif /*LV_USE_SYSMON*/
 
-/*1: Enable the runtime performance profiler*/
-#define LV_USE_PROFILER 0
+/*1: Enable the runtime performance profiler
+ * Set with CONFIG_BSP_PROFILER, events go to the BSP per-core trace buffer (see bsp/profiler.h)*/
+#if CONFIG_BSP_PROFILER
+    #define LV_USE_PROFILER 1
+#else
+    #define LV_USE_PROFILER 0
+#endif
 #if LV_USE_PROFILER
     /*1: Enable the built-in profiler*/
-    #define LV_USE_PROFILER_BUILTIN 1
+    #define LV_USE_PROFILER_BUILTIN 0
     #if LV_USE_PROFILER_BUILTIN
         /*Default profiler trace buffer size*/
         #define LV_PROFILER_BUILTIN_BUF_SIZE (16 * 1024)     /*[bytes]*/
     #endif
 
     /*Header to include for the profiler*/
-    #define LV_PROFILER_INCLUDE "lvgl/src/misc/lv_profiler_builtin.h"
+    #define LV_PROFILER_INCLUDE "bsp/profiler.h"
 
     /*Profiler start point function*/
-    #define LV_PROFILER_BEGIN    LV_PROFILER_BUILTIN_BEGIN
+    #define LV_PROFILER_BEGIN    BSP_PROFILER_BEGIN
 
     /*Profiler end point function*/
-    #define LV_PROFILER_END      LV_PROFILER_BUILTIN_END
+    #define LV_PROFILER_END      BSP_PROFILER_END
 
     /*Profiler start point function with custom tag*/
-    #define LV_PROFILER_BEGIN_TAG LV_PROFILER_BUILTIN_BEGIN_TAG
+    #define LV_PROFILER_BEGIN_TAG BSP_PROFILER_BEGIN_TAG
 
     /*Profiler end point function with custom tag*/
-    #define LV_PROFILER_END_TAG   LV_PROFILER_BUILTIN_END_TAG
+    #define LV_PROFILER_END_TAG   BSP_PROFILER_END_TAG
 #endif
 
 /*1: Enable Monkey test*/
@@ -40,6 +40,11 @@ void app_main(void)
     disp = bsp_display_start();
     bsp_display_rotate(disp, LV_DISP_ROTATION_270);
 
+    bsp_audio_config_t audio_cfg = { .sample_rate = 44100 };
+    if (ESP_OK != bsp_audio_init(&audio_cfg)) {
+        ESP_LOGW(TAG, "Audio not available");
+    }
+
     ESP_LOGI(TAG, "Display LVGL UI");
 
     bsp_display_off();
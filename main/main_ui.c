@@ -31,8 +31,25 @@ lv_subject_t brightness_subject;
 
 LV_IMG_DECLARE(emoji);   
 
+static bsp_audio_clip_handle_t click_clip;
+
+/* Key click: 10 ms decaying 2 kHz square wave at 16 kHz */
+static void _app_click_create(void)
+{
+    int16_t pcm[160];
+    for (int i = 0; i < 160; i++) {
+        int32_t amp = 12000 * (160 - i) / 160;
+        pcm[i] = ((i / 4) & 1) ? amp : -amp;
+    }
+    bsp_audio_clip_create(pcm, 160, 16000, &click_clip);
+}
+
 static void _app_button_cb(lv_event_t *e)
 {
+    if (click_clip) {
+        bsp_audio_clip_play(click_clip, 60);
+    }
+
     lv_display_rotation_t rotation = (lv_display_rotation_t)lv_display_get_rotation(lv_display_get_default());
     rotation++;
     if (rotation > LV_DISPLAY_ROTATION_270) {
@@ -54,6 +71,8 @@ void app_main_display()
 {
     lv_obj_t *scr = lv_screen_active();
 
+    _app_click_create();
+
     /* DEMO of using LVGL lv_observer features below */
 
     // Initialize lv_subject into int (int32_t) type
@@ -68,10 +87,10 @@ void app_main_display()
     /*Create a label below the slider*/
     lv_obj_t * slider_label = lv_label_create(scr);
     lv_obj_align_to(slider_label, slider, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
-    lv_label_bind_text(slider_label, &brightness_subject, "%d %%");     // Bind label text with lv_subject
+    bsp_label_bind_text_batched(slider_label, &brightness_subject, "%d %%"); // Bind label text with lv_subject, once per frame
 
-    // Add lv_observer with a callback when the value changes
-    lv_subject_add_observer_obj(&brightness_subject, brightness_observer_cb, NULL, NULL);
+    // Add lv_observer with a callback when the value changes, at most once per frame while dragging
+    bsp_subject_add_observer_batched(&brightness_subject, brightness_observer_cb, NULL, NULL);
 
     /* Emoji - image */
     lv_obj_t *img_emoji = lv_image_create(scr);
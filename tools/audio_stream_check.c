@@ -0,0 +1,553 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Streams WAV files through the ring buffer and task handoff of the BSP player (bsp_audio_stream.c) on
+ * Linux, with a reader and an output thread like the tasks of bsp_audio.c and a file as the output
+ * (CONFIG_BSP_AUDIO_FILE_SINK), and compares the output bytes with the converted samples of the files.
+ *
+ *   cc -O2 -Wall -pthread -I components/wt32sc01plus/priv_include tools/audio_stream_check.c \
+ *      components/wt32sc01plus/bsp_audio_stream.c -o audio_stream_check
+ *   ./audio_stream_check [-r ring_kb] [-b block_frames] [-x speed] [-s seed]
+ *
+ * The output runs `speed` times faster than the DAC. Playing another file or stopping may cut a stream
+ * at any block, and starvations pad a block with silence, but no sample may be lost, repeated or played
+ * after its stream was cancelled. The exit status is 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "bsp_audio_stream.h"
+
+#define PATH_LEN        64
+#define NUM_FILES       8
+#define WAIT_MS         5000
+
+static int s_errors;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAILED line %d: %s\n", __LINE__, #cond);                \
+            s_errors++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/* FreeRTOS task notification: a counting flag with a timeout */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+} notify_t;
+
+#define NOTIFY_INIT { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 }
+
+static void notify_give(notify_t *n)
+{
+    pthread_mutex_lock(&n->lock);
+    n->count++;
+    pthread_cond_signal(&n->cond);
+    pthread_mutex_unlock(&n->lock);
+}
+
+static void notify_take(notify_t *n, int timeout_ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&n->lock);
+    while (n->count == 0 && pthread_cond_timedwait(&n->cond, &n->lock, &ts) != ETIMEDOUT) {
+    }
+    n->count = 0;
+    pthread_mutex_unlock(&n->lock);
+}
+
+static void sleep_ms(int ms)
+{
+    usleep(ms * 1000);
+}
+
+typedef struct {
+    char path[PATH_LEN];
+    uint16_t channels;
+    uint32_t rate;
+    size_t frames;
+    int16_t *pcm;           /* As in the file */
+} test_file_t;
+
+static struct {
+    audio_stream_t stream;
+    uint32_t block_frames;
+    uint32_t speed;
+    volatile uint32_t gain;
+    notify_t reader;
+    notify_t output;
+    /* Play queue of length 1, overwritten */
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_cond;
+    bool queued;
+    char queue_path[PATH_LEN];
+    uint32_t queue_gen;
+    volatile bool reading;          /* Reader has a request or a file open */
+    volatile bool quit;
+    FILE *sink;
+    volatile uint32_t blocks;
+    int16_t *block;
+} s_ctx = {
+    .reader = NOTIFY_INIT,
+    .output = NOTIFY_INIT,
+    .queue_lock = PTHREAD_MUTEX_INITIALIZER,
+    .queue_cond = PTHREAD_COND_INITIALIZER,
+};
+
+/**************************************************************************************************
+ *  The tasks of bsp_audio.c
+ **************************************************************************************************/
+
+static void play(const char *path)
+{
+    pthread_mutex_lock(&s_ctx.queue_lock);
+    strcpy(s_ctx.queue_path, path);
+    s_ctx.queue_gen = audio_stream_cancel(&s_ctx.stream);
+    s_ctx.queued = true;
+    s_ctx.reading = true;
+    pthread_cond_signal(&s_ctx.queue_cond);
+    pthread_mutex_unlock(&s_ctx.queue_lock);
+}
+
+static void stop(void)
+{
+    audio_stream_cancel(&s_ctx.stream);
+    notify_give(&s_ctx.output);
+}
+
+static void *reader_task(void *arg)
+{
+    for (;;) {
+        char path[PATH_LEN];
+        audio_format_t fmt;
+        uint32_t remaining;
+
+        pthread_mutex_lock(&s_ctx.queue_lock);
+        while (!s_ctx.queued && !s_ctx.quit) {
+            s_ctx.reading = false;
+            pthread_cond_wait(&s_ctx.queue_cond, &s_ctx.queue_lock);
+        }
+        if (s_ctx.quit) {
+            pthread_mutex_unlock(&s_ctx.queue_lock);
+            return NULL;
+        }
+        const uint32_t gen = s_ctx.queue_gen;
+        strcpy(path, s_ctx.queue_path);
+        s_ctx.queued = false;
+        pthread_mutex_unlock(&s_ctx.queue_lock);
+
+        audio_stream_flush(&s_ctx.stream);
+        while (s_ctx.stream.flush_req) {
+            notify_give(&s_ctx.output);
+            notify_take(&s_ctx.reader, 10);
+        }
+
+        FILE *f = fopen(path, "rb");
+        const char *err = f ? audio_wav_parse(f, &fmt, &remaining) : "cannot open";
+        if (err) {
+            printf("FAILED: %s: %s\n", path, err);
+            s_errors++;
+            if (f) {
+                fclose(f);
+            }
+            continue;
+        }
+        audio_stream_publish(&s_ctx.stream, &fmt, gen);
+        notify_give(&s_ctx.output);
+
+        while (audio_stream_current(&s_ctx.stream, gen) && remaining > 0) {
+            if (audio_stream_fill(&s_ctx.stream) == s_ctx.stream.size) {
+                notify_take(&s_ctx.reader, 100);
+                continue;
+            }
+            const size_t n = audio_stream_fill_from(&s_ctx.stream, f, remaining);
+            if (n == 0) {
+                break;
+            }
+            remaining -= n;
+            notify_give(&s_ctx.output);
+        }
+        fclose(f);
+        if (audio_stream_end(&s_ctx.stream, gen)) {
+            notify_give(&s_ctx.output);
+        }
+    }
+}
+
+static void *output_task(void *arg)
+{
+    const size_t block_bytes = s_ctx.block_frames * 4;
+
+    while (!s_ctx.quit) {
+        if (audio_stream_take_flush(&s_ctx.stream)) {
+            notify_give(&s_ctx.reader);
+        }
+        if (!s_ctx.stream.ready) {
+            s_ctx.stream.started = false;
+            notify_take(&s_ctx.output, 20);
+            continue;
+        }
+        const int frames = audio_stream_next(&s_ctx.stream, s_ctx.block, s_ctx.block_frames, s_ctx.gain);
+        notify_give(&s_ctx.reader);
+        if (frames < 0) {
+            notify_take(&s_ctx.output, 10);
+            continue;
+        }
+        memset(&s_ctx.block[frames * 2], 0, (s_ctx.block_frames - frames) * 4);
+        /* Consumed at `speed` times the DAC rate */
+        usleep((uint64_t)s_ctx.block_frames * 1000000 / s_ctx.stream.fmt.sample_rate / s_ctx.speed);
+        fwrite(s_ctx.block, 1, block_bytes, s_ctx.sink);
+        __atomic_add_fetch(&s_ctx.blocks, 1, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+/* Wait until the reader is idle and no stream is playing */
+static void wait_idle(void)
+{
+    for (int ms = 0; ms < WAIT_MS; ms++) {
+        if (!s_ctx.reading && !s_ctx.stream.ready) {
+            sleep_ms(2);
+            if (!s_ctx.reading && !s_ctx.stream.ready) {
+                return;
+            }
+        }
+        sleep_ms(1);
+    }
+    printf("FAILED: player did not finish\n");
+    s_errors++;
+}
+
+static void wait_blocks(uint32_t blocks)
+{
+    for (int ms = 0; ms < WAIT_MS && s_ctx.blocks < blocks; ms++) {
+        sleep_ms(1);
+    }
+}
+
+/**************************************************************************************************
+ *  Test files and the output check
+ **************************************************************************************************/
+
+static uint32_t s_rng = 1;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void put_le(FILE *f, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        fputc((v >> (8 * i)) & 0xFF, f);
+    }
+}
+
+/*
+ * Samples are never 0, or 0 after halving, so silence cannot pass as samples. `extra` adds an odd sized
+ * chunk before "fmt " and an 18 byte "fmt " chunk.
+ */
+static void make_wav(test_file_t *t, const char *dir, int index, uint16_t channels, uint32_t rate, size_t frames,
+                     bool extra, uint16_t bits)
+{
+    snprintf(t->path, sizeof(t->path), "%s/%d.wav", dir, index);
+    t->channels = channels;
+    t->rate = rate;
+    t->frames = frames;
+    t->pcm = malloc(frames * channels * sizeof(int16_t));
+    for (size_t i = 0; i < frames * channels; i++) {
+        const int16_t v = 4 + rnd() % 30000;
+        t->pcm[i] = (rnd() & 1) ? v : -v;
+    }
+
+    FILE *f = fopen(t->path, "wb");
+    const uint32_t data_len = frames * channels * 2;
+    const uint32_t fmt_len = extra ? 18 : 16;
+    fwrite("RIFF", 1, 4, f);
+    put_le(f, 4 + (extra ? 8 + 4 : 0) + 8 + fmt_len + 8 + data_len, 4);
+    fwrite("WAVE", 1, 4, f);
+    if (extra) {
+        fwrite("LIST", 1, 4, f);
+        put_le(f, 3, 4);
+        fwrite("abc", 1, 4, f);     /* With the pad byte */
+    }
+    fwrite("fmt ", 1, 4, f);
+    put_le(f, fmt_len, 4);
+    put_le(f, 1, 2);
+    put_le(f, channels, 2);
+    put_le(f, rate, 4);
+    put_le(f, rate * channels * bits / 8, 4);
+    put_le(f, channels * bits / 8, 2);
+    put_le(f, bits, 2);
+    if (extra) {
+        put_le(f, 0, 2);
+    }
+    fwrite("data", 1, 4, f);
+    put_le(f, data_len, 4);
+    fwrite(t->pcm, 1, data_len, f);
+    fclose(f);
+}
+
+/* Output frame `i` of a file at `gain` */
+static void expected_frame(const test_file_t *t, size_t i, uint32_t gain, int16_t out[2])
+{
+    if (t->channels == 1) {
+        out[0] = out[1] = (t->pcm[i] * (int32_t)gain) >> 8;
+    } else {
+        out[0] = (t->pcm[2 * i] * (int32_t)gain) >> 8;
+        out[1] = (t->pcm[2 * i + 1] * (int32_t)gain) >> 8;
+    }
+}
+
+static size_t match_frames(const int16_t *block, size_t frames, const test_file_t *t, size_t pos, uint32_t gain)
+{
+    size_t n = 0;
+    while (n < frames && pos + n < t->frames) {
+        int16_t e[2];
+        expected_frame(t, pos + n, gain, e);
+        if (block[2 * n] != e[0] || block[2 * n + 1] != e[1]) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Check the output since `from` against the files played in order `order[0..count-1]`: each block
+ * continues the current stream or starts one of the later ones, the rest of a block is silence. Returns
+ * the position in the file playing at the end, `*ret_last` its index in `order`.
+ */
+static size_t check_output(long from, const test_file_t *files, const int *order, int count, uint32_t gain,
+                           int *ret_last)
+{
+    const size_t block_bytes = s_ctx.block_frames * 4;
+    int16_t *block = malloc(block_bytes);
+    int cur = -1;
+    size_t pos = 0;
+    long at = from;
+
+    fflush(s_ctx.sink);
+    fseek(s_ctx.sink, from, SEEK_SET);
+    while (fread(block, 1, block_bytes, s_ctx.sink) == block_bytes) {
+        size_t n = cur >= 0 ? match_frames(block, s_ctx.block_frames, &files[order[cur]], pos, gain) : 0;
+        if (n == 0) {
+            for (int next = cur + 1; next < count && n == 0; next++) {
+                n = match_frames(block, s_ctx.block_frames, &files[order[next]], 0, gain);
+                if (n > 0) {
+                    cur = next;
+                    pos = 0;
+                }
+            }
+        }
+        pos += n;
+        for (size_t i = n * 2; i < s_ctx.block_frames * 2; i++) {
+            if (block[i] != 0) {
+                printf("FAILED: block at byte %ld, frame %d is not the next sample of a stream\n", at, (int)(i / 2));
+                s_errors++;
+                break;
+            }
+        }
+        at += block_bytes;
+    }
+    fseek(s_ctx.sink, 0, SEEK_END);
+    free(block);
+    *ret_last = cur;
+    return pos;
+}
+
+/* Cancelled before the reader published: the stream stays unpublished whatever the order */
+static void check_cancel(void)
+{
+    static uint8_t ring[64];
+    const audio_format_t fmt = { .sample_rate = 8000, .channels = 1 };
+    audio_stream_t s;
+
+    audio_stream_init(&s, ring, sizeof(ring));
+    uint32_t gen = audio_stream_cancel(&s);
+    CHECK(audio_stream_publish(&s, &fmt, gen) && s.ready && audio_stream_current(&s, gen));
+    audio_stream_cancel(&s);
+    CHECK(!s.ready && !audio_stream_current(&s, gen) && !audio_stream_end(&s, gen) && !s.eof);
+
+    gen = audio_stream_cancel(&s);
+    audio_stream_cancel(&s);
+    CHECK(!audio_stream_publish(&s, &fmt, gen) && !s.ready);
+
+    /* Flush: the output drops everything the reader wrote */
+    gen = audio_stream_cancel(&s);
+    audio_stream_flush(&s);
+    CHECK(s.flush_req && !s.ready);
+    s.head += 40;
+    CHECK(audio_stream_take_flush(&s) && !s.flush_req && audio_stream_fill(&s) == 0 && !audio_stream_take_flush(&s));
+}
+
+static void check_wav_errors(const char *dir)
+{
+    static const struct {
+        const char *bytes;
+        size_t len;
+    } bad[] = {
+        { "RIFX\0\0\0\0WAVE", 12 },
+        { "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0", 24 },                                       /* Truncated */
+        { "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\x40\x1f\0\0\x80\x3e\0\0\x02\0\x08\0", 36 },   /* 8 bit */
+        { "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x03\0\x40\x1f\0\0\x80\x3e\0\0\x06\0\x10\0", 36 },   /* 3 channels */
+        { "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\x40\x1f\0\0\x80\x3e\0\0\x02\0\x10\0", 36 },   /* No data */
+        { "RIFF\0\0\0\0WAVEdata\x02\0\0\0\x01\0", 22 },                                             /* data before fmt */
+    };
+    char path[PATH_LEN];
+    audio_format_t fmt;
+    uint32_t len;
+
+    snprintf(path, sizeof(path), "%s/bad.wav", dir);
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        FILE *f = fopen(path, "wb");
+        fwrite(bad[i].bytes, 1, bad[i].len, f);
+        fclose(f);
+        f = fopen(path, "rb");
+        const char *err = audio_wav_parse(f, &fmt, &len);
+        if (err == NULL) {
+            printf("FAILED: bad WAV %d accepted\n", (int)i);
+            s_errors++;
+        }
+        fclose(f);
+    }
+    remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ring_kb = 4, seed = 1;
+    int opt;
+
+    s_ctx.block_frames = 240;
+    s_ctx.speed = 20;
+    while ((opt = getopt(argc, argv, "r:b:x:s:")) != -1) {
+        switch (opt) {
+        case 'r': ring_kb = strtoul(optarg, NULL, 0); break;
+        case 'b': s_ctx.block_frames = strtoul(optarg, NULL, 0); break;
+        case 'x': s_ctx.speed = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-r ring_kb] [-b block_frames] [-x speed] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ring_kb == 0 || s_ctx.block_frames == 0 || s_ctx.speed == 0) {
+        fprintf(stderr, "invalid configuration\n");
+        return 2;
+    }
+    s_rng = seed ? seed : 1;
+
+    char dir[] = "/tmp/audio_stream_check.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 2;
+    }
+    check_cancel();
+    check_wav_errors(dir);
+
+    test_file_t files[NUM_FILES];
+    make_wav(&files[0], dir, 0, 2, 44100, 44100 / 2, false, 16);
+    make_wav(&files[1], dir, 1, 1, 22050, 22050 / 2 + 17, true, 16);
+    for (int i = 2; i < NUM_FILES; i++) {
+        make_wav(&files[i], dir, i, 1 + i % 2, 16000, 8000 + rnd() % 8000, i % 3 == 0, 16);
+    }
+
+    uint8_t *ring = malloc(ring_kb * 1024);
+    audio_stream_init(&s_ctx.stream, ring, ring_kb * 1024);
+    s_ctx.block = malloc(s_ctx.block_frames * 4);
+    s_ctx.sink = tmpfile();
+    s_ctx.gain = 256;
+    pthread_t reader, output;
+    pthread_create(&output, NULL, output_task, NULL);
+    pthread_create(&reader, NULL, reader_task, NULL);
+
+    int last;
+    long from;
+    size_t pos;
+
+    /* Whole files, stereo and mono at half volume */
+    for (int i = 0; i < 2; i++) {
+        s_ctx.gain = i ? 128 : 256;
+        from = ftell(s_ctx.sink);
+        play(files[i].path);
+        wait_idle();
+        pos = check_output(from, files, &i, 1, s_ctx.gain, &last);
+        CHECK(last == 0 && pos == files[i].frames);
+    }
+    s_ctx.gain = 256;
+
+    /* Another file cuts the stream */
+    const int pair[2] = { 0, 2 };
+    from = ftell(s_ctx.sink);
+    play(files[0].path);
+    wait_blocks(s_ctx.blocks + 10);
+    play(files[2].path);
+    wait_idle();
+    pos = check_output(from, files, pair, 2, 256, &last);
+    CHECK(last == 1 && pos == files[2].frames);
+
+    /* Stop, nothing plays afterwards */
+    from = ftell(s_ctx.sink);
+    play(files[3].path);
+    wait_blocks(s_ctx.blocks + 5);
+    stop();
+    wait_idle();
+    const uint32_t blocks = s_ctx.blocks;
+    sleep_ms(50);
+    CHECK(s_ctx.blocks == blocks);
+    pos = check_output(from, files, (const int[]) { 3 }, 1, 256, &last);
+    CHECK(pos < files[3].frames);
+
+    /* Plays in quick succession, the streams come out in order and only the last one completes */
+    int order[NUM_FILES * 4];
+    for (int round = 0; round < 4; round++) {
+        from = ftell(s_ctx.sink);
+        for (int i = 0; i < NUM_FILES; i++) {
+            order[i] = (i + round) % NUM_FILES;
+            play(files[order[i]].path);
+            sleep_ms(rnd() % 4);
+        }
+        wait_idle();
+        pos = check_output(from, files, order, NUM_FILES, 256, &last);
+        CHECK(last == NUM_FILES - 1 && pos == files[order[NUM_FILES - 1]].frames);
+    }
+
+    s_ctx.quit = true;
+    pthread_mutex_lock(&s_ctx.queue_lock);
+    pthread_cond_signal(&s_ctx.queue_cond);
+    pthread_mutex_unlock(&s_ctx.queue_lock);
+    pthread_join(reader, NULL);
+    pthread_join(output, NULL);
+
+    printf("%u blocks, %u starvations, lowest ring fill %u of %u bytes\n", s_ctx.blocks, s_ctx.stream.starvations,
+           s_ctx.stream.fill_min, s_ctx.stream.size);
+    for (int i = 0; i < NUM_FILES; i++) {
+        remove(files[i].path);
+        free(files[i].pcm);
+    }
+    rmdir(dir);
+    fclose(s_ctx.sink);
+    free(s_ctx.block);
+    free(ring);
+    printf("%s\n", s_errors ? "MISMATCH" : "output matches the files");
+    return s_errors ? 1 : 0;
+}
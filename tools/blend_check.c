@@ -0,0 +1,75 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Compares the word-at-a-time RGB565 kernels of CONFIG_BSP_BLEND_FAST (bsp_blend_kernels.h) with the
+ * scalar references of the LVGL 9 loops on Linux, the same randomized comparison as bsp_blend_selftest().
+ *
+ *   cc -O2 -Wall -I components/wt32sc01plus/priv_include tools/blend_check.c -o blend_check
+ *   ./blend_check [-r rounds]
+ *
+ * The image copy (the DMA on the target) and the ESP32-S3 vector fill only run on the target. The exit
+ * status is 1 when a kernel differs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "bsp_blend_kernels.h"
+
+static void fill(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color)
+{
+    bsp_blend_swar_fill(dest, w, h, stride, color);
+}
+
+static void fill_opa(uint16_t *dest, int32_t w, int32_t h, int32_t stride, uint16_t color, uint8_t opa)
+{
+    bsp_blend_swar_fill_opa(dest, w, h, stride, color, opa);
+}
+
+static void argb8888(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, const uint8_t *src, int32_t src_stride)
+{
+    bsp_blend_swar_argb8888(dest, w, h, dest_stride, src, src_stride);
+}
+
+static void swap(uint16_t *buf, size_t count)
+{
+    bsp_blend_swar_swap(buf, count);
+}
+
+int main(int argc, char **argv)
+{
+    const bsp_blend_kernels_t kernels = {
+        .fill = fill,
+        .fill_opa = fill_opa,
+        .argb8888 = argb8888,
+        .swap = swap,
+    };
+    int rounds = 100000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* Word aligned like the heap buffers of the target */
+    uint32_t a[(BSP_BLEND_CHECK_DEST_SIZE + 3) / 4];
+    uint32_t b[(BSP_BLEND_CHECK_DEST_SIZE + 3) / 4];
+    uint32_t src[(BSP_BLEND_CHECK_SRC_SIZE + 3) / 4];
+    bsp_blend_mismatch_t m;
+
+    if (!bsp_blend_check(&kernels, rounds, (uint8_t *)a, (uint8_t *)b, (uint8_t *)src, &m)) {
+        printf("MISMATCH: %s differs at byte %zu: %dx%d stride %d offset %d color 0x%04x opa %d\n",
+               m.kernel, m.byte, (int)m.w, (int)m.h, (int)m.stride, (int)m.offset, m.color, m.opa);
+        return 1;
+    }
+    printf("fill, fill_opa, argb8888 and swap match the references in %d rounds\n", rounds);
+    return 0;
+}
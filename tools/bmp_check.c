@@ -0,0 +1,163 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Checks the streaming BMP writer of the screenshots (bsp_bmp.c) on Linux: random images are written as
+ * areas in random order, partly outside the image, and read back against the frame they came from.
+ *
+ *   cc -O2 -Wall -I components/wt32sc01plus/priv_include tools/bmp_check.c components/wt32sc01plus/bsp_bmp.c \
+ *      -o bmp_check
+ *   ./bmp_check [-n images]
+ *
+ * The exit status is 1 when a file differs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "bsp_bmp.h"
+
+#define MAX_W       37
+#define MAX_H       23
+
+typedef struct {
+    int x1, y1, x2, y2;
+} area_t;
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return lo + s_rng % (hi - lo + 1);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Writes the frame as bands of random height, each split into random columns, in random order */
+static int write_image(const char *path, const uint16_t *frame, int w, int h)
+{
+    area_t areas[MAX_W * MAX_H];
+    uint16_t px[(MAX_W + 8) * (MAX_H + 8)];
+    int n = 0;
+    bmp_writer_t bmp;
+
+    for (int y = 0; y < h;) {
+        const int y2 = (int)rnd(y, h - 1);
+        for (int x = 0; x < w;) {
+            const int x2 = rnd(0, 1) ? w - 1 : (int)rnd(x, w - 1);
+            areas[n++] = (area_t) { x, y, x2, y2 };
+            x = x2 + 1;
+        }
+        y = y2 + 1;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        const int j = rnd(0, i);
+        const area_t t = areas[i];
+        areas[i] = areas[j];
+        areas[j] = t;
+    }
+
+    if (!bmp_open(&bmp, path, w, h)) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        /* Grow the area past the image edges, the writer clips it */
+        const int x1 = areas[i].x1 - (areas[i].x1 == 0 ? (int)rnd(0, 3) : 0);
+        const int y1 = areas[i].y1 - (areas[i].y1 == 0 ? (int)rnd(0, 3) : 0);
+        const int x2 = areas[i].x2 + (areas[i].x2 == w - 1 ? (int)rnd(0, 3) : 0);
+        const int y2 = areas[i].y2 + (areas[i].y2 == h - 1 ? (int)rnd(0, 3) : 0);
+        const int stride = x2 - x1 + 1 + (rnd(0, 1) ? 0 : (int)rnd(1, 2));
+        for (int y = y1; y <= y2; y++) {
+            for (int x = x1; x < x1 + stride; x++) {
+                const int in = x >= 0 && x < w && y >= 0 && y < h;
+                px[(y - y1) * stride + (x - x1)] = in ? frame[y * w + x] : 0xDEAD;
+            }
+        }
+        if (!bmp_write_area(&bmp, x1, y1, x2, y2, px, stride)) {
+            bmp_close(&bmp);
+            return -1;
+        }
+    }
+    return bmp_close(&bmp) ? 0 : -1;
+}
+
+static int check_file(const char *path, const uint16_t *frame, int w, int h)
+{
+    static uint8_t file[BMP_HEADER_SIZE + (MAX_W * 2 + 3) * MAX_H + 1];
+    const uint32_t row_bytes = (w * 2 + 3) & ~3U;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return -1;
+    }
+    const size_t size = fread(file, 1, sizeof(file), f);
+    fclose(f);
+    if (size != BMP_HEADER_SIZE + row_bytes * h || file[0] != 'B' || file[1] != 'M' ||
+            get_u32(&file[2]) != size || get_u32(&file[10]) != BMP_HEADER_SIZE ||
+            get_u32(&file[18]) != (uint32_t)w || get_u32(&file[22]) != (uint32_t) - h ||
+            get_u32(&file[54]) != 0xF800 || get_u32(&file[58]) != 0x07E0 || get_u32(&file[62]) != 0x001F) {
+        printf("%dx%d: bad header or size %zu\n", w, h, size);
+        return -1;
+    }
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row = &file[BMP_HEADER_SIZE + y * row_bytes];
+        for (int x = 0; x < w; x++) {
+            if ((row[x * 2] | (row[x * 2 + 1] << 8)) != frame[y * w + x]) {
+                printf("%dx%d: pixel %d,%d differs\n", w, h, x, y);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char path[] = "/tmp/bmp_check_XXXXXX";
+    uint16_t frame[MAX_W * MAX_H];
+    int images = 2000;
+    int errors = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            images = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n images]\n", argv[0]);
+            return 2;
+        }
+    }
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 2;
+    }
+    close(fd);
+
+    for (int i = 0; i < images && errors < 10; i++) {
+        const int w = rnd(1, MAX_W);
+        const int h = rnd(1, MAX_H);
+        for (int p = 0; p < w * h; p++) {
+            frame[p] = (uint16_t)rnd(0, 0xFFFF);
+        }
+        if (write_image(path, frame, w, h) != 0) {
+            printf("%dx%d: write failed\n", w, h);
+            errors++;
+        } else if (check_file(path, frame, w, h) != 0) {
+            errors++;
+        }
+    }
+    unlink(path);
+
+    printf("%s\n", errors ? "MISMATCH" : "files match the frames");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+# MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+#
+# Profile-guided IRAM placement for LVGL and BSP hot paths (CONFIG_BSP_IRAM_HOT_PATHS).
+#
+#   1. Build with CONFIG_BSP_PROFILER and CONFIG_BSP_METRICS_ENABLE, run the UI (or bsp_monkey_run()),
+#      save bsp_profiler_export_chrome() as before.json and bsp_metrics_dump_csv() as before.csv
+#   2. python3 tools/iram_plan.py plan before.json --map build/IDF-ESP_LCD-LVGL.map \
+#          [--objdump app.dis] [--budget 16384] -o components/wt32sc01plus/linker_iram.lf
+#      app.dis is `xtensa-esp32s3-elf-objdump -d build/IDF-ESP_LCD-LVGL.elf`, it adds the uninstrumented
+#      callees of the hot functions (blend and fill loops) to the candidates
+#   3. Enable CONFIG_BSP_IRAM_HOT_PATHS, rebuild, capture after.json / after.csv the same way
+#   4. python3 tools/iram_plan.py compare before.csv after.csv      render time and FPS
+#      python3 tools/iram_plan.py compare before.json after.json    time per function
+#
+# Candidates are ranked by exclusive time per byte of code and taken until the budget is used.
+# The part of the output fragment from the "# Hand-maintained" line on is kept as it is; hot functions
+# of its archives are listed for adding by hand instead of generated.
+
+import argparse
+import collections
+import csv
+import json
+import os
+import re
+import sys
+
+Section = collections.namedtuple("Section", "archive obj name size in_iram")
+
+# Output sections already in internal RAM
+IRAM_OUTPUTS = (".iram0.text", ".iram0.vectors", ".iram0.text_end")
+
+# Start of the kept part of the output fragment
+MANUAL_MARKER = "# Hand-maintained, kept by tools/iram_plan.py plan"
+
+RE_OUTPUT = re.compile(r"^(\.[\w.]+|/DISCARD/)")
+RE_INPUT = re.compile(r"^ \.(?:text|literal)\.(\S+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+))?\s*$")
+RE_INPUT_CONT = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+)\s*$")
+RE_OBJECT = re.compile(r"([^/\\]+\.a)\(([^)]+)\)$")
+RE_FUNC = re.compile(r"^[0-9a-f]+ <([^>]+)>:$")
+RE_CALL = re.compile(r"\s(?:call(?:0|4|8|12)|jal|j)\s.*<([^>+]+)(?:\+0x[0-9a-f]+)?>")
+
+
+def object_stem(obj):
+    """lv_draw_sw_blend.c.obj -> lv_draw_sw_blend, the object name of a linker fragment entity"""
+    for ext in (".c.obj", ".cpp.obj", ".S.obj", ".obj", ".o"):
+        if obj.endswith(ext):
+            return obj[: -len(ext)]
+    return obj
+
+
+def parse_map(path):
+    """Linked function sections of archives: name -> [Section], .text and .literal sizes summed"""
+    sizes = collections.OrderedDict()
+    output = ""
+    pending = None
+    linked = False
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            # Sections listed before the memory map were discarded (--gc-sections)
+            if not linked:
+                linked = line.startswith("Linker script and memory map")
+                continue
+            m = RE_OUTPUT.match(line)
+            if m:
+                output = m.group(1)
+                pending = None
+                continue
+            if pending:
+                m = RE_INPUT_CONT.match(line)
+                if m:
+                    add_section(sizes, pending, m.group(2), m.group(3), output)
+                pending = None
+                continue
+            m = RE_INPUT.match(line)
+            if m:
+                if m.group(2):
+                    add_section(sizes, m.group(1), m.group(3), m.group(4), output)
+                else:
+                    pending = m.group(1)
+    funcs = collections.defaultdict(list)
+    for (archive, obj, name), (size, in_iram) in sizes.items():
+        funcs[name].append(Section(archive, obj, name, size, in_iram))
+    return funcs
+
+
+def add_section(sizes, name, size, source, output):
+    m = RE_OBJECT.search(source)
+    size = int(size, 16)
+    if not m or size == 0 or output == "/DISCARD/":
+        return
+    key = (m.group(1), object_stem(m.group(2)), name)
+    old_size, old_iram = sizes.get(key, (0, False))
+    sizes[key] = (old_size + size, old_iram or output in IRAM_OUTPUTS)
+
+
+def parse_calls(path):
+    """Direct calls from the disassembly: caller -> set of callees"""
+    calls = collections.defaultdict(set)
+    func = None
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = RE_FUNC.match(line)
+            if m:
+                func = m.group(1)
+                continue
+            m = RE_CALL.search(line)
+            if m and func and m.group(1) != func:
+                calls[func].add(m.group(1))
+    return calls
+
+
+def trace_times(paths):
+    """Exclusive and inclusive time in us per name from bsp_profiler_export_chrome() traces"""
+    excl = collections.Counter()
+    incl = collections.Counter()
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            events = json.load(f)["traceEvents"]
+        stacks = collections.defaultdict(list)
+        for ev in events:
+            if ev.get("ph") not in ("B", "E"):
+                continue
+            stack = stacks[(ev["pid"], ev.get("tid", 0))]
+            if ev["ph"] == "B":
+                stack.append([ev["name"], ev["ts"], 0])
+                continue
+            # Events dropped by a full buffer leave unmatched ends, skip them
+            if not stack or stack[-1][0] != ev["name"]:
+                continue
+            name, start, children = stack.pop()
+            total = ev["ts"] - start
+            incl[name] += total
+            excl[name] += total - children
+            if stack:
+                stack[-1][2] += total
+    return excl, incl
+
+
+def read_manual(path):
+    """Kept part of an existing fragment and the archives it maps"""
+    try:
+        with open(path, encoding="utf-8") as f:
+            text = f.read()
+    except FileNotFoundError:
+        return "", set()
+    start = text.find(MANUAL_MARKER)
+    if start < 0:
+        return "", set()
+    manual = text[start:]
+    return manual, set(re.findall(r"^archive:\s*(\S+)", manual, re.MULTILINE))
+
+
+def plan(args):
+    excl, _ = trace_times(args.trace)
+    funcs = parse_map(args.map)
+    calls = parse_calls(args.objdump) if args.objdump else {}
+    if not excl:
+        sys.exit("No begin/end events in the traces, was CONFIG_BSP_PROFILER enabled while recording?")
+
+    # Priority of a function: its own exclusive time, or for an uninstrumented callee the exclusive
+    # time of the hottest instrumented caller within --depth calls
+    priority = {}
+    for name, us in excl.items():
+        priority[name] = max(priority.get(name, 0), us)
+        frontier = {name}
+        for _ in range(args.depth):
+            frontier = {c for f in frontier for c in calls.get(f, ()) if c not in excl}
+            for callee in frontier:
+                priority[callee] = max(priority.get(callee, 0), us)
+
+    candidates = []
+    missing = []
+    for name, us in priority.items():
+        sections = funcs.get(name)
+        if not sections:
+            if name in excl:
+                missing.append(name)
+            continue
+        for sec in sections:
+            if not sec.in_iram:
+                candidates.append((us / sec.size, us, sec))
+    candidates.sort(key=lambda c: c[0], reverse=True)
+
+    manual, manual_archives = read_manual(args.output)
+    chosen = []
+    by_hand = []
+    used = 0
+    for _, us, sec in candidates:
+        if sec.archive in manual_archives:
+            if not re.search(rf"^\s+({sec.obj}:{sec.name}|{sec.obj}) \(noflash\)", manual, re.MULTILINE):
+                by_hand.append(sec)
+        elif used + sec.size <= args.budget:
+            chosen.append((us, sec))
+            used += sec.size
+
+    total_us = sum(excl.values())
+    print(f"{'function':40} {'object':32} {'bytes':>7} {'us':>10} {'%':>6}")
+    for us, sec in chosen:
+        print(f"{sec.name[:40]:40} {sec.obj[:32]:32} {sec.size:7} {us:10} {100.0 * us / total_us:6.1f}")
+    print(f"{len(chosen)} functions, {used} of {args.budget} bytes")
+    if missing:
+        print("Not in the map (tags or inlined): " + ", ".join(sorted(missing)[:20]))
+    if by_hand:
+        print("Hot in hand-maintained archives, add to the kept part if wanted: " +
+              ", ".join(f"{s.obj}:{s.name}" for s in by_hand[:20]))
+
+    by_archive = collections.defaultdict(list)
+    for _, sec in chosen:
+        by_archive[sec.archive].append(sec)
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("# Generated by tools/iram_plan.py from " + ", ".join(os.path.basename(t) for t in args.trace) + "\n")
+        f.write(f"# {len(chosen)} functions, {used} of {args.budget} bytes of IRAM\n")
+        f.write("# Used with CONFIG_BSP_IRAM_HOT_PATHS, regenerate after changing the UI or LVGL version\n")
+        for archive in sorted(by_archive):
+            stem = re.sub(r"\W", "_", archive[3:-2] if archive.startswith("lib") else archive[:-2])
+            f.write(f"\n[mapping:bsp_iram_{stem}]\narchive: {archive}\nentities:\n")
+            f.write("    if BSP_IRAM_HOT_PATHS = y:\n")
+            for sec in sorted(by_archive[archive], key=lambda s: (s.obj, s.name)):
+                f.write(f"        {sec.obj}:{sec.name} (noflash)\n")
+            f.write("    else:\n        * (default)\n")
+        if manual:
+            f.write("\n" + manual)
+    print(f"Wrote {args.output}" + (", kept the hand-maintained part" if manual else ""))
+
+
+def metrics_summary(path):
+    with open(path, newline="", encoding="utf-8") as f:
+        rows = [r for r in csv.DictReader(f) if int(r["frames"]) > 0]
+    if not rows:
+        sys.exit(f"{path}: no samples with frames")
+    frames = sum(int(r["frames"]) for r in rows)
+    return collections.OrderedDict([
+        ("render us avg", sum(int(r["render_us_avg"]) * int(r["frames"]) for r in rows) / frames),
+        ("render us max", max(int(r["render_us_max"]) for r in rows)),
+        ("fps", sum(float(r["fps"]) for r in rows) / len(rows)),
+        ("lvgl cpu %", sum(int(r["lvgl_cpu_pct"]) for r in rows) / len(rows)),
+        ("frames", frames),
+    ])
+
+
+def compare(args):
+    print(f"{'':40} {'before':>12} {'after':>12} {'change':>8}")
+    if args.before.endswith(".json"):
+        before, _ = trace_times([args.before])
+        after, _ = trace_times([args.after])
+        rows = [(name, before[name], after.get(name, 0)) for name, _ in before.most_common(args.top)]
+        rows.append(("total", sum(before.values()), sum(after.values())))
+    else:
+        before = metrics_summary(args.before)
+        after = metrics_summary(args.after)
+        rows = [(key, before[key], after[key]) for key in before]
+    for name, b, a in rows:
+        change = f"{100.0 * (a - b) / b:+7.1f}%" if b else ""
+        print(f"{name[:40]:40} {b:12.1f} {a:12.1f} {change:>8}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Profile-guided IRAM placement of hot functions")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("plan", help="Generate the linker fragment from profiler traces")
+    p.add_argument("trace", nargs="+", help="bsp_profiler_export_chrome() output")
+    p.add_argument("--map", required=True, help="Linker map of the same build (build/<project>.map)")
+    p.add_argument("--objdump", help="Disassembly of the same build, adds uninstrumented callees")
+    p.add_argument("--depth", type=int, default=2, help="Call depth of the added callees")
+    p.add_argument("--budget", type=int, default=16384, help="IRAM budget in bytes")
+    p.add_argument("-o", "--output", default="components/wt32sc01plus/linker_iram.lf", help="Linker fragment")
+    p.set_defaults(func=plan)
+
+    p = sub.add_parser("compare", help="Compare metrics CSV or profiler traces before/after")
+    p.add_argument("before")
+    p.add_argument("after")
+    p.add_argument("--top", type=int, default=15, help="Functions listed when comparing traces")
+    p.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Runs the touch-to-photon pipeline model of CONFIG_BSP_LATENCY (bsp_latency_model.h) on Linux with
+ * simulated touch, LVGL and panel timing, and checks the histogram against the simulated latencies.
+ *
+ *   cc -O2 -Wall -I components/wt32sc01plus/priv_include tools/latency_sim.c -o latency_sim
+ *   ./latency_sim [-n touches] [-i indev_period_ms] [-r refr_period_ms] [-d render_ms] [-f flush_ms] [-s static_pct]
+ *
+ * -i 0 reads the touch right after the interrupt (CONFIG_BSP_DISPLAY_TICKLESS), otherwise the read timer
+ * polls with that period. The exit status is 1 when the model disagrees with the simulation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "bsp_latency_model.h"
+
+#define BUCKET_US       4000
+#define TIMEOUT_US      100000
+#define TOUCH_GAP_US    250000      /* between touches, longer than a touch in flight */
+#define I2C_READ_US     400         /* FT5x06 read at 400 kHz */
+#define WAKE_US         150         /* interrupt to the LVGL task reading */
+#define IRQ_REPEAT_US   5000        /* the FT5x06 repeats the interrupt while touched */
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return lo + s_rng % (hi - lo + 1);
+}
+
+static int64_t next_multiple(int64_t t, int64_t period)
+{
+    return (t / period + 1) * period;
+}
+
+int main(int argc, char **argv)
+{
+    int touches = 1000;
+    int indev_period_us = 30000;
+    int refr_period_us = 33000;
+    int render_us = 12000;
+    int flush_us = 9000;
+    int static_pct = 10;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:i:r:d:f:s:")) != -1) {
+        switch (opt) {
+        case 'n': touches = atoi(optarg); break;
+        case 'i': indev_period_us = atoi(optarg) * 1000; break;
+        case 'r': refr_period_us = atoi(optarg) * 1000; break;
+        case 'd': render_us = atoi(optarg) * 1000; break;
+        case 'f': flush_us = atoi(optarg) * 1000; break;
+        case 's': static_pct = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n touches] [-i indev_ms] [-r refr_ms] [-d render_ms] [-f flush_ms] [-s static_pct]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (refr_period_us <= 0 || render_us <= 0 || flush_us <= 0) {
+        fprintf(stderr, "refresh, render and flush times must be positive\n");
+        return 2;
+    }
+
+    bsp_latency_model_t m;
+    bsp_latency_model_init(&m, BUCKET_US, TIMEOUT_US);
+
+    uint32_t hist[BSP_LATENCY_MODEL_BUCKETS] = { 0 };
+    uint32_t events = 0, no_change = 0, min_us = UINT32_MAX, max_us = 0;
+    uint64_t sum_us = 0;
+
+    for (int i = 0; i < touches; i++) {
+        const int64_t irq = (int64_t)(i + 1) * TOUCH_GAP_US + rnd(0, 40000);
+        const int64_t read = (indev_period_us ? next_multiple(irq, indev_period_us) : irq + WAKE_US) + I2C_READ_US;
+
+        bsp_latency_model_irq(&m, irq);
+        if (irq + IRQ_REPEAT_US < read) {
+            bsp_latency_model_irq(&m, irq + IRQ_REPEAT_US);
+        }
+        bsp_latency_model_read(&m, read);
+        if (irq + IRQ_REPEAT_US >= read) {
+            bsp_latency_model_irq(&m, irq + IRQ_REPEAT_US);
+        }
+
+        if ((int)rnd(0, 99) < static_pct) {
+            /* Nothing invalidated, the next reads time it out */
+            bsp_latency_model_poll(&m, read + TIMEOUT_US / 2, false);
+            bsp_latency_model_poll(&m, read + TIMEOUT_US + 1, false);
+            no_change++;
+            continue;
+        }
+
+        /* Partial refresh in 1 to 4 areas; with two buffers an area is flushed once the previous transfer is done */
+        const int64_t inval = read + rnd(200, 2000);
+        const int64_t refr = next_multiple(inval, refr_period_us);
+        const int areas = rnd(1, 4);
+        int64_t t = refr;
+        int64_t ready = refr;
+
+        bsp_latency_model_invalidate(&m, inval);
+        bsp_latency_model_invalidate(&m, inval + 100);
+        bsp_latency_model_refr_start(&m, refr);
+        for (int a = 0; a < areas; a++) {
+            t += rnd(render_us / 2, render_us * 3 / 2) / areas;
+            t = t > ready ? t : ready;
+            bsp_latency_model_flush(&m, t, a == areas - 1);
+            ready = t + rnd(flush_us / 2, flush_us * 3 / 2) / areas;
+            if (a < areas - 1) {
+                bsp_latency_model_flush_ready(&m, ready);
+            }
+        }
+        /* REFR_READY right after the last flush call, before its transfer is done */
+        bsp_latency_model_poll(&m, t + 10, true);
+        bsp_latency_model_flush_ready(&m, ready);
+        bsp_latency_model_poll(&m, ready + 1000, false);
+
+        const uint32_t total = ready - irq;
+        const uint32_t bucket = total / BUCKET_US;
+        hist[bucket < BSP_LATENCY_MODEL_BUCKETS ? bucket : BSP_LATENCY_MODEL_BUCKETS - 1]++;
+        events++;
+        sum_us += total;
+        min_us = total < min_us ? total : min_us;
+        max_us = total > max_us ? total : max_us;
+    }
+
+    printf("%u touches, %u without change, %u overlapped interrupts\n", m.events, m.no_change, m.overlapped);
+    if (m.events) {
+        printf("min %u avg %llu max %u us\n", m.total_min_us, (unsigned long long)(m.total_sum_us / m.events), m.total_max_us);
+        static const char *const names[BSP_LATENCY_MODEL_STAGES] = { "read", "process", "refr_wait", "render", "flush" };
+        for (int i = 0; i < BSP_LATENCY_MODEL_STAGES; i++) {
+            printf("  %-10s avg %6llu max %6u us\n", names[i], (unsigned long long)(m.stage_sum_us[i] / m.events),
+                   m.stage_max_us[i]);
+        }
+    }
+    for (int i = 0; i < BSP_LATENCY_MODEL_BUCKETS; i++) {
+        if (m.hist[i]) {
+            printf("%5d%s ms %6u\n", i * BUCKET_US / 1000, i == BSP_LATENCY_MODEL_BUCKETS - 1 ? "+" : " ", m.hist[i]);
+        }
+    }
+
+    int errors = 0;
+    for (int i = 0; i < BSP_LATENCY_MODEL_BUCKETS; i++) {
+        errors += m.hist[i] != hist[i];
+    }
+    errors += m.events != events || m.no_change != no_change || m.overlapped != (uint32_t)touches;
+    errors += events && (m.total_sum_us != sum_us || m.total_min_us != min_us || m.total_max_us != max_us);
+    errors += bsp_latency_model_state(&m) != BSP_LATENCY_MODEL_IDLE;
+    printf("%s\n", errors ? "MISMATCH" : "model matches the simulation");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+# MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+#
+# Host viewer for the BSP display mirror stream (components/wt32sc01plus/include/bsp/mirror.h).
+#
+#   python3 tools/mirror_viewer.py /dev/ttyUSB0 --baud 921600      live window (needs pyserial)
+#   python3 tools/mirror_viewer.py capture.bin --dump screen.ppm    decode a capture without a window
+#
+# Bytes outside of valid packets (console log output) are skipped.
+
+import argparse
+import struct
+import sys
+
+SYNC = b"\xA5\x5A"
+PKT_FRAME_BEGIN = 1
+PKT_TILE = 2
+PKT_FRAME_END = 3
+MAX_PAYLOAD = 1024
+
+
+def crc16_le(data):
+    """Same as esp_rom_crc16_le(0, data, len)"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFF
+
+
+def rgb565_to_rgb(c):
+    r = (c >> 11) & 0x1F
+    g = (c >> 5) & 0x3F
+    b = c & 0x1F
+    return (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)
+
+
+class Decoder:
+    """Rebuilds the screen from the packet stream"""
+
+    def __init__(self, on_resize=None, on_tile=None, on_frame=None):
+        self.buf = bytearray()
+        self.width = 0
+        self.height = 0
+        self.pixels = []
+        self.frame = 0
+        self.crc_errors = 0
+        self.skipped = 0
+        self.on_resize = on_resize
+        self.on_tile = on_tile
+        self.on_frame = on_frame
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                # Keep a possible first sync byte
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.skipped += len(self.buf) - keep
+                del self.buf[:len(self.buf) - keep]
+                return
+            self.skipped += start
+            del self.buf[:start]
+            if len(self.buf) < 5:
+                return
+            ptype, length = self.buf[2], struct.unpack_from("<H", self.buf, 3)[0]
+            if length > MAX_PAYLOAD:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < 5 + length + 2:
+                return
+            payload = bytes(self.buf[5:5 + length])
+            crc = struct.unpack_from("<H", self.buf, 5 + length)[0]
+            if crc != crc16_le(payload):
+                # Sync bytes inside log output or a corrupted packet, resync after them
+                self.crc_errors += 1
+                del self.buf[:1]
+                continue
+            del self.buf[:5 + length + 2]
+            self.packet(ptype, payload)
+
+    def packet(self, ptype, payload):
+        if ptype == PKT_FRAME_BEGIN:
+            w, h, self.frame = struct.unpack_from("<HHI", payload)
+            if (w, h) != (self.width, self.height):
+                self.width, self.height = w, h
+                self.pixels = [0] * (w * h)
+                if self.on_resize:
+                    self.on_resize(w, h)
+        elif ptype == PKT_TILE and self.width:
+            x, y, tw, th = struct.unpack_from("<HHBB", payload)
+            tile = []
+            for i in range(6, len(payload) - 2, 3):
+                count = payload[i] + 1
+                color = payload[i + 1] | (payload[i + 2] << 8)
+                tile.extend([color] * count)
+            if len(tile) != tw * th or x + tw > self.width or y + th > self.height:
+                return
+            for row in range(th):
+                base = (y + row) * self.width + x
+                self.pixels[base:base + tw] = tile[row * tw:(row + 1) * tw]
+            if self.on_tile:
+                self.on_tile(x, y, tw, th, tile)
+        elif ptype == PKT_FRAME_END:
+            if self.on_frame:
+                self.on_frame(self.frame)
+
+    def write_ppm(self, path):
+        with open(path, "wb") as f:
+            f.write(b"P6\n%d %d\n255\n" % (self.width, self.height))
+            f.write(bytes(v for c in self.pixels for v in rgb565_to_rgb(c)))
+
+
+def run_window(source, args):
+    import tkinter as tk
+
+    root = tk.Tk()
+    root.title("WT32-SC01 Plus mirror")
+    canvas = tk.Canvas(root, highlightthickness=0)
+    canvas.pack()
+    state = {"img": None, "shown": None, "status": canvas.create_text(4, 4, anchor="nw", fill="yellow")}
+
+    def on_resize(w, h):
+        state["img"] = tk.PhotoImage(width=w, height=h)
+        state["shown"] = state["img"].zoom(args.scale) if args.scale > 1 else state["img"]
+        canvas.config(width=w * args.scale, height=h * args.scale)
+        canvas.delete("screen")
+        canvas.create_image(0, 0, anchor="nw", image=state["shown"], tags="screen")
+        canvas.tag_raise(state["status"])
+
+    def on_tile(x, y, tw, th, tile):
+        rows = []
+        for row in range(th):
+            rows.append("{" + " ".join("#%02x%02x%02x" % rgb565_to_rgb(c) for c in tile[row * tw:(row + 1) * tw]) + "}")
+        state["img"].put(" ".join(rows), to=(x, y))
+
+    def on_frame(frame):
+        if args.scale > 1:
+            state["shown"] = state["img"].zoom(args.scale)
+            canvas.itemconfig("screen", image=state["shown"])
+        canvas.itemconfig(state["status"], text="frame %d  crc errors %d" % (frame, decoder.crc_errors))
+
+    decoder = Decoder(on_resize, on_tile, on_frame)
+
+    def poll():
+        data = source.read(4096)
+        if data:
+            decoder.feed(data)
+        root.after(5 if data else 20, poll)
+
+    poll()
+    root.mainloop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="View the BSP display mirror stream")
+    parser.add_argument("source", help="Serial port, or a file with a captured stream")
+    parser.add_argument("--baud", type=int, default=921600, help="UART baud rate (CONFIG_BSP_MIRROR_UART_BAUD)")
+    parser.add_argument("--scale", type=int, default=1, help="Window zoom factor")
+    parser.add_argument("--dump", metavar="PPM", help="Decode without a window and write the last screen as PPM")
+    parser.add_argument("--capture", metavar="FILE", help="Also save the raw stream")
+    args = parser.parse_args()
+
+    if args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        import serial
+        port = serial.Serial(args.source, args.baud, timeout=0)
+        read = port.read
+    else:
+        f = open(args.source, "rb")
+        read = f.read
+
+    capture = open(args.capture, "wb") if args.capture else None
+
+    class Source:
+        @staticmethod
+        def read(n):
+            data = read(n)
+            if capture and data:
+                capture.write(data)
+            return data
+
+    if args.dump:
+        decoder = Decoder()
+        while True:
+            data = Source.read(65536)
+            if not data:
+                break
+            decoder.feed(data)
+        if not decoder.width:
+            sys.exit("No frame in the stream")
+        decoder.write_ppm(args.dump)
+        print("frame %d %dx%d, %d crc errors, %d bytes skipped" %
+              (decoder.frame, decoder.width, decoder.height, decoder.crc_errors, decoder.skipped))
+    else:
+        run_window(Source, args)
+
+
+if __name__ == "__main__":
+    main()
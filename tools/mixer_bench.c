@@ -0,0 +1,220 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Checks the sound effect mixing kernel (bsp_audio_mix.h) on Linux against a 64 bit per sample model
+ * with random clips, rates, gains and play positions, then times it with the load of
+ * bsp_audio_mixer_benchmark().
+ *
+ *   cc -O2 -Wall -I components/wt32sc01plus/priv_include tools/mixer_bench.c -o mixer_bench
+ *   ./mixer_bench [-r rounds] [-s seed] [-b block_frames] [-n blocks] [-m max_voices]
+ *
+ * Host timings only compare kernel changes with each other, bsp_audio_mixer_benchmark() gives the
+ * ESP32-S3 numbers. The exit status is 1 when the kernel differs from the model.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "bsp_audio_mix.h"
+
+#define CHECK_VOICES        32
+#define CHECK_MAX_FRAMES    512
+
+static int s_errors;
+static uint32_t s_rng = 1;
+static volatile int16_t s_sink;     /* Keeps the timed mixes */
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAILED line %d: %s\n", __LINE__, #cond);                \
+            s_errors++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static uint32_t rnd(uint32_t range)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng % range;
+}
+
+static struct bsp_audio_clip *clip_new(uint32_t frames, uint32_t sample_rate)
+{
+    struct bsp_audio_clip *clip = malloc(sizeof(struct bsp_audio_clip) + frames * sizeof(int16_t));
+
+    clip->frames = frames;
+    clip->sample_rate = sample_rate;
+    clip->users = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        /* Mostly near full scale so several voices saturate */
+        clip->pcm[i] = rnd(4) ? (int16_t)(rnd(65536) - 32768) : (rnd(2) ? INT16_MAX : INT16_MIN);
+    }
+    return clip;
+}
+
+/* One voice over one block, sample by sample. Returns false when the voice finished in the block. */
+static bool model_voice(int64_t *acc, size_t frames, const struct bsp_audio_clip *clip, uint32_t *pos,
+                        int32_t gain, uint32_t out_rate, uint32_t master_gain)
+{
+    const uint64_t step = ((uint64_t)clip->sample_rate << AUDIO_MIX_POS_SHIFT) / out_rate;
+    const int64_t g = ((int64_t)gain * master_gain) >> 8;
+
+    for (size_t i = 0; i < frames; i++) {
+        if ((*pos >> AUDIO_MIX_POS_SHIFT) >= clip->frames) {
+            return false;
+        }
+        acc[i] += clip->pcm[*pos >> AUDIO_MIX_POS_SHIFT] * g;
+        *pos += step;
+    }
+    return (*pos >> AUDIO_MIX_POS_SHIFT) < clip->frames;
+}
+
+static int16_t model_sat16(int64_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+}
+
+/* Random voices mixed block after block until all have finished, compared with the model each block */
+static void check_round(void)
+{
+    struct bsp_audio_clip *clips[4];
+    audio_mix_voice_t voices[CHECK_VOICES] = { 0 };
+    uint32_t model_pos[CHECK_VOICES];
+    bool model_on[CHECK_VOICES];
+    int16_t block[2 * CHECK_MAX_FRAMES], expected[2 * CHECK_MAX_FRAMES];
+    int32_t acc[CHECK_MAX_FRAMES];
+    int64_t model_acc[CHECK_MAX_FRAMES];
+    static const uint32_t rates[] = { 8000, 11025, 16000, 22050, 44100, 48000 };
+    const uint32_t out_rate = rates[rnd(6)];
+    const size_t count = 1 + rnd(CHECK_VOICES);
+
+    for (int c = 0; c < 4; c++) {
+        /* Down to a single sample, and rates far from the output rate both ways */
+        clips[c] = clip_new(1 + rnd(c ? 3000 : 4), rates[rnd(6)]);
+    }
+    for (size_t v = 0; v < count; v++) {
+        model_on[v] = rnd(4) != 0;
+        if (model_on[v]) {
+            struct bsp_audio_clip *clip = clips[rnd(4)];
+            voices[v] = (audio_mix_voice_t) {
+                .clip = clip, .pos = rnd(clip->frames) << AUDIO_MIX_POS_SHIFT, .gain = rnd(257)
+            };
+            clip->users++;
+        }
+        model_pos[v] = voices[v].pos;
+    }
+
+    for (int b = 0; b < 100000; b++) {
+        const size_t frames = 1 + rnd(CHECK_MAX_FRAMES);
+        const uint32_t master_gain = rnd(4) ? rnd(257) : 256;
+        bool any = false;
+
+        for (size_t i = 0; i < 2 * frames; i++) {
+            block[i] = (int16_t)(rnd(65536) - 32768);
+        }
+        memset(model_acc, 0, sizeof(model_acc));
+        for (size_t v = 0; v < count; v++) {
+            if (model_on[v]) {
+                model_on[v] = model_voice(model_acc, frames, voices[v].clip, &model_pos[v], voices[v].gain,
+                                          out_rate, master_gain);
+                any = true;
+            }
+        }
+        for (size_t i = 0; i < frames; i++) {
+            expected[2 * i] = any ? model_sat16(block[2 * i] + (model_acc[i] >> 8)) : block[2 * i];
+            expected[2 * i + 1] = any ? model_sat16(block[2 * i + 1] + (model_acc[i] >> 8)) : block[2 * i + 1];
+        }
+
+        audio_mix(block, frames, voices, count, out_rate, master_gain, acc);
+        if (memcmp(block, expected, frames * 2 * sizeof(int16_t)) != 0) {
+            printf("FAILED block %d of %u frames, %u voices at %u Hz\n", b, (unsigned)frames, (unsigned)count,
+                   out_rate);
+            s_errors++;
+            break;
+        }
+        for (size_t v = 0; v < count; v++) {
+            CHECK((voices[v].clip != NULL) == model_on[v]);
+            CHECK(!model_on[v] || voices[v].pos == model_pos[v]);
+        }
+        if (!any || s_errors) {
+            break;
+        }
+    }
+
+    for (int c = 0; c < 4; c++) {
+        /* Every finished voice handed its reference back */
+        CHECK(clips[c]->users == 0);
+        free(clips[c]);
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* The load of bsp_audio_mixer_benchmark() */
+static void bench(int voices, int blocks, size_t block_frames)
+{
+    struct bsp_audio_clip *clip = malloc(sizeof(struct bsp_audio_clip) + AUDIO_MIX_BENCH_CLIP_FRAMES * sizeof(int16_t));
+    audio_mix_voice_t *v = calloc(voices, sizeof(audio_mix_voice_t));
+    int16_t *block = malloc(block_frames * 2 * sizeof(int16_t));
+    int32_t *acc = malloc(block_frames * sizeof(int32_t));
+    int64_t elapsed = 0;
+
+    audio_mix_bench_clip(clip);
+    for (int b = 0; b < blocks; b++) {
+        audio_mix_bench_prepare(block, block_frames, v, voices, clip);
+        const int64_t start = now_ns();
+        audio_mix(block, block_frames, v, voices, AUDIO_MIX_BENCH_RATE, 256, acc);
+        elapsed += now_ns() - start;
+        s_sink = block[b % block_frames];
+    }
+    const uint32_t ns = elapsed / blocks;
+    printf("%2d voices: %6u ns per %u frame block, %.3f%% of real time\n", voices, ns,
+           (unsigned)block_frames, 100.0 * ns / (block_frames * 1e9 / AUDIO_MIX_BENCH_RATE));
+    free(acc);
+    free(block);
+    free(v);
+    free(clip);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 2000, blocks = 20000, max_voices = 16, block_frames = 240;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:s:b:n:m:")) != -1) {
+        switch (opt) {
+        case 'r': rounds = atoi(optarg); break;
+        case 's': s_rng = strtoul(optarg, NULL, 0); break;
+        case 'b': block_frames = atoi(optarg); break;
+        case 'n': blocks = atoi(optarg); break;
+        case 'm': max_voices = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r rounds] [-s seed] [-b block_frames] [-n blocks] [-m max_voices]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (s_rng == 0 || block_frames <= 0 || blocks < 0 || max_voices < 0) {
+        fprintf(stderr, "invalid configuration\n");
+        return 2;
+    }
+
+    for (int r = 0; r < rounds && !s_errors; r++) {
+        check_round();
+    }
+    if (!s_errors) {
+        for (int voices = 1; voices <= max_voices && blocks; voices *= 2) {
+            bench(voices, blocks, block_frames);
+        }
+    }
+
+    printf("%s\n", s_errors ? "MISMATCH" : "kernel matches the model");
+    return s_errors ? 1 : 0;
+}
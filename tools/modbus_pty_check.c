@@ -0,0 +1,494 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Runs the Modbus RTU master of the BSP (bsp_modbus_master_core.c) on Linux against simulated slaves on the
+ * other end of a pseudo-terminal, and checks the poll merging, the poll rates, the register cache, the
+ * writes, the error counters and the t3.5 inter-frame gap.
+ *
+ *   cc -O2 -Wall -pthread -I components/wt32sc01plus/priv_include tools/modbus_pty_check.c \
+ *      components/wt32sc01plus/bsp_modbus_master_core.c components/wt32sc01plus/bsp_modbus_rtu.c \
+ *      -o modbus_pty_check -lutil
+ *   ./modbus_pty_check [-t run_ms] [-b baud_rate] [-v]
+ *
+ * Slave 1 and 2 answer, 3 is silent, 4 answers with exceptions, 5 with a bad CRC and 6 with a short
+ * response. -v prints every frame the slaves receive. The exit status is 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+#include "bsp_modbus_master_core.h"
+
+#define SIM_SLAVES          7
+#define SIM_REGS            256
+#define SIM_GAP_MS          2           /* A pseudo-terminal has no character timing, end of frame silence */
+#define GAP_SLACK_US        1000        /* Scheduling latency between the master sending and the slave waking */
+#define RESPONSE_TIMEOUT_MS 20
+#define MAX_MERGE_GAP       4
+
+static int s_errors;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAILED line %d: %s\n", __LINE__, #cond);                \
+            s_errors++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_until_us(int64_t deadline_us)
+{
+    const struct timespec ts = { .tv_sec = deadline_us / 1000000, .tv_nsec = (deadline_us % 1000000) * 1000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+/* Read one frame: wait `timeout_ms` for the first byte, then until SIM_GAP_MS of silence */
+static size_t read_frame(int fd, uint8_t *buf, size_t size, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    size_t len = 0;
+    int wait_ms = timeout_ms;
+
+    while (poll(&pfd, 1, wait_ms) > 0) {
+        uint8_t byte;
+        const ssize_t n = len < size ? read(fd, buf + len, size - len) : read(fd, &byte, 1);
+        if (n <= 0) {
+            break;
+        }
+        len = len < size ? len + n : size + 1;
+        wait_ms = SIM_GAP_MS;
+    }
+    return len;
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len) {
+        const ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return tcdrain(fd) == 0 ? 0 : -1;
+}
+
+/* Master port on the terminal side of the pseudo-terminal */
+
+static int io_write(void *ctx, const uint8_t *frame, size_t len)
+{
+    return write_all(*(int *)ctx, frame, len);
+}
+
+static int io_read_frame(void *ctx, uint8_t *buf, size_t size, uint32_t timeout_ms, size_t *ret_len)
+{
+    const size_t len = read_frame(*(int *)ctx, buf, size, timeout_ms);
+    if (len > size) {
+        *ret_len = 0;
+        tcflush(*(int *)ctx, TCIFLUSH);
+        return -1;
+    }
+    *ret_len = len;
+    return 0;
+}
+
+static void io_flush_input(void *ctx)
+{
+    tcflush(*(int *)ctx, TCIFLUSH);
+}
+
+static int64_t io_now_us(void *ctx)
+{
+    return now_us();
+}
+
+static void io_wait_until_us(void *ctx, int64_t deadline_us)
+{
+    sleep_until_us(deadline_us);
+}
+
+/* Simulated slaves on the other side */
+
+static struct {
+    int fd;
+    atomic_bool stop;
+    pthread_mutex_t lock;
+    uint16_t regs[SIM_SLAVES][2][SIM_REGS];     /* [slave][input][address] */
+    uint32_t frames[SIM_SLAVES];                /* Frames received per slave address */
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t served[64];                        /* Requests covering each register, see s_polls */
+    int64_t min_gap_us;
+    uint32_t max_count;
+    int verbose;
+} s_sim;
+
+static const modbus_master_entry_t s_polls[] = {
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 60 },
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 1, .period_ms = 150 },
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 2, .period_ms = 300 },
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 5, .period_ms = 300 },
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 10, .period_ms = 150 },
+    { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 40, .period_ms = 60 },
+    { .slave = 1, .function = MODBUS_FC_READ_INPUT, .address = 0, .period_ms = 150 },
+    { .slave = 1, .function = MODBUS_FC_READ_INPUT, .address = 3, .period_ms = 300 },
+    { .slave = 2, .function = MODBUS_FC_READ_HOLDING, .address = 100, .period_ms = 100 },
+    { .slave = 2, .function = MODBUS_FC_READ_HOLDING, .address = 101, .period_ms = 100 },
+    { .slave = 2, .function = MODBUS_FC_READ_INPUT, .address = 7, .period_ms = 200 },
+    { .slave = 3, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 500 },
+    { .slave = 4, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 500 },
+    { .slave = 5, .function = MODBUS_FC_READ_INPUT, .address = 1, .period_ms = 500 },
+    { .slave = 6, .function = MODBUS_FC_READ_HOLDING, .address = 2, .period_ms = 500 },
+};
+#define NUM_POLLS   (sizeof(s_polls) / sizeof(s_polls[0]))
+
+static void sim_respond(const uint8_t *req, size_t len, int64_t *ret_end_us)
+{
+    uint8_t rsp[MODBUS_RTU_MAX_FRAME];
+    size_t n = 0;
+    const uint8_t slave = req[0];
+    const uint8_t fc = req[1];
+    const uint16_t address = modbus_rtu_get_u16(&req[2]);
+    const uint16_t arg = modbus_rtu_get_u16(&req[4]);
+
+    pthread_mutex_lock(&s_sim.lock);
+    if (fc == MODBUS_FC_WRITE_SINGLE) {
+        s_sim.writes++;
+        for (int s = 1; s < SIM_SLAVES; s++) {
+            if (s == slave || slave == 0) {
+                s_sim.regs[s][0][address % SIM_REGS] = arg;
+            }
+        }
+        if (slave != 0) {
+            memcpy(rsp, req, 6);
+            n = 6;
+        }
+    } else {
+        s_sim.reads++;
+        s_sim.max_count = arg > s_sim.max_count ? arg : s_sim.max_count;
+        for (size_t i = 0; i < NUM_POLLS; i++) {
+            if (s_polls[i].slave == slave && s_polls[i].function == fc &&
+                    s_polls[i].address >= address && s_polls[i].address < address + arg) {
+                s_sim.served[i]++;
+            }
+        }
+        rsp[0] = slave;
+        rsp[1] = fc;
+        if (slave == 4) {
+            rsp[1] |= MODBUS_FC_EXCEPTION;
+            rsp[2] = MODBUS_EX_ILLEGAL_ADDRESS;
+            n = 3;
+        } else {
+            rsp[2] = arg * 2;
+            for (uint16_t r = 0; r < arg; r++) {
+                modbus_rtu_put_u16(&rsp[3 + 2 * r], s_sim.regs[slave][fc == MODBUS_FC_READ_INPUT][(address + r) % SIM_REGS]);
+            }
+            /* Slave 6 drops the last register */
+            n = 3 + 2 * arg - (slave == 6 ? 2 : 0);
+        }
+    }
+    pthread_mutex_unlock(&s_sim.lock);
+
+    if (n == 0 || slave == 3) {
+        return;
+    }
+    n = modbus_rtu_seal(rsp, n);
+    if (slave == 5) {
+        rsp[n - 1] ^= 0x01;
+    }
+    write_all(s_sim.fd, rsp, n);
+    *ret_end_us = now_us();
+}
+
+/*
+ * All requests of the master are 8 bytes long. They are read by length rather than by SIM_GAP_MS of
+ * silence, which is longer than t3.5 above 19200 baud, so frames sent too early stay apart and show up
+ * in the gap.
+ */
+static size_t sim_read_request(uint8_t *req, int64_t *ret_first_us)
+{
+    struct pollfd pfd = { .fd = s_sim.fd, .events = POLLIN };
+    size_t len = 0;
+    int wait_ms = 50;
+
+    while (len < 8 && poll(&pfd, 1, wait_ms) > 0) {
+        const ssize_t n = read(s_sim.fd, req + len, 8 - len);
+        if (n <= 0) {
+            break;
+        }
+        if (len == 0) {
+            *ret_first_us = now_us();
+        }
+        len += n;
+        wait_ms = RESPONSE_TIMEOUT_MS;
+    }
+    return len;
+}
+
+static void *sim_task(void *arg)
+{
+    uint8_t req[8];
+    int64_t last_us = 0;
+
+    while (!atomic_load(&s_sim.stop)) {
+        int64_t first_us = 0;
+        const size_t len = sim_read_request(req, &first_us);
+        if (len == 0) {
+            continue;
+        }
+        if (s_sim.verbose) {
+            printf("%8.3f:", first_us / 1000.0);
+            for (size_t i = 0; i < len; i++) {
+                printf(" %02x", req[i]);
+            }
+            printf("\n");
+        }
+        if (len != 8 || !modbus_rtu_crc_ok(req, len) || req[0] >= SIM_SLAVES) {
+            printf("FAILED: bad request of %d bytes\n", (int)len);
+            s_errors++;
+            continue;
+        }
+        /* Silence since the end of the previous frame on the bus */
+        if (last_us && first_us - last_us < s_sim.min_gap_us) {
+            s_sim.min_gap_us = first_us - last_us;
+        }
+        last_us = first_us;
+        s_sim.frames[req[0]]++;
+        sim_respond(req, len, &last_us);
+    }
+    return NULL;
+}
+
+static struct {
+    uint32_t calls;
+    uint16_t last[NUM_POLLS];
+} s_changes;
+
+static void on_change(size_t id, uint16_t value, void *user_ctx)
+{
+    CHECK(user_ctx == &s_changes && id < NUM_POLLS);
+    s_changes.calls++;
+    s_changes.last[id] = value;
+}
+
+/* Request merging without the bus, all polls but one due at 0 */
+static void check_plan(void)
+{
+    modbus_master_entry_t entries[] = {
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 200, .period_ms = 100, .id = 0 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 10, .period_ms = 100, .id = 1 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 100, .id = 2 },
+        { .slave = 1, .function = MODBUS_FC_READ_INPUT, .address = 1, .period_ms = 100, .id = 3 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 5, .period_ms = 100, .id = 4 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 15, .period_ms = 1000, .id = 5 },  /* Not due */
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 20, .period_ms = 100, .id = 6 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 22, .period_ms = 1000, .id = 10 }, /* Not due */
+        { .slave = 2, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 100, .id = 7 },
+        { .slave = 2, .function = MODBUS_FC_READ_HOLDING, .address = 124, .period_ms = 100, .id = 8 },  /* 125 registers from 0 */
+        { .slave = 2, .function = MODBUS_FC_READ_HOLDING, .address = 125, .period_ms = 100, .id = 9 },
+    };
+    modbus_master_t m = {
+        .entries = entries,
+        .num = sizeof(entries) / sizeof(entries[0]),
+        .baud_rate = 9600,
+        .max_merge_gap = MAX_MERGE_GAP,
+    };
+    modbus_request_t req;
+
+    for (size_t i = 0; i < m.num; i++) {
+        entries[i].next_due_us = entries[i].period_ms == 1000 ? 1000000 : 0;
+    }
+    modbus_master_init(&m);
+    CHECK(modbus_master_next_due(&m) == 0);
+
+    /* 5, 10 and 20 merged into the read of 0, 15 is not due but bridges the gap to 20 and is read too, 22 is left */
+    CHECK(modbus_master_plan(&m, 0, &req));
+    CHECK(req.start == 0 && req.count == 21 && req.first == 0 && req.last == 4);
+    CHECK(m.stats.merged == 4);
+    CHECK(req.len == 8 && req.frame[0] == 1 && req.frame[1] == MODBUS_FC_READ_HOLDING && modbus_rtu_crc_ok(req.frame, 8));
+    CHECK(modbus_rtu_get_u16(&req.frame[2]) == 0 && modbus_rtu_get_u16(&req.frame[4]) == 21);
+    CHECK(modbus_master_plan(&m, 0, &req) && req.start == 200 && req.count == 1);
+    CHECK(modbus_master_plan(&m, 0, &req) && req.frame[1] == MODBUS_FC_READ_INPUT && req.start == 1);
+    /* At most 125 registers, whatever the gap */
+    m.max_merge_gap = MODBUS_RTU_MAX_READ_REGS;
+    CHECK(modbus_master_plan(&m, 0, &req) && req.frame[0] == 2 && req.start == 0 && req.count == 125);
+    CHECK(modbus_master_plan(&m, 0, &req) && req.start == 125 && req.count == 1);
+    CHECK(!modbus_master_plan(&m, 0, &req));
+    CHECK(modbus_master_next_due(&m) == 100000);
+
+    /* Served 30 ms late: next poll on the grid, served 250 ms late: one period from now */
+    CHECK(modbus_master_plan(&m, 130000, &req) && m.entries[req.first].next_due_us == 200000);
+    const size_t late = m.stats.late;
+    CHECK(modbus_master_plan(&m, 350000, &req) && m.entries[req.first].next_due_us == 450000);
+    CHECK(m.stats.late == late + 1);
+
+    /* Served 40 ms early: one period from now rather than on its grid */
+    modbus_master_entry_t pair[] = {
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 1, .period_ms = 100, .next_due_us = 40000 },
+        { .slave = 1, .function = MODBUS_FC_READ_HOLDING, .address = 0, .period_ms = 100 },
+    };
+    m = (modbus_master_t) {
+        .entries = pair,
+        .num = 2,
+    };
+    modbus_master_init(&m);
+    CHECK(modbus_master_plan(&m, 0, &req) && req.count == 2 && m.stats.merged == 1);
+    CHECK(pair[0].next_due_us == 100000 && pair[1].next_due_us == 100000);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t run_ms = 2000, baud_rate = 9600;
+    int term_fd, opt;
+    pthread_t sim;
+
+    while ((opt = getopt(argc, argv, "t:b:v")) != -1) {
+        switch (opt) {
+        case 't': run_ms = strtoul(optarg, NULL, 0); break;
+        case 'b': baud_rate = strtoul(optarg, NULL, 0); break;
+        case 'v': s_sim.verbose = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-t run_ms] [-b baud_rate] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    /* Below 9600 baud the poll table does not fit on the bus */
+    if (run_ms < 1000 || baud_rate < 9600) {
+        fprintf(stderr, "invalid configuration\n");
+        return 2;
+    }
+
+    check_plan();
+
+    struct termios tio;
+    if (openpty(&s_sim.fd, &term_fd, NULL, NULL, NULL) != 0) {
+        perror("openpty");
+        return 2;
+    }
+    tcgetattr(term_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(term_fd, TCSANOW, &tio);
+
+    for (int s = 0; s < SIM_SLAVES; s++) {
+        for (int r = 0; r < SIM_REGS; r++) {
+            s_sim.regs[s][0][r] = s * 1000 + r;
+            s_sim.regs[s][1][r] = s * 1000 + r + 500;
+        }
+    }
+    pthread_mutex_init(&s_sim.lock, NULL);
+    s_sim.min_gap_us = INT64_MAX;
+    pthread_create(&sim, NULL, sim_task, NULL);
+
+    modbus_master_entry_t entries[NUM_POLLS];
+    modbus_master_cache_t cache[NUM_POLLS] = { 0 };
+    modbus_master_t m = {
+        .io = {
+            .write = io_write,
+            .read_frame = io_read_frame,
+            .flush_input = io_flush_input,
+            .now_us = io_now_us,
+            .wait_until_us = io_wait_until_us,
+            .ctx = &term_fd,
+        },
+        .entries = entries,
+        .cache = cache,
+        .num = NUM_POLLS,
+        .baud_rate = baud_rate,
+        .response_timeout_ms = RESPONSE_TIMEOUT_MS,
+        .max_merge_gap = MAX_MERGE_GAP,
+        .on_change = on_change,
+        .user_ctx = &s_changes,
+    };
+    const int64_t start = now_us();
+    const int64_t end = start + run_ms * 1000LL;
+    int step = 0;
+
+    for (size_t i = 0; i < NUM_POLLS; i++) {
+        entries[i] = s_polls[i];
+        entries[i].id = i;
+        entries[i].next_due_us = start;
+    }
+    modbus_master_init(&m);
+
+    /* The master task: writes first, then polls, sleep until the next poll is due */
+    for (int64_t now = start; now < end; now = now_us()) {
+        if (step == 0 && now - start > run_ms * 200LL) {
+            CHECK(modbus_master_write_single(&m, 1, 10, 0xBEEF));
+            step++;
+        } else if (step == 1 && now - start > run_ms * 400LL) {
+            CHECK(modbus_master_write_single(&m, 0, 5, 0x1234));
+            step++;
+        } else if (step == 2 && now - start > run_ms * 500LL) {
+            CHECK(!modbus_master_write_single(&m, 3, 5, 1));
+            pthread_mutex_lock(&s_sim.lock);
+            s_sim.regs[2][1][7] = 0x7777;
+            pthread_mutex_unlock(&s_sim.lock);
+            step++;
+        } else if (!modbus_master_poll(&m)) {
+            const int64_t due = modbus_master_next_due(&m);
+            sleep_until_us(due < end ? due : end);
+        }
+    }
+    atomic_store(&s_sim.stop, true);
+    pthread_join(sim, NULL);
+
+    const modbus_master_stats_t *st = &m.stats;
+    uint32_t served = 0;
+    printf("%u requests, %u writes, %u merged, %u late, %u timeouts, %u crc errors, %u exceptions, %u bad, "
+           "max rtt %u us, min gap %d us\n", st->requests, st->writes, st->merged, st->late, st->timeouts,
+           st->crc_errors, st->exceptions, st->bad_responses, st->max_rtt_us, (int)s_sim.min_gap_us);
+
+    /* Every frame reached the slaves, the silent, faulty ones are counted */
+    CHECK(st->requests == s_sim.reads && st->writes == s_sim.writes && st->writes == 3);
+    CHECK(st->timeouts == s_sim.frames[3] && s_sim.frames[3] > 0);
+    CHECK(st->exceptions == s_sim.frames[4] && s_sim.frames[4] > 0);
+    CHECK(st->crc_errors == s_sim.frames[5] && s_sim.frames[5] > 0);
+    CHECK(st->bad_responses == s_sim.frames[6] && s_sim.frames[6] > 0);
+    CHECK(st->max_rtt_us > 0 && st->max_rtt_us < RESPONSE_TIMEOUT_MS * 1000);
+    CHECK(s_sim.max_count <= MODBUS_RTU_MAX_READ_REGS);
+    /* t3.5 of silence before every frame */
+    CHECK(s_sim.min_gap_us + GAP_SLACK_US >= modbus_rtu_t35_us(baud_rate));
+
+    for (size_t i = 0; i < NUM_POLLS; i++) {
+        const modbus_master_entry_t *p = &s_polls[i];
+        const uint32_t expected = run_ms / p->period_ms;
+        served += s_sim.served[i];
+        /* At least at its rate, reads merged for other polls refresh it more often */
+        if (s_sim.served[i] * 10 < expected * 9) {
+            printf("FAILED poll %d:%d:%d every %u ms served %u times in %u ms\n", p->slave, p->function, p->address,
+                   p->period_ms, s_sim.served[i], run_ms);
+            s_errors++;
+        }
+        if (p->slave > 2) {
+            CHECK(!cache[i].valid);
+            continue;
+        }
+        CHECK(cache[i].valid && cache[i].value == s_sim.regs[p->slave][p->function == MODBUS_FC_READ_INPUT][p->address]);
+        CHECK(s_changes.last[i] == cache[i].value);
+    }
+    /* Merged polls make fewer requests than polls served */
+    CHECK(st->merged > 0 && st->requests < served);
+    CHECK(cache[4].value == 0xBEEF && cache[3].value == 0x1234 && cache[10].value == 0x7777);
+    CHECK(s_changes.calls == 11 + 3);
+
+    close(term_fd);
+    close(s_sim.fd);
+    printf("%s\n", s_errors ? "MISMATCH" : "master matches the simulated bus");
+    return s_errors ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * MIT License - Copyright (c) 2024 Sukesh Ashok Kumar
+ *
+ * Checks the Modbus RTU framing of the BSP master and slave (bsp_modbus_rtu.c) on Linux against frames
+ * from the Modbus specification and a bitwise CRC.
+ *
+ *   cc -O2 -Wall -I components/wt32sc01plus/priv_include tools/modbus_rtu_check.c \
+ *      components/wt32sc01plus/bsp_modbus_rtu.c -o modbus_rtu_check
+ *   ./modbus_rtu_check
+ *
+ * The exit status is 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "bsp_modbus_rtu.h"
+
+static int s_errors;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("FAILED line %d: %s\n", __LINE__, #cond);                \
+            s_errors++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/* Reference for the table driven CRC */
+static uint16_t crc16_bitwise(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+int main(void)
+{
+    uint8_t frame[MODBUS_RTU_MAX_FRAME];
+    uint32_t rng = 0x12345678;
+
+    /* CRC check value of the CRC-16/MODBUS catalogue entry */
+    CHECK(modbus_rtu_crc16((const uint8_t *)"123456789", 9) == 0x4B37);
+    for (size_t len = 0; len <= MODBUS_RTU_MAX_FRAME; len++) {
+        for (size_t i = 0; i < len; i++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            frame[i] = (uint8_t)rng;
+        }
+        CHECK(modbus_rtu_crc16(frame, len) == crc16_bitwise(frame, len));
+    }
+
+    /* Requests of the specification examples, CRC low byte first */
+    static const uint8_t read[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD };
+    CHECK(modbus_rtu_build_read(frame, 1, MODBUS_FC_READ_HOLDING, 0, 10) == sizeof(read));
+    CHECK(memcmp(frame, read, sizeof(read)) == 0);
+    CHECK(modbus_rtu_crc_ok(frame, sizeof(read)));
+    static const uint8_t write[] = { 0x01, 0x06, 0x00, 0x01, 0x00, 0x03, 0x98, 0x0B };
+    CHECK(modbus_rtu_build_write_single(frame, 1, 1, 3) == sizeof(write));
+    CHECK(memcmp(frame, write, sizeof(write)) == 0);
+
+    /* Any flipped bit breaks the CRC, too short frames never pass */
+    for (size_t bit = 0; bit < sizeof(write) * 8; bit++) {
+        memcpy(frame, write, sizeof(write));
+        frame[bit / 8] ^= 1 << (bit % 8);
+        CHECK(!modbus_rtu_crc_ok(frame, sizeof(write)));
+    }
+    CHECK(!modbus_rtu_crc_ok(write, MODBUS_RTU_MIN_FRAME - 1));
+    CHECK(modbus_rtu_seal(frame, 2) == MODBUS_RTU_MIN_FRAME && modbus_rtu_crc_ok(frame, MODBUS_RTU_MIN_FRAME));
+
+    /* t3.5 is 3.5 characters of 11 bits up to 19200 baud, then fixed */
+    CHECK(modbus_rtu_t35_us(9600) == 4011);
+    CHECK(modbus_rtu_t35_us(19200) == 2006);
+    CHECK(modbus_rtu_t35_us(38400) == 1750);
+    CHECK(modbus_rtu_t35_us(0) == 1750);
+    CHECK(modbus_rtu_frame_us(9600, 8) == 9167);
+    CHECK(modbus_rtu_frame_us(115200, MODBUS_RTU_MAX_FRAME) == 24445);
+    CHECK(modbus_rtu_frame_us(0, 8) == 0);
+
+    printf("%s\n", s_errors ? "MISMATCH" : "framing matches the specification");
+    return s_errors ? 1 : 0;
+}